@@ -20,6 +20,8 @@
 #include "segment.h"
 #include "iostat.h"
 #include <trace/events/f2fs.h>
+#include "j_log_operate.h"
+#include "j_recovery.h"
 
 #define DEFAULT_CHECKPOINT_IOPRIO (IOPRIO_PRIO_VALUE(IOPRIO_CLASS_BE, 3))
 
@@ -310,6 +312,9 @@ static int __f2fs_write_meta_page(struct page *page,
 		goto redirty_out;
 	if (wbc->for_reclaim && page->index < GET_SUM_BLOCK(sbi, 0))
 		goto redirty_out;
+#if F2FSJ_CTRL_CP
+	clear_page_journal_dirty(sbi, page);
+#endif
 
 	f2fs_do_write_meta_page(sbi, page, io_type);
 	dec_page_count(sbi, F2FS_DIRTY_META);
@@ -409,6 +414,11 @@ continue_unlock:
 				/* someone wrote it for us */
 				goto continue_unlock;
 			}
+#if F2FSJ_CTRL_CP
+			/* journal covers it, write it once at journal apply */
+			if (f2fsj_absorb_page_write(sbi, page, &wbc, io_type))
+				goto continue_unlock;
+#endif
 
 			f2fs_wait_on_page_writeback(page, META, true, true);
 
@@ -605,6 +615,10 @@ int f2fs_acquire_orphan_inode(struct f2fs_sb_info *sbi)
 		return -ENOSPC;
 	}
 
+	/*
+	 * f2fsj: the slot is kept only if the orphan cannot be journaled,
+	 * see f2fsj_add_orphan_inode().
+	 */
 	if (unlikely(im->ino_num >= sbi->max_orphans))
 		err = -ENOSPC;
 	else
@@ -624,10 +638,69 @@ void f2fs_release_orphan_inode(struct f2fs_sb_info *sbi)
 	spin_unlock(&im->ino_lock);
 }
 
+#if F2FSJ_CTRL_CP
+/*
+ * caller reserved an orphan slot by f2fs_acquire_orphan_inode(), a journaled
+ * orphan gives it back, so only orphans in flight count against max_orphans.
+ */
+static void f2fsj_add_orphan_inode(struct f2fs_sb_info *sbi, nid_t ino)
+{
+	if (j_log_orphan(ino, 0) == F2FSJ_OK) {
+		__add_ino_entry(sbi, ino, 0, J_ORPHAN_INO);
+		f2fs_release_orphan_inode(sbi);
+		return;
+	}
+
+	/* no free log entry, use the reserved slot in orphan blocks */
+	__add_ino_entry(sbi, ino, 0, ORPHAN_INO);
+}
+
+/*
+ * tmpfile is linked by linkat, journal it so replay does not free the
+ * inode which may have been linked by a later checkpoint.
+ */
+void f2fsj_relink_orphan_inode(struct f2fs_sb_info *sbi, nid_t ino)
+{
+	if (f2fs_exist_written_data(sbi, ino, J_ORPHAN_INO))
+		j_log_orphan(ino, J_ORPHAN_RELINK);
+	f2fs_remove_orphan_inode(sbi, ino);
+}
+
+/*
+ * journal tail moves past the logs applied by checkpoint, log orphans alive
+ * at that point again behind it, freed orphans are dropped from journal in
+ * this way. Caller writes the logs before it moves the tail.
+ */
+void f2fsj_relog_orphan_inodes(struct f2fs_sb_info *sbi)
+{
+	struct inode_management *im = &sbi->im[J_ORPHAN_INO];
+	struct ino_entry *orphan;
+	unsigned int nr_lost = 0;
+
+	/* orphan inode operations are covered under f2fs_lock_op() */
+	f2fs_lock_all(sbi);
+	list_for_each_entry(orphan, &im->ino_list, list) {
+		if (j_log_orphan(orphan->ino, 0) != F2FSJ_OK)
+			nr_lost++;
+	}
+	f2fs_unlock_all(sbi);
+
+	if (nr_lost) {
+		set_sbi_flag(sbi, SBI_NEED_FSCK);
+		f2fs_warn(sbi, "%u orphan inodes are not journaled, run fsck to fix.",
+			  nr_lost);
+	}
+}
+#endif
+
 void f2fs_add_orphan_inode(struct inode *inode)
 {
 	/* add new orphan ino entry into list */
+#if F2FSJ_CTRL_CP
+	f2fsj_add_orphan_inode(F2FS_I_SB(inode), inode->i_ino);
+#else
 	__add_ino_entry(F2FS_I_SB(inode), inode->i_ino, 0, ORPHAN_INO);
+#endif
 	f2fs_update_inode_page(inode);
 }
 
@@ -635,6 +708,9 @@ void f2fs_remove_orphan_inode(struct f2fs_sb_info *sbi, nid_t ino)
 {
 	/* remove orphan entry from orphan list */
 	__remove_ino_entry(sbi, ino, ORPHAN_INO);
+#if F2FSJ_CTRL_CP
+	__remove_ino_entry(sbi, ino, J_ORPHAN_INO);
+#endif
 }
 
 static int recover_orphan_inode(struct f2fs_sb_info *sbi, nid_t ino)
@@ -653,6 +729,14 @@ static int recover_orphan_inode(struct f2fs_sb_info *sbi, nid_t ino)
 		return PTR_ERR(inode);
 	}
 
+#if F2FSJ_CTRL_CP
+	/* journaled orphan is linked again by linkat before the checkpoint */
+	if (inode->i_nlink) {
+		iput(inode);
+		return 0;
+	}
+#endif
+
 	err = dquot_initialize(inode);
 	if (err) {
 		iput(inode);
@@ -682,17 +766,44 @@ err_out:
 	return err;
 }
 
+#if F2FSJ_CTRL_CP
+static int f2fsj_recover_journal_orphan(struct f2fs_sb_info *sbi, nid_t ino)
+{
+	struct node_info ni;
+	int err;
+
+	err = f2fs_get_node_info(sbi, ino, &ni);
+	if (err)
+		return err;
+
+	/* journal is not trimmed by checkpoint, inode may be freed already */
+	if (ni.blk_addr == NULL_ADDR)
+		return 0;
+
+	return recover_orphan_inode(sbi, ino);
+}
+#endif
+
 int f2fs_recover_orphan_inodes(struct f2fs_sb_info *sbi)
 {
 	block_t start_blk, orphan_blocks, i, j;
 	unsigned int s_flags = sbi->sb->s_flags;
 	int err = 0;
+#if F2FSJ_CTRL_CP
+	nid_t ino;
+#endif
 #ifdef CONFIG_QUOTA
 	int quota_enabled;
 #endif
 
+#if F2FSJ_CTRL_CP
+	if (!is_set_ckpt_flags(sbi, CP_ORPHAN_PRESENT_FLAG) &&
+			!j_has_journal_orphans())
+		return 0;
+#else
 	if (!is_set_ckpt_flags(sbi, CP_ORPHAN_PRESENT_FLAG))
 		return 0;
+#endif
 
 	if (bdev_read_only(sbi->sb->s_bdev)) {
 		f2fs_info(sbi, "write access unavailable, skipping orphan cleanup");
@@ -717,6 +828,10 @@ int f2fs_recover_orphan_inodes(struct f2fs_sb_info *sbi)
 
 	start_blk = __start_cp_addr(sbi) + 1 + __cp_payload(sbi);
 	orphan_blocks = __start_sum_addr(sbi) - 1 - __cp_payload(sbi);
+#if F2FSJ_CTRL_CP
+	if (!is_set_ckpt_flags(sbi, CP_ORPHAN_PRESENT_FLAG))
+		orphan_blocks = 0;
+#endif
 
 	f2fs_ra_meta_pages(sbi, start_blk, orphan_blocks, META_CP, true);
 
@@ -742,6 +857,16 @@ int f2fs_recover_orphan_inodes(struct f2fs_sb_info *sbi)
 		}
 		f2fs_put_page(page, 1);
 	}
+#if F2FSJ_CTRL_CP
+	/* orphans since the last checkpoint are collected by journal replay */
+	while ((ino = j_pop_journal_orphan())) {
+		err = f2fsj_recover_journal_orphan(sbi, ino);
+		if (err) {
+			j_drop_journal_orphans();
+			goto out;
+		}
+	}
+#endif
 	/* clear Orphan Flag */
 	clear_ckpt_flags(sbi, CP_ORPHAN_PRESENT_FLAG);
 out:
@@ -1663,6 +1788,10 @@ int f2fs_write_checkpoint(struct f2fs_sb_info *sbi, struct cp_control *cpc)
 	 */
 	ckpt_ver = cur_cp_version(ckpt);
 	ckpt->checkpoint_ver = cpu_to_le64(++ckpt_ver);
+#if F2FSJ_CTRL_CP
+	/* NAT/SIT/SSA changed so far are written by this checkpoint */
+	j_meta_deltas_new_checkpoint(ckpt_ver);
+#endif
 
 	/* write cached NAT/SIT entries to NAT/SIT area */
 	err = f2fs_flush_nat_entries(sbi, cpc);
@@ -1706,120 +1835,94 @@ out:
 	return err;
 }
 
-int j_apply_flushing(struct f2fs_sb_info *sbi, struct cp_control *cpc)
+/*
+ * f2fsj: write back the pages of the applied epochs before freezing FS
+ * operations. New operations keep running and log into later epochs while
+ * this happens, so block_operations() only has to flush what was dirtied in
+ * the meantime. Caller holds cp_global_sem.
+ */
+static int j_prepare_operations(struct f2fs_sb_info *sbi)
 {
-	int err = 0;
 	struct writeback_control wbc = {
-		.sync_mode = WB_SYNC_NONE,
+		.sync_mode = WB_SYNC_ALL,
 		.nr_to_write = LONG_MAX,
 		.for_reclaim = 0,
 	};
+	int err = 0;
 
+	f2fs_flush_inline_data(sbi);
 
-	struct f2fs_checkpoint *ckpt = F2FS_CKPT(sbi);
-	unsigned long long ckpt_ver;
-
-
-	if (f2fs_readonly(sbi->sb) || f2fs_hw_is_readonly(sbi))
-		return -EROFS;
-
-	if (unlikely(is_sbi_flag_set(sbi, SBI_CP_DISABLED))) {
-		if (cpc->reason != CP_PAUSE)
-			return 0;
-		f2fs_warn(sbi, "Start checkpoint disabled!");
+	if (get_pages(sbi, F2FS_DIRTY_DENTS)) {
+		err = f2fs_sync_dirty_inodes(sbi, DIR_INODE);
+		if (err)
+			return err;
 	}
-	if (cpc->reason != CP_RESIZE)
-		down_write(&sbi->cp_global_sem);
 
-	if (!is_sbi_flag_set(sbi, SBI_IS_DIRTY) &&
-		((cpc->reason & CP_FASTBOOT) || (cpc->reason & CP_SYNC) ||
-		((cpc->reason & CP_DISCARD) && !sbi->discard_blks)))
-		goto out;
-	if (unlikely(f2fs_cp_error(sbi))) {
-		err = -EIO;
-		goto out;
+	if (get_pages(sbi, F2FS_DIRTY_IMETA)) {
+		err = f2fs_sync_inode_meta(sbi);
+		if (err)
+			return err;
 	}
 
-	trace_f2fs_write_checkpoint(sbi->sb, cpc->reason, "start block_ops");
-
-	//err = block_operations(sbi);
-	// if (err)
-	// 	goto out;
-
-
-	trace_f2fs_write_checkpoint(sbi->sb, cpc->reason, "finish block_ops");
-
-	f2fs_flush_merged_writes(sbi);
-
-
-	/* this is the case of multiple fstrims without any changes */
-	if (cpc->reason & CP_DISCARD) {
-		if (!f2fs_exist_trim_candidates(sbi, cpc)) {
-			//unblock_operations(sbi);
-			goto out;
-		}
-
-		if (NM_I(sbi)->nat_cnt[DIRTY_NAT] == 0 &&
-				SIT_I(sbi)->dirty_sentries == 0 &&
-				prefree_segments(sbi) == 0) {
-			f2fs_flush_sit_entries(sbi, cpc);
-			f2fs_clear_prefree_segments(sbi, cpc);
-			//unblock_operations(sbi);
-			goto out;
-		}
+	if (get_pages(sbi, F2FS_DIRTY_NODES)) {
+		atomic_inc(&sbi->wb_sync_req[NODE]);
+		err = f2fs_sync_node_pages(sbi, &wbc, false, FS_JOURNAL_CP_IO);
+		atomic_dec(&sbi->wb_sync_req[NODE]);
+		if (err)
+			return err;
 	}
 
+	/* SSA and already flushed NAT/SIT pages do not depend on cp_rwsem */
+	if (get_pages(sbi, F2FS_DIRTY_META))
+		f2fs_sync_meta_pages(sbi, META, LONG_MAX, FS_JOURNAL_CP_IO);
 
-	/*
-	 * update checkpoint pack index
-	 * Increase the version number so that
-	 * SIT entries and seg summaries are written at correct place
-	 */
-	ckpt_ver = cur_cp_version(ckpt);
-	ckpt->checkpoint_ver = cpu_to_le64(++ckpt_ver);
-
-	/* write cached NAT/SIT entries to NAT/SIT area */
-	err = f2fs_flush_nat_entries(sbi, cpc);
-	if (err) {
-		f2fs_err(sbi, "f2fs_flush_nat_entries failed err:%d, stop checkpoint", err);
-		f2fs_bug_on(sbi, !f2fs_cp_error(sbi));
-		goto stop;
-	}
+	return err;
+}
 
+/*
+ * f2fsj checkpoint, first step: flush dirty inodes, node and meta pages
+ * while FS operations and epoch commits go on. cp_global_sem keeps it
+ * apart from checkpoints, which flush the same lists.
+ */
+int j_prepare_flushing(struct f2fs_sb_info *sbi)
+{
+	int err;
 
-	f2fs_flush_sit_entries(sbi, cpc);
+	if (f2fs_readonly(sbi->sb) || f2fs_hw_is_readonly(sbi))
+		return -EROFS;
 
-	/* save inmem log status */
-	f2fs_save_inmem_curseg(sbi);
+	if (unlikely(is_sbi_flag_set(sbi, SBI_CP_DISABLED)))
+		return 0;
 
+	down_write(&sbi->cp_global_sem);
 
-	err = do_checkpoint(sbi, cpc);
-	if (err) {
-		f2fs_err(sbi, "do_checkpoint failed err:%d, stop checkpoint", err);
-		f2fs_bug_on(sbi, !f2fs_cp_error(sbi));
-		f2fs_release_discard_addrs(sbi);
-	} else {
-		f2fs_clear_prefree_segments(sbi, cpc);
+	if (unlikely(f2fs_cp_error(sbi))) {
+		err = -EIO;
+		goto out;
 	}
 
-
-	f2fs_restore_inmem_curseg(sbi);
-stop:
-	//unblock_operations(sbi);
-	stat_inc_cp_count(sbi->stat_info);
-
-	if (cpc->reason & CP_RECOVERY)
-		f2fs_notice(sbi, "checkpoint: version = %llx", ckpt_ver);
-
-	/* update CP_TIME to trigger checkpoint periodically */
-	f2fs_update_time(sbi, CP_TIME);
-	trace_f2fs_write_checkpoint(sbi->sb, cpc->reason, "finish checkpoint");
+	trace_f2fs_write_checkpoint(sbi->sb, CP_FASTBOOT, "start prepare_ops");
+	err = j_prepare_operations(sbi);
+	trace_f2fs_write_checkpoint(sbi->sb, CP_FASTBOOT, "finish prepare_ops");
 out:
-	if (cpc->reason != CP_RESIZE)
-		up_write(&sbi->cp_global_sem);
+	up_write(&sbi->cp_global_sem);
 	return err;
 }
 
+/*
+ * f2fsj checkpoint, second step: write the checkpoint pack which the journal
+ * tail moves after. block_operations() still freezes FS operations, but only
+ * for what was dirtied since j_prepare_flushing(). Meta deltas are kept, they
+ * are stamped by the version of this checkpoint in f2fs_write_checkpoint().
+ */
+int j_apply_flushing(struct f2fs_sb_info *sbi, struct cp_control *cpc)
+{
+	/* absorbed updates do not dirty FS, the checkpoint is written anyway */
+	set_sbi_flag(sbi, SBI_IS_DIRTY);
+
+	return f2fs_write_checkpoint(sbi, cpc);
+}
+
 
 void f2fs_init_ino_entry_info(struct f2fs_sb_info *sbi)
 {
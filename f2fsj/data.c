@@ -26,6 +26,8 @@
 #include "node.h"
 #include "segment.h"
 #include "iostat.h"
+#include "j_log_operate.h"
+#include "j_op_lat.h"
 #include <trace/events/f2fs.h>
 
 #define NUM_PREALLOC_POST_READ_CTXS	128
@@ -3368,7 +3370,7 @@ unlock_out:
 	return err;
 }
 
-static int f2fs_write_begin(struct file *file, struct address_space *mapping,
+static int __f2fs_write_begin(struct file *file, struct address_space *mapping,
 		loff_t pos, unsigned len, unsigned flags,
 		struct page **pagep, void **fsdata)
 {
@@ -3506,12 +3508,29 @@ fail:
 	return err;
 }
 
+/* nothing is journaled before write_end, all of it is f2fs core work */
+static int f2fs_write_begin(struct file *file, struct address_space *mapping,
+		loff_t pos, unsigned len, unsigned flags,
+		struct page **pagep, void **fsdata)
+{
+	j_op_lat_t lat;
+	int err;
+
+	j_op_lat_begin(&lat, J_OP_WRITE_BEGIN);
+	err = __f2fs_write_begin(file, mapping, pos, len, flags, pagep, fsdata);
+	j_op_lat_end(&lat);
+	return err;
+}
+
 static int f2fs_write_end(struct file *file,
 			struct address_space *mapping,
 			loff_t pos, unsigned len, unsigned copied,
 			struct page *page, void *fsdata)
 {
 	struct inode *inode = page->mapping->host;
+	j_op_lat_t lat;
+
+	j_op_lat_begin(&lat, J_OP_WRITE_END);
 
 	trace_f2fs_write_end(inode, pos, len, copied);
 
@@ -3536,6 +3555,7 @@ static int f2fs_write_end(struct file *file,
 		if (pos + copied > i_size_read(inode) &&
 				!f2fs_verity_in_progress(inode))
 			f2fs_i_size_write(inode, pos + copied);
+		j_op_lat_end(&lat);
 		return copied;
 	}
 #endif
@@ -3548,9 +3568,19 @@ static int f2fs_write_end(struct file *file,
 	if (pos + copied > i_size_read(inode) &&
 	    !f2fs_verity_in_progress(inode))
 		f2fs_i_size_write(inode, pos + copied);
+#if F2FSJ_CTRL_CP
+	/* journal the bytes, or write back the page at epoch commit */
+	if (S_ISREG(inode->i_mode)) {
+		j_op_lat_phase_begin(&lat);
+		j_record_data_write(F2FS_I(inode), page,
+				offset_in_page(pos), copied);
+		j_op_lat_phase_end(&lat, J_OP_PHASE_LOG);
+	}
+#endif
 unlock_out:
 	f2fs_put_page(page, 1);
 	f2fs_update_time(F2FS_I_SB(inode), REQ_TIME);
+	j_op_lat_end(&lat);
 	return copied;
 }
 
@@ -3684,11 +3714,15 @@ static ssize_t f2fs_direct_IO(struct kiocb *iocb, struct iov_iter *iter)
 		if (err > 0) {
 			f2fs_update_iostat(F2FS_I_SB(inode), APP_DIRECT_IO,
 									err);
+			f2fsj_account_iostat(F2FS_I_SB(inode), APP_DIRECT_IO,
+									err);
 			if (!do_opu)
 				set_inode_flag(inode, FI_UPDATE_WRITE);
 		} else if (err == -EIOCBQUEUED) {
 			f2fs_update_iostat(F2FS_I_SB(inode), APP_DIRECT_IO,
 						count - iov_iter_count(iter));
+			f2fsj_account_iostat(F2FS_I_SB(inode), APP_DIRECT_IO,
+						count - iov_iter_count(iter));
 		} else if (err < 0) {
 			f2fs_write_failed(inode, offset + count);
 		}
@@ -3728,6 +3762,9 @@ void f2fs_invalidate_page(struct page *page, unsigned int offset,
 	}
 
 	clear_page_private_gcing(page);
+#if F2FSJ_CTRL_CP
+	clear_page_journal_dirty(sbi, page);
+#endif
 
 	if (test_opt(sbi, COMPRESS_CACHE)) {
 		if (f2fs_compressed_file(inode))
@@ -3764,6 +3801,9 @@ int f2fs_release_page(struct page *page, gfp_t wait)
 	}
 
 	clear_page_private_gcing(page);
+#if F2FSJ_CTRL_CP
+	clear_page_journal_dirty(F2FS_P_SB(page), page);
+#endif
 
 	detach_page_private(page);
 	set_page_private(page, 0);
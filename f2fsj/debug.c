@@ -19,6 +19,7 @@
 #include "node.h"
 #include "segment.h"
 #include "gc.h"
+#include "j_stats.h"
 
 static LIST_HEAD(f2fs_stat_list);
 static DEFINE_MUTEX(f2fs_stat_mutex);
@@ -142,6 +143,9 @@ static void update_general_status(struct f2fs_sb_info *sbi)
 	si->append = sbi->im[APPEND_INO].ino_num;
 	si->update = sbi->im[UPDATE_INO].ino_num;
 	si->orphans = sbi->im[ORPHAN_INO].ino_num;
+#if F2FSJ_CTRL_CP
+	si->orphans += sbi->im[J_ORPHAN_INO].ino_num;
+#endif
 	si->utilization = utilization(sbi);
 
 	si->free_segs = free_segments(sbi);
@@ -572,6 +576,9 @@ static int stat_show(struct seq_file *s, void *v)
 				si->cache_mem >> 10);
 		seq_printf(s, "  - paged : %llu KB\n",
 				si->page_mem >> 10);
+#if F2FSJ_CTRL_CP
+		j_stats_show(s);
+#endif
 	}
 	mutex_unlock(&f2fs_stat_mutex);
 	return 0;
@@ -618,7 +618,11 @@ struct page *f2fs_init_inode_metadata(struct inode *inode, struct inode *dir,
 		 * we should remove this inode from orphan list.
 		 */
 		if (inode->i_nlink == 0)
+#if F2FSJ_CTRL_CP
+			f2fsj_relink_orphan_inode(F2FS_I_SB(dir), inode->i_ino);
+#else
 			f2fs_remove_orphan_inode(F2FS_I_SB(dir), inode->i_ino);
+#endif
 		f2fs_i_links_write(inode, true);
 	}
 	return page;
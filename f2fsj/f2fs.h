@@ -34,6 +34,10 @@
 #define ENABLE_F2FSJ (0)
 #define F2FSJ_INO_NEW_ATTR (1) ///< If this macro is set to 0, should close f2fsj moudle when compiling
 #define F2FSJ_CTRL_CP (1)  ///< Whether enable the original ckpt, 1 -> journal; 0->ckpt
+#define F2FSJ_DATA_JOURNAL_FSYNC (0) ///< journal small writes of data journaling files and fsync them by epoch commit, needs DATA_JOURNAL_LOG replay
+#define F2FSJ_DIRSYNC_COMMIT (0) ///< dirsync link/symlink/rename only commits the epoch, needs their replay
+#define F2FSJ_ABSORB_ATTR (0) ///< journaled setattr/xattr/range changes stay in-core, needs their replay
+#define F2FSJ_GC_COMMIT_REUSE (0) ///< reuse GC victims after an epoch commit, needs replay of every log
 
 #ifdef CONFIG_F2FS_CHECK_FS
 #define f2fs_bug_on(sbi, condition)	BUG_ON(condition)
@@ -108,6 +112,7 @@ extern const char *f2fs_fault_name[FAULT_MAX];
 #define F2FS_MOUNT_MERGE_CHECKPOINT	0x10000000
 #define	F2FS_MOUNT_GC_MERGE		0x20000000
 #define F2FS_MOUNT_COMPRESS_CACHE	0x40000000
+#define F2FS_MOUNT_DATA_JOURNAL		0x80000000
 
 #define F2FS_OPTION(sbi)	((sbi)->mount_opt)
 #define clear_opt(sbi, option)	(F2FS_OPTION(sbi).opt &= ~F2FS_MOUNT_##option)
@@ -262,6 +267,9 @@ enum {
 /* for the list of ino */
 enum {
 	ORPHAN_INO,		/* for orphan ino list */
+#if F2FSJ_CTRL_CP
+	J_ORPHAN_INO,		/* for orphan ino list kept by journal */
+#endif
 	APPEND_INO,		/* for append ino list */
 	UPDATE_INO,		/* for update ino list */
 	TRANS_DIR_INO,		/* for trasactions dir ino list */
@@ -730,6 +738,7 @@ enum {
 	FI_ENABLE_COMPRESS,	/* enable compression in "user" compression mode */
 	FI_COMPRESS_RELEASED,	/* compressed blocks were released */
 	FI_ALIGNED_WRITE,	/* enable aligned write */
+	FI_J_UNJOURNALED_DATA,	/* f2fsj: data or size changed outside data journal */
 	FI_MAX,			/* max flag, never be used */
 };
 
@@ -811,6 +820,10 @@ struct f2fs_inode_info {
 
     ///< spin lock to protect global_epoch operations
     spinlock_t ino_spin_lock_global_ep;
+
+    ///< access time log of epoch j_atime_log_ep, protected by epoch switch lock
+    read_stat_log_t *j_atime_log;
+    uint64_t j_atime_log_ep;
 #endif
 };
 
@@ -1096,6 +1109,7 @@ enum count_type {
 	F2FS_DIO_READ,
     F2FSJ_DIRTY_DATA,
     F2FSJ_UNLINK_META,
+    F2FSJ_JDIRTY_PAGES,     ///< node/meta pages held in memory by journal
 	NR_COUNT_TYPE,
 };
 
@@ -1166,6 +1180,8 @@ enum iostat_type {
 	FS_CP_DATA_IO,			/* data IOs from checkpoint */
 	FS_CP_NODE_IO,			/* node IOs from checkpoint */
 	FS_CP_META_IO,			/* meta IOs from checkpoint */
+	FS_JOURNAL_IO,			/* f2fsj journal commit and clear IOs */
+	FS_JOURNAL_CP_IO,		/* node/meta IOs from f2fsj journal apply */
 
 	/* READ IO */
 	APP_DIRECT_READ_IO,		/* app direct read IOs */
@@ -1177,12 +1193,27 @@ enum iostat_type {
 	FS_CDATA_READ_IO,		/* compressed data read IOs */
 	FS_NODE_READ_IO,		/* node read IOs */
 	FS_META_READ_IO,		/* meta read IOs */
+	FS_JOURNAL_READ_IO,		/* f2fsj journal read IOs */
 
 	/* other */
 	FS_DISCARD,			/* discard */
 	NR_IO_TYPE,
 };
 
+#if F2FSJ_CTRL_CP
+/* f2fsj write amplification: who writes the bytes the device receives */
+enum f2fsj_wa_type {
+	J_WA_LOGICAL,			/* bytes written by applications */
+	J_WA_JOURNAL,			/* journal commits and journal superblock */
+	J_WA_JOURNAL_ZERO,		/* journal cleared after mount */
+	J_WA_CHECKPOINT,		/* checkpoint and journal apply */
+	J_WA_NODE,			/* node writeback */
+	J_WA_DATA,			/* data writeback and direct IO */
+	J_WA_GC,			/* blocks moved by GC */
+	NR_J_WA_TYPE,
+};
+#endif
+
 struct f2fs_io_info {
 	struct f2fs_sb_info *sbi;	/* f2fs_sb_info pointer */
 	nid_t ino;		/* inode number */
@@ -1373,7 +1404,8 @@ static inline void f2fs_clear_bit(unsigned int nr, char *addr);
  * bit 3	PAGE_PRIVATE_ONGOING_MIGRATION
  * bit 4	PAGE_PRIVATE_INLINE_INODE
  * bit 5	PAGE_PRIVATE_REF_RESOURCE
- * bit 6-	f2fs private data
+ * bit 6	PAGE_PRIVATE_JOURNAL_DIRTY
+ * bit 7-	f2fs private data
  *
  * Layout B: lowest bit should be 0
  * page.private is a wrapped pointer.
@@ -1385,6 +1417,7 @@ enum {
 	PAGE_PRIVATE_ONGOING_MIGRATION,		/* data page which is on-going migrating */
 	PAGE_PRIVATE_INLINE_INODE,		/* inode page contains inline data */
 	PAGE_PRIVATE_REF_RESOURCE,		/* dirty page has referenced resources */
+	PAGE_PRIVATE_JOURNAL_DIRTY,		/* f2fsj: dirty node/meta page covered by committed journal */
 	PAGE_PRIVATE_MAX
 };
 
@@ -1421,18 +1454,49 @@ static inline void clear_page_private_##name(struct page *page) \
 	} \
 }
 
+/* f2fsj: the flag tells whether the page is counted, so test and change it at once */
+#define PAGE_PRIVATE_TEST_AND_SET_FUNC(name, flagname) \
+static inline bool test_and_set_page_private_##name(struct page *page) \
+{ \
+	if (!PagePrivate(page)) { \
+		get_page(page); \
+		SetPagePrivate(page); \
+		set_page_private(page, 0); \
+	} \
+	set_bit(PAGE_PRIVATE_NOT_POINTER, &page_private(page)); \
+	return test_and_set_bit(PAGE_PRIVATE_##flagname, &page_private(page)); \
+}
+
+#define PAGE_PRIVATE_TEST_AND_CLEAR_FUNC(name, flagname) \
+static inline bool test_and_clear_page_private_##name(struct page *page) \
+{ \
+	bool was_set; \
+	if (!PagePrivate(page)) \
+		return false; \
+	was_set = test_and_clear_bit(PAGE_PRIVATE_##flagname, &page_private(page)); \
+	if (page_private(page) == 1 << PAGE_PRIVATE_NOT_POINTER) { \
+		set_page_private(page, 0); \
+		ClearPagePrivate(page); \
+		put_page(page); \
+	} \
+	return was_set; \
+}
+
 PAGE_PRIVATE_GET_FUNC(nonpointer, NOT_POINTER);
 PAGE_PRIVATE_GET_FUNC(reference, REF_RESOURCE);
 PAGE_PRIVATE_GET_FUNC(inline, INLINE_INODE);
 PAGE_PRIVATE_GET_FUNC(gcing, ONGOING_MIGRATION);
 PAGE_PRIVATE_GET_FUNC(atomic, ATOMIC_WRITE);
 PAGE_PRIVATE_GET_FUNC(dummy, DUMMY_WRITE);
+PAGE_PRIVATE_GET_FUNC(jdirty, JOURNAL_DIRTY);
 
 PAGE_PRIVATE_SET_FUNC(reference, REF_RESOURCE);
 PAGE_PRIVATE_SET_FUNC(inline, INLINE_INODE);
 PAGE_PRIVATE_SET_FUNC(gcing, ONGOING_MIGRATION);
 PAGE_PRIVATE_SET_FUNC(atomic, ATOMIC_WRITE);
 PAGE_PRIVATE_SET_FUNC(dummy, DUMMY_WRITE);
+PAGE_PRIVATE_TEST_AND_SET_FUNC(jdirty, JOURNAL_DIRTY);
+PAGE_PRIVATE_TEST_AND_CLEAR_FUNC(jdirty, JOURNAL_DIRTY);
 
 PAGE_PRIVATE_CLEAR_FUNC(reference, REF_RESOURCE);
 PAGE_PRIVATE_CLEAR_FUNC(inline, INLINE_INODE);
@@ -1808,18 +1872,39 @@ struct f2fs_sb_info {
 #endif
 
 #ifdef CONFIG_F2FS_IOSTAT
-	/* For app/fs IO statistics */
-	spinlock_t iostat_lock;
-	unsigned long long rw_iostat[NR_IO_TYPE];
+	/* For app/fs IO statistics, counted per cpu without lock */
+	struct iostat_cpu __percpu *iostat_cpu;
+	spinlock_t iostat_lock;			/* for iostat period */
 	unsigned long long prev_rw_iostat[NR_IO_TYPE];
 	bool iostat_enable;
 	unsigned long iostat_next_period;
 	unsigned int iostat_period_ms;
 
-	/* For io latency related statistics info in one iostat period */
-	spinlock_t iostat_lat_lock;
+	/* io latency sums at the start of the iostat period */
 	struct iostat_lat_info *iostat_io_lat;
 #endif
+
+#if F2FSJ_CTRL_CP
+	/* For f2fsj checkpoint scheduling */
+	unsigned int j_max_recovery_ms;		/* journal replay time objective, 0: periodic */
+	unsigned int j_replay_cost_ns;		/* replay cost of one journal log */
+	unsigned int j_absorb_max_pages;	/* journal dirty pages held in memory, 0: off */
+	unsigned int j_data_journal_max_bytes;	/* largest journaled write, 0: off */
+	unsigned int j_log_compaction;		/* compact journal before checkpoint */
+	unsigned int j_compress_journal;	/* LZ4 frames from next mount */
+	unsigned int j_op_latency;		/* per operation latency histograms */
+	unsigned int j_crash_point;		/* hold journal here for crash tests */
+	unsigned int j_crash_hit;		/* last crash point reached */
+	unsigned int j_stress;			/* threads of the last journal stress run */
+	unsigned int j_stress_ops;		/* logs per stress thread */
+	unsigned int j_stress_files;		/* files "0".."N-1" driven by the stress test */
+	unsigned int j_stress_dir_ino;		/* directory of these files */
+	unsigned int j_stress_commit_ops;	/* logs of a stress thread between commits */
+
+	/* For f2fsj write amplification, since mount */
+	atomic64_t j_wa_bytes[NR_J_WA_TYPE];
+	atomic64_t j_wa_ios[NR_J_WA_TYPE];	/* block or bio submissions */
+#endif
 };
 
 struct f2fs_private_dio {
@@ -2348,6 +2433,83 @@ static inline s64 get_pages(struct f2fs_sb_info *sbi, int count_type)
 	return atomic_read(&sbi->nr_pages[count_type]);
 }
 
+#if F2FSJ_CTRL_CP
+/*
+ * f2fsj write absorption: once the journal covers a dirty node/meta page,
+ * background writeback skips it, so repeated updates across epochs cost
+ * one write at the next journal apply. Reclaim, sync writes and
+ * checkpoint still write it, and j_absorb_max_pages bounds the memory.
+ */
+static inline void set_page_journal_dirty(struct f2fs_sb_info *sbi,
+						struct page *page)
+{
+	if (!test_and_set_page_private_jdirty(page))
+		inc_page_count(sbi, F2FSJ_JDIRTY_PAGES);
+}
+
+static inline void clear_page_journal_dirty(struct f2fs_sb_info *sbi,
+						struct page *page)
+{
+	if (test_and_clear_page_private_jdirty(page))
+		dec_page_count(sbi, F2FSJ_JDIRTY_PAGES);
+}
+
+static inline bool f2fsj_absorb_page_write(struct f2fs_sb_info *sbi,
+				struct page *page, struct writeback_control *wbc,
+				enum iostat_type io_type)
+{
+	if (!page_private_jdirty(page))
+		return false;
+	if (io_type != FS_NODE_IO && io_type != FS_META_IO)
+		return false;
+	if (wbc->sync_mode != WB_SYNC_NONE || wbc->for_reclaim)
+		return false;
+	return get_pages(sbi, F2FSJ_JDIRTY_PAGES) <= sbi->j_absorb_max_pages;
+}
+
+static inline void f2fsj_account_write(struct f2fs_sb_info *sbi,
+				enum f2fsj_wa_type type, unsigned long long bytes)
+{
+	atomic64_add(bytes, &sbi->j_wa_bytes[type]);
+	atomic64_inc(&sbi->j_wa_ios[type]);
+}
+
+/* f2fs write paths report an iostat type, sort it into f2fsj categories */
+static inline void f2fsj_account_iostat(struct f2fs_sb_info *sbi,
+				enum iostat_type io_type, unsigned long long bytes)
+{
+	switch (io_type) {
+	case APP_WRITE_IO:
+	case APP_MAPPED_IO:
+		f2fsj_account_write(sbi, J_WA_LOGICAL, bytes);
+		break;
+	case APP_DIRECT_IO:
+	case FS_DATA_IO:
+		f2fsj_account_write(sbi, J_WA_DATA, bytes);
+		break;
+	case FS_NODE_IO:
+		f2fsj_account_write(sbi, J_WA_NODE, bytes);
+		break;
+	case FS_META_IO:
+	case FS_CP_DATA_IO:
+	case FS_CP_NODE_IO:
+	case FS_CP_META_IO:
+	case FS_JOURNAL_CP_IO:
+		f2fsj_account_write(sbi, J_WA_CHECKPOINT, bytes);
+		break;
+	case FS_GC_DATA_IO:
+	case FS_GC_NODE_IO:
+		f2fsj_account_write(sbi, J_WA_GC, bytes);
+		break;
+	default:
+		break;
+	}
+}
+#else
+static inline void f2fsj_account_iostat(struct f2fs_sb_info *sbi,
+				enum iostat_type io_type, unsigned long long bytes) {}
+#endif
+
 static inline int get_dirty_pages(struct inode *inode)
 {
 	return atomic_read(&F2FS_I(inode)->dirty_pages);
@@ -2827,6 +2989,7 @@ static inline void f2fs_change_bit(unsigned int nr, char *addr)
 #define F2FS_NOATIME_FL			0x00000080 /* do not update atime */
 #define F2FS_NOCOMP_FL			0x00000400 /* Don't compress */
 #define F2FS_INDEX_FL			0x00001000 /* hash-indexed directory */
+#define F2FS_JOURNAL_DATA_FL		0x00004000 /* f2fsj: journal small writes */
 #define F2FS_DIRSYNC_FL			0x00010000 /* dirsync behaviour (directories only) */
 #define F2FS_PROJINHERIT_FL		0x20000000 /* Create with parents projid */
 #define F2FS_CASEFOLD_FL		0x40000000 /* Casefolded file */
@@ -2834,7 +2997,8 @@ static inline void f2fs_change_bit(unsigned int nr, char *addr)
 /* Flags that should be inherited by new inodes from their parent. */
 #define F2FS_FL_INHERITED (F2FS_SYNC_FL | F2FS_NODUMP_FL | F2FS_NOATIME_FL | \
 			   F2FS_DIRSYNC_FL | F2FS_PROJINHERIT_FL | \
-			   F2FS_CASEFOLD_FL | F2FS_COMPR_FL | F2FS_NOCOMP_FL)
+			   F2FS_CASEFOLD_FL | F2FS_COMPR_FL | F2FS_NOCOMP_FL | \
+			   F2FS_JOURNAL_DATA_FL)
 
 /* Flags that are appropriate for regular files (all but dir-specific ones). */
 #define F2FS_REG_FLMASK		(~(F2FS_DIRSYNC_FL | F2FS_PROJINHERIT_FL | \
@@ -3031,6 +3195,39 @@ static inline int f2fs_compressed_file(struct inode *inode)
 		is_inode_flag_set(inode, FI_COMPRESSED_FILE);
 }
 
+#if F2FSJ_CTRL_CP
+/*
+ * f2fsj data journaling: small buffered writes of the file are copied into
+ * the journal, so fsync only waits for an epoch commit and the data is
+ * written to its home location at journal apply. Mount option data_journal
+ * enables it for every regular file, chattr +j for one file.
+ *
+ * Recovery does not replay DATA_JOURNAL_LOG yet, writes stay ordered until
+ * F2FSJ_DATA_JOURNAL_FSYNC is on.
+ */
+static inline bool f2fsj_data_journal_file(struct inode *inode)
+{
+	struct f2fs_sb_info *sbi = F2FS_I_SB(inode);
+
+	if (!F2FSJ_DATA_JOURNAL_FSYNC)
+		return false;
+	if (!S_ISREG(inode->i_mode) || !sbi->j_data_journal_max_bytes)
+		return false;
+	/* journal never stores plain text of encrypted files */
+	if (IS_ENCRYPTED(inode) || f2fs_compressed_file(inode))
+		return false;
+	return test_opt(sbi, DATA_JOURNAL) ||
+		(F2FS_I(inode)->i_flags & F2FS_JOURNAL_DATA_FL);
+}
+
+/* fsync of the file can no longer be satisfied by an epoch commit only */
+static inline void f2fsj_mark_unjournaled(struct inode *inode)
+{
+	if (f2fsj_data_journal_file(inode))
+		set_inode_flag(inode, FI_J_UNJOURNALED_DATA);
+}
+#endif
+
 static inline bool f2fs_need_compress_data(struct inode *inode)
 {
 	int compress_mode = F2FS_OPTION(F2FS_I_SB(inode)).compress_mode;
@@ -3316,6 +3513,10 @@ int f2fs_getattr(struct user_namespace *mnt_userns, const struct path *path,
 		 struct kstat *stat, u32 request_mask, unsigned int flags);
 int f2fs_setattr(struct user_namespace *mnt_userns, struct dentry *dentry,
 		 struct iattr *attr);
+#if F2FSJ_CTRL_CP
+int f2fsj_update_time(struct inode *inode, struct timespec64 *time, int flags);
+#endif
+int f2fsj_do_fallocate(struct inode *inode, int mode, loff_t offset, loff_t len);
 int f2fs_truncate_hole(struct inode *inode, pgoff_t pg_start, pgoff_t pg_end);
 void f2fs_truncate_data_blocks_range(struct dnode_of_data *dn, int count);
 int f2fs_precache_extents(struct inode *inode);
@@ -3412,6 +3613,9 @@ static inline int f2fs_add_link(struct dentry *dentry, struct inode *inode)
  */
 int f2fs_inode_dirtied(struct inode *inode, bool sync);
 void f2fs_inode_synced(struct inode *inode);
+#if F2FSJ_CTRL_CP
+void f2fsj_absorb_inode_dirty(struct inode *inode);
+#endif
 int f2fs_enable_quota_files(struct f2fs_sb_info *sbi, bool rdonly);
 int f2fs_quota_sync(struct super_block *sb, int type);
 loff_t max_file_blocks(struct inode *inode);
@@ -3441,6 +3645,10 @@ bool f2fs_is_checkpointed_node(struct f2fs_sb_info *sbi, nid_t nid);
 bool f2fs_need_inode_block_update(struct f2fs_sb_info *sbi, nid_t ino);
 int f2fs_get_node_info(struct f2fs_sb_info *sbi, nid_t nid,
 						struct node_info *ni);
+#if F2FSJ_CTRL_CP
+int f2fsj_replay_nat_delta(struct f2fs_sb_info *sbi, nid_t nid, nid_t ino,
+				block_t blkaddr, unsigned char version);
+#endif
 pgoff_t f2fs_get_next_page_offset(struct dnode_of_data *dn, pgoff_t pgofs);
 int f2fs_get_dnode_of_data(struct dnode_of_data *dn, pgoff_t index, int mode);
 int f2fs_truncate_inode_blocks(struct inode *inode, pgoff_t from);
@@ -3499,6 +3707,19 @@ int f2fs_create_flush_cmd_control(struct f2fs_sb_info *sbi);
 int f2fs_flush_device_cache(struct f2fs_sb_info *sbi);
 void f2fs_destroy_flush_cmd_control(struct f2fs_sb_info *sbi, bool free);
 void f2fs_invalidate_blocks(struct f2fs_sb_info *sbi, block_t addr);
+#if F2FSJ_CTRL_CP && F2FSJ_GC_COMMIT_REUSE
+void f2fsj_gc_moved_block(struct f2fs_sb_info *sbi, nid_t nid,
+			unsigned int ofs_in_node, block_t old_blkaddr,
+			block_t new_blkaddr);
+unsigned int f2fsj_reclaim_gc_segments(struct f2fs_sb_info *sbi);
+#endif
+#if F2FSJ_CTRL_CP
+void f2fsj_replay_sit_delta(struct f2fs_sb_info *sbi, unsigned int segno,
+				unsigned int blkofs, int del);
+void f2fsj_replay_ssa_delta(struct f2fs_sb_info *sbi, unsigned int segno,
+				unsigned int blkofs, nid_t nid,
+				unsigned int ofs_in_node, unsigned char version);
+#endif
 bool f2fs_is_checkpointed_data(struct f2fs_sb_info *sbi, block_t blkaddr);
 int f2fs_start_discard_thread(struct f2fs_sb_info *sbi);
 void f2fs_drop_discard_cmd(struct f2fs_sb_info *sbi);
@@ -3597,6 +3818,10 @@ int f2fs_acquire_orphan_inode(struct f2fs_sb_info *sbi);
 void f2fs_release_orphan_inode(struct f2fs_sb_info *sbi);
 void f2fs_add_orphan_inode(struct inode *inode);
 void f2fs_remove_orphan_inode(struct f2fs_sb_info *sbi, nid_t ino);
+#if F2FSJ_CTRL_CP
+void f2fsj_relink_orphan_inode(struct f2fs_sb_info *sbi, nid_t ino);
+void f2fsj_relog_orphan_inodes(struct f2fs_sb_info *sbi);
+#endif
 int f2fs_recover_orphan_inodes(struct f2fs_sb_info *sbi);
 int f2fs_get_valid_checkpoint(struct f2fs_sb_info *sbi);
 void f2fs_update_dirty_page(struct inode *inode, struct page *page);
@@ -3612,6 +3837,7 @@ int f2fs_issue_checkpoint(struct f2fs_sb_info *sbi);
 int f2fs_start_ckpt_thread(struct f2fs_sb_info *sbi);
 void f2fs_stop_ckpt_thread(struct f2fs_sb_info *sbi);
 void f2fs_init_ckpt_req_control(struct f2fs_sb_info *sbi);
+int j_prepare_flushing(struct f2fs_sb_info *sbi);
 int j_apply_flushing(struct f2fs_sb_info *sbi, struct cp_control *cpc);
 
 /*
@@ -3687,6 +3913,11 @@ block_t f2fs_start_bidx_of_node(unsigned int node_ofs, struct inode *inode);
 int f2fs_gc(struct f2fs_sb_info *sbi, bool sync, bool background, bool force,
 			unsigned int segno);
 void f2fs_build_gc_manager(struct f2fs_sb_info *sbi);
+#if F2FSJ_CTRL_CP
+int f2fsj_replay_gc_move(struct f2fs_sb_info *sbi, nid_t nid,
+			unsigned int ofs_in_node, block_t old_blkaddr,
+			block_t new_blkaddr);
+#endif
 int f2fs_resize_fs(struct f2fs_sb_info *sbi, __u64 block_count);
 int __init f2fs_create_garbage_collection_cache(void);
 void f2fs_destroy_garbage_collection_cache(void);
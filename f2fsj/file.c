@@ -32,6 +32,9 @@
 #include "acl.h"
 #include "gc.h"
 #include "iostat.h"
+#include "j_log_operate.h"
+#include "j_epoch_process.h"
+#include "j_op_lat.h"
 #include <trace/events/f2fs.h>
 #include <uapi/linux/f2fs.h>
 
@@ -152,8 +155,13 @@ static vm_fault_t f2fs_vm_page_mkwrite(struct vm_fault *vmf)
 	set_page_dirty(page);
 	if (!PageUptodate(page))
 		SetPageUptodate(page);
+#if F2FSJ_CTRL_CP
+	j_record_dirty_data_range(F2FS_I(inode), page->index, page->index);
+	f2fsj_mark_unjournaled(inode);
+#endif
 
 	f2fs_update_iostat(sbi, APP_MAPPED_IO, F2FS_BLKSIZE);
+	f2fsj_account_iostat(sbi, APP_MAPPED_IO, F2FS_BLKSIZE);
 	f2fs_update_time(sbi, REQ_TIME);
 
 	trace_f2fs_vm_page_mkwrite(page, DATA);
@@ -246,7 +254,7 @@ static void try_to_fix_pino(struct inode *inode)
 }
 
 static int f2fs_do_sync_file(struct file *file, loff_t start, loff_t end,
-						int datasync, bool atomic)
+				int datasync, bool atomic, j_op_lat_t *lat)
 {
 	struct inode *inode = file->f_mapping->host;
 	struct f2fs_sb_info *sbi = F2FS_I_SB(inode);
@@ -268,6 +276,25 @@ static int f2fs_do_sync_file(struct file *file, loff_t start, loff_t end,
 
 	trace_f2fs_sync_file_enter(inode);
 
+#if F2FSJ_CTRL_CP && F2FSJ_DATA_JOURNAL_FSYNC
+	/*
+	 * Every change of a data journaling file since last fsync is in the
+	 * journal, so the commit of running epoch is enough, the dirty pages
+	 * stay in memory until journal apply.
+	 */
+	if (!atomic && f2fsj_data_journal_file(inode)) {
+		if (!is_inode_flag_set(inode, FI_J_UNJOURNALED_DATA)) {
+			j_op_lat_phase_begin(lat);
+			ret = j_sync_epoch_commit(sbi);
+			j_op_lat_phase_end(lat, J_OP_PHASE_COMMIT);
+			trace_f2fs_sync_file_exit(inode, cp_reason, datasync, ret);
+			return ret;
+		}
+		/* node path below syncs all, set it again if it fails */
+		clear_inode_flag(inode, FI_J_UNJOURNALED_DATA);
+	}
+#endif
+
 	if (S_ISDIR(inode->i_mode))
 		goto go_write;
 
@@ -278,6 +305,10 @@ static int f2fs_do_sync_file(struct file *file, loff_t start, loff_t end,
 	clear_inode_flag(inode, FI_NEED_IPU);
 
 	if (ret || is_sbi_flag_set(sbi, SBI_CP_DISABLED)) {
+#if F2FSJ_CTRL_CP
+		if (ret)
+			f2fsj_mark_unjournaled(inode);
+#endif
 		trace_f2fs_sync_file_exit(inode, cp_reason, datasync, ret);
 		return ret;
 	}
@@ -393,15 +424,26 @@ flush_out:
 	}
 	f2fs_update_time(sbi, REQ_TIME);
 out:
+#if F2FSJ_CTRL_CP
+	if (ret)
+		f2fsj_mark_unjournaled(inode);
+#endif
 	trace_f2fs_sync_file_exit(inode, cp_reason, datasync, ret);
 	return ret;
 }
 
 int f2fs_sync_file(struct file *file, loff_t start, loff_t end, int datasync)
 {
+	j_op_lat_t lat;
+	int ret;
+
 	if (unlikely(f2fs_cp_error(F2FS_I_SB(file_inode(file)))))
 		return -EIO;
-	return f2fs_do_sync_file(file, start, end, datasync, false);
+
+	j_op_lat_begin(&lat, J_OP_FSYNC);
+	ret = f2fs_do_sync_file(file, start, end, datasync, false, &lat);
+	j_op_lat_end(&lat);
+	return ret;
 }
 
 static bool __found_offset(struct address_space *mapping, block_t blkaddr,
@@ -895,15 +937,35 @@ static void __setattr_copy(struct user_namespace *mnt_userns,
 #define __setattr_copy setattr_copy
 #endif
 
-int f2fs_setattr(struct user_namespace *mnt_userns, struct dentry *dentry,
-		 struct iattr *attr)
+#if F2FSJ_CTRL_CP
+/*
+ * One CHOWN_LOG per setattr is written before the change is absorbed in
+ * the in-core inode. Recovery does not replay it yet, so until it does
+ * (F2FSJ_ABSORB_ATTR) nothing is logged and the caller dirties the inode.
+ */
+static bool f2fsj_journal_setattr(struct inode *inode, unsigned int ia_valid,
+				  j_op_lat_t *lat)
+{
+#if F2FSJ_ABSORB_ATTR
+	bool journaled;
+
+	j_op_lat_phase_begin(lat);
+	journaled = j_log_setattr(inode, ia_valid) == F2FSJ_OK;
+	j_op_lat_phase_end(lat, J_OP_PHASE_LOG);
+
+	return journaled;
+#else
+	return false;
+#endif
+}
+#endif
+
+static int __f2fs_setattr(struct dentry *dentry, struct iattr *attr,
+			  j_op_lat_t *lat)
 {
 	struct inode *inode = d_inode(dentry);
 	int err;
 
-    /** For log collection*/
-    delta_log_t *dlog_chown_log = NULL;
-
 	if (unlikely(f2fs_cp_error(F2FS_I_SB(inode))))
 		return -EIO;
 
@@ -931,6 +993,12 @@ int f2fs_setattr(struct user_namespace *mnt_userns, struct dentry *dentry,
 	if (err)
 		return err;
 
+#if F2FSJ_CTRL_CP
+	/* truncated blocks are not journaled, fsync takes the node path */
+	if (attr->ia_valid & ATTR_SIZE)
+		f2fsj_mark_unjournaled(inode);
+#endif
+
 	if (is_quota_modification(inode, attr)) {
 		err = dquot_initialize(inode);
 		if (err)
@@ -956,6 +1024,7 @@ int f2fs_setattr(struct user_namespace *mnt_userns, struct dentry *dentry,
 			inode->i_uid = attr->ia_uid;
 		if (attr->ia_valid & ATTR_GID)
 			inode->i_gid = attr->ia_gid;
+		/* dquot is checkpointed with the inode, uid/gid are not absorbed */
 		f2fs_mark_inode_dirty_sync(inode, true);
 		f2fs_unlock_op(F2FS_I_SB(inode));
 	}
@@ -993,6 +1062,19 @@ int f2fs_setattr(struct user_namespace *mnt_userns, struct dentry *dentry,
 		inode->i_mtime = inode->i_ctime = current_time(inode);
 		F2FS_I(inode)->last_disk_size = i_size_read(inode);
 		spin_unlock(&F2FS_I(inode)->i_size_lock);
+
+#if F2FSJ_CTRL_CP && F2FSJ_ABSORB_ATTR
+		/*
+		 * the size is also in CHOWN_LOG, this one carries the freed
+		 * range; without it the inode cannot be absorbed below
+		 */
+		j_op_lat_phase_begin(lat);
+		if (j_log_range(inode, TRUNCATE_LOG, 0, old_size, attr->ia_size,
+				old_size > attr->ia_size ?
+				old_size - attr->ia_size : 0) != F2FSJ_OK)
+			f2fs_mark_inode_dirty_sync(inode, true);
+		j_op_lat_phase_end(lat, J_OP_PHASE_LOG);
+#endif
 	}
 
 	__setattr_copy(&init_user_ns, inode, attr);
@@ -1008,38 +1090,13 @@ int f2fs_setattr(struct user_namespace *mnt_userns, struct dentry *dentry,
 	}
 
 	/* file size may changed here */
+#if F2FSJ_CTRL_CP
+	if (f2fsj_journal_setattr(inode, attr->ia_valid, lat))
+		f2fsj_absorb_inode_dirty(inode);
+	else
+		f2fs_mark_inode_dirty_sync(inode, true);
+#else
 	f2fs_mark_inode_dirty_sync(inode, true);
-
-    /** Add journal here, before f2fs_delete_entry()*/
-#if ENABLE_F2FSJ
-    alloc_log_entry_memory(&dlog_chown_log);
-    if (dlog_chown_log)
-    {
-        ///< prepare log head
-        dlog_chown_log->delta_log_head.log_type = CHOWN_LOG;
-        dlog_chown_log->delta_log_head.checksum = 0;    /** TODO, crc*/
-        dlog_chown_log->delta_log_head.log_size = sizeof(j_log_contents_t);
-
-        ///< log contents
-        dlog_chown_log->delta_log_contents.log_chown_mi.ino_num  = inode->i_ino;
-        if (attr->ia_valid & ATTR_UID)
-            dlog_chown_log->delta_log_contents.log_chown_mi.user_id  = attr->ia_uid;
-        if (attr->ia_valid & ATTR_GID)
-            dlog_chown_log->delta_log_contents.log_chown_mi.group_id = attr->ia_gid;
-        if (attr->ia_valid & ATTR_SIZE)
-        {
-            dlog_chown_log->delta_log_contents.log_chown_mi.i_size = attr->ia_size;
-            dlog_chown_log->delta_log_contents.log_chown_mi.ctime  = inode->i_mtime;
-            dlog_chown_log->delta_log_contents.log_chown_mi.mtime  = inode->i_ctime;
-        }
-
-        ///< add into inode's local epoch
-        insert_log_into_inode(F2FS_I(inode), dlog_chown_log);
-    }
-    else
-    {
-        STATUS_LOG(STATUS_ERROR, "allocate memory got dlog failed\n");
-    }
 #endif
 
 	/* inode change will produce dirty node pages flushed by checkpoint */
@@ -1048,9 +1105,48 @@ int f2fs_setattr(struct user_namespace *mnt_userns, struct dentry *dentry,
 	return err;
 }
 
+int f2fs_setattr(struct user_namespace *mnt_userns, struct dentry *dentry,
+		 struct iattr *attr)
+{
+	j_op_lat_t lat;
+	int err;
+
+	j_op_lat_begin(&lat, J_OP_SETATTR);
+	err = __f2fs_setattr(dentry, attr, &lat);
+	j_op_lat_end(&lat);
+	return err;
+}
+
+#if F2FSJ_CTRL_CP
+/*
+ * Access time is journaled and absorbed in memory, so reads do not dirty
+ * inode node pages; other time updates go through the generic path.
+ * Recovery does not replay the atime logs yet, so until it does
+ * (F2FSJ_ABSORB_ATTR) atime takes the generic path too.
+ */
+int f2fsj_update_time(struct inode *inode, struct timespec64 *time, int flags)
+{
+	if (!F2FSJ_ABSORB_ATTR || flags != S_ATIME ||
+			f2fs_cp_error(F2FS_I_SB(inode)))
+		return generic_update_time(inode, time, flags);
+
+	inode->i_atime = *time;
+	if (j_log_atime(inode) != F2FSJ_OK) {
+		f2fs_mark_inode_dirty_sync(inode, false);
+		return 0;
+	}
+
+	f2fsj_absorb_inode_dirty(inode);
+	return 0;
+}
+#endif
+
 const struct inode_operations f2fs_file_inode_operations = {
 	.getattr	= f2fs_getattr,
 	.setattr	= f2fs_setattr,
+#if F2FSJ_CTRL_CP
+	.update_time	= f2fsj_update_time,
+#endif
 	.get_acl	= f2fs_get_acl,
 	.set_acl	= f2fs_set_acl,
 	.listxattr	= f2fs_listxattr,
@@ -1807,10 +1903,29 @@ static long f2fs_fallocate(struct file *file, int mode,
 		return -EOPNOTSUPP;
 
 	inode_lock(inode);
+	ret = f2fsj_do_fallocate(inode, mode, offset, len);
+	inode_unlock(inode);
+
+	trace_f2fs_fallocate(inode, mode, offset, len, ret);
+	return ret;
+}
+
+/* caller should hold inode_lock(), also used to replay FALLOCATE_LOG/PUNCH_LOG */
+int f2fsj_do_fallocate(struct inode *inode, int mode, loff_t offset, loff_t len)
+{
+#if F2FSJ_CTRL_CP && F2FSJ_ABSORB_ATTR
+	loff_t old_size = i_size_read(inode);
+#endif
+	int ret = 0;
+
+#if F2FSJ_CTRL_CP
+	/* allocated, zeroed or moved blocks are not in the data journal */
+	f2fsj_mark_unjournaled(inode);
+#endif
 
 	if (mode & FALLOC_FL_PUNCH_HOLE) {
 		if (offset >= inode->i_size)
-			goto out;
+			return 0;
 
 		ret = punch_hole(inode, offset, len);
 	} else if (mode & FALLOC_FL_COLLAPSE_RANGE) {
@@ -1825,14 +1940,20 @@ static long f2fs_fallocate(struct file *file, int mode,
 
 	if (!ret) {
 		inode->i_mtime = inode->i_ctime = current_time(inode);
+#if F2FSJ_CTRL_CP && F2FSJ_ABSORB_ATTR
+		/* logged and absorbed only once FALLOCATE_LOG/PUNCH_LOG are replayed */
+		if (j_log_range(inode, (mode & FALLOC_FL_PUNCH_HOLE) ?
+				PUNCH_LOG : FALLOCATE_LOG, mode, old_size,
+				offset, len) == F2FSJ_OK)
+			f2fsj_absorb_inode_dirty(inode);
+		else
+			f2fs_mark_inode_dirty_sync(inode, false);
+#else
 		f2fs_mark_inode_dirty_sync(inode, false);
+#endif
 		f2fs_update_time(F2FS_I_SB(inode), REQ_TIME);
 	}
 
-out:
-	inode_unlock(inode);
-
-	trace_f2fs_fallocate(inode, mode, offset, len, ret);
 	return ret;
 }
 
@@ -1931,6 +2052,12 @@ static int f2fs_setflags_common(struct inode *inode, u32 iflags, u32 mask)
 	else
 		clear_inode_flag(inode, FI_PROJ_INHERIT);
 
+#if F2FSJ_CTRL_CP
+	/* writes before the flag is set are not in the journal */
+	if ((iflags ^ masked_flags) & F2FS_JOURNAL_DATA_FL)
+		set_inode_flag(inode, FI_J_UNJOURNALED_DATA);
+#endif
+
 	inode->i_ctime = current_time(inode);
 	f2fs_set_inode_flags(inode);
 	f2fs_mark_inode_dirty_sync(inode, true);
@@ -1961,6 +2088,7 @@ static const struct {
 	{ F2FS_NOATIME_FL,	FS_NOATIME_FL },
 	{ F2FS_NOCOMP_FL,	FS_NOCOMP_FL },
 	{ F2FS_INDEX_FL,	FS_INDEX_FL },
+	{ F2FS_JOURNAL_DATA_FL,	FS_JOURNAL_DATA_FL },
 	{ F2FS_DIRSYNC_FL,	FS_DIRSYNC_FL },
 	{ F2FS_PROJINHERIT_FL,	FS_PROJINHERIT_FL },
 	{ F2FS_CASEFOLD_FL,	FS_CASEFOLD_FL },
@@ -1975,6 +2103,7 @@ static const struct {
 		FS_NOATIME_FL |		\
 		FS_NOCOMP_FL |		\
 		FS_INDEX_FL |		\
+		FS_JOURNAL_DATA_FL |	\
 		FS_DIRSYNC_FL |		\
 		FS_PROJINHERIT_FL |	\
 		FS_ENCRYPT_FL |		\
@@ -1991,6 +2120,7 @@ static const struct {
 		FS_NODUMP_FL |		\
 		FS_NOATIME_FL |		\
 		FS_NOCOMP_FL |		\
+		FS_JOURNAL_DATA_FL |	\
 		FS_DIRSYNC_FL |		\
 		FS_PROJINHERIT_FL |	\
 		FS_CASEFOLD_FL)
@@ -2123,11 +2253,11 @@ static int f2fs_ioc_commit_atomic_write(struct file *filp)
 		if (ret)
 			goto err_out;
 
-		ret = f2fs_do_sync_file(filp, 0, LLONG_MAX, 0, true);
+		ret = f2fs_do_sync_file(filp, 0, LLONG_MAX, 0, true, NULL);
 		if (!ret)
 			f2fs_drop_inmem_pages(inode);
 	} else {
-		ret = f2fs_do_sync_file(filp, 0, LLONG_MAX, 1, false);
+		ret = f2fs_do_sync_file(filp, 0, LLONG_MAX, 1, false, NULL);
 	}
 err_out:
 	if (is_inode_flag_set(inode, FI_ATOMIC_REVOKE_REQUEST)) {
@@ -2222,7 +2352,7 @@ static int f2fs_ioc_abort_volatile_write(struct file *filp)
 	if (f2fs_is_volatile_file(inode)) {
 		clear_inode_flag(inode, FI_VOLATILE_FILE);
 		stat_dec_volatile_write(inode);
-		ret = f2fs_do_sync_file(filp, 0, LLONG_MAX, 0, true);
+		ret = f2fs_do_sync_file(filp, 0, LLONG_MAX, 0, true, NULL);
 	}
 
 	clear_inode_flag(inode, FI_ATOMIC_REVOKE_REQUEST);
@@ -4391,6 +4521,10 @@ out_err:
 write:
 		ret = __generic_file_write_iter(iocb, from);
 		clear_inode_flag(inode, FI_NO_PREALLOC);
+#if F2FSJ_CTRL_CP
+		if (iocb->ki_flags & IOCB_DIRECT)
+			f2fsj_mark_unjournaled(inode);
+#endif
 
 		/* if we couldn't write data, we should deallocate blocks. */
 		if (preallocated && i_size_read(inode) < target_size) {
@@ -4401,8 +4535,10 @@ write:
 			up_write(&F2FS_I(inode)->i_gc_rwsem[WRITE]);
 		}
 
-		if (ret > 0)
+		if (ret > 0) {
 			f2fs_update_iostat(F2FS_I_SB(inode), APP_WRITE_IO, ret);
+			f2fsj_account_iostat(F2FS_I_SB(inode), APP_WRITE_IO, ret);
+		}
 	}
 unlock:
 	inode_unlock(inode);
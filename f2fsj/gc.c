@@ -22,6 +22,10 @@
 #include "iostat.h"
 #include <trace/events/f2fs.h>
 
+#if F2FSJ_CTRL_CP
+#include "j_epoch_process.h"
+#endif
+
 static struct kmem_cache *victim_entry_slab;
 
 static unsigned int count_bits(const unsigned long *addr,
@@ -1285,8 +1289,13 @@ static int move_data_block(struct inode *inode, block_t bidx,
 	}
 
 	f2fs_update_iostat(fio.sbi, FS_GC_DATA_IO, F2FS_BLKSIZE);
+	f2fsj_account_iostat(fio.sbi, FS_GC_DATA_IO, F2FS_BLKSIZE);
 
 	f2fs_update_data_blkaddr(&dn, newaddr);
+#if F2FSJ_CTRL_CP && F2FSJ_GC_COMMIT_REUSE
+	f2fsj_gc_moved_block(fio.sbi, dn.nid, dn.ofs_in_node,
+					fio.old_blkaddr, newaddr);
+#endif
 	set_inode_flag(inode, FI_APPEND_WRITE);
 	if (page->index == 0)
 		set_inode_flag(inode, FI_FIRST_BLOCK_WRITTEN);
@@ -1676,6 +1685,33 @@ skip:
 	return seg_freed;
 }
 
+/*
+ * Data blocks moved by GC are journaled, so once the moves are committed
+ * the victims whose blocks were all moved can be reused without waiting
+ * for a checkpoint. Node segments and partly moved victims still need one.
+ *
+ * A reused block may be rewritten before the checkpoint, so a crash is
+ * only safe if recovery replays every log of the journal, not only the
+ * moves. Until then it is compiled out with the journaling of the moves
+ * (F2FSJ_GC_COMMIT_REUSE).
+ */
+static int f2fs_gc_free_prefree(struct f2fs_sb_info *sbi,
+					struct cp_control *cpc)
+{
+#if F2FSJ_CTRL_CP && F2FSJ_GC_COMMIT_REUSE
+	f2fs_submit_merged_write(sbi, DATA);
+	f2fs_submit_merged_write(sbi, NODE);
+	f2fs_wait_on_all_pages(sbi, F2FS_WB_DATA);
+	f2fs_wait_on_all_pages(sbi, F2FS_WB_CP_DATA);
+
+	if (!j_sync_epoch_commit(sbi) &&
+			f2fsj_reclaim_gc_segments(sbi) &&
+			!has_not_enough_free_secs(sbi, 0, 0))
+		return 0;
+#endif
+	return f2fs_write_checkpoint(sbi, cpc);
+}
+
 int f2fs_gc(struct f2fs_sb_info *sbi, bool sync,
 			bool background, bool force, unsigned int segno)
 {
@@ -1722,7 +1758,7 @@ gc_more:
 		 */
 		if (prefree_segments(sbi) &&
 				!is_sbi_flag_set(sbi, SBI_CP_DISABLED)) {
-			ret = f2fs_write_checkpoint(sbi, &cpc);
+			ret = f2fs_gc_free_prefree(sbi, &cpc);
 			if (ret)
 				goto stop;
 		}
@@ -1774,7 +1810,7 @@ gc_more:
 			goto gc_more;
 		}
 		if (gc_type == FG_GC && !is_sbi_flag_set(sbi, SBI_CP_DISABLED))
-			ret = f2fs_write_checkpoint(sbi, &cpc);
+			ret = f2fs_gc_free_prefree(sbi, &cpc);
 	}
 stop:
 	SIT_I(sbi)->last_victim[ALLOC_NEXT] = 0;
@@ -1830,6 +1866,48 @@ static void init_atgc_management(struct f2fs_sb_info *sbi)
 	am->age_threshold = DEF_GC_THREAD_AGE_THRESHOLD;
 }
 
+#if F2FSJ_CTRL_CP
+/*
+ * redo a journaled GC move: point the data index at the new block unless a
+ * later write has replaced the old one.
+ */
+int f2fsj_replay_gc_move(struct f2fs_sb_info *sbi, nid_t nid,
+			unsigned int ofs_in_node, block_t old_blkaddr,
+			block_t new_blkaddr)
+{
+	struct dnode_of_data dn;
+	struct page *node_page;
+	struct inode *inode;
+	nid_t ino;
+
+	node_page = f2fs_get_node_page(sbi, nid);
+	if (IS_ERR(node_page))
+		return PTR_ERR(node_page);
+	ino = ino_of_node(node_page);
+	f2fs_put_page(node_page, 1);
+
+	inode = f2fs_iget(sbi->sb, ino);
+	if (IS_ERR(inode))
+		return PTR_ERR(inode);
+
+	node_page = f2fs_get_node_page(sbi, nid);
+	if (IS_ERR(node_page)) {
+		iput(inode);
+		return PTR_ERR(node_page);
+	}
+
+	set_new_dnode(&dn, inode, NULL, node_page, nid);
+	dn.ofs_in_node = ofs_in_node;
+	if (f2fs_data_blkaddr(&dn) == old_blkaddr) {
+		dn.data_blkaddr = new_blkaddr;
+		f2fs_set_data_blkaddr(&dn);
+	}
+	f2fs_put_dnode(&dn);
+	iput(inode);
+	return 0;
+}
+#endif
+
 void f2fs_build_gc_manager(struct f2fs_sb_info *sbi)
 {
 	DIRTY_I(sbi)->v_ops = &default_v_ops;
@@ -808,6 +808,13 @@ no_delete:
 	stat_sub_compr_blocks(inode,
 			atomic_read(&F2FS_I(inode)->i_compr_blocks));
 
+#if F2FSJ_CTRL_CP
+	/* an absorbed change has not reached node page, see f2fsj_absorb_inode_dirty() */
+	if (inode->i_nlink && !is_bad_inode(inode) &&
+			is_inode_flag_set(inode, FI_DIRTY_INODE) &&
+			!f2fs_cp_error(sbi))
+		f2fs_update_inode_page(inode);
+#endif
 	if (likely(!f2fs_cp_error(sbi) &&
 				!is_sbi_flag_set(sbi, SBI_CP_DISABLED)))
 		f2fs_bug_on(sbi, is_inode_flag_set(inode, FI_DIRTY_INODE));
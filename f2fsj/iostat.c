@@ -18,95 +18,133 @@
 static struct kmem_cache *bio_iostat_ctx_cache;
 static mempool_t *bio_iostat_ctx_pool;
 
+static void f2fs_sum_iostat(struct f2fs_sb_info *sbi,
+				unsigned long long *rw_iostat)
+{
+	struct iostat_cpu *ic;
+	int cpu, i;
+
+	memset(rw_iostat, 0, sizeof(unsigned long long) * NR_IO_TYPE);
+	for_each_possible_cpu(cpu) {
+		ic = per_cpu_ptr(sbi->iostat_cpu, cpu);
+		for (i = 0; i < NR_IO_TYPE; i++)
+			rw_iostat[i] += READ_ONCE(ic->rw_iostat[i]);
+	}
+
+	/* buffered IOs are not counted on the IO path, derive them */
+	rw_iostat[APP_BUFFERED_IO] = rw_iostat[APP_WRITE_IO] -
+					rw_iostat[APP_DIRECT_IO];
+	rw_iostat[APP_BUFFERED_READ_IO] = rw_iostat[APP_READ_IO] -
+					rw_iostat[APP_DIRECT_READ_IO];
+}
+
 int __maybe_unused iostat_info_seq_show(struct seq_file *seq, void *offset)
 {
 	struct super_block *sb = seq->private;
 	struct f2fs_sb_info *sbi = F2FS_SB(sb);
 	time64_t now = ktime_get_real_seconds();
+	unsigned long long rw_iostat[NR_IO_TYPE];
 
 	if (!sbi->iostat_enable)
 		return 0;
 
+	f2fs_sum_iostat(sbi, rw_iostat);
+
 	seq_printf(seq, "time:		%-16llu\n", now);
 
 	/* print app write IOs */
 	seq_puts(seq, "[WRITE]\n");
 	seq_printf(seq, "app buffered:	%-16llu\n",
-				sbi->rw_iostat[APP_BUFFERED_IO]);
+				rw_iostat[APP_BUFFERED_IO]);
 	seq_printf(seq, "app direct:	%-16llu\n",
-				sbi->rw_iostat[APP_DIRECT_IO]);
+				rw_iostat[APP_DIRECT_IO]);
 	seq_printf(seq, "app mapped:	%-16llu\n",
-				sbi->rw_iostat[APP_MAPPED_IO]);
+				rw_iostat[APP_MAPPED_IO]);
 
 	/* print fs write IOs */
 	seq_printf(seq, "fs data:	%-16llu\n",
-				sbi->rw_iostat[FS_DATA_IO]);
+				rw_iostat[FS_DATA_IO]);
 	seq_printf(seq, "fs node:	%-16llu\n",
-				sbi->rw_iostat[FS_NODE_IO]);
+				rw_iostat[FS_NODE_IO]);
 	seq_printf(seq, "fs meta:	%-16llu\n",
-				sbi->rw_iostat[FS_META_IO]);
+				rw_iostat[FS_META_IO]);
 	seq_printf(seq, "fs gc data:	%-16llu\n",
-				sbi->rw_iostat[FS_GC_DATA_IO]);
+				rw_iostat[FS_GC_DATA_IO]);
 	seq_printf(seq, "fs gc node:	%-16llu\n",
-				sbi->rw_iostat[FS_GC_NODE_IO]);
+				rw_iostat[FS_GC_NODE_IO]);
 	seq_printf(seq, "fs cp data:	%-16llu\n",
-				sbi->rw_iostat[FS_CP_DATA_IO]);
+				rw_iostat[FS_CP_DATA_IO]);
 	seq_printf(seq, "fs cp node:	%-16llu\n",
-				sbi->rw_iostat[FS_CP_NODE_IO]);
+				rw_iostat[FS_CP_NODE_IO]);
 	seq_printf(seq, "fs cp meta:	%-16llu\n",
-				sbi->rw_iostat[FS_CP_META_IO]);
+				rw_iostat[FS_CP_META_IO]);
+	seq_printf(seq, "fs journal:	%-16llu\n",
+				rw_iostat[FS_JOURNAL_IO]);
+	seq_printf(seq, "fs journal cp:	%-16llu\n",
+				rw_iostat[FS_JOURNAL_CP_IO]);
 
 	/* print app read IOs */
 	seq_puts(seq, "[READ]\n");
 	seq_printf(seq, "app buffered:	%-16llu\n",
-				sbi->rw_iostat[APP_BUFFERED_READ_IO]);
+				rw_iostat[APP_BUFFERED_READ_IO]);
 	seq_printf(seq, "app direct:	%-16llu\n",
-				sbi->rw_iostat[APP_DIRECT_READ_IO]);
+				rw_iostat[APP_DIRECT_READ_IO]);
 	seq_printf(seq, "app mapped:	%-16llu\n",
-				sbi->rw_iostat[APP_MAPPED_READ_IO]);
+				rw_iostat[APP_MAPPED_READ_IO]);
 
 	/* print fs read IOs */
 	seq_printf(seq, "fs data:	%-16llu\n",
-				sbi->rw_iostat[FS_DATA_READ_IO]);
+				rw_iostat[FS_DATA_READ_IO]);
 	seq_printf(seq, "fs gc data:	%-16llu\n",
-				sbi->rw_iostat[FS_GDATA_READ_IO]);
+				rw_iostat[FS_GDATA_READ_IO]);
 	seq_printf(seq, "fs compr_data:	%-16llu\n",
-				sbi->rw_iostat[FS_CDATA_READ_IO]);
+				rw_iostat[FS_CDATA_READ_IO]);
 	seq_printf(seq, "fs node:	%-16llu\n",
-				sbi->rw_iostat[FS_NODE_READ_IO]);
+				rw_iostat[FS_NODE_READ_IO]);
 	seq_printf(seq, "fs meta:	%-16llu\n",
-				sbi->rw_iostat[FS_META_READ_IO]);
+				rw_iostat[FS_META_READ_IO]);
+	seq_printf(seq, "fs journal:	%-16llu\n",
+				rw_iostat[FS_JOURNAL_READ_IO]);
 
 	/* print other IOs */
 	seq_puts(seq, "[OTHER]\n");
 	seq_printf(seq, "fs discard:	%-16llu\n",
-				sbi->rw_iostat[FS_DISCARD]);
+				rw_iostat[FS_DISCARD]);
 
 	return 0;
 }
 
+/* called with iostat_lock held, once per iostat period */
 static inline void __record_iostat_latency(struct f2fs_sb_info *sbi)
 {
-	int io, idx = 0;
+	int io, idx = 0, cpu;
 	unsigned int cnt;
-	struct f2fsj_iostat_latency iostat_lat[MAX_IO_TYPE][NR_PAGE_TYPE];
-	struct iostat_lat_info *io_lat = sbi->iostat_io_lat;
+	unsigned long sum, peak;
+	struct f2fs_iostat_latency iostat_lat[MAX_IO_TYPE][NR_PAGE_TYPE];
+	struct iostat_lat_info *prev = sbi->iostat_io_lat;
+	struct iostat_lat_info *lat;
 
-	spin_lock_irq(&sbi->iostat_lat_lock);
 	for (idx = 0; idx < MAX_IO_TYPE; idx++) {
 		for (io = 0; io < NR_PAGE_TYPE; io++) {
-			cnt = io_lat->bio_cnt[idx][io];
-			iostat_lat[idx][io].peak_lat =
-			   jiffies_to_msecs(io_lat->peak_lat[idx][io]);
-			iostat_lat[idx][io].cnt = cnt;
-			iostat_lat[idx][io].avg_lat = cnt ?
-			   jiffies_to_msecs(io_lat->sum_lat[idx][io]) / cnt : 0;
-			io_lat->sum_lat[idx][io] = 0;
-			io_lat->peak_lat[idx][io] = 0;
-			io_lat->bio_cnt[idx][io] = 0;
+			cnt = 0;
+			sum = 0;
+			peak = 0;
+			for_each_possible_cpu(cpu) {
+				lat = &per_cpu_ptr(sbi->iostat_cpu, cpu)->lat;
+				cnt += READ_ONCE(lat->bio_cnt[idx][io]);
+				sum += READ_ONCE(lat->sum_lat[idx][io]);
+				peak = max(peak, xchg(&lat->peak_lat[idx][io], 0));
+			}
+
+			iostat_lat[idx][io].peak_lat = jiffies_to_msecs(peak);
+			iostat_lat[idx][io].cnt = cnt - prev->bio_cnt[idx][io];
+			iostat_lat[idx][io].avg_lat = iostat_lat[idx][io].cnt ?
+				jiffies_to_msecs(sum - prev->sum_lat[idx][io]) /
+				iostat_lat[idx][io].cnt : 0;
+			prev->bio_cnt[idx][io] = cnt;
+			prev->sum_lat[idx][io] = sum;
 		}
 	}
-	spin_unlock_irq(&sbi->iostat_lat_lock);
 
 	trace_f2fs_iostat_latency(sbi, iostat_lat);
 }
@@ -114,13 +152,15 @@ static inline void __record_iostat_latency(struct f2fs_sb_info *sbi)
 static inline void f2fs_record_iostat(struct f2fs_sb_info *sbi)
 {
 	unsigned long long iostat_diff[NR_IO_TYPE];
+	unsigned long long rw_iostat[NR_IO_TYPE];
 	int i;
 
 	if (time_is_after_jiffies(sbi->iostat_next_period))
 		return;
 
-	/* Need double check under the lock */
-	spin_lock(&sbi->iostat_lock);
+	/* someone else is closing this period */
+	if (!spin_trylock(&sbi->iostat_lock))
+		return;
 	if (time_is_after_jiffies(sbi->iostat_next_period)) {
 		spin_unlock(&sbi->iostat_lock);
 		return;
@@ -128,33 +168,29 @@ static inline void f2fs_record_iostat(struct f2fs_sb_info *sbi)
 	sbi->iostat_next_period = jiffies +
 				msecs_to_jiffies(sbi->iostat_period_ms);
 
+	f2fs_sum_iostat(sbi, rw_iostat);
 	for (i = 0; i < NR_IO_TYPE; i++) {
-		iostat_diff[i] = sbi->rw_iostat[i] -
-				sbi->prev_rw_iostat[i];
-		sbi->prev_rw_iostat[i] = sbi->rw_iostat[i];
+		iostat_diff[i] = rw_iostat[i] - sbi->prev_rw_iostat[i];
+		sbi->prev_rw_iostat[i] = rw_iostat[i];
 	}
+
+	__record_iostat_latency(sbi);
 	spin_unlock(&sbi->iostat_lock);
 
 	trace_f2fs_iostat(sbi, iostat_diff);
-
-	__record_iostat_latency(sbi);
 }
 
 void f2fs_reset_iostat(struct f2fs_sb_info *sbi)
 {
-	struct iostat_lat_info *io_lat = sbi->iostat_io_lat;
-	int i;
+	int cpu;
 
 	spin_lock(&sbi->iostat_lock);
-	for (i = 0; i < NR_IO_TYPE; i++) {
-		sbi->rw_iostat[i] = 0;
-		sbi->prev_rw_iostat[i] = 0;
-	}
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(sbi->iostat_cpu, cpu), 0,
+					sizeof(struct iostat_cpu));
+	memset(sbi->prev_rw_iostat, 0, sizeof(sbi->prev_rw_iostat));
+	memset(sbi->iostat_io_lat, 0, sizeof(struct iostat_lat_info));
 	spin_unlock(&sbi->iostat_lock);
-
-	spin_lock_irq(&sbi->iostat_lat_lock);
-	memset(io_lat, 0, sizeof(struct iostat_lat_info));
-	spin_unlock_irq(&sbi->iostat_lat_lock);
 }
 
 void f2fs_update_iostat(struct f2fs_sb_info *sbi,
@@ -163,19 +199,7 @@ void f2fs_update_iostat(struct f2fs_sb_info *sbi,
 	if (!sbi->iostat_enable)
 		return;
 
-	spin_lock(&sbi->iostat_lock);
-	sbi->rw_iostat[type] += io_bytes;
-
-	if (type == APP_WRITE_IO || type == APP_DIRECT_IO)
-		sbi->rw_iostat[APP_BUFFERED_IO] =
-			sbi->rw_iostat[APP_WRITE_IO] -
-			sbi->rw_iostat[APP_DIRECT_IO];
-
-	if (type == APP_READ_IO || type == APP_DIRECT_READ_IO)
-		sbi->rw_iostat[APP_BUFFERED_READ_IO] =
-			sbi->rw_iostat[APP_READ_IO] -
-			sbi->rw_iostat[APP_DIRECT_READ_IO];
-	spin_unlock(&sbi->iostat_lock);
+	this_cpu_add(sbi->iostat_cpu->rw_iostat[type], io_bytes);
 
 	f2fs_record_iostat(sbi);
 }
@@ -185,9 +209,8 @@ static inline void __update_iostat_latency(struct bio_iostat_ctx *iostat_ctx,
 {
 	unsigned long ts_diff;
 	unsigned int iotype = iostat_ctx->type;
-	unsigned long flags;
 	struct f2fs_sb_info *sbi = iostat_ctx->sbi;
-	struct iostat_lat_info *io_lat = sbi->iostat_io_lat;
+	struct iostat_lat_info __percpu *io_lat = &sbi->iostat_cpu->lat;
 	int idx;
 
 	if (!sbi->iostat_enable)
@@ -206,12 +229,11 @@ static inline void __update_iostat_latency(struct bio_iostat_ctx *iostat_ctx,
 			idx = WRITE_ASYNC_IO;
 	}
 
-	spin_lock_irqsave(&sbi->iostat_lat_lock, flags);
-	io_lat->sum_lat[idx][iotype] += ts_diff;
-	io_lat->bio_cnt[idx][iotype]++;
-	if (ts_diff > io_lat->peak_lat[idx][iotype])
-		io_lat->peak_lat[idx][iotype] = ts_diff;
-	spin_unlock_irqrestore(&sbi->iostat_lat_lock, flags);
+	/* bio completion may run in irq, this_cpu ops are irq safe */
+	this_cpu_add(io_lat->sum_lat[idx][iotype], ts_diff);
+	this_cpu_inc(io_lat->bio_cnt[idx][iotype]);
+	if (ts_diff > this_cpu_read(io_lat->peak_lat[idx][iotype]))
+		this_cpu_write(io_lat->peak_lat[idx][iotype], ts_diff);
 }
 
 void iostat_update_and_unbind_ctx(struct bio *bio, int rw)
@@ -268,20 +290,27 @@ void f2fs_destroy_iostat_processing(void)
 
 int f2fs_init_iostat(struct f2fs_sb_info *sbi)
 {
-	/* init iostat info */
+	/* init iostat info, cheap enough to be on by default */
 	spin_lock_init(&sbi->iostat_lock);
-	spin_lock_init(&sbi->iostat_lat_lock);
-	sbi->iostat_enable = false;
+	sbi->iostat_enable = true;
 	sbi->iostat_period_ms = DEFAULT_IOSTAT_PERIOD_MS;
 	sbi->iostat_io_lat = f2fs_kzalloc(sbi, sizeof(struct iostat_lat_info),
 					GFP_KERNEL);
 	if (!sbi->iostat_io_lat)
 		return -ENOMEM;
 
+	sbi->iostat_cpu = alloc_percpu(struct iostat_cpu);
+	if (!sbi->iostat_cpu) {
+		kfree(sbi->iostat_io_lat);
+		sbi->iostat_io_lat = NULL;
+		return -ENOMEM;
+	}
+
 	return 0;
 }
 
 void f2fs_destroy_iostat(struct f2fs_sb_info *sbi)
 {
+	free_percpu(sbi->iostat_cpu);
 	kfree(sbi->iostat_io_lat);
 }
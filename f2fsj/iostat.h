@@ -28,6 +28,16 @@ struct iostat_lat_info {
 	unsigned int bio_cnt[MAX_IO_TYPE][NR_PAGE_TYPE];	/* bio count */
 };
 
+/*
+ * Only the local cpu adds to its counters, so the IO path takes no lock;
+ * readers sum up all cpus. Sums and counts only grow, peaks are cleared
+ * by the iostat period.
+ */
+struct iostat_cpu {
+	unsigned long long rw_iostat[NR_IO_TYPE];
+	struct iostat_lat_info lat;
+};
+
 extern int __maybe_unused iostat_info_seq_show(struct seq_file *seq,
 			void *offset);
 extern void f2fs_reset_iostat(struct f2fs_sb_info *sbi);
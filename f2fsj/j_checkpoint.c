@@ -11,8 +11,13 @@
 #include "j_checkpoint.h"
 #include "j_epoch.h"
 #include "j_journal_file.h"
+#include "j_stats.h"
+#include "j_stress.h"
+#include "j_trace.h"
 
 static j_checkpoint_list_t g_checkpoint_list;
+static spinlock_t g_checkpoint_list_lock;
+static atomic64_t g_nr_unapplied_logs = ATOMIC64_INIT(0);
 static struct kmem_cache *kmem_log_cp_info_slab_cache_heap = NULL;
 static struct kmem_cache *kmem_log_cp_list_head_node_slab_cache_heap = NULL;
 static uint8_t trigger_journal_apply = 0;
@@ -25,6 +30,9 @@ int init_g_checkpoint_list()
     g_checkpoint_list.g_ep_num = 0;
     g_checkpoint_list.g_ep_ver = 0;
 
+    ///< commit thread appends committed epochs while checkpoint thread takes a snapshot of them
+    spin_lock_init(&g_checkpoint_list_lock);
+
     kmem_log_cp_info_slab_cache_heap = NULL;
     kmem_log_cp_info_slab_cache_heap = kmem_cache_create("f2fsj_log_cp_info_cache_heap", sizeof(j_log_cp_info_t), 0,
                                                         SLAB_RECLAIM_ACCOUNT | SLAB_MEM_SPREAD, NULL);
@@ -46,76 +54,138 @@ int init_g_checkpoint_list()
     return F2FSJ_OK;
 }
 
-int epoch_checkpoint(struct f2fs_sb_info *sbi)
+int epoch_checkpoint_prepare(struct f2fs_sb_info *sbi)
+{
+    int err = 0;
+
+    if (is_g_checkpoint_cp_list_empty())
+    {
+        return F2FSJ_OK;
+    }
+
+    // most pages of the committed epochs are written here, file operations and commits go on
+    err = j_prepare_flushing(sbi);
+    if (err)
+    {
+        STATUS_LOG(STATUS_ERROR, "write back pages before journal checkpoint failed, err %d\n", err);
+        return F2FSJ_ERROR;
+    }
+
+    return F2FSJ_OK;
+}
+
+/**
+ * @brief Give the snapshot back to g_checkpoint_list, ahead of epochs committed since
+ */
+static void j_restore_checkpoint_snapshot(struct list_head *applied_ep_list)
+{
+    spin_lock(&g_checkpoint_list_lock);
+    list_splice(applied_ep_list, &g_checkpoint_list.g_checkpoint_list);
+    spin_unlock(&g_checkpoint_list_lock);
+}
+
+int epoch_checkpoint_snapshot(j_checkpoint_snapshot_t *snap)
+{
+    INIT_LIST_HEAD(&snap->ep_list);
+
+    // logs before the stable one are in epochs committed so far, no later log is
+    snap->tail_log_entry = j_get_stable_log_entry();
+
+    spin_lock(&g_checkpoint_list_lock);
+    list_splice_init(&g_checkpoint_list.g_checkpoint_list, &snap->ep_list);
+    spin_unlock(&g_checkpoint_list_lock);
+
+    return !list_empty(&snap->ep_list);
+}
+
+int epoch_checkpoint(struct f2fs_sb_info *sbi, j_checkpoint_snapshot_t *snap)
 {
     int err;
-    struct list_head *g_checkpoint_list_head = NULL;
+    struct list_head *applied_ep_list = &snap->ep_list;
     j_checkpoint_list_t *g_to_be_checkpoint_ep = NULL;
     j_checkpoint_list_t *g_to_be_checkpoint_ep_next = NULL;
 
     struct list_head *g_epoch_cp_info_list_head = NULL;
     j_log_cp_info_t * cp_info      = NULL;
-    j_log_cp_info_t * cp_info_next = NULL;
+    uint64_t applied_ep_ver = 0;
+    uint64_t applied_logs = 0;
+    uint64_t applied_eps = 0;
+    unsigned long long ckpt_ver = 0;
 
     struct cp_control cpc = {
         .reason = CP_FASTBOOT,
     };
 
+    if (list_empty(applied_ep_list))
+    {
+        return F2FSJ_OK;
+    }
 
-    // get global to_be_checkpoint list_head
-    g_checkpoint_list_head = &g_checkpoint_list.g_checkpoint_list;
+    list_for_each_entry(g_to_be_checkpoint_ep, applied_ep_list, g_checkpoint_list)
+    {
+        if (g_to_be_checkpoint_ep->g_ep_ver > applied_ep_ver)
+        {
+            applied_ep_ver = g_to_be_checkpoint_ep->g_ep_ver;
+        }
+        applied_logs += g_to_be_checkpoint_ep->nr_logs;
+        applied_eps ++;
+    }
+    trace_f2fsj_checkpoint_apply_start(sbi->sb, applied_eps, get_nr_unapplied_logs());
 
-    list_for_each_entry_safe(g_to_be_checkpoint_ep, g_to_be_checkpoint_ep_next,
-                                    g_checkpoint_list_head, g_checkpoint_list)
+    // use cp_info (#inode, #node, #NAT, #segnum) to locate in-memory metadata pages
+    // With page state control, use bind writes by flushing Dirty in-mem FS metadata
+    list_for_each_entry(g_to_be_checkpoint_ep, applied_ep_list, g_checkpoint_list)
     {
         g_epoch_cp_info_list_head = &g_to_be_checkpoint_ep->ep_log_cp_info_list_head;
-
-        // use cp_info (#inode, #node, #NAT, #segnum) to locate in-memory metadata pages
-        // With page state control, use bind writes by flushing Dirty in-mem FS metadata
-        list_for_each_entry_safe(cp_info, cp_info_next, g_epoch_cp_info_list_head, log_cp_list)
+        list_for_each_entry(cp_info, g_epoch_cp_info_list_head, log_cp_list)
         {
-#if 0
-            // apply inode page
-            if (cp_info->log_inode_id != 0)
+            ///< journaled data goes home before the node pages pointing to it are checkpointed
+            if (cp_info->log_data_journaled
+             && j_apply_DATA(sbi, cp_info->log_inode_id, cp_info->log_data_page_idx) != F2FSJ_OK)
             {
-                j_apply_NODE(sbi, cp_info->log_inode_id);
+                err = -EIO;
+                goto restore;
             }
-
-            // apply Dirty FS metadata
-
-            // apply node page
-            if (cp_info->log_node_id != 0)
-            {
-                j_apply_NODE(sbi, cp_info->log_node_id);
-            }
-
-            // apply SIT
-            if (cp_info->log_segno != 0)
-            {
-                j_apply_META(sbi, cp_info->log_inode_id, cp_info->log_node_id, cp_info->log_segno);
-            }
-#endif
-            ///< delete cp_info from epoch_cp_info_list
-            list_del(&cp_info->log_cp_list);
-            free_log_cp_info_memory(cp_info);
         }
+    }
 
+    j_crash_point(sbi, J_CRASH_CHECKPOINT);
 
-        ///< delete these cp_info_list of one global epoch from g_checkpoint_list
-        list_del(&g_to_be_checkpoint_ep->g_checkpoint_list);
-        free_log_cp_head_node_memory(g_to_be_checkpoint_ep);
+    /** apply by ckpt, FS operations are only frozen to publish the checkpoint pack*/
+    INFO_REPORT("Apply in-mem metadata of epochs up to %llu begin\n", applied_ep_ver);
+    ckpt_ver = cur_cp_version(F2FS_CKPT(sbi));
+    err = j_apply_flushing(sbi, &cpc);
+    if (!err && cur_cp_version(F2FS_CKPT(sbi)) == ckpt_ver)
+    {
+        // e.g., checkpoint is disabled, the journal is all there is
+        err = -EAGAIN;
     }
-
-    //apply by ckpt
-    INFO_REPORT("Apply in-mem metadata begin\n");
-    //j_apply_flushing(sbi, &cpc);
-    f2fs_write_checkpoint(sbi, &cpc);
+    if (err)
+    {
+        goto restore;
+    }
+    trace_f2fsj_checkpoint_apply_end(sbi->sb, applied_ep_ver, applied_logs, 0);
     INFO_REPORT("Apply in-mem metadata end\n");
 
-    // reset on-disk journal space info
-    reset_on_disk_journal_space_info();
+    // the checkpoint covers the snapshot, drop it
+    list_for_each_entry_safe(g_to_be_checkpoint_ep, g_to_be_checkpoint_ep_next,
+                                    applied_ep_list, g_checkpoint_list)
+    {
+        ///< delete these cp_info_list of one global epoch from the snapshot
+        list_del(&g_to_be_checkpoint_ep->g_checkpoint_list);
+        free_log_cp_list(g_to_be_checkpoint_ep);
+    }
+
+    atomic64_sub(applied_logs, &g_nr_unapplied_logs);
+    j_stat_epoch(J_STAT_EP_APPLIED, applied_eps);
 
     return F2FSJ_OK;
+
+restore:
+    trace_f2fsj_checkpoint_apply_end(sbi->sb, applied_ep_ver, applied_logs, err);
+    STATUS_LOG(STATUS_ERROR, "journal checkpoint failed, err %d, epochs stay in the journal\n", err);
+    j_restore_checkpoint_snapshot(applied_ep_list);
+    return F2FSJ_ERROR;
 }
 
 /**
@@ -140,6 +210,28 @@ int is_g_checkpoint_cp_list_empty()
     }
 }
 
+uint64_t get_nr_unapplied_logs()
+{
+    return atomic64_read(&g_nr_unapplied_logs);
+}
+
+void j_forget_unapplied_logs(uint64_t nr_logs)
+{
+    int64_t cur = atomic64_read(&g_nr_unapplied_logs);
+    int64_t old = 0;
+
+    // dropped logs may be applied already, never go below zero
+    while (cur > 0)
+    {
+        old = atomic64_cmpxchg(&g_nr_unapplied_logs, cur, cur - min_t(int64_t, cur, nr_logs));
+        if (old == cur)
+        {
+            break;
+        }
+        cur = old;
+    }
+}
+
 int alloc_log_cp_head_node_memory(j_checkpoint_list_t ** cp_head_node)
 {
     *cp_head_node = kmem_cache_alloc(kmem_log_cp_list_head_node_slab_cache_heap, GFP_NOIO);
@@ -151,6 +243,7 @@ int alloc_log_cp_head_node_memory(j_checkpoint_list_t ** cp_head_node)
 
     // init cp_info list head
     INIT_LIST_HEAD(&((*cp_head_node)->ep_log_cp_info_list_head));
+    (*cp_head_node)->nr_logs = 0;
 
     return F2FSJ_OK;
 }
@@ -168,6 +261,8 @@ int alloc_log_cp_info_memory(j_log_cp_info_t ** log_cp_info)
     (*log_cp_info)->log_inode_id = 0;
     (*log_cp_info)->log_node_id  = 0;
     (*log_cp_info)->log_segno    = 0;
+    (*log_cp_info)->log_data_journaled = 0;
+    (*log_cp_info)->log_data_page_idx  = 0;
     //INIT_LIST_HEAD(&((*log_cp_info)->log_cp_list));
 
     return F2FSJ_OK;
@@ -201,6 +296,21 @@ int free_log_cp_head_node_memory(j_checkpoint_list_t* cp_head_node)
     return F2FSJ_OK;
 }
 
+int free_log_cp_list(j_checkpoint_list_t *cp_head_node)
+{
+    j_log_cp_info_t * cp_info      = NULL;
+    j_log_cp_info_t * cp_info_next = NULL;
+
+    list_for_each_entry_safe(cp_info, cp_info_next, &cp_head_node->ep_log_cp_info_list_head, log_cp_list)
+    {
+        ///< delete cp_info from epoch_cp_info_list
+        list_del(&cp_info->log_cp_list);
+        free_log_cp_info_memory(cp_info);
+    }
+
+    return free_log_cp_head_node_memory(cp_head_node);
+}
+
 int insert_cp_info_list_head_2_g_cp_list(j_checkpoint_list_t *cp_head_node)
 {
     // for debug
@@ -209,7 +319,11 @@ int insert_cp_info_list_head_2_g_cp_list(j_checkpoint_list_t *cp_head_node)
         INFO_REPORT("Empty global j_CP list, first insert log\n");
     }
 
+    spin_lock(&g_checkpoint_list_lock);
     list_add_tail(&cp_head_node->g_checkpoint_list, &g_checkpoint_list.g_checkpoint_list);
+    spin_unlock(&g_checkpoint_list_lock);
+
+    atomic64_add(cp_head_node->nr_logs, &g_nr_unapplied_logs);
 
     return F2FSJ_OK;
 }
@@ -260,14 +374,16 @@ int get_cp_info_from_log(struct f2fs_inode_info *f2fs_i, j_checkpoint_list_t *cp
         cp_info->log_node_id  = write_log->nat_en_log.j_nid;
         cp_info->log_segno    = write_log->sit_log.segno;
         /** Commit phase
-         *  writeback() data pages (by DF logs)
+         *  data pages are already written back by epoch_commit(), once per inode on its dirty ranges
         */
-        ret = ep_commit_writeback_data_pages(f2fs_i);
-        if (ret != F2FSJ_OK)
-        {
-            STATUS_LOG(STATUS_ERROR, "J_commit invoke writepages() happens err\n");
-            return F2FSJ_ERROR;
-        }
+    }
+    else if (log_type == DATA_JOURNAL_LOG)
+    {
+        data_journal_log_t * dj_log = (data_journal_log_t *)log_entry->log_entry_addr;
+        cp_info->log_inode_id = dj_log->ino_num;
+        /** data is in the journal, the dirty page is written to its home location by checkpoint*/
+        cp_info->log_data_journaled = 1;
+        cp_info->log_data_page_idx  = dj_log->page_idx;
     }
     else if (log_type == CHOWN_LOG)
     {
@@ -275,6 +391,12 @@ int get_cp_info_from_log(struct f2fs_inode_info *f2fs_i, j_checkpoint_list_t *cp
         cp_info->log_inode_id = chown_log->ino_num;
         cp_info->log_node_id  = 0;
         cp_info->log_segno    = 0;     
+
+        // setattr always logs some ATTR_* bits, none is a record of the journal stress test
+        if (unlikely(!chown_log->ia_valid))
+        {
+            j_stress_log_committed(chown_log->i_size);
+        }
     }
     else if (log_type == UNLINK_LOG)
     {
@@ -282,7 +404,37 @@ int get_cp_info_from_log(struct f2fs_inode_info *f2fs_i, j_checkpoint_list_t *cp
         // Do not consider FS metadata for newly create files
         cp_info->log_inode_id = delete_log->ino_num;
     }
-    //TODO, rename and link
+    else if (log_type == READ_FILE_DATA_LOG || log_type == READ_DIR_LOG || log_type == STAT_LOG)
+    {
+        read_stat_log_t * atime_log = (read_stat_log_t *)log_entry->log_entry_addr;
+        cp_info->log_inode_id = atime_log->ino_num;
+    }
+    else if (log_type == TRUNCATE_LOG || log_type == FALLOCATE_LOG || log_type == PUNCH_LOG)
+    {
+        range_log_t * range_log = (range_log_t *)log_entry->log_entry_addr;
+        // direct node pages of the range are checkpointed with inode page
+        cp_info->log_inode_id = range_log->ino_num;
+    }
+    else if (log_type == XATTR_LOG)
+    {
+        xattr_log_t * xattr_log = (xattr_log_t *)log_entry->log_entry_addr;
+        // inline xattrs are in inode page, others are in xattr node
+        cp_info->log_inode_id = xattr_log->ino_num;
+        cp_info->log_node_id  = xattr_log->xattr_nid;
+    }
+    else if (log_type == LINK_LOG)
+    {
+        link_log_t * link_log = (link_log_t *)log_entry->log_entry_addr;
+        cp_info->log_inode_id = link_log->ino_num;
+        cp_info->log_node_id  = link_log->parent_ino;
+    }
+    else if (log_type == RENAME_LOG)
+    {
+        rename_log_t * rename_log = (rename_log_t *)log_entry->log_entry_addr;
+        // both directories are modified, renamed inode only changes i_pino and ctime
+        cp_info->log_inode_id = rename_log->new_parent_ino;
+        cp_info->log_node_id  = rename_log->old_parent_ino;
+    }
     else
     {
         STATUS_LOG(STATUS_INFO, "This type of log is unknown- [%d], log size is %d\n", log_type, log_header->log_size);
@@ -290,6 +442,7 @@ int get_cp_info_from_log(struct f2fs_inode_info *f2fs_i, j_checkpoint_list_t *cp
 
     // insert this cp_info into cp_info_list
     list_add_tail(&(cp_info->log_cp_list), &(cp_head_node->ep_log_cp_info_list_head));
+    cp_head_node->nr_logs ++;
 
     return F2FSJ_OK;
 }
@@ -299,30 +452,32 @@ int set_page_dirty_and_ready_do_cp(struct f2fs_sb_info *sbi, j_checkpoint_list_t
     j_log_cp_info_t * cp_info      = NULL;
     j_log_cp_info_t * cp_info_next = NULL;
 
+    // write absorption is off
+    if (!sbi->j_absorb_max_pages)
+    {
+        return F2FSJ_OK;
+    }
+
     list_for_each_entry_safe(cp_info, cp_info_next, &cp_head_node->ep_log_cp_info_list_head, log_cp_list)
     {
             if (cp_info->log_inode_id != 0)
             {
-                j_clear_NODE_page_j_dirty(sbi, cp_info->log_inode_id);
-                j_set_NODE_page_dirty(sbi, cp_info->log_inode_id);
-                j_clear_META_nat_page_j_dirty(sbi, cp_info->log_inode_id);
-                j_set_META_nat_page_dirty(sbi, cp_info->log_inode_id);
+                j_set_NODE_page_j_dirty(sbi, cp_info->log_inode_id);
+                j_set_META_nat_page_j_dirty(sbi, cp_info->log_inode_id);
             }
 
             if (cp_info->log_node_id != 0)
             {
-                j_clear_NODE_page_j_dirty(sbi, cp_info->log_node_id);
-                j_set_NODE_page_dirty(sbi, cp_info->log_node_id);
-                j_clear_META_nat_page_j_dirty(sbi, cp_info->log_node_id);
-                j_set_META_nat_page_dirty(sbi, cp_info->log_node_id);
+                j_set_NODE_page_j_dirty(sbi, cp_info->log_node_id);
+                j_set_META_nat_page_j_dirty(sbi, cp_info->log_node_id);
             }
 
             if (cp_info->log_segno != 0)
             {
-                j_clear_META_sit_page_j_dirty(sbi, cp_info->log_segno);
-                j_set_META_sit_page_dirty(sbi, cp_info->log_segno);
-                j_clear_META_ssa_page_j_dirty(sbi, cp_info->log_segno);
-                j_set_META_ssa_page_dirty(sbi, cp_info->log_segno);
+                j_set_META_sit_page_j_dirty(sbi, cp_info->log_segno);
+                j_set_META_ssa_page_j_dirty(sbi, cp_info->log_segno);
             }
     }
+
+    return F2FSJ_OK;
 }
\ No newline at end of file
@@ -23,7 +23,10 @@ typedef struct __j_checkpoint_list
     //for cp_list head node, chain log_cp_info comes from same epoch 
     struct list_head ep_log_cp_info_list_head;
     uint32_t g_ep_num;
-    uint32_t g_ep_ver;
+    uint64_t g_ep_ver;       ///< epoch_seq of the committed epoch
+
+    ///< number of logs committed in this epoch, they need replay until checkpoint applies them
+    uint32_t nr_logs;
 }j_checkpoint_list_t;
 
 typedef struct __j_log_cp_info
@@ -40,9 +43,20 @@ typedef struct __j_log_cp_info
     uint32_t log_node_id;
     uint32_t log_segno;
 
+    ///< data page of log_inode_id journaled by DATA_JOURNAL_LOG, written to its home location by checkpoint
+    uint8_t  log_data_journaled;
+    uint32_t log_data_page_idx;
+
     struct list_head log_cp_list;
 }j_log_cp_info_t;
 
+///< committed epochs applied by one journal checkpoint and the journal range holding their logs
+typedef struct __j_checkpoint_snapshot
+{
+    struct list_head ep_list;       ///< epochs taken from the global checkpoint list
+    uint32_t tail_log_entry;        ///< logs before it belong to these epochs
+}j_checkpoint_snapshot_t;
+
 int init_g_checkpoint_list();
 
 int alloc_log_cp_info_memory(j_log_cp_info_t ** log_cp_info);
@@ -53,29 +67,63 @@ int free_log_cp_info_memory(j_log_cp_info_t* log_cp_info);
 
 int free_log_cp_head_node_memory(j_checkpoint_list_t* cp_head_node);
 
+/**
+ * @brief Free the cp_info list of an epoch and its head node
+ *
+ * @param cp_head_node
+ * @return int
+ */
+int free_log_cp_list(j_checkpoint_list_t *cp_head_node);
+
 int insert_cp_info_list_head_2_g_cp_list(j_checkpoint_list_t *cp_head_node);
 
 int get_cp_info_from_log(struct f2fs_inode_info *f2fs_i, j_checkpoint_list_t *cp_head_node, j_log_entry_t *delta_log);
 
 /**
- * @brief set the META and NODE to dirty, means journa logs are already on the disk
- *        and we can do checkpoint soon after
+ * @brief journal logs are already on the disk, so the dirty META and NODE pages they cover
+ *        are set journal dirty and held in memory (bounded by sbi->j_absorb_max_pages)
+ *        until checkpoint writes them once
  * 
  * @param cp_head_node 
  * @return int 
  */
 int set_page_dirty_and_ready_do_cp(struct f2fs_sb_info *sbi, j_checkpoint_list_t *cp_head_node);
 
+/**
+ * @brief First step of a journal checkpoint: write back dirty NODE and META pages
+ *        while file operations and epoch commits keep running
+ *
+ * @param sbi
+ * @return int
+ */
+int epoch_checkpoint_prepare(struct f2fs_sb_info *sbi);
+
+/**
+ * @brief Take the committed epochs out of the global checkpoint list, together with the journal
+ *        tail the checkpoint may move to once they are applied.
+ *        Caller holds off epoch commits while the snapshot is taken
+ *
+ * @param snap
+ * @return int, 0 if nothing is committed
+ */
+int epoch_checkpoint_snapshot(j_checkpoint_snapshot_t *snap);
+
 /**
  * @brief This function will be invoked by j_checkpoint_thread
  *
  *        Checkpoint order: 1)apply NODE -> refer f2fs_sync_inode_meta() and f2fs_sync_node_pages()
  *                          2)apply META -> refer f2fs_sync_meta_pages(). maybe directly invoke f2fs_write_meta_pages()
  *
+ *        Epochs are committed meanwhile, the journal tail only moves past the logs of the snapshot.
+ *        Most pages are already written by epoch_checkpoint_prepare(), file operations are
+ *        blocked just to publish the checkpoint pack (j_apply_flushing()).
+ *        If the checkpoint fails or is not written, epochs stay in the journal for the next one
+ *
  * @param sbi
+ * @param snap, given back to the global checkpoint list on failure
  * @return int
  */
-int epoch_checkpoint(struct f2fs_sb_info *sbi);
+int epoch_checkpoint(struct f2fs_sb_info *sbi, j_checkpoint_snapshot_t *snap);
 
 /**
  * @brief Whether global to_be checkpoint log file is empty
@@ -84,5 +132,20 @@ int epoch_checkpoint(struct f2fs_sb_info *sbi);
  */
 int is_g_checkpoint_cp_list_empty();
 
+/**
+ * @brief How many committed logs are not applied by checkpoint yet,
+ *        i.e., how many logs a recovery would replay now
+ *
+ * @return uint64_t
+ */
+uint64_t get_nr_unapplied_logs();
+
+/**
+ * @brief Logs dropped by log compaction are not replayed any more
+ *
+ * @param nr_logs
+ */
+void j_forget_unapplied_logs(uint64_t nr_logs);
+
 
 #endif // !J_CHECKPOINT_H
\ No newline at end of file
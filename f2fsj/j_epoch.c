@@ -11,6 +11,7 @@
 #include "j_epoch.h"
 #include <linux/slab.h>
 #include "f2fs.h"
+#include "j_stats.h"
 
 static uint64_t g_epoch_seq = 0;
 static uint8_t g_running_ep = 0; // TODO, This value should be controled by journal process thread
@@ -60,12 +61,12 @@ int is_valid_running_ep()
     return 1;
 }
 
-int ino_register_lock(uint8_t global_epoch_idx)
+void ino_register_lock(uint8_t global_epoch_idx)
 {
     spin_lock(&global_epoch_ino_register_lock[global_epoch_idx]);
 }
 
-int ino_register_unlock(uint8_t global_epoch_idx)
+void ino_register_unlock(uint8_t global_epoch_idx)
 {
     spin_unlock(&global_epoch_ino_register_lock[global_epoch_idx]);
 }
@@ -73,18 +74,18 @@ int ino_register_unlock(uint8_t global_epoch_idx)
 
 int get_global_epoch(uint8_t * ep_no, struct list_head ** g_ep_head)
 {
-    spin_lock(&epoch_switch_spin_lock);
+    j_stat_spin_lock(&epoch_switch_spin_lock, J_STAT_LOCK_EPOCH_SWITCH);
     if (is_valid_running_ep())
     {
         *ep_no = g_running_ep;
         *g_ep_head = &global_epoch[g_running_ep].global_ino_epoch_list;
-        spin_unlock(&epoch_switch_spin_lock);
+        j_stat_spin_unlock(&epoch_switch_spin_lock, J_STAT_LOCK_EPOCH_SWITCH);
         //INFO_REPORT("get current global epoch info success, idx %d\n", g_running_ep);
         return F2FSJ_OK;
     }
     else
     {
-        spin_unlock(&epoch_switch_spin_lock);
+        j_stat_spin_unlock(&epoch_switch_spin_lock, J_STAT_LOCK_EPOCH_SWITCH);
         STATUS_LOG(STATUS_ERROR, "invalid running epoch number, please check\n");
         return F2FSJ_ERROR;
     }
@@ -128,7 +129,29 @@ struct list_head  *get_g_to_be_commited_epoch_list_head()
 }
 
 
-int iterate_2_next_ep()
+uint64_t get_running_epoch_seq()
+{
+    uint64_t ep_seq = 0;
+
+    j_stat_spin_lock(&epoch_switch_spin_lock, J_STAT_LOCK_EPOCH_SWITCH);
+    ep_seq = g_epoch_seq;
+    j_stat_spin_unlock(&epoch_switch_spin_lock, J_STAT_LOCK_EPOCH_SWITCH);
+
+    return ep_seq;
+}
+
+uint64_t j_lock_running_epoch()
+{
+    j_stat_spin_lock(&epoch_switch_spin_lock, J_STAT_LOCK_EPOCH_SWITCH);
+    return g_epoch_seq;
+}
+
+void j_unlock_running_epoch()
+{
+    j_stat_spin_unlock(&epoch_switch_spin_lock, J_STAT_LOCK_EPOCH_SWITCH);
+}
+
+void iterate_2_next_ep()
 {
     g_epoch_seq ++;
     g_running_ep ++;
@@ -136,7 +159,7 @@ int iterate_2_next_ep()
     if (global_epoch[g_running_ep].g_epoch_status == EPOCH_IDLE)
     {
         global_epoch[g_running_ep].g_epoch_status = EPOCH_RUNNING;
-        global_epoch[g_running_ep].epoch_seq      = g_running_ep;
+        global_epoch[g_running_ep].epoch_seq      = g_epoch_seq;
         //INFO_REPORT("Switch to next epoch\n");
     }
     else
@@ -145,14 +168,32 @@ int iterate_2_next_ep()
     }
 }
 
-int ep_switch_spin_lock()
+void ep_switch_spin_lock()
 {
-    spin_lock(&epoch_switch_spin_lock);
+    j_stat_spin_lock(&epoch_switch_spin_lock, J_STAT_LOCK_EPOCH_SWITCH);
 }
 
-int ep_switch_spin_unlock()
+void ep_switch_spin_unlock()
 {
-    spin_unlock(&epoch_switch_spin_lock);
+    j_stat_spin_unlock(&epoch_switch_spin_lock, J_STAT_LOCK_EPOCH_SWITCH);
+}
+
+int get_nr_busy_epochs()
+{
+    int nr_busy = 0;
+    int i = 0;
+
+    j_stat_spin_lock(&epoch_switch_spin_lock, J_STAT_LOCK_EPOCH_SWITCH);
+    for (i = 0; i < MAX_GLOBAL_EP_NUM; i++)
+    {
+        if (global_epoch[i].g_epoch_status != EPOCH_IDLE)
+        {
+            nr_busy ++;
+        }
+    }
+    j_stat_spin_unlock(&epoch_switch_spin_lock, J_STAT_LOCK_EPOCH_SWITCH);
+
+    return nr_busy;
 }
 
 #define J_TIMEOUT_MS (5000)
@@ -169,13 +210,12 @@ int alloc_log_memory()
     static uint64_t cnt = 0;
     static unsigned long time_stamp1 = 0;
     static unsigned long time_stamp2 = 0;
-    static void * mem_ptr = NULL;
     if (!is_init)
     {
         printk("memory test init\n");
         is_init = 1;
         time_stamp1 = get_current_time_ms();
-        printk("time test %lld\n", time_stamp1);
+        printk("time test %lu\n", time_stamp1);
     }
 
     time_stamp2 = get_current_time_ms();
@@ -183,7 +223,7 @@ int alloc_log_memory()
     // timeout Or journal file full
     if (time_stamp2 - time_stamp1 >= J_TIMEOUT_MS || ((cnt / STEP) + 1 >= J_COMMIT_SIZE))
     {
-        printk("time2 - time2 %lld, used page for journal is %lld\n", time_stamp2 - time_stamp1, cnt / STEP);
+        printk("time2 - time2 %lu, used page for journal is %llu\n", time_stamp2 - time_stamp1, cnt / STEP);
         for (i = 0; i < (cnt / STEP); i++)
         {
             //kunmap_atomic(page_buf_array[i]);
@@ -63,6 +63,25 @@ typedef enum __j_inode_log_list_status_e
     LOG_LIST_INUSE = 1
 }j_inode_log_list_status_e;
 
+#define J_MAX_DIRTY_RANGES (4)
+
+typedef struct __j_dirty_range
+{
+    pgoff_t start_idx;      ///< first dirty page index
+    pgoff_t end_idx;        ///< last dirty page index, inclusive
+}j_dirty_range_t;
+
+/**
+ * Data pages dirtied by an inode in one epoch, they are written back before the epoch commits.
+ * Ranges are sorted and never overlap or touch, when there are more than J_MAX_DIRTY_RANGES,
+ * the two ranges with the smallest gap are merged, so writeback may cover some clean pages.
+ */
+typedef struct __j_dirty_range_set
+{
+    uint8_t nr_ranges;
+    j_dirty_range_t ranges[J_MAX_DIRTY_RANGES + 1];     ///< one more slot for inserting before merge
+}j_dirty_range_set_t;
+
 typedef struct __j_ino_epoch
 {
     // epoch number
@@ -73,6 +92,9 @@ typedef struct __j_ino_epoch
 
     // inode log list head
     struct list_head inode_log_list_head;
+
+    // data pages dirtied in this epoch
+    j_dirty_range_set_t dirty_data_ranges;
 }j_ino_local_epoch_t;
 
 typedef struct __global_epoch
@@ -107,16 +129,29 @@ global_epoch_t *get_cur_g_running_epoch();
 
 struct list_head *get_g_to_be_commited_epoch_list_head();
 
-int ino_register_lock(uint8_t global_epoch_idx);
+void ino_register_lock(uint8_t global_epoch_idx);
 
-int ino_register_unlock(uint8_t global_epoch_idx);
+void ino_register_unlock(uint8_t global_epoch_idx);
 
 ///< @brief Should be protected by ep switch lock
-int iterate_2_next_ep();
+void iterate_2_next_ep();
+
+///< @brief Sequence of current running epoch, it grows by one at each epoch switch
+uint64_t get_running_epoch_seq();
+
+/**
+ * @brief Hold off epoch switch, a log of the returned running epoch is not committed yet
+ *        and can be updated in place until j_unlock_running_epoch()
+ */
+uint64_t j_lock_running_epoch();
+void j_unlock_running_epoch();
+
+void ep_switch_spin_lock();
 
-int ep_switch_spin_lock();
+void ep_switch_spin_unlock();
 
-int ep_switch_spin_unlock();
+///< @brief Global epochs running or waiting for commit
+int get_nr_busy_epochs();
 
 /** API for file operations to allocate memory for log entry*/
 int alloc_log_entry_memory(delta_log_t ** log_entry);
@@ -13,16 +13,102 @@
 #include "j_log_operate.h"
 #include "j_journal_file.h"
 #include "j_checkpoint.h"
+#include "j_stats.h"
+#include "j_trace.h"
+
+///< inode whose data pages are submitted at commit and need to be waited before journal commit
+typedef struct __j_data_wb_inode
+{
+    struct inode *inode;
+    j_dirty_range_set_t ranges;
+    struct list_head wb_list;
+}j_data_wb_inode_t;
+
+/**
+ * @brief Submit data pages dirtied by an inode in the committing local epoch, ordered mode
+ *        requires them on disk before the logs of this epoch. The inode is grabbed until waited.
+ *
+ * @param f2fs_i
+ * @param local_ep_idx
+ * @param wb_inode_list
+ * @return int F2FSJ_ERROR if the data pages cannot be written
+ */
+static int ep_commit_submit_inode_data(struct f2fs_inode_info *f2fs_i, uint8_t local_ep_idx,
+                                                        struct list_head *wb_inode_list)
+{
+    j_data_wb_inode_t *wb_inode = NULL;
+    j_dirty_range_set_t ranges;
+    int ret = F2FSJ_OK;
+
+    j_fetch_dirty_data_ranges(f2fs_i, local_ep_idx, &ranges);
+    if (!ranges.nr_ranges)
+    {
+        return F2FSJ_OK;
+    }
+
+    // inode is being evicted, its dirty pages are written or truncated by eviction
+    if (!igrab(&f2fs_i->vfs_inode))
+    {
+        return F2FSJ_OK;
+    }
+
+    if (ep_commit_writeback_data_pages(f2fs_i, &ranges) != F2FSJ_OK)
+    {
+        ret = F2FSJ_ERROR;
+    }
+
+    wb_inode = kmalloc(sizeof(j_data_wb_inode_t), GFP_NOFS);
+    if (!wb_inode)
+    {
+        // cannot defer it, wait now
+        if (ep_commit_wait_data_pages(f2fs_i, &ranges) != F2FSJ_OK)
+        {
+            ret = F2FSJ_ERROR;
+        }
+        iput(&f2fs_i->vfs_inode);
+        return ret;
+    }
+
+    wb_inode->inode = &f2fs_i->vfs_inode;
+    memcpy(&wb_inode->ranges, &ranges, sizeof(j_dirty_range_set_t));
+    list_add_tail(&wb_inode->wb_list, wb_inode_list);
+
+    return ret;
+}
+
+/**
+ * @brief Wait all data pages submitted by ep_commit_submit_inode_data(), the list is always
+ *        drained and the inodes are put even if some pages fail
+ *
+ * @param wb_inode_list
+ * @return int F2FSJ_ERROR if any data page is not written
+ */
+static int ep_commit_wait_inode_data(struct list_head *wb_inode_list)
+{
+    j_data_wb_inode_t *wb_inode = NULL;
+    j_data_wb_inode_t *wb_inode_next = NULL;
+    int ret = F2FSJ_OK;
+
+    list_for_each_entry_safe(wb_inode, wb_inode_next, wb_inode_list, wb_list)
+    {
+        if (ep_commit_wait_data_pages(F2FS_I(wb_inode->inode), &wb_inode->ranges) != F2FSJ_OK)
+        {
+            ret = F2FSJ_ERROR;
+        }
+        iput(wb_inode->inode);
+
+        list_del(&wb_inode->wb_list);
+        kfree(wb_inode);
+    }
+
+    return ret;
+}
 
 int trigger_epoch_commit()
 {
     global_epoch_t *g_to_be_committed_ep = NULL;
 
-    uint8_t local_running_ep_no = MAX_GLOBAL_EP_NUM;
-    struct list_head *g_epoch_inode_list_head        = NULL;
     struct list_head *g_to_be_committed_ep_list_head = NULL;
-    struct f2fs_inode_info * f2fs_i      = NULL;
-    struct f2fs_inode_info * f2fs_i_next = NULL;
 
 
     //Now, I use a spinlock to change the current running epoch to to_be_committed epoch
@@ -45,18 +131,12 @@ int trigger_epoch_commit()
 
     ep_switch_spin_unlock();
 
-    /** iterate the checkin inodes and set their local running epoch to EPOCH_TOBE_COMMIT*/
-    /** But this step does not make sence, inode log list may not need record epoch status
-     *  IDLE or INUSE for per-inode log list is enough 
-    */
-#if 0
-    g_epoch_inode_list_head = &g_to_be_committed_ep->global_ino_epoch_list;
-    list_for_each_entry_safe(f2fs_i, f2fs_i_next, g_epoch_inode_list_head, ino_regis_global_epoch_list)
-    {
-        local_running_ep_no = f2fs_i->j_local_active_epoch;
-        f2fs_i->j_ino_log_list[local_running_ep_no].log_list_status = EPOCH_TOBE_COMMIT; // can delete
-    }
-#endif
+    j_stat_epoch(J_STAT_EP_SEALED, 1);
+    trace_f2fsj_epoch_seal(g_to_be_committed_ep->epoch_seq, g_to_be_committed_ep->g_epoch_type);
+
+    /** local epochs of the checkin inodes are not marked here, IDLE or INUSE is enough for
+     *  the per-inode log list, epoch_commit() moves them to COMMITTING
+     */
 
     INFO_REPORT("epoch %d can be committed\n", g_to_be_committed_ep->epoch_seq);
 
@@ -76,10 +156,11 @@ int epoch_commit(struct f2fs_sb_info *sbi)
 
     uint8_t local_ep_idx  = NONE_EPOCH;
     uint8_t global_ep_idx = NONE_EPOCH;
+    uint32_t nr_inodes = 0;
+    int ep_ret = F2FSJ_OK;
 
-    struct page *p = NULL;
-    struct bio  *b = NULL;
-    uint32_t j_start_blk = 0;
+    struct blk_plug plug;
+    LIST_HEAD(wb_inode_list);
 
     /** get global commit and checkpoint epoch list head*/
     g_to_be_committed_ep_list_head  = get_g_to_be_commited_epoch_list_head();
@@ -123,11 +204,19 @@ int epoch_commit(struct f2fs_sb_info *sbi)
                 return F2FSJ_ERROR;
             }
 
-            ///< link this cp_info list head into g_checkpoint_list
-            insert_cp_info_list_head_2_g_cp_list(cp_info_list_head_node);
+            cp_info_list_head_node->g_ep_num = g_to_be_committed_ep->g_epoch_type;
+            cp_info_list_head_node->g_ep_ver = g_to_be_committed_ep->epoch_seq;
 
             global_ep_idx = g_to_be_committed_ep->g_epoch_type;
             INFO_REPORT("global ep idx %d\n", global_ep_idx);
+
+            nr_inodes = 0;
+            ep_ret    = F2FSJ_OK;
+            trace_f2fsj_aggregate_start(g_to_be_committed_ep->epoch_seq, global_ep_idx, 0, 0);
+
+            ///< data of all inodes in this epoch is submitted together
+            blk_start_plug(&plug);
+
             /** iter each inode log list and aggregate logs into pages*/
             list_for_each_entry_safe(f2fs_i, f2fs_i_next, g_epoch_inode_list_head, ino_regis_global_epoch_list[global_ep_idx])
             {
@@ -143,23 +232,39 @@ int epoch_commit(struct f2fs_sb_info *sbi)
                         continue;
                     }
 
+                    spin_lock(&f2fs_i->ino_spin_lock_local_ep);
+
                     ///< change this inode local epoch to COMMITTING
                     f2fs_i->j_ino_log_list[local_ep_idx].log_list_status = EPOCH_COMMITING; // can delete
                     /** reset inode local active epoch
-                     *  wait future file ops to make this inode register to new running g_epoch and also enable local epoch*/
-                    f2fs_i->j_local_active_epoch = NONE_EPOCH;
+                     *  wait future file ops to make this inode register to new running g_epoch and also enable local epoch
+                     *  a file op may already have done it, keep the local epoch of the new running g_epoch then*/
+                    if (f2fs_i->j_local_active_epoch == local_ep_idx)
+                    {
+                        f2fs_i->j_local_active_epoch = NONE_EPOCH;
+                    }
 
-                    //spin_unlock(&f2fs_i->ino_spin_lock_local_ep);
+                    spin_unlock(&f2fs_i->ino_spin_lock_local_ep);
 
                     /** aggregates logs into page
                      *  In this function, log entries will be deleted from local log list
                      *  collec cp_info for journal apply
                     */
                     aggregate_per_ino_log(f2fs_i, cp_info_list_head_node, global_ep_idx, local_ep_idx);
+                    nr_inodes ++;
+
+                    /** ordered mode: writeback data pages dirtied in this epoch, only the dirty ranges*/
+                    if (ep_commit_submit_inode_data(f2fs_i, local_ep_idx, &wb_inode_list) != F2FSJ_OK)
+                    {
+                        ep_ret = F2FSJ_ERROR;
+                    }
 
-                    /** reset local inode log list status*/
-                    //local_ep_idx  = f2fs_i->g2l_ep_map[global_ep_idx];
+                    /** reset local inode log list status, and unmap it from this g_epoch: the g_epoch
+                     *  runs again after wrapping around, the inode must check in again then*/
+                    spin_lock(&f2fs_i->ino_spin_lock_local_ep);
+                    f2fs_i->g2l_ep_map[global_ep_idx] = NONE_EPOCH;
                     f2fs_i->j_ino_log_list[local_ep_idx].log_list_status = LOG_LIST_IDLE;
+                    spin_unlock(&f2fs_i->ino_spin_lock_local_ep);
                 }
                 else
                 {
@@ -167,13 +272,59 @@ int epoch_commit(struct f2fs_sb_info *sbi)
                 }
             }
 
+            blk_finish_plug(&plug);
+
+            trace_f2fsj_aggregate_end(g_to_be_committed_ep->epoch_seq, global_ep_idx, nr_inodes,
+                                      cp_info_list_head_node->nr_logs);
+
+            // data must be on disk before the logs that describe it
+            if (ep_commit_wait_inode_data(&wb_inode_list) != F2FSJ_OK)
+            {
+                ep_ret = F2FSJ_ERROR;
+            }
+
+            // block allocation of the data above (and anything since last commit) goes with this epoch
+            if (ep_ret == F2FSJ_OK && j_log_meta_deltas() != F2FSJ_OK)
+            {
+                STATUS_LOG(STATUS_ERROR, "log meta deltas of epoch %llu fail\n", g_to_be_committed_ep->epoch_seq);
+                ep_ret = F2FSJ_ERROR;
+            }
+
+            j_crash_point(sbi, J_CRASH_COMMIT_DATA);
+
+            if (ep_ret != F2FSJ_OK)
+            {
+                /** data or meta deltas of this epoch are not in place, do not commit logs
+                 *  depending on them, its pages are left to the normal writeback and checkpoint
+                 */
+                STATUS_LOG(STATUS_ERROR, "epoch %llu is not complete, abort its commit\n", g_to_be_committed_ep->epoch_seq);
+                ret = F2FSJ_ERROR;
+                free_log_cp_list(cp_info_list_head_node);
+            }
             // Code at here means that we already aggragate information of a group of logs which comes from same global epoch
             // we can commit journal now
-            write_current_mmap_j_file(sbi);
+            else if (write_current_mmap_j_file(sbi) != F2FSJ_OK)
+            {
+                /** the journal does not cover this epoch, so its pages are written back as usual
+                 *  and made durable by a checkpoint, fsync waiting for it fails
+                */
+                STATUS_LOG(STATUS_ERROR, "write journal of epoch %llu fail\n", g_to_be_committed_ep->epoch_seq);
+                ret = F2FSJ_ERROR;
+                free_log_cp_list(cp_info_list_head_node);
+            }
+            else
+            {
+                j_stat_epoch(J_STAT_EP_COMMITTED, 1);
+                j_crash_point(sbi, J_CRASH_COMMIT_JOURNAL);
+
+                // Then hold NODE and META pages covered by this epoch in memory until checkpoint,
+                // must be done before checkpoint can see (and free) this cp_info list
+                set_page_dirty_and_ready_do_cp(sbi, cp_info_list_head_node);
 
-            // Then set NODE and META page to dirty and ready for checkpoint
-            // TODO
-            //set_page_dirty_and_ready_do_cp(sbi, cp_info_list_head_node);
+                ///< link this cp_info list head into g_checkpoint_list only after the journal covers it,
+                ///< so a checkpoint snapshot never applies an epoch that is not durable yet
+                insert_cp_info_list_head_2_g_cp_list(cp_info_list_head_node);
+            }
 
             ///< when complete commit, delete this g_epoch from g_to_be_commited_ep_list
             list_del(&g_to_be_committed_ep->to_be_commit_global_epoch_list);
@@ -189,7 +340,7 @@ int epoch_commit(struct f2fs_sb_info *sbi)
         INFO_REPORT("To be committed epoch list is empty, no register epoch\n");
     }
 
-    return F2FSJ_OK;
+    return ret;
 }
 
 int is_g_commit_ep_empty()
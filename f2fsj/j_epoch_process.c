@@ -11,6 +11,8 @@
 #include "j_epoch_process.h"
 #include "j_epoch_commit.h"
 #include "j_checkpoint.h"
+#include "j_log_compact.h"
+#include "j_stats.h"
 #include "node.h"
 #include "segment.h"
 
@@ -25,8 +27,97 @@ static uint8_t stop_flag2 = 0;
 
 static bool is_clean_jfile = false;
 
+///< epochs are committed by commit thread or by fsync of data journaling files, one at a time
+static DEFINE_MUTEX(g_ep_commit_mutex);
+static uint64_t g_committed_ep_seq = 0;   ///< epochs with smaller sequence are committed, protected by g_ep_commit_mutex
+
+///< epoch_checkpoint() by checkpoint thread or by the journal stress test, and log compaction,
+///< one at a time, taken before g_ep_commit_mutex
+static DEFINE_MUTEX(g_checkpoint_mutex);
+
+static j_cp_sched_t g_cp_sched = {0};
+
 #define J_COMMIT_INTERVAL (5)
 
+///< free journal space below it triggers journal compaction, or checkpoint
+#define J_JOURNAL_LOW_SPACE (JOURNAL_FILE_SIZE / 20)
+
+/**
+ * @brief Clear the journal file left by recovery, before the first epoch is committed into it.
+ *        Caller holds g_ep_commit_mutex
+ *
+ * @param sbi
+ */
+static void j_clean_jfile_once(struct f2fs_sb_info *sbi)
+{
+    if (!is_clean_jfile)
+    {
+        // make journal clean by setting 0
+        INFO_REPORT("clear journal file...\n");
+        clear_journal_file_after_recovery(sbi->sb);
+        INFO_REPORT("clear journal file end\n");
+        is_clean_jfile = true;
+    }
+}
+
+/**
+ * @brief Switch running epoch and commit all epochs waiting for commit.
+ *        Caller holds g_ep_commit_mutex
+ *
+ * @param sbi
+ * @return int
+ */
+static int j_commit_running_epoch(struct f2fs_sb_info *sbi)
+{
+    uint64_t ep_seq = get_running_epoch_seq();
+    uint64_t start_ns = 0;
+    int ret = F2FSJ_OK;
+
+    j_clean_jfile_once(sbi);
+
+    // Switch to next journal period
+    trigger_epoch_commit();
+
+    if (!is_g_commit_ep_empty())
+    {
+        start_ns = get_current_time_ns();
+        ret = epoch_commit(sbi);
+        j_stat_latency(&g_j_stats.commit_lat, start_ns);
+    }
+
+    if (ret == F2FSJ_OK)
+    {
+        g_committed_ep_seq = ep_seq + 1;
+    }
+
+    return ret;
+}
+
+int j_sync_epoch_commit(struct f2fs_sb_info *sbi)
+{
+    uint64_t ep_seq = get_running_epoch_seq();
+    uint64_t start_ns = 0;
+    int ret = F2FSJ_OK;
+
+    // fsync waiting for another commit is the backpressure of the journal
+    if (!mutex_trylock(&g_ep_commit_mutex))
+    {
+        start_ns = get_current_time_ns();
+        mutex_lock(&g_ep_commit_mutex);
+        j_stat_stall(start_ns);
+    }
+
+    // a commit finished while we were waiting already covers our logs (group commit)
+    if (g_committed_ep_seq <= ep_seq)
+    {
+        ret = j_commit_running_epoch(sbi);
+    }
+
+    mutex_unlock(&g_ep_commit_mutex);
+
+    return ret == F2FSJ_OK ? 0 : -EIO;
+}
+
 int j_ep_commit_kthread(void *param)
 {
     struct f2fs_sb_info *sbi = (struct f2fs_sb_info *)param;
@@ -43,32 +134,189 @@ int j_ep_commit_kthread(void *param)
         // sleep
         F2FSj_K_THREAD_SLEEP_MS(1000);
 
-        if (!is_clean_jfile)
-        {
-            // make journal clean by setting 0
-            INFO_REPORT("clear journal file...\n");
-            clear_journal_file_after_recovery(sbi->sb);
-            INFO_REPORT("clear journal file end\n");
-            is_clean_jfile = true;
-        }
+        mutex_lock(&g_ep_commit_mutex);
+
+        j_clean_jfile_once(sbi);
 
         if (commt_thread_cnt % J_COMMIT_INTERVAL == 0)
         //if (commt_thread_cnt == 1) // for debug
         {
-            // Switch to next journal period
-            trigger_epoch_commit();
-
-            if (!is_g_commit_ep_empty())
-            {
-                epoch_commit(sbi);
-            }
+            j_commit_running_epoch(sbi);
         }
+
+        mutex_unlock(&g_ep_commit_mutex);
         //INFO_REPORT("[%s] run one time\n", __FUNCTION__);
     }
 
     return F2FSJ_OK;
 }
 
+int j_sync_epoch_checkpoint(struct f2fs_sb_info *sbi)
+{
+    j_checkpoint_snapshot_t snap;
+    uint64_t start_ns = 0;
+    int nr_snap = 0;
+    int ret = F2FSJ_OK;
+
+    mutex_lock(&g_checkpoint_mutex);
+    start_ns = get_current_time_ns();
+    ret = epoch_checkpoint_prepare(sbi);
+    if (ret == F2FSJ_OK)
+    {
+        // committed epochs are taken together with the journal range holding their logs
+        mutex_lock(&g_ep_commit_mutex);
+        nr_snap = epoch_checkpoint_snapshot(&snap);
+        mutex_unlock(&g_ep_commit_mutex);
+
+        // epochs go on being committed behind the snapshot while it is applied
+        ret = epoch_checkpoint(sbi, &snap);
+    }
+    if (ret == F2FSJ_OK && nr_snap)
+    {
+        ///< orphans are not in the checkpoint pack, log them again behind the new tail
+        f2fsj_relog_orphan_inodes(sbi);
+
+        // and write them before the tail drops the logs they replace
+        mutex_lock(&g_ep_commit_mutex);
+        ret = j_flush_journal_logs(sbi);
+        if (ret == F2FSJ_OK)
+        {
+            ret = j_reset_journal_tail(sbi, snap.tail_log_entry);
+        }
+        mutex_unlock(&g_ep_commit_mutex);
+    }
+    j_stat_latency(&g_j_stats.checkpoint_lat, start_ns);
+    mutex_unlock(&g_checkpoint_mutex);
+
+    return ret;
+}
+
+unsigned int j_estimate_recovery_ms(struct f2fs_sb_info *sbi)
+{
+    return div64_u64(get_nr_unapplied_logs() * sbi->j_replay_cost_ns, 1000000);
+}
+
+/**
+ * @brief How many logs can be replayed within the recovery time objective
+ *
+ * @param sbi
+ * @return uint64_t
+ */
+static uint64_t j_replay_budget_logs(struct f2fs_sb_info *sbi)
+{
+    if (!sbi->j_replay_cost_ns)
+    {
+        return U64_MAX;
+    }
+
+    return div64_u64((uint64_t)sbi->j_max_recovery_ms * 1000000, sbi->j_replay_cost_ns);
+}
+
+/**
+ * @brief Sample journal fill rate once per checkpoint thread tick,
+ *        a moving average (3/4 old, 1/4 new) absorbs bursts
+ *
+ * @param sched
+ */
+static void j_update_fill_rate(j_cp_sched_t *sched)
+{
+    uint64_t total_logs = get_total_alloc_log_entries();
+    uint64_t new_logs = total_logs - sched->last_total_logs;
+
+    sched->last_total_logs = total_logs;
+    sched->fill_rate = (sched->fill_rate * 3 + new_logs) >> 2;
+    sched->tick ++;
+}
+
+/**
+ * @brief Decide whether committed epochs should be applied now.
+ *        Instead of a fixed interval, checkpoint is driven by the journal fill level,
+ *        FS metadata pressure and the recovery time objective (j_max_recovery_ms):
+ *        logs that are committed but not applied are what a crash would have to replay.
+ *
+ * @param sbi
+ * @param sched
+ * @return j_cp_reason_e
+ */
+static j_cp_reason_e j_need_checkpoint(struct f2fs_sb_info *sbi, j_cp_sched_t *sched)
+{
+    int free_on_disk_journal_space = get_on_disk_free_journal_space();
+    uint64_t unapplied_logs = 0;
+    uint64_t budget_logs = 0;
+
+    // free space trigger journal apply (journal ckpt)
+    if (free_on_disk_journal_space <= J_JOURNAL_LOW_SPACE)
+    {
+        return J_CP_JOURNAL_FULL;
+    }
+
+    // operator disables the time objective, keep the fixed interval
+    if (!sbi->j_max_recovery_ms)
+    {
+        return (sched->tick % 3 == 0) ? J_CP_PERIODIC : J_CP_NONE;
+    }
+
+    // in-memory FS metadata grows too much, apply it before memory pressure does it
+    if (excess_dirty_nats(sbi) || excess_dirty_nodes(sbi) || excess_prefree_segs(sbi))
+    {
+        return J_CP_DIRTY_META;
+    }
+
+    // pages held by journal are written by checkpoint only, release them
+    if (sbi->j_absorb_max_pages
+     && get_pages(sbi, F2FSJ_JDIRTY_PAGES) >= sbi->j_absorb_max_pages)
+    {
+        return J_CP_ABSORB_FULL;
+    }
+
+    // logs that will be committed before the next decision need replay too
+    unapplied_logs = get_nr_unapplied_logs();
+    budget_logs = j_replay_budget_logs(sbi);
+    if (unapplied_logs + sched->fill_rate * (J_COMMIT_INTERVAL + 1) >= budget_logs)
+    {
+        return J_CP_RECOVERY_TIME;
+    }
+
+    // apply logs while nobody is waiting for IO, so that busy periods checkpoint less
+    if (is_idle(sbi, REQ_TIME)
+     && unapplied_logs >= budget_logs / J_IDLE_CP_BUDGET_RATIO)
+    {
+        return J_CP_IDLE;
+    }
+
+    return J_CP_NONE;
+}
+
+/**
+ * @brief Journal is nearly full, make room by compacting its oldest logs instead of applying them
+ *
+ * @param sbi
+ * @return int, F2FSJ_OK if journal has enough free space afterwards
+ */
+static int j_try_compact_journal(struct f2fs_sb_info *sbi)
+{
+    int ret = F2FSJ_OK;
+
+    if (!sbi->j_log_compaction)
+    {
+        return F2FSJ_ERROR;
+    }
+
+    // both move the journal tail
+    mutex_lock(&g_checkpoint_mutex);
+    mutex_lock(&g_ep_commit_mutex);
+    ret = j_compact_journal(sbi);
+    mutex_unlock(&g_ep_commit_mutex);
+    mutex_unlock(&g_checkpoint_mutex);
+
+    if (ret != F2FSJ_OK || get_on_disk_free_journal_space() <= J_JOURNAL_LOW_SPACE)
+    {
+        return F2FSJ_ERROR;
+    }
+
+    return F2FSJ_OK;
+}
+
 int j_checkpoint_kthread(void *param)
 {
     struct f2fs_sb_info *sbi = (struct f2fs_sb_info *)param;
@@ -76,10 +324,7 @@ int j_checkpoint_kthread(void *param)
 
     INFO_REPORT("Journal checkpoint thread begins to run\n");
 
-    static uint64_t cnt = 0;
-    static uint64_t cnt_unlink = 0;
-    int free_on_disk_journal_space = 0;
-    uint64_t cp_thread_cnt = 0;
+    j_cp_reason_e reason = J_CP_NONE;
 
     while (!kthread_should_stop())
     {
@@ -88,32 +333,26 @@ int j_checkpoint_kthread(void *param)
         // sleep 1s
         F2FSj_K_THREAD_SLEEP_MS(1000);
 
-        cp_thread_cnt ++;
+        j_update_fill_rate(&g_cp_sched);
+
+        // nothing committed, nothing to apply
+        if (is_g_checkpoint_cp_list_empty())
+        {
+            continue;
+        }
+
+        reason = j_need_checkpoint(sbi, &g_cp_sched);
+        if (reason == J_CP_JOURNAL_FULL && j_try_compact_journal(sbi) == F2FSJ_OK)
+        {
+            INFO_REPORT("journal compacted, checkpoint is postponed\n");
+            continue;
+        }
 
-        // if free journal space is less than 25%, should trigger checkpoint to apply logs and free journal file
-        free_on_disk_journal_space = get_on_disk_free_journal_space();
-        if (free_on_disk_journal_space)
+        if (reason != J_CP_NONE)
         {
-            // free space trigger journal apply (journal ckpt)
-            if (free_on_disk_journal_space <= (0.05) * JOURNAL_FILE_SIZE)
-            {
-                // if global checkpoint list is not empty, we can do checkpoint
-                if (!is_g_checkpoint_cp_list_empty())
-                {
-                    INFO_REPORT("Exceed free journal space ratio, trigger checkpoint\n");
-                    epoch_checkpoint(sbi);
-                }
-            }
-
-            // timeout to trigger checkpoint
-            if (cp_thread_cnt % 3 == 0)
-            {
-                if (!is_g_checkpoint_cp_list_empty())
-                {
-                    INFO_REPORT("Exceed 30s, trigger checkpoint\n");
-                    epoch_checkpoint(sbi);
-                }
-            }
+            INFO_REPORT("trigger checkpoint, reason %d, unapplied logs %llu, fill rate %llu\n",
+                        reason, get_nr_unapplied_logs(), g_cp_sched.fill_rate);
+            j_sync_epoch_checkpoint(sbi);
         }
     }
 
@@ -19,6 +19,34 @@
 #define J_EP_COMMIT_TIMEOUT (4 * 1e3)   ///< 2000ms <-> 2s
 #define J_CHECKPOINT_TIMEOUT (4 * 1e3)
 
+#define J_DEF_MAX_RECOVERY_MS (2000)    ///< default recovery time objective, 0 means periodic checkpoint
+/**
+ * default replay cost of one log: replay reads the inode and maybe a directory node page
+ * of the log, about one random 4KB read of an SSD. Raised by recovery, which times the logs
+ * actually replayed, and can be set through sysfs j_replay_cost_ns
+ */
+#define J_DEF_REPLAY_COST_NS  (20000)
+#define J_IDLE_CP_BUDGET_RATIO (4)      ///< when idle, checkpoint once 1/4 of the replay budget is used
+#define J_DEF_ABSORB_SEGS     (4)       ///< default memory budget of journal dirty pages, in segments
+
+typedef enum __j_cp_reason
+{
+    J_CP_NONE = 0,
+    J_CP_JOURNAL_FULL,      ///< on-disk journal is running out of space
+    J_CP_DIRTY_META,        ///< too many dirty NAT/node pages or prefree segments
+    J_CP_ABSORB_FULL,       ///< journal dirty pages use up their memory budget
+    J_CP_RECOVERY_TIME,     ///< replaying unapplied logs would exceed the recovery time objective
+    J_CP_IDLE,              ///< device is idle, apply logs in advance
+    J_CP_PERIODIC,          ///< legacy fixed interval
+}j_cp_reason_e;
+
+typedef struct __j_cp_sched
+{
+    uint64_t last_total_logs;   ///< allocated log entries at last tick
+    uint64_t fill_rate;         ///< EWMA of allocated log entries per tick
+    uint64_t tick;
+}j_cp_sched_t;
+
 typedef struct __j_ep_commit_task
 {
     struct task_struct *f2fsj_ep_commit_task;
@@ -63,4 +91,31 @@ int create_f2fsj_kthread(struct f2fs_sb_info *sbi);
 
 int stop_f2fsj_kthread();
 
+/**
+ * @brief Commit the running epoch now and wait until its logs are durable, used by fsync
+ *        of data journaling files. Concurrent callers share one commit
+ *
+ * @param sbi
+ * @return int, 0 or -EIO
+ */
+int j_sync_epoch_commit(struct f2fs_sb_info *sbi);
+
+/**
+ * @brief Apply committed epochs now, used by checkpoint thread and by the journal stress test.
+ *        Checkpoints run one at a time, epoch commits only wait while the snapshot is taken
+ *        and while the journal tail is moved past it
+ *
+ * @param sbi
+ * @return int, F2FSJ_OK or F2FSJ_ERROR
+ */
+int j_sync_epoch_checkpoint(struct f2fs_sb_info *sbi);
+
+/**
+ * @brief Estimate how long journal replay would take if we crashed now
+ *
+ * @param sbi
+ * @return unsigned int, in ms
+ */
+unsigned int j_estimate_recovery_ms(struct f2fs_sb_info *sbi);
+
 #endif // !_J_EPOCH_PROCESS_H
\ No newline at end of file
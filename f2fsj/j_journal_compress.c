@@ -0,0 +1,498 @@
+/**
+ * @file j_journal_compress.c
+ * @author leslie.cui (10033908@github.com)
+ * @brief implementation of LZ4 compressed journal
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ */
+#include "j_journal_compress.h"
+#include "iostat.h"
+#include "j_trace.h"
+#include <linux/crc32.h>
+#include <linux/vmalloc.h>
+#include <linux/lz4.h>
+
+#ifdef CONFIG_F2FS_FS_LZ4
+
+#define J_ZFRAME_HEAD_SIZE  (sizeof(j_zframe_head_t))
+#define J_ZFRAME_MAX_BLKS   \
+    DIV_ROUND_UP(J_ZFRAME_HEAD_SIZE + LZ4_COMPRESSBOUND(J_ZFRAME_MAX_PAGES * PAGE_SIZE), PAGE_SIZE)
+
+///< frames are written by epoch commit one at a time, or read by replay at mount
+static struct page *g_zpages[J_ZFRAME_MAX_BLKS];
+static uint8_t *g_zbuf = NULL;          ///< g_zpages mapped continuously
+static void *g_zwrkmem = NULL;
+static uint32_t g_zstart_blk = 0;       ///< first frame of the generation replay reads, kept in journal superblock
+static uint32_t g_zdisk_blk = 0;        ///< next frame goes to this journal block
+static uint32_t g_zgeneration = 1;
+static bool g_zrestart = false;        ///< set by checkpoint, older frames are no longer needed
+
+static void *j_vmap(struct page **pages, unsigned int count)
+{
+    void *buf = NULL;
+    int i = 0;
+
+    for (i = 0; i < 3; i++)
+    {
+        buf = vm_map_ram(pages, count, -1);
+        if (buf)
+        {
+            break;
+        }
+        vm_unmap_aliases();
+    }
+    return buf;
+}
+
+bool j_journal_compress_supported(void)
+{
+    return true;
+}
+
+int j_init_journal_compress(void)
+{
+    int i = 0;
+
+    if (g_zbuf)
+    {
+        return F2FSJ_OK;
+    }
+
+    for (i = 0; i < J_ZFRAME_MAX_BLKS; i++)
+    {
+        g_zpages[i] = alloc_page(GFP_KERNEL);
+        if (!g_zpages[i])
+        {
+            goto fail;
+        }
+    }
+
+    g_zwrkmem = kvmalloc(LZ4_MEM_COMPRESS, GFP_KERNEL);
+    if (!g_zwrkmem)
+    {
+        goto fail;
+    }
+
+    g_zbuf = j_vmap(g_zpages, J_ZFRAME_MAX_BLKS);
+    if (!g_zbuf)
+    {
+        goto fail;
+    }
+
+    return F2FSJ_OK;
+
+fail:
+    STATUS_LOG(STATUS_ERROR, "alloc journal compression buffers fail\n");
+    j_destroy_journal_compress();
+    return F2FSJ_ERROR;
+}
+
+void j_destroy_journal_compress(void)
+{
+    int i = 0;
+
+    if (g_zbuf)
+    {
+        vm_unmap_ram(g_zbuf, J_ZFRAME_MAX_BLKS);
+        g_zbuf = NULL;
+    }
+
+    kvfree(g_zwrkmem);
+    g_zwrkmem = NULL;
+
+    for (i = 0; i < J_ZFRAME_MAX_BLKS; i++)
+    {
+        if (g_zpages[i])
+        {
+            __free_page(g_zpages[i]);
+            g_zpages[i] = NULL;
+        }
+    }
+}
+
+void j_reset_journal_zframes(void)
+{
+    g_zstart_blk = 0;
+    g_zdisk_blk = 0;
+    g_zgeneration = 1;
+    WRITE_ONCE(g_zrestart, false);
+}
+
+void j_restart_journal_zframes(void)
+{
+    WRITE_ONCE(g_zrestart, true);
+}
+
+static uint32_t j_zframe_head_crc(j_zframe_head_t *head)
+{
+    j_zframe_head_t tmp = *head;
+
+    tmp.head_crc = 0;
+    return crc32_le(~0, (uint8_t *)&tmp, J_ZFRAME_HEAD_SIZE);
+}
+
+/**
+ * @brief synchronous IO of nr_blks frame blocks (g_zpages) from journal block blk
+ */
+static int j_zframe_io(struct f2fs_sb_info *sbi, uint32_t blk, uint32_t first_zpage, uint32_t nr_blks,
+                                int op, int op_flags)
+{
+    struct bio *b = NULL;
+    uint32_t i = 0;
+    int ret = F2FSJ_OK;
+
+    if (op == REQ_OP_WRITE)
+    {
+        ret = j_alloc_bio_write(sbi, &b, JORNAL_FILE_0_START_BLK + blk, nr_blks);
+    }
+    else
+    {
+        ret = j_alloc_bio_read(sbi, &b, JORNAL_FILE_0_START_BLK + blk);
+    }
+    if (ret != F2FSJ_OK)
+    {
+        return F2FSJ_ERROR;
+    }
+
+    bio_set_op_attrs(b, op, op_flags);
+    for (i = 0; i < nr_blks; i++)
+    {
+        if (add_journal_page_2_bio(g_zpages[first_zpage + i], b) != F2FSJ_OK)
+        {
+            bio_put(b);
+            return F2FSJ_ERROR;
+        }
+    }
+
+    if (op == REQ_OP_WRITE)
+    {
+        trace_f2fsj_journal_bio_submit(sbi->sb, JORNAL_FILE_0_START_BLK + blk, nr_blks, op_flags, 0);
+        f2fsj_account_write(sbi, J_WA_JOURNAL, (uint64_t)nr_blks * JOURNAL_BLOCK_SIZE);
+    }
+    f2fs_update_iostat(sbi, op == REQ_OP_WRITE ? FS_JOURNAL_IO : FS_JOURNAL_READ_IO,
+                       (uint64_t)nr_blks * JOURNAL_BLOCK_SIZE);
+    if (submit_bio_wait(b))
+    {
+        STATUS_LOG(STATUS_ERROR, "journal frame io at blk %u err %d\n", blk, b->bi_status);
+        ret = F2FSJ_ERROR;
+    }
+    if (op == REQ_OP_WRITE)
+    {
+        trace_f2fsj_journal_bio_complete(sbi->sb, JORNAL_FILE_0_START_BLK + blk, nr_blks, op_flags,
+                                        blk_status_to_errno(b->bi_status));
+    }
+    bio_put(b);
+
+    return ret;
+}
+
+/**
+ * @brief compress one frame of pages into g_zbuf
+ *
+ * @return uint32_t, journal blocks of the frame, 0 on error
+ */
+static uint32_t j_build_zframe(struct page **pages, uint32_t first_page, uint32_t nr_pages)
+{
+    j_zframe_head_t *head = (j_zframe_head_t *)g_zbuf;
+    uint8_t *payload = g_zbuf + J_ZFRAME_HEAD_SIZE;
+    uint32_t raw_len = nr_pages * PAGE_SIZE;
+    uint32_t nr_blks = 0;
+    uint8_t *src = NULL;
+    int z_len = 0;
+
+    src = j_vmap(&pages[first_page], nr_pages);
+    if (!src)
+    {
+        return 0;
+    }
+
+    memset(head, 0, J_ZFRAME_HEAD_SIZE);
+    z_len = LZ4_compress_default(src, payload, raw_len, LZ4_COMPRESSBOUND(raw_len), g_zwrkmem);
+    if (z_len <= 0 || z_len >= raw_len)
+    {
+        // e.g. data journal logs of compressed data, frame takes one more block than the pages
+        memcpy(payload, src, raw_len);
+        z_len = raw_len;
+        head->flags = J_ZFRAME_RAW;
+    }
+    vm_unmap_ram(src, nr_pages);
+
+    head->magic      = J_ZFRAME_MAGIC;
+    head->generation = g_zgeneration;
+    head->first_page = first_page;
+    head->nr_pages   = nr_pages;
+    head->z_len      = z_len;
+    head->data_crc   = crc32_le(~0, payload, z_len);
+    head->head_crc   = j_zframe_head_crc(head);
+
+    nr_blks = DIV_ROUND_UP(J_ZFRAME_HEAD_SIZE + z_len, PAGE_SIZE);
+    memset(payload + z_len, 0, nr_blks * PAGE_SIZE - J_ZFRAME_HEAD_SIZE - z_len);
+
+    return nr_blks;
+}
+
+/**
+ * @brief write frames of the pages from g_zdisk_blk on, -ENOSPC if a frame passes end_blk
+ */
+static int j_write_zframes(struct f2fs_sb_info *sbi, struct page **pages, uint32_t first_page,
+                                    uint32_t nr_pages, uint32_t end_blk, int *op_flags, uint32_t *nr_blks)
+{
+    uint32_t frame_pages = 0;
+    uint32_t frame_blks = 0;
+    int flags = 0;
+
+    while (nr_pages)
+    {
+        // frames follow the journal pages around the end of journal file but never cross it
+        frame_pages = min3(nr_pages, (uint32_t)J_ZFRAME_MAX_PAGES, JOURNAL_BLK_PER_SMALL_FILE - first_page);
+        frame_blks = j_build_zframe(pages, first_page, frame_pages);
+        if (!frame_blks)
+        {
+            return F2FSJ_ERROR;
+        }
+
+        if (g_zdisk_blk + frame_blks > end_blk)
+        {
+            return -ENOSPC;
+        }
+
+        flags = REQ_SYNC;
+        if (*op_flags & REQ_PREFLUSH)
+        {
+            flags |= REQ_PREFLUSH;
+            *op_flags &= ~REQ_PREFLUSH;
+        }
+        if (frame_pages == nr_pages)
+        {
+            flags |= (*op_flags & REQ_FUA);
+        }
+
+        if (j_zframe_io(sbi, g_zdisk_blk, 0, frame_blks, REQ_OP_WRITE, flags) != F2FSJ_OK)
+        {
+            return F2FSJ_ERROR;
+        }
+
+        g_zdisk_blk += frame_blks;
+        *nr_blks += frame_blks;
+        first_page = (first_page + frame_pages) % JOURNAL_BLK_PER_SMALL_FILE;
+        nr_pages -= frame_pages;
+    }
+
+    return F2FSJ_OK;
+}
+
+/**
+ * @brief write pages from live_page as a new generation of frames, after the frames of the current
+ *        generation or else before them, so replay keeps reading them until the new generation is
+ *        durable and journal superblock points to it
+ */
+static int j_write_zgeneration(struct f2fs_sb_info *sbi, struct page **pages, uint32_t live_page,
+                                        uint32_t nr_pages, int *op_flags, uint32_t *nr_blks)
+{
+    uint32_t old_end_blk = g_zdisk_blk;
+    uint32_t gen_blks = 0;
+    int ret = F2FSJ_OK;
+
+    WRITE_ONCE(g_zrestart, false);
+    g_zgeneration ++;
+    INFO_REPORT("restart journal frames, generation %u, %u pages from %u\n", g_zgeneration, nr_pages, live_page);
+
+    ret = j_write_zframes(sbi, pages, live_page, nr_pages, JOURNAL_BLK_PER_SMALL_FILE, op_flags, &gen_blks);
+    if (ret == -ENOSPC)
+    {
+        *nr_blks += gen_blks;
+        gen_blks = 0;
+        g_zdisk_blk = 0;
+        ret = j_write_zframes(sbi, pages, live_page, nr_pages, g_zstart_blk, op_flags, &gen_blks);
+    }
+    *nr_blks += gen_blks;
+    if (ret == -ENOSPC)
+    {
+        STATUS_LOG(STATUS_ERROR, "compressed journal does not fit in journal file\n");
+        ret = F2FSJ_ERROR;
+    }
+
+    if (ret == F2FSJ_OK)
+    {
+        ret = j_write_journal_zframe_start(sbi, g_zdisk_blk - gen_blks);
+    }
+
+    if (ret != F2FSJ_OK)
+    {
+        // journal superblock still points to the current generation, the next commit tries again
+        g_zdisk_blk = old_end_blk;
+        WRITE_ONCE(g_zrestart, true);
+        return ret;
+    }
+
+    g_zstart_blk = g_zdisk_blk - gen_blks;
+    return F2FSJ_OK;
+}
+
+int j_write_journal_zframes(struct f2fs_sb_info *sbi, struct page **pages, uint32_t first_page,
+                                    uint32_t nr_pages, uint32_t live_page, int op_flags, uint32_t *nr_blks)
+{
+    uint32_t end_page = (first_page + nr_pages) % JOURNAL_BLK_PER_SMALL_FILE;
+    uint32_t live_pages = 0;
+    int ret = F2FSJ_OK;
+
+    *nr_blks = 0;
+    if (!g_zbuf)
+    {
+        return F2FSJ_ERROR;
+    }
+
+    live_pages = (end_page + JOURNAL_BLK_PER_SMALL_FILE - live_page) % JOURNAL_BLK_PER_SMALL_FILE;
+    if (!live_pages)
+    {
+        live_pages = JOURNAL_BLK_PER_SMALL_FILE;
+    }
+
+    /** append while room for a new generation of the live pages is left on either side of the
+     *  current one, a generation which grew over all the journal file could not be replaced
+     */
+    if (!READ_ONCE(g_zrestart)
+     && (g_zdisk_blk + nr_pages + live_pages <= JOURNAL_BLK_PER_SMALL_FILE || live_pages <= g_zstart_blk))
+    {
+        ret = j_write_zframes(sbi, pages, first_page, nr_pages, JOURNAL_BLK_PER_SMALL_FILE, &op_flags, nr_blks);
+        if (ret != -ENOSPC)
+        {
+            return ret;
+        }
+    }
+
+    return j_write_zgeneration(sbi, pages, live_page, live_pages, &op_flags, nr_blks);
+}
+
+static bool j_is_valid_zframe_head(j_zframe_head_t *head, uint32_t generation)
+{
+    return head->magic == J_ZFRAME_MAGIC
+        && head->head_crc == j_zframe_head_crc(head)
+        && head->generation == generation
+        && head->nr_pages && head->nr_pages <= J_ZFRAME_MAX_PAGES
+        && head->first_page + head->nr_pages <= JOURNAL_BLK_PER_SMALL_FILE
+        && head->z_len <= LZ4_COMPRESSBOUND(J_ZFRAME_MAX_PAGES * PAGE_SIZE);
+}
+
+int j_read_journal_zframes(struct f2fs_sb_info *sbi, struct page **pages, uint32_t start_blk)
+{
+    j_zframe_head_t *head = NULL;
+    uint32_t blk = start_blk < JOURNAL_BLK_PER_SMALL_FILE ? start_blk : 0;
+    uint32_t nr_blks = 0;
+    uint32_t nr_frames = 0;
+    uint32_t generation = 0;
+    uint8_t *dst = NULL;
+    int len = 0;
+
+    if (j_init_journal_compress() != F2FSJ_OK)
+    {
+        return F2FSJ_ERROR;
+    }
+
+    head = (j_zframe_head_t *)g_zbuf;
+    while (blk < JOURNAL_BLK_PER_SMALL_FILE)
+    {
+        if (j_zframe_io(sbi, blk, 0, 1, REQ_OP_READ, REQ_SYNC) != F2FSJ_OK)
+        {
+            break;
+        }
+
+        // the first frame tells which generation is the newest
+        if (!nr_frames)
+        {
+            generation = head->generation;
+        }
+
+        if (!j_is_valid_zframe_head(head, generation))
+        {
+            break;
+        }
+
+        nr_blks = DIV_ROUND_UP(J_ZFRAME_HEAD_SIZE + head->z_len, PAGE_SIZE);
+        if (blk + nr_blks > JOURNAL_BLK_PER_SMALL_FILE
+         || (nr_blks > 1 && j_zframe_io(sbi, blk + 1, 1, nr_blks - 1, REQ_OP_READ, REQ_SYNC) != F2FSJ_OK))
+        {
+            break;
+        }
+
+        // torn frame, commit of it did not finish
+        if (crc32_le(~0, g_zbuf + J_ZFRAME_HEAD_SIZE, head->z_len) != head->data_crc)
+        {
+            break;
+        }
+
+        dst = j_vmap(&pages[head->first_page], head->nr_pages);
+        if (!dst)
+        {
+            break;
+        }
+
+        if (head->flags & J_ZFRAME_RAW)
+        {
+            len = head->z_len;
+            memcpy(dst, g_zbuf + J_ZFRAME_HEAD_SIZE, len);
+        }
+        else
+        {
+            len = LZ4_decompress_safe(g_zbuf + J_ZFRAME_HEAD_SIZE, dst, head->z_len, head->nr_pages * PAGE_SIZE);
+        }
+        vm_unmap_ram(dst, head->nr_pages);
+
+        if (len != head->nr_pages * PAGE_SIZE)
+        {
+            STATUS_LOG(STATUS_ERROR, "decompress journal frame at blk %u fail, len %d\n", blk, len);
+            break;
+        }
+
+        // later frames rewrite the last page of earlier ones
+        nr_frames ++;
+        blk += nr_blks;
+    }
+
+    g_zstart_blk = start_blk < JOURNAL_BLK_PER_SMALL_FILE ? start_blk : 0;
+    g_zdisk_blk = blk;
+    g_zgeneration = generation ? generation : 1;
+    INFO_REPORT("read %u journal frames, blocks %u-%u\n", nr_frames, g_zstart_blk, blk);
+
+    return F2FSJ_OK;
+}
+
+#else
+
+bool j_journal_compress_supported(void)
+{
+    return false;
+}
+
+int j_init_journal_compress(void)
+{
+    return F2FSJ_ERROR;
+}
+
+void j_destroy_journal_compress(void)
+{
+}
+
+void j_reset_journal_zframes(void)
+{
+}
+
+void j_restart_journal_zframes(void)
+{
+}
+
+int j_write_journal_zframes(struct f2fs_sb_info *sbi, struct page **pages, uint32_t first_page,
+                                    uint32_t nr_pages, uint32_t live_page, int op_flags, uint32_t *nr_blks)
+{
+    return F2FSJ_ERROR;
+}
+
+int j_read_journal_zframes(struct f2fs_sb_info *sbi, struct page **pages, uint32_t start_blk)
+{
+    STATUS_LOG(STATUS_ERROR, "journal is compressed but LZ4 is not supported\n");
+    return F2FSJ_ERROR;
+}
+
+#endif
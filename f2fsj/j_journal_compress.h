@@ -0,0 +1,95 @@
+/**
+ * @file j_journal_compress.h
+ * @author leslie.cui (10033908@github.com)
+ * @brief LZ4 compressed journal. Journal pages written by one commit are compressed into frames,
+ *        frames are appended to the journal file and decompressed back into the memory mapped
+ *        journal file before replay, so logs keep their layout in memory
+ *
+ *        Frame layout: j_zframe_head_t, then z_len bytes of LZ4 (or raw) journal pages, padded to
+ *        journal blocks
+ *
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef _J_JOURNAL_COMPRESS_H_
+#define _J_JOURNAL_COMPRESS_H_
+
+#include "f2fs.h"
+#include "j_journal_file.h"
+
+#define J_DEF_COMPRESS_JOURNAL  (0)     ///< journal format is chosen when journal file is cleared after mount
+
+#define J_ZFRAME_MAGIC          (0x5A4A4632)    ///< "2FJZ"
+#define J_ZFRAME_MAX_PAGES      (64)            ///< journal pages compressed into one frame
+#define J_ZFRAME_RAW            (0x1)           ///< pages do not compress, stored as they are
+
+typedef struct __j_zframe_head
+{
+    uint32_t magic;
+    uint32_t generation;    ///< increased by each new generation of frames, stale frames end replay
+    uint32_t first_page;    ///< journal page of the memory mapped journal file
+    uint32_t nr_pages;
+    uint32_t z_len;         ///< bytes following this head
+    uint32_t flags;         ///< J_ZFRAME_RAW
+    uint32_t data_crc;      ///< crc32 of the z_len bytes
+    uint32_t head_crc;      ///< crc32 of this head with head_crc 0
+}j_zframe_head_t;
+
+/**
+ * @brief Whether this kernel can compress the journal (CONFIG_F2FS_FS_LZ4)
+ *
+ * @return bool
+ */
+bool j_journal_compress_supported(void);
+
+/**
+ * @brief Allocate compression buffers, it is fine to call it again
+ *
+ * @return int
+ */
+int j_init_journal_compress(void);
+
+void j_destroy_journal_compress(void);
+
+/**
+ * @brief Frames are appended from the beginning of the journal file again, after it is cleared
+ */
+void j_reset_journal_zframes(void);
+
+/**
+ * @brief Logs before the journal tail are applied by checkpoint, next commit starts a new
+ *        generation of frames
+ */
+void j_restart_journal_zframes(void);
+
+/**
+ * @brief Compress nr_pages journal pages from first_page into frames and write them synchronously.
+ *        When frames restart or do not fit at the end of journal file, pages from live_page up to
+ *        the end of the range are written as a new generation instead. It goes after the frames of
+ *        the current generation or before them, never over them, and journal superblock points to
+ *        it once it is durable
+ *
+ * @param pages, pages of the memory mapped journal file
+ * @param first_page, nr_pages, pages to write, they may wrap around the end of journal file
+ * @param live_page, journal page of the oldest live log
+ * @param op_flags, REQ_PREFLUSH is only set on the first frame and REQ_FUA on the last one
+ * @param[out] nr_blks, journal blocks taken by the frames
+ * @return int
+ */
+int j_write_journal_zframes(struct f2fs_sb_info *sbi, struct page **pages, uint32_t first_page,
+                                    uint32_t nr_pages, uint32_t live_page, int op_flags, uint32_t *nr_blks);
+
+/**
+ * @brief Read frames from start_blk and decompress them into pages in order, stop at the first
+ *        invalid or stale frame
+ *
+ * @param pages, pages of the memory mapped journal file
+ * @param start_blk, first frame of the newest durable generation, from journal superblock
+ * @return int
+ */
+int j_read_journal_zframes(struct f2fs_sb_info *sbi, struct page **pages, uint32_t start_blk);
+
+#endif // !_J_JOURNAL_COMPRESS_H_
@@ -10,14 +10,65 @@
 #include "j_journal_file.h"
 #include "node.h"
 #include "segment.h"
+#include "iostat.h"
 #include "j_recovery.h"
+#include "j_journal_compress.h"
+#include "j_stats.h"
+#include "j_op_lat.h"
+#include "j_trace.h"
 #include <linux/stat.h>
+#include <linux/crc32.h>
 
 // alloc memory for log_entry_info, the memory for log contents is allocated from mmaped journal file
 static struct kmem_cache* j_log_entry_info_slab = NULL;
 static j_file_mapping_t j_file_mmap[4] = {0};
 static j_jsb_info_t g_jsb = {0};
 static j_on_disk_file_into_t g_on_disk_j_file = {0};
+static uint64_t g_total_alloc_log_entries = 0; ///< protected by j_file_memap_lock
+
+///< log compaction, protected by j_file_memap_lock
+static uint32_t g_tail_log_entry    = 0;  ///< replay starts from this log
+static uint32_t g_written_log_entry = 0;  ///< logs before it are written by the last epoch commit
+static uint32_t g_stable_log_entry  = 0;  ///< logs before it are written by the commit before the last one
+static uint32_t g_live_log_entry    = 0;  ///< oldest log replay may need, the head never enters its page
+
+///< time spent in replay handlers at recovery, for calibration of the replay cost of one log
+typedef struct __j_replay_cost
+{
+    uint64_t replay_ns;
+    uint64_t nr_logs;
+}j_replay_cost_t;
+
+/**
+ * @brief Persist the journal tail, format flags and first block of compressed frames in journal
+ *        superblock, journal blocks written before are flushed ahead of it
+ */
+static int j_write_journal_sb(struct super_block *sb, uint32_t tail_log_entry, uint32_t flags,
+                                        uint32_t zframe_start_blk)
+{
+    j_jsb_info_t *j_sb_blk_ptr = NULL;
+    struct buffer_head *bh = NULL;
+    int err = 0;
+
+    bh = sb_bread(sb, F2FSJ_SB_BLOCK1_ADDR);
+    if (!bh)
+    {
+        STATUS_LOG(STATUS_ERROR, "sb_bread journal file superblock failed\n");
+        return F2FSJ_ERROR;
+    }
+
+    j_sb_blk_ptr = (j_jsb_info_t *)bh->b_data;
+    j_sb_blk_ptr->j_tail_log_entry = tail_log_entry;
+    j_sb_blk_ptr->j_flags = flags;
+    j_sb_blk_ptr->j_zframe_start_blk = zframe_start_blk;
+    mark_buffer_dirty(bh);
+    err = __sync_dirty_buffer(bh, REQ_SYNC | REQ_PREFLUSH | REQ_FUA);
+    brelse(bh);
+    f2fs_update_iostat(F2FS_SB(sb), FS_JOURNAL_IO, JOURNAL_BLOCK_SIZE);
+    f2fsj_account_write(F2FS_SB(sb), J_WA_JOURNAL, JOURNAL_BLOCK_SIZE);
+
+    return err ? F2FSJ_ERROR : F2FSJ_OK;
+}
 
 int init_journal_file_info(struct super_block *sb)
 {
@@ -37,6 +88,9 @@ int init_journal_file_info(struct super_block *sb)
         g_jsb.j_magic_num    = j_sb_blk_ptr->j_magic_num;
         g_jsb.j_start_addr   = j_sb_blk_ptr->j_start_addr;
         g_jsb.j_file_size    = j_sb_blk_ptr->j_file_size;
+        g_jsb.j_tail_log_entry = j_sb_blk_ptr->j_tail_log_entry;
+        g_jsb.j_flags          = j_sb_blk_ptr->j_flags;
+        g_jsb.j_zframe_start_blk = j_sb_blk_ptr->j_zframe_start_blk;
     }
 
     if (g_jsb.j_magic_num != JOURNAL_FILE_MAGIC_NUMBER)
@@ -48,6 +102,12 @@ int init_journal_file_info(struct super_block *sb)
         j_sb_blk_ptr->j_file_size    = JOURNAL_FILE_SIZE;
         j_sb_blk_ptr->j_current_small_file = F2FSJ_J_FILE_0;
         j_sb_blk_ptr->j_current_free_log_entry = JOURNAL_BLK_PER_SMALL_FILE;
+        j_sb_blk_ptr->j_tail_log_entry = 0;
+        j_sb_blk_ptr->j_flags = 0;
+        j_sb_blk_ptr->j_zframe_start_blk = 0;
+        g_jsb.j_tail_log_entry = 0;
+        g_jsb.j_flags = 0;
+        g_jsb.j_zframe_start_blk = 0;
         mark_buffer_dirty(bh);
         sync_dirty_buffer(bh);
         INFO_REPORT("Init journal file superblock end");
@@ -76,9 +136,16 @@ int init_journal_file_info(struct super_block *sb)
 
     // read logs from journal file
     INFO_REPORT("begin to read journal file\n");
+    g_tail_log_entry = g_jsb.j_tail_log_entry < J_LOG_ENTRY_PER_FILE ? g_jsb.j_tail_log_entry : 0;
     recover_read_journal(sb);
     INFO_REPORT("read journal file end\n");
 
+    // logs are allocated from the beginning again, on-disk tail is reset when journal file is cleared
+    g_tail_log_entry    = 0;
+    g_written_log_entry = 0;
+    g_stable_log_entry  = 0;
+    g_live_log_entry    = 0;
+
     // init in-memory journal file info
     g_jsb.j_current_small_file     = F2FSJ_J_FILE_0;
     g_jsb.j_current_free_log_entry = JOURNAL_BLK_PER_SMALL_FILE;
@@ -125,12 +192,88 @@ int mmap_journal_file()
 
 }
 
+/**
+ * @brief Journal pages from the one of the oldest live log to the one of head_log_entry,
+ *        caller holds j_file_memap_lock
+ */
+static uint32_t j_live_journal_pages(uint32_t head_log_entry)
+{
+    return (J_LOG_ENTRY_TO_BLK(head_log_entry) + JOURNAL_BLK_PER_SMALL_FILE
+          - J_LOG_ENTRY_TO_BLK(g_live_log_entry)) % JOURNAL_BLK_PER_SMALL_FILE + 1;
+}
+
+/**
+ * @brief Move the journal head over a log of nr_entries. A log which does not fit before
+ *        J_LOG_WRAP_ENTRY goes to the start of the journal file behind a WRAP_LOG. Pages entered
+ *        by the head are zeroed, so that replay stops at the head instead of reading logs left
+ *        there by the last round, and none of them may be the page of the oldest live log.
+ *        Caller holds j_file_memap_lock
+ *
+ * @param may_wrap, false if the log must follow the head in the journal file
+ * @return uint32_t, first entry of the log, J_LOG_ENTRY_PER_FILE if there is no room for it
+ */
+static uint32_t j_advance_log_head(j_file_mapping_t *j_f_mapping, uint32_t nr_entries, bool may_wrap)
+{
+    uint32_t head = j_f_mapping->j_cur_log_entry_idx;
+    uint32_t log_entry_idx = head;
+    uint32_t page = J_LOG_ENTRY_TO_BLK(head);
+    uint32_t new_pages = 0;
+    uint32_t free_pages = 0;
+    j_log_head_t *wrap_log = NULL;
+
+    if (log_entry_idx + nr_entries > J_LOG_WRAP_ENTRY)
+    {
+        if (!may_wrap)
+        {
+            return J_LOG_ENTRY_PER_FILE;
+        }
+        log_entry_idx = 0;
+    }
+
+    // pages after the head page up to the one of the new head, around the end of journal file
+    new_pages  = (J_LOG_ENTRY_TO_BLK(log_entry_idx + nr_entries) + JOURNAL_BLK_PER_SMALL_FILE - page)
+               % JOURNAL_BLK_PER_SMALL_FILE;
+    free_pages = JOURNAL_BLK_PER_SMALL_FILE - j_live_journal_pages(head);
+    if (new_pages > free_pages)
+    {
+        return J_LOG_ENTRY_PER_FILE;
+    }
+
+    while (new_pages--)
+    {
+        page = (page + 1) % JOURNAL_BLK_PER_SMALL_FILE;
+        memset(j_f_mapping->j_pages_buf[page], 0, JOURNAL_BLOCK_SIZE);
+    }
+
+    if (log_entry_idx != head)
+    {
+        wrap_log = (j_log_head_t *)(J_LOG_ENTRY_ADDR(j_f_mapping, head));
+        wrap_log->log_type = WRAP_LOG;
+        wrap_log->log_size = J_LOG_ENTRY_SIZE;
+    }
+
+    j_f_mapping->j_cur_log_entry_idx = log_entry_idx + nr_entries;
+    return log_entry_idx;
+}
+
 int j_alloc_log_entry(log_type_e log_type, j_log_entry_t **log_entry)
+{
+    return j_alloc_log_entries(log_type, 1, log_entry);
+}
+
+int j_alloc_log_entries(log_type_e log_type, uint32_t nr_entries, j_log_entry_t **log_entry)
 {
     j_file_mapping_t *j_f_mapping = NULL;
     uint32_t log_entry_idx = 0;
+    uint64_t start_ns = j_op_lat_now();
 
     *log_entry = NULL;
+    if (nr_entries == 0 || nr_entries > J_LOG_ENTRY_PER_BLOCK + 1)
+    {
+        STATUS_LOG(STATUS_ERROR, "invalid number of log entries %u\n", nr_entries);
+        return F2FSJ_ERROR;
+    }
+
     *log_entry = kmem_cache_alloc(j_log_entry_info_slab, GFP_NOIO);
     if (*log_entry == NULL)
     {
@@ -140,49 +283,72 @@ int j_alloc_log_entry(log_type_e log_type, j_log_entry_t **log_entry)
 
     //INFO_REPORT("allocate log entry addr is %p\n", *log_entry );
 
-    spin_lock(&g_jsb.j_file_memap_lock);
+    j_stat_spin_lock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
 
-    if (j_file_mmap[g_jsb.j_current_small_file].j_file_state == J_FILE_IDLE)
+    j_f_mapping = &j_file_mmap[g_jsb.j_current_small_file];
+    if (j_f_mapping->j_file_state == J_FILE_IDLE)
     {
         INFO_REPORT("IDLE j_file[%d] is in-used\n", g_jsb.j_current_small_file);
-        j_file_mmap[g_jsb.j_current_small_file].j_file_state = J_FILE_INUSE;
+        j_f_mapping->j_file_state = J_FILE_INUSE;
     }
-    else if (j_file_mmap[g_jsb.j_current_small_file].j_file_state == J_WHOLE_FILE_WAIT_COMMIT)
+    else if (j_f_mapping->j_file_state == J_WHOLE_FILE_WAIT_COMMIT)
     {
+        j_stat_spin_unlock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+        atomic64_inc(&g_j_stats.nr_alloc_fail);
         INFO_REPORT("current j_file is whole wait for commit, cannot alloc log entry\n");
-        return -1;
+        kmem_cache_free(j_log_entry_info_slab, *log_entry);
+        *log_entry = NULL;
+        return F2FSJ_ERROR;
     }
 
-    j_f_mapping = &j_file_mmap[g_jsb.j_current_small_file];
-    log_entry_idx  = j_file_mmap[g_jsb.j_current_small_file].j_cur_log_entry_idx;
+    // entries of one log must be continuous, do not split it at the end of journal file
+    log_entry_idx = j_advance_log_head(j_f_mapping, nr_entries, true);
+    if (log_entry_idx == J_LOG_ENTRY_PER_FILE)
+    {
+        // journal checkpoint has to free the oldest logs first
+        j_stat_spin_unlock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+        atomic64_inc(&g_j_stats.nr_alloc_fail);
+        INFO_REPORT("No free entry on J_file[%d], need journal checkpoint\n", g_jsb.j_current_small_file);
+        kmem_cache_free(j_log_entry_info_slab, *log_entry);
+        *log_entry = NULL;
+        return F2FSJ_ERROR;
+    }
 
     //*log_entry = J_LOG_ENTRY_ADDR(j_f_mapping, log_entry_idx);
-    (*log_entry)->log_entry_idx  = j_file_mmap[g_jsb.j_current_small_file].j_cur_log_entry_idx;
+    (*log_entry)->log_entry_idx  = log_entry_idx;
     //INIT_LIST_HEAD(&((*log_entry)->log_node));
     (*log_entry)->log_entry_addr = J_LOG_ENTRY_ADDR(j_f_mapping, log_entry_idx);
+    (*log_entry)->log_type       = log_type;
 
+    g_total_alloc_log_entries += nr_entries;
+    j_f_mapping->j_file_state = J_PARTIAL_FILE_WAIT_COMMIT;
 
-    j_file_mmap[g_jsb.j_current_small_file].j_cur_log_entry_idx++;
-    if (j_file_mmap[g_jsb.j_current_small_file].j_cur_log_entry_idx == J_LOG_ENTRY_PER_FILE)
-    {
-        INFO_REPORT("No free entry on J_file[%d], need GC journal file\n", g_jsb.j_current_small_file);
-        // current journal file change to WAIT_COMMIT
-        j_file_mmap[g_jsb.j_current_small_file].j_file_state = J_WHOLE_FILE_WAIT_COMMIT;
+    j_stat_spin_unlock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
 
-        // Wait journal apply, invoke journal ckpt here; TODO
+    j_stat_log(log_type, nr_entries * J_LOG_ENTRY_SIZE);
+    trace_f2fsj_alloc_log(log_type, log_entry_idx, nr_entries);
+    j_op_lat_log_phase(log_type, J_OP_PHASE_ALLOC, start_ns);
+    return F2FSJ_OK;
+}
 
-        // Then, journal file can reuse
-        j_file_mmap[g_jsb.j_current_small_file].j_cur_log_entry_idx = 0;
-        j_file_mmap[g_jsb.j_current_small_file].j_file_state = J_FILE_INUSE;
-        j_file_mmap[g_jsb.j_current_small_file].j_cur_file_first_inused_blk = j_file_mmap[g_jsb.j_current_small_file].j_cur_file_start_blk;
-        INFO_REPORT("reuse j_file[%d], start in-used\n", g_jsb.j_current_small_file);
-    }
-    else
+int j_copy_to_log_entries(j_log_entry_t *log_entry, uint32_t entry_ofs, const uint8_t *src, uint32_t len)
+{
+    j_file_mapping_t *j_f_mapping = &j_file_mmap[g_jsb.j_current_small_file];
+    uint32_t log_entry_idx = log_entry->log_entry_idx + entry_ofs;
+    uint32_t copy_len = 0;
+
+    // continuous entries in one journal page are continuous in memory, copy page by page
+    while (len)
     {
-        j_file_mmap[g_jsb.j_current_small_file].j_file_state = J_PARTIAL_FILE_WAIT_COMMIT;
+        copy_len = min_t(uint32_t, len,
+                (J_LOG_ENTRY_PER_BLOCK - J_LOG_ENTRY_TO_BLK_OFFSET(log_entry_idx)) * J_LOG_ENTRY_SIZE);
+        memcpy(J_LOG_ENTRY_ADDR(j_f_mapping, log_entry_idx), src, copy_len);
+
+        src += copy_len;
+        len -= copy_len;
+        log_entry_idx += DIV_ROUND_UP(copy_len, J_LOG_ENTRY_SIZE);
     }
 
-    spin_unlock(&g_jsb.j_file_memap_lock);
     return F2FSJ_OK;
 }
 
@@ -230,6 +396,17 @@ j_jsb_info_t* get_current_jouranl_sb()
     return &g_jsb;
 }
 
+uint64_t get_total_alloc_log_entries()
+{
+    uint64_t nr_logs = 0;
+
+    j_stat_spin_lock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+    nr_logs = g_total_alloc_log_entries;
+    j_stat_spin_unlock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+
+    return nr_logs;
+}
+
 int get_on_disk_free_journal_space()
 {
     if (g_on_disk_j_file.total_file_size >= g_on_disk_j_file.used_file_size)
@@ -243,10 +420,66 @@ int get_on_disk_free_journal_space()
     }
 }
 
-int reset_on_disk_journal_space_info()
+uint32_t j_get_stable_log_entry(void)
 {
-    g_on_disk_j_file.used_file_size = 0;
-    INFO_REPORT("journal checkpoint reset on-disk journal file size\n");
+    uint32_t stable_log_entry = 0;
+
+    j_stat_spin_lock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+    stable_log_entry = g_stable_log_entry;
+    j_stat_spin_unlock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+
+    return stable_log_entry;
+}
+
+int j_reset_journal_tail(struct f2fs_sb_info *sbi, uint32_t tail_log_entry)
+{
+    j_log_head_t *log_header = NULL;
+    uint32_t cur_log_entry_idx = 0;
+
+    // copies of a compaction at the new tail are as old as the logs they replace
+    log_header = (j_log_head_t *)(J_LOG_ENTRY_ADDR(&j_file_mmap[0], tail_log_entry));
+    if (log_header->log_type == COMPACT_LOG)
+    {
+        tail_log_entry += 1 + ((compact_log_t *)log_header)->nr_entries;
+    }
+
+    if (j_write_journal_sb(sbi->sb, tail_log_entry, g_jsb.j_flags, g_jsb.j_zframe_start_blk) != F2FSJ_OK)
+    {
+        return F2FSJ_ERROR;
+    }
+
+    j_stat_spin_lock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+    g_tail_log_entry  = tail_log_entry;
+    g_live_log_entry  = tail_log_entry;
+    cur_log_entry_idx = j_file_mmap[0].j_cur_log_entry_idx;
+    g_on_disk_j_file.used_file_size = j_live_journal_pages(cur_log_entry_idx) * PAGE_SIZE;
+    j_stat_spin_unlock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+
+    if (g_jsb.j_flags & J_JSB_COMPRESSED)
+    {
+        j_restart_journal_zframes();
+    }
+    INFO_REPORT("journal checkpoint moves journal tail to %u\n", tail_log_entry);
+
+    return F2FSJ_OK;
+}
+
+int j_write_journal_zframe_start(struct f2fs_sb_info *sbi, uint32_t start_blk)
+{
+    uint32_t tail_log_entry = 0;
+
+    // commit and tail moves are serialized, the in-memory tail is the one in journal superblock
+    j_stat_spin_lock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+    tail_log_entry = g_tail_log_entry;
+    j_stat_spin_unlock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+
+    if (j_write_journal_sb(sbi->sb, tail_log_entry, g_jsb.j_flags, start_blk) != F2FSJ_OK)
+    {
+        return F2FSJ_ERROR;
+    }
+    g_jsb.j_zframe_start_blk = start_blk;
+
+    return F2FSJ_OK;
 }
 
 // This function need to be re-construct TODO!!!
@@ -397,65 +630,276 @@ int add_journal_page_2_bio(struct page *p_log, struct bio *b)
     return F2FSJ_OK;
 }
 
-int write_current_mmap_j_file(struct f2fs_sb_info *sbi)
+/**
+ * @brief Synchronously write nr_pages journal pages of j_file_idx, starting from page_idx
+ *
+ * @param op_flags, REQ_PREFLUSH is only set on the first bio and REQ_FUA on the last one
+ * @return int
+ */
+static int j_write_journal_pages(struct f2fs_sb_info *sbi, int j_file_idx, uint32_t page_idx,
+                                        uint32_t nr_pages, int op_flags)
 {
     struct bio *b = NULL;
+    uint32_t nr_bio_pages = 0;
+    uint32_t j = 0;
+    int flags = 0;
+    int ret = F2FSJ_OK;
+
+    while (nr_pages)
+    {
+        //each bio can contain 256 pages
+        nr_bio_pages = min_t(uint32_t, nr_pages, 256);
+
+        if (j_alloc_bio_write(sbi, &b, j_file_mmap[j_file_idx].j_cur_file_start_blk + page_idx, nr_bio_pages))
+        {
+            return F2FSJ_ERROR;
+        }
+
+        flags = REQ_SYNC;
+        if (op_flags & REQ_PREFLUSH)
+        {
+            flags |= REQ_PREFLUSH;
+            op_flags &= ~REQ_PREFLUSH;
+        }
+        if (nr_bio_pages == nr_pages)
+        {
+            flags |= (op_flags & REQ_FUA);
+        }
+        bio_set_op_attrs(b, REQ_OP_WRITE, flags);
+
+        for (j = 0; j < nr_bio_pages; j ++)
+        {
+            add_journal_page_2_bio(j_file_mmap[j_file_idx].j_pages[page_idx + j], b);
+        }
+
+        trace_f2fsj_journal_bio_submit(sbi->sb, j_file_mmap[j_file_idx].j_cur_file_start_blk + page_idx,
+                                        nr_bio_pages, flags, 0);
+        f2fs_update_iostat(sbi, FS_JOURNAL_IO, (uint64_t)nr_bio_pages * JOURNAL_BLOCK_SIZE);
+        f2fsj_account_write(sbi, J_WA_JOURNAL, (uint64_t)nr_bio_pages * JOURNAL_BLOCK_SIZE);
+        if (submit_bio_wait(b))
+        {
+            STATUS_LOG(STATUS_ERROR, "write journal pages [%u, %u) err %d\n",
+                        page_idx, page_idx + nr_bio_pages, b->bi_status);
+            ret = F2FSJ_ERROR;
+        }
+        trace_f2fsj_journal_bio_complete(sbi->sb, j_file_mmap[j_file_idx].j_cur_file_start_blk + page_idx,
+                                        nr_bio_pages, flags, blk_status_to_errno(b->bi_status));
+        bio_put(b);
+
+        if (ret != F2FSJ_OK)
+        {
+            return ret;
+        }
+
+        page_idx += nr_bio_pages;
+        nr_pages -= nr_bio_pages;
+    }
+
+    return F2FSJ_OK;
+}
+
+/**
+ * @brief Write journal pages in the format of the journal file
+ *
+ * @param[out] nr_blks, journal blocks written
+ */
+static int j_write_journal_range(struct f2fs_sb_info *sbi, int j_file_idx, uint32_t start_page,
+                                        uint32_t nr_pages, int op_flags, uint32_t *nr_blks)
+{
+    uint32_t live_page = 0;
+    uint32_t head_pages = 0;
+    int ret = F2FSJ_OK;
+
+    if (g_jsb.j_flags & J_JSB_COMPRESSED)
+    {
+        j_stat_spin_lock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+        live_page = J_LOG_ENTRY_TO_BLK(g_live_log_entry);
+        j_stat_spin_unlock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+
+        return j_write_journal_zframes(sbi, j_file_mmap[j_file_idx].j_pages, start_page, nr_pages,
+                                        live_page, op_flags, nr_blks);
+    }
+
+    *nr_blks = nr_pages;
+    if (start_page + nr_pages <= JOURNAL_BLK_PER_SMALL_FILE)
+    {
+        return j_write_journal_pages(sbi, j_file_idx, start_page, nr_pages, op_flags);
+    }
+
+    // log entry allocation wraps around the journal file
+    head_pages = JOURNAL_BLK_PER_SMALL_FILE - start_page;
+    ret = j_write_journal_pages(sbi, j_file_idx, start_page, head_pages, op_flags & ~REQ_FUA);
+    if (ret == F2FSJ_OK)
+    {
+        ret = j_write_journal_pages(sbi, j_file_idx, 0, nr_pages - head_pages, op_flags & ~REQ_PREFLUSH);
+    }
+    return ret;
+}
+
+static int j_write_mmap_j_file(struct f2fs_sb_info *sbi)
+{
     // find journal file tagged with J_WHOLE_FILE_WAIT_COMMIT
-    int i = 0, j = 0, nr_page = 0;
-    uint32_t start_blk = 0;
-    uint32_t end_blk = 0;
-    uint32_t total_pages = 0;
+    int i = 0;
+    int op_flags = 0;
+    int ret = F2FSJ_OK;
+    uint32_t start_page = 0;
+    uint32_t end_page = 0;
+    uint32_t file_pages = 0;
+    uint32_t nr_blks = 0;
     uint32_t cur_log_entry_idx = 0;
+    uint32_t live_pages = 0;
 
-    spin_lock(&g_jsb.j_file_memap_lock);
+    j_stat_spin_lock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
     cur_log_entry_idx = j_file_mmap[0].j_cur_log_entry_idx;
-    spin_unlock(&g_jsb.j_file_memap_lock);
+    live_pages = j_live_journal_pages(cur_log_entry_idx);
+    j_stat_spin_unlock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+
+    /** Commit record of jbd2 is replaced by the logs themselves, so:
+     *  1) flush device cache, data pages waited by epoch_commit() are durable before the logs
+     *  2) FUA the last journal page, fsync returns once epoch commit returns
+     */
+    if (!test_opt(sbi, NOBARRIER))
+    {
+        op_flags = REQ_PREFLUSH | REQ_FUA;
+    }
 
     for (i = 0; i < NR_JOUNRAL_SMALL_FILE; i++)
     {
-        start_blk = j_file_mmap[i].j_cur_file_first_inused_blk; // first inused blk_lba
-        end_blk = J_LOG_ENTRY_TO_BLK(cur_log_entry_idx) + j_file_mmap[i].j_cur_file_start_blk; // last inused blk_lba
-        total_pages = end_blk - start_blk + 1;
+        if (j_file_mmap[i].j_file_state != J_WHOLE_FILE_WAIT_COMMIT
+         && j_file_mmap[i].j_file_state != J_PARTIAL_FILE_WAIT_COMMIT)
+        {
+            continue;
+        }
+
+        start_page = j_file_mmap[i].j_cur_file_first_inused_blk - j_file_mmap[i].j_cur_file_start_blk; // first inused page
+        end_page   = min_t(uint32_t, J_LOG_ENTRY_TO_BLK(cur_log_entry_idx), JOURNAL_BLK_PER_SMALL_FILE - 1); // last inused page
+
+        INFO_REPORT("Journal file %d is being written to disk, state is %d, start-[%u], end-[%u]\n",
+                     i, j_file_mmap[i].j_file_state, start_page, end_page);
 
-        j_alloc_bio_write(sbi, &b, start_blk, 256);
-        if (j_file_mmap[i].j_file_state == J_WHOLE_FILE_WAIT_COMMIT
-         || j_file_mmap[i].j_file_state == J_PARTIAL_FILE_WAIT_COMMIT)
+        if (end_page >= start_page)
         {
-            INFO_REPORT("Journal file %d is being written to disk, state is %d, pages num is %d, start-[%d], end-[%d]\n",
-                         i, j_file_mmap[i].j_file_state, end_blk - start_blk + 1, start_blk, end_blk);
+            file_pages = end_page - start_page + 1;
+        }
+        else
+        {
+            file_pages = JOURNAL_BLK_PER_SMALL_FILE - start_page + end_page + 1;
+        }
+        ret = j_write_journal_range(sbi, i, start_page, file_pages, op_flags, &nr_blks);
 
-            for (j = 0; j <= end_blk - start_blk; j ++)
-            {
-                // all pages are added into bio
-                if (nr_page == total_pages)
-                {
-                    // write the last pages
-                    //submit_bio_wait(b);
-                    submit_bio(b);
-                    break;
-                }
+        if (ret != F2FSJ_OK)
+        {
+            return ret;
+        }
 
-                //each bio can contain 256 pages
-                if (nr_page % 256 == 0 && nr_page != 0)
-                {
-                    submit_bio(b); // write middle 256 pages and allocate a new bio
-                    j_alloc_bio_write(sbi, &b, start_blk, 256);
-                }
+        // update first in-used journal block, the last page is partially used and is written again next time
+        j_file_mmap[i].j_cur_file_first_inused_blk = j_file_mmap[i].j_cur_file_start_blk + end_page;
 
-                // add page into bio
-                add_journal_page_2_bio(j_file_mmap[i].j_pages[j], b);
-                nr_page ++;
-                start_blk ++;
-            }
+        /** update on-disk j_file info, compressed frames may take fewer blocks than the pages but
+         *  the memory mapped journal file is filled all the same
+         */
+        g_on_disk_j_file.used_file_size = live_pages * PAGE_SIZE;
+    }
 
-            // update first in-used journal block
-            j_file_mmap[i].j_cur_file_first_inused_blk = end_blk;
+    return F2FSJ_OK;
+}
+
+int write_current_mmap_j_file(struct f2fs_sb_info *sbi)
+{
+    uint32_t cur_log_entry_idx = 0;
 
-            //update on-disk j_file info
-            g_on_disk_j_file.used_file_size += (end_blk - start_blk + 1) * (PAGE_SIZE);
+    j_stat_spin_lock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+    cur_log_entry_idx = j_file_mmap[0].j_cur_log_entry_idx;
+    j_stat_spin_unlock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+
+    if (j_write_mmap_j_file(sbi) != F2FSJ_OK)
+    {
+        return F2FSJ_ERROR;
+    }
+
+    /** logs allocated before a commit may belong to the next epoch and be updated in place
+     *  (access time), they are stable only after one more commit
+     */
+    j_stat_spin_lock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+    g_stable_log_entry  = g_written_log_entry;
+    g_written_log_entry = cur_log_entry_idx;
+    j_stat_spin_unlock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+
+    return F2FSJ_OK;
+}
+
+int j_flush_journal_logs(struct f2fs_sb_info *sbi)
+{
+    // not a commit, the stable log entry stays
+    return j_write_mmap_j_file(sbi);
+}
+
+int j_get_compact_range(uint32_t *tail_log_entry, uint32_t *stable_log_entry)
+{
+    j_stat_spin_lock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+    *tail_log_entry   = g_tail_log_entry;
+    *stable_log_entry = g_stable_log_entry;
+    j_stat_spin_unlock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+
+    return *tail_log_entry <= *stable_log_entry ? F2FSJ_OK : F2FSJ_ERROR;
+}
+
+int j_alloc_compact_entries(uint32_t nr_entries, j_log_entry_t *log_entry)
+{
+    j_file_mapping_t *j_f_mapping = NULL;
+    int ret = F2FSJ_OK;
+
+    j_stat_spin_lock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+
+    j_f_mapping = &j_file_mmap[g_jsb.j_current_small_file];
+    if (j_f_mapping->j_file_state == J_WHOLE_FILE_WAIT_COMMIT
+     || j_f_mapping->j_cur_log_entry_idx < g_stable_log_entry)
+    {
+        ret = F2FSJ_ERROR;
+    }
+    else
+    {
+        // copies are not new logs, fill rate of the journal does not count them
+        log_entry->log_entry_idx = j_advance_log_head(j_f_mapping, nr_entries, false);
+        if (log_entry->log_entry_idx == J_LOG_ENTRY_PER_FILE)
+        {
+            ret = F2FSJ_ERROR;
+        }
+        else
+        {
+            log_entry->log_entry_addr = J_LOG_ENTRY_ADDR(j_f_mapping, log_entry->log_entry_idx);
+            j_f_mapping->j_file_state = J_PARTIAL_FILE_WAIT_COMMIT;
         }
     }
 
+    j_stat_spin_unlock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+    return ret;
+}
+
+int j_commit_compacted_journal(struct f2fs_sb_info *sbi, uint32_t compact_log_entry, uint32_t resume_log_entry)
+{
+    uint32_t cur_log_entry_idx = 0;
+
+    // copies are durable before the tail skips their originals
+    if (j_write_mmap_j_file(sbi) != F2FSJ_OK)
+    {
+        return F2FSJ_ERROR;
+    }
+
+    if (j_write_journal_sb(sbi->sb, compact_log_entry, g_jsb.j_flags, g_jsb.j_zframe_start_blk) != F2FSJ_OK)
+    {
+        return F2FSJ_ERROR;
+    }
+
+    // replay needs nothing before resume_log_entry any more, the head may go on up to its page
+    j_stat_spin_lock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+    g_tail_log_entry  = compact_log_entry;
+    g_live_log_entry  = resume_log_entry;
+    cur_log_entry_idx = j_file_mmap[0].j_cur_log_entry_idx;
+    g_on_disk_j_file.used_file_size = j_live_journal_pages(cur_log_entry_idx) * PAGE_SIZE;
+    j_stat_spin_unlock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+
+    return F2FSJ_OK;
 }
 
 char zero_page[4096] = {0};
@@ -469,6 +913,7 @@ int clear_journal_file_after_recovery(struct super_block *sb)
     int i = 0, j = 0, nr_page = 0;
     uint32_t start_blk = 0;
     uint32_t end_blk = 0;
+    uint32_t flags = 0;
 
     for (i = 0; i < NR_JOUNRAL_SMALL_FILE; i++)
     {
@@ -481,6 +926,9 @@ int clear_journal_file_after_recovery(struct super_block *sb)
         {
             if (nr_page % 256 == 0 && nr_page != 0)
             {
+                // every bio holds 256 zeroed pages
+                f2fs_update_iostat(F2FS_SB(sb), FS_JOURNAL_IO, 256 * JOURNAL_BLOCK_SIZE);
+                f2fsj_account_write(F2FS_SB(sb), J_WA_JOURNAL_ZERO, 256 * JOURNAL_BLOCK_SIZE);
                 if (nr_page != JOURNAL_BLK_PER_SMALL_FILE)
                 {
                     submit_bio(b);
@@ -507,6 +955,28 @@ int clear_journal_file_after_recovery(struct super_block *sb)
         }
         INFO_REPORT("Clear %d-th j-file with %d pages\n", i, j);
     }
+
+    // format of the cleared journal, it is kept until the journal is cleared by next mount
+    flags = g_jsb.j_flags & ~J_JSB_COMPRESSED;
+    if (F2FS_SB(sb)->j_compress_journal && j_journal_compress_supported()
+     && j_init_journal_compress() == F2FSJ_OK)
+    {
+        flags |= J_JSB_COMPRESSED;
+        j_reset_journal_zframes();
+    }
+    else
+    {
+        j_destroy_journal_compress();
+    }
+
+    // replay of the cleared journal starts from the beginning
+    if (g_jsb.j_tail_log_entry || g_jsb.j_zframe_start_blk || flags != g_jsb.j_flags)
+    {
+        j_write_journal_sb(sb, 0, flags, 0);
+        g_jsb.j_tail_log_entry = 0;
+        g_jsb.j_flags = flags;
+        g_jsb.j_zframe_start_blk = 0;
+    }
 }
 
 int recover_read_journal(struct super_block *sb)
@@ -519,6 +989,19 @@ int recover_read_journal(struct super_block *sb)
     uint32_t end_blk = 0;
     uint32_t start_page_idx = 0;
     int ret = F2FSJ_OK;
+    uint64_t start_ns = get_current_time_ns();
+
+    // frames are decompressed into the memory mapped journal file, replay reads logs from it as usual
+    if (g_jsb.j_flags & J_JSB_COMPRESSED)
+    {
+        if (j_read_journal_zframes(F2FS_SB(sb), j_file_mmap[0].j_pages, g_jsb.j_zframe_start_blk) != F2FSJ_OK)
+        {
+            STATUS_LOG(STATUS_ERROR, "read compressed journal fail\n");
+            return F2FSJ_ERROR;
+        }
+        g_j_stats.recovery.read_us = div_u64(get_current_time_ns() - start_ns, 1000);
+        return iterate_journal(sb, 0);
+    }
 
     // Only read and do not change mmaped journal file status
     //for (i = 0; i < NR_JOUNRAL_SMALL_FILE; i++)
@@ -535,6 +1018,7 @@ int recover_read_journal(struct super_block *sb)
         {
             if (nr_page % 256 == 0 && nr_page != 0)
             {
+                f2fs_update_iostat(F2FS_SB(sb), FS_JOURNAL_READ_IO, 256 * JOURNAL_BLOCK_SIZE);
                 if (nr_page == total_pages)
                 {
                     submit_bio_wait(b);
@@ -561,6 +1045,7 @@ int recover_read_journal(struct super_block *sb)
         }
         INFO_REPORT("submit bio to read %d journal pages\n", total_pages);
     }
+    g_j_stats.recovery.read_us = div_u64(get_current_time_ns() - start_ns, 1000);
 
     if (b->bi_status)
     {
@@ -577,7 +1062,11 @@ int recover_read_journal(struct super_block *sb)
 int is_invalid_log_type(log_type_e log_type)
 {
     if (log_type == CREATE_LOG || log_type == MKDIR_LOG || log_type == UNLINK_LOG
-    || log_type == RENAME_LOG || log_type == DATA_WRITE_LOG)
+    || log_type == LINK_LOG || log_type == RENAME_LOG || log_type == SYMLINK_LOG || log_type == CHOWN_LOG
+    || log_type == READ_FILE_DATA_LOG || log_type == READ_DIR_LOG || log_type == STAT_LOG
+    || log_type == XATTR_LOG || log_type == TRUNCATE_LOG || log_type == FALLOCATE_LOG || log_type == PUNCH_LOG
+    || log_type == ORPHAN_LOG || log_type == META_DELTA_LOG || log_type == COMPACT_LOG || log_type == WRAP_LOG
+    || log_type == DATA_WRITE_LOG || log_type == DATA_JOURNAL_LOG)
     {
         return 0;
     }
@@ -589,71 +1078,256 @@ int is_invalid_log_type(log_type_e log_type)
 }
 
 
-int iterate_journal(struct super_block *sb, int j_file_idx)
+/**
+ * @brief entries of one log are continuous in journal file but not in memory when the log
+ *        crosses a journal page, gather them into buf
+ */
+static void j_copy_from_log_entries(int j_file_idx, uint32_t log_entry_idx, uint8_t *buf, uint32_t len)
 {
-    int i = 0;
-    int j = 0;
-    uint8_t * p_addr = NULL;
-    uint8_t * log_en = NULL;
+    uint32_t copy_len = 0;
+
+    while (len)
+    {
+        copy_len = min_t(uint32_t, len,
+                (J_LOG_ENTRY_PER_BLOCK - J_LOG_ENTRY_TO_BLK_OFFSET(log_entry_idx)) * J_LOG_ENTRY_SIZE);
+        memcpy(buf, J_LOG_ENTRY_ADDR(&j_file_mmap[j_file_idx], log_entry_idx), copy_len);
+        buf += copy_len;
+        len -= copy_len;
+        log_entry_idx += DIV_ROUND_UP(copy_len, J_LOG_ENTRY_SIZE);
+    }
+}
+
+/**
+ * @brief data of a data journal log follows its header in the next log entries,
+ *        a crash during journal write may leave it torn
+ *
+ * @return 1 if data matches its crc
+ */
+static int is_valid_data_journal_log(data_journal_log_t *dj_log)
+{
+    uint32_t len = dj_log->data_len;
+
+    if (dj_log->nr_data_slots != DIV_ROUND_UP(len, J_LOG_ENTRY_SIZE)
+     || dj_log->data_ofs + len > PAGE_SIZE
+     || (dj_log->nr_data_slots + 1) * J_LOG_ENTRY_SIZE != dj_log->log_header.log_size)
+    {
+        return 0;
+    }
+
+    return crc32_le(~0, (uint8_t *)dj_log + J_LOG_ENTRY_SIZE, len) == dj_log->data_crc;
+}
+
+uint8_t *j_get_journal_log(uint32_t log_entry_idx, uint8_t *buf, uint32_t *nr_entries)
+{
+    uint8_t *log_en = NULL;
     j_log_head_t *log_header = NULL;
 
-    uint64_t time1, time2;
-    time1 = get_current_time_ms();
+    if (log_entry_idx >= J_LOG_ENTRY_PER_FILE)
+    {
+        return NULL;
+    }
+
+    log_en = J_LOG_ENTRY_ADDR(&j_file_mmap[0], log_entry_idx);
+    log_header = (j_log_head_t *)log_en;
+    *nr_entries = log_header->log_size / J_LOG_ENTRY_SIZE;
+    if (log_header->log_size == 0 || log_header->log_size % J_LOG_ENTRY_SIZE
+     || *nr_entries > J_LOG_ENTRY_PER_BLOCK + 1
+     || log_entry_idx + *nr_entries > J_LOG_ENTRY_PER_FILE || is_invalid_log_type(log_header->log_type))
+    {
+        return NULL;
+    }
+
+    if (*nr_entries > 1)
+    {
+        j_copy_from_log_entries(0, log_entry_idx, buf, log_header->log_size);
+        log_en = buf;
+    }
 
-    for (i = 0; i < JOURNAL_BLK_PER_SMALL_FILE; i ++)
+    if (log_header->log_type == DATA_JOURNAL_LOG
+     && !is_valid_data_journal_log((data_journal_log_t *)log_en))
     {
-        p_addr = j_file_mmap[j_file_idx].j_pages_buf[i];
+        INFO_REPORT("read a torn data journal log\n");
+        return NULL;
+    }
+
+    return log_en;
+}
+
+/**
+ * @brief replay logs in [from, to) until an invalid log, copies of log compaction are skipped
+ *        because their originals are replayed. A range up to the end of journal file follows
+ *        a WRAP_LOG to the file start once
+ *
+ * @param cost, time spent in replay handlers and how many logs they replayed
+ * @return uint64_t, how many logs are replayed
+ */
+static uint64_t j_replay_journal_range(struct super_block *sb, uint32_t from, uint32_t to, uint8_t *log_buf,
+                                                        j_replay_cost_t *cost)
+{
+    uint32_t i = from;
+    uint32_t nr_entries = 0;
+    uint8_t *log_en = NULL;
+    j_log_head_t *log_header = NULL;
+    uint64_t nr_replayed = 0;
+    uint64_t start_ns = 0;
 
-        for (j = 0; j < J_LOG_ENTRY_PER_BLOCK; j ++)
+    // one log takes one or more continuous log entries
+    while (i < to)
+    {
+        log_en = j_get_journal_log(i, log_buf, &nr_entries);
+        if (!log_en)
         {
-            log_en = (uint8_t *)p_addr + (J_LOG_ENTRY_SIZE * j);
-            log_header = (j_log_head_t *)log_en;
-            if (log_header->log_size != 128 || is_invalid_log_type(log_header->log_type))
+            INFO_REPORT("read an invalid log, recover end\n");
+            break;
+        }
+
+        log_header = (j_log_head_t *)log_en;
+        if (log_header->log_type == COMPACT_LOG)
+        {
+            i += nr_entries + ((compact_log_t *)log_en)->nr_entries;
+            continue;
+        }
+
+        // logs go on from the start of journal file, which is replayed up to where it started
+        if (log_header->log_type == WRAP_LOG)
+        {
+            if (to != J_LOG_ENTRY_PER_FILE)
             {
-                INFO_REPORT("read an invalid log, recover end\n");
-                goto end;
+                break;
             }
-            INFO_REPORT("read one log, file op is %d\n", log_header->log_type);
-            // do the recovery by log type
-            do_recover_from_journal(sb, log_header->log_type, (uint8_t *) log_en);
+            i  = 0;
+            to = from;
+            continue;
         }
+
+        INFO_REPORT("read one log, file op is %d\n", log_header->log_type);
+        trace_f2fsj_replay_log(sb, i, log_header->log_type, log_header->log_size);
+        // do the recovery by log type, only logs with a replay handler tell the replay cost
+        start_ns = get_current_time_ns();
+        if (do_recover_from_journal(sb, log_header->log_type, log_en))
+        {
+            cost->replay_ns += get_current_time_ns() - start_ns;
+            cost->nr_logs ++;
+        }
+        nr_replayed ++;
+        i += nr_entries;
     }
 
-end:
-    time2 = get_current_time_ms();
-    INFO_REPORT("recover %d files cost %llu ms\n", i, time2 - time1);
+    return nr_replayed;
 }
 
-int ep_commit_writeback_data_pages(struct f2fs_inode_info *f2fs_i)
+int iterate_journal(struct super_block *sb, int j_file_idx)
 {
-    struct inode *inode = NULL;
-    struct address_space *mapping = NULL;
+    uint32_t i = g_tail_log_entry;
+    uint32_t nr_entries = 0;
+    uint8_t * log_en = NULL;
+    uint8_t * log_buf = NULL;
+    compact_log_t *compact_log = NULL;
+    uint32_t copies_end = 0;
+    uint32_t resume_log_entry = 0;
+
+    uint64_t time1, time2;
+    uint64_t nr_replayed = 0;
+    j_replay_cost_t cost = {0};
+    struct f2fs_sb_info *sbi = F2FS_SB(sb);
+    time1 = get_current_time_ns();
+
+    // one log takes at most one journal page plus one entry
+    log_buf = kmalloc((J_LOG_ENTRY_PER_BLOCK + 1) * J_LOG_ENTRY_SIZE, GFP_KERNEL);
+    if (!log_buf)
+    {
+        STATUS_LOG(STATUS_ERROR, "alloc memory for reading journal fail\n");
+        return F2FSJ_ERROR;
+    }
 
-    if (f2fs_i)
+    // orphans and meta deltas left by a mount which did not reach their recovery
+    j_drop_journal_orphans();
+    j_drop_journal_meta_deltas();
+
+    /** tail is left by log compaction: its copies replace the compacted logs and are older than
+     *  the logs written between the compacted range and the copies
+     */
+    log_en = j_get_journal_log(i, log_buf, &nr_entries);
+    if (log_en && ((j_log_head_t *)log_en)->log_type == COMPACT_LOG)
     {
-        inode = &f2fs_i->vfs_inode;
-        if (inode)
+        compact_log = (compact_log_t *)log_en;
+        copies_end = i + 1 + compact_log->nr_entries;
+        resume_log_entry = compact_log->resume_log_entry;
+        INFO_REPORT("journal tail is compacted, %u logs, resume at %u\n", compact_log->nr_logs, resume_log_entry);
+
+        nr_replayed += j_replay_journal_range(sb, i + 1, copies_end, log_buf, &cost);
+        if (resume_log_entry < i)
         {
-            mapping = inode->i_mapping;
-            struct writeback_control wbc =
-            {
-                .sync_mode = WB_SYNC_ALL,
-                .nr_to_write = mapping->nrpages,
-                .range_start = 0,  // TODO, The first page num in log
-                .range_end   = 0,  // TODO, The last page num is log
-                .for_reclaim = 0,
-            };
-    
-            return mapping->a_ops->writepages(mapping, &wbc);
+            nr_replayed += j_replay_journal_range(sb, resume_log_entry, i, log_buf, &cost);
         }
-        else
+        i = copies_end;
+    }
+
+    nr_replayed += j_replay_journal_range(sb, i, J_LOG_ENTRY_PER_FILE, log_buf, &cost);
+
+    kfree(log_buf);
+    time2 = get_current_time_ns();
+    INFO_REPORT("recover %llu logs cost %llu ms\n", nr_replayed, (time2 - time1) / 1000000);
+    g_j_stats.recovery.replay_us = div_u64(time2 - time1, 1000);
+    g_j_stats.recovery.nr_logs = nr_replayed;
+
+    /** calibrate replay cost for checkpoint scheduling, only grow it to stay conservative.
+     *  Logs without a replay handler are only read, their cost says nothing about replay
+     */
+    if (cost.nr_logs >= J_REPLAY_CALIBRATE_MIN_LOGS
+     && div64_u64(cost.replay_ns, cost.nr_logs) > sbi->j_replay_cost_ns)
+    {
+        sbi->j_replay_cost_ns = div64_u64(cost.replay_ns, cost.nr_logs);
+    }
+    return F2FSJ_OK;
+}
+
+int ep_commit_writeback_data_pages(struct f2fs_inode_info *f2fs_i, j_dirty_range_set_t *ranges)
+{
+    struct address_space *mapping = f2fs_i->vfs_inode.i_mapping;
+    uint8_t i = 0;
+    int ret = 0;
+
+    for (i = 0; i < ranges->nr_ranges; i ++)
+    {
+        struct writeback_control wbc =
+        {
+            .sync_mode = WB_SYNC_ALL,
+            .nr_to_write = LONG_MAX,
+            .range_start = (loff_t)ranges->ranges[i].start_idx << PAGE_SHIFT,
+            .range_end   = ((loff_t)ranges->ranges[i].end_idx << PAGE_SHIFT) + PAGE_SIZE - 1,
+            .for_reclaim = 0,
+        };
+
+        ret = mapping->a_ops->writepages(mapping, &wbc);
+        if (ret)
         {
-            STATUS_LOG(STATUS_ERROR, "get vfs inode from f2fs_inode_info happens err\n");
+            STATUS_LOG(STATUS_ERROR, "writeback data of ino-[%lu] fail, err %d\n", f2fs_i->vfs_inode.i_ino, ret);
+            return F2FSJ_ERROR;
         }
     }
 
-    // should never reach here
-    return F2FSJ_ERROR;
+    return F2FSJ_OK;
+}
+
+int ep_commit_wait_data_pages(struct f2fs_inode_info *f2fs_i, j_dirty_range_set_t *ranges)
+{
+    struct address_space *mapping = f2fs_i->vfs_inode.i_mapping;
+    uint8_t i = 0;
+    int ret = 0;
+
+    for (i = 0; i < ranges->nr_ranges; i ++)
+    {
+        ret = filemap_fdatawait_range(mapping, (loff_t)ranges->ranges[i].start_idx << PAGE_SHIFT,
+                            ((loff_t)ranges->ranges[i].end_idx << PAGE_SHIFT) + PAGE_SIZE - 1);
+        if (ret)
+        {
+            STATUS_LOG(STATUS_ERROR, "wait data of ino-[%lu] fail, err %d\n", f2fs_i->vfs_inode.i_ino, ret);
+            return F2FSJ_ERROR;
+        }
+    }
+
+    return F2FSJ_OK;
 }
 
 int j_apply_NODE(struct f2fs_sb_info *sbi, uint32_t nid)
@@ -694,6 +1368,31 @@ int j_apply_NODE(struct f2fs_sb_info *sbi, uint32_t nid)
     return F2FSJ_OK;
 }
 
+int j_apply_DATA(struct f2fs_sb_info *sbi, uint32_t ino_num, uint32_t page_idx)
+{
+    struct inode *inode = NULL;
+    loff_t start = (loff_t)page_idx << PAGE_SHIFT;
+    int ret = 0;
+
+    // not cached, its dirty pages were written before eviction
+    inode = ilookup(sbi->sb, ino_num);
+    if (!inode)
+    {
+        return F2FSJ_OK;
+    }
+
+    // a clean page, e.g., written by an earlier log or by background writeback, costs nothing
+    ret = filemap_write_and_wait_range(inode->i_mapping, start, start + PAGE_SIZE - 1);
+    iput(inode);
+    if (ret)
+    {
+        STATUS_LOG(STATUS_ERROR, "apply journaled data of ino-[%u] page %u fail, err %d\n", ino_num, page_idx, ret);
+        return F2FSJ_ERROR;
+    }
+
+    return F2FSJ_OK;
+}
+
 int j_apply_META(struct f2fs_sb_info *sbi, uint32_t ino_num, uint32_t node_id, uint32_t segno)
 {
     uint32_t ret = F2FSJ_OK;
@@ -772,6 +1471,7 @@ int j_apply_META(struct f2fs_sb_info *sbi, uint32_t ino_num, uint32_t node_id, u
 
 int do_recover_from_journal(struct super_block *sb, log_type_e log_type, uint8_t *log_content)
 {
+    int replayed = 0;
 
     if (log_type == CREATE_LOG || log_type == MKDIR_LOG)
     {
@@ -787,6 +1487,74 @@ int do_recover_from_journal(struct super_block *sb, log_type_e log_type, uint8_t
         INFO_REPORT("unlink log, file name is %s", delete_log->file_name);
         //j_recover_unlink(sb, delete_log);
     }
+    else if (log_type == LINK_LOG)
+    {
+        link_log_t * link_log = (link_log_t *)log_content;
+        INFO_REPORT("link log, ino %u, p_ino %u\n", link_log->ino_num, link_log->parent_ino);
+        //j_recover_link(sb, link_log);
+    }
+    else if (log_type == SYMLINK_LOG)
+    {
+        symlink_log_t * symlink_log = (symlink_log_t *)log_content;
+        INFO_REPORT("symlink log, p_ino is %d\n", symlink_log->j_new_inode.i_pino);
+        //j_recover_symlink(sb, symlink_log);
+    }
+    else if (log_type == RENAME_LOG)
+    {
+        rename_log_t * rename_log = (rename_log_t *)log_content;
+        INFO_REPORT("rename log, ino %u, from p_ino %u to p_ino %u\n",
+                     rename_log->ino_num, rename_log->old_parent_ino, rename_log->new_parent_ino);
+        //j_recover_rename(sb, rename_log);
+    }
+    else if (log_type == READ_FILE_DATA_LOG || log_type == READ_DIR_LOG || log_type == STAT_LOG)
+    {
+        read_stat_log_t * atime_log = (read_stat_log_t *)log_content;
+        INFO_REPORT("access time log, ino %u, atime %llu\n", atime_log->ino_num, atime_log->access_time_s);
+        //j_recover_atime(sb, atime_log);
+    }
+    else if (log_type == TRUNCATE_LOG || log_type == FALLOCATE_LOG || log_type == PUNCH_LOG)
+    {
+        range_log_t * range_log = (range_log_t *)log_content;
+        INFO_REPORT("range log %d, ino %u, size %llu -> %llu\n",
+                     log_type, range_log->ino_num, range_log->old_size, range_log->new_size);
+        //j_recover_range(sb, range_log);
+    }
+    else if (log_type == XATTR_LOG)
+    {
+        xattr_log_t * xattr_log = (xattr_log_t *)log_content;
+        INFO_REPORT("xattr log, ino %u, index %u, flags 0x%x\n",
+                     xattr_log->ino_num, xattr_log->name_index, xattr_log->flags);
+        //j_recover_xattr(sb, xattr_log);
+    }
+    else if (log_type == CHOWN_LOG)
+    {
+        chown_log_t * chown_log = (chown_log_t *)log_content;
+        INFO_REPORT("setattr log, ino %u, ia_valid 0x%x\n", chown_log->ino_num, chown_log->ia_valid);
+        //j_recover_setattr(sb, chown_log);
+    }
+    else if (log_type == META_DELTA_LOG)
+    {
+        meta_delta_log_t * delta_log = (meta_delta_log_t *)log_content;
+        INFO_REPORT("meta delta log, %u deltas, flags 0x%x\n", delta_log->nr_deltas, delta_log->flags);
+        // only collected here, replayed after node and segment managers are built
+        j_recover_meta_delta(sb, delta_log);
+        replayed = 1;
+    }
+    else if (log_type == ORPHAN_LOG)
+    {
+        orphan_log_t * orphan_log = (orphan_log_t *)log_content;
+        INFO_REPORT("orphan log, ino %u, flags 0x%x\n", orphan_log->ino_num, orphan_log->flags);
+        // only collected here, inodes are freed after mount is ready
+        j_recover_orphan(sb, orphan_log);
+        replayed = 1;
+    }
+    else if (log_type == DATA_JOURNAL_LOG)
+    {
+        data_journal_log_t * dj_log = (data_journal_log_t *)log_content;
+        INFO_REPORT("data journal log, ino %u, page %u, ofs %u, len %u\n",
+                     dj_log->ino_num, dj_log->page_idx, dj_log->data_ofs, dj_log->data_len);
+        //j_recover_data_journal(sb, dj_log);
+    }
 
-    return F2FSJ_OK;
+    return replayed;
 }
\ No newline at end of file
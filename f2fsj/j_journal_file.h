@@ -44,6 +44,11 @@
 #define J_LOG_ENTRY_SIZE (128)
 #define J_LOG_ENTRY_PER_FILE (256 * 1024 * 1024 / J_LOG_ENTRY_SIZE)
 #define J_LOG_ENTRY_PER_BLOCK (4096 / J_LOG_ENTRY_SIZE)
+// last log entry of the journal file is kept for WRAP_LOG, logs end before it
+#define J_LOG_WRAP_ENTRY (J_LOG_ENTRY_PER_FILE - 1)
+
+// Buffered writes up to this size are journaled for data journaling files, 0 disables it
+#define J_DEF_DATA_JOURNAL_MAX_BYTES (2048)
 
 // log entry <-> blk LBA
 #define J_LOG_ENTRY_TO_BLK(__log_entry_idx) \
@@ -116,10 +121,15 @@ typedef struct __j_jsb_info
 
     uint32_t j_current_small_file;  // 0
     uint32_t j_current_free_log_entry;  // 0-J_LOG_ENTRY_PER_FILE
+    uint32_t j_tail_log_entry;      // replay starts from this log, moved forward by log compaction
+    uint32_t j_flags;               // J_JSB_COMPRESSED
+    uint32_t j_zframe_start_blk;    // compressed journal, first block of the frames replay reads
 
     spinlock_t j_file_memap_lock;
 }j_jsb_info_t;
 
+#define J_JSB_COMPRESSED (0x1) ///< journal pages are written as LZ4 frames, see j_journal_compress.h
+
 typedef struct __j_file_mapping_t
 {
     uint8_t j_file_state;
@@ -146,6 +156,7 @@ typedef struct __j_log_entry_t
     uint32_t log_entry_idx;
     struct list_head log_node;
     uint8_t *log_entry_addr;
+    uint8_t log_type;           ///< type given at allocation, log header may differ (mkdir logs CREATE_LOG)
 }j_log_entry_t;
 
 
@@ -166,6 +177,26 @@ int mmap_journal_file();
 
 int j_alloc_log_entry(log_type_e log_type, j_log_entry_t **log_entry);
 
+/**
+ * @brief allocate nr_entries continuous log entries for one log (e.g., DATA_JOURNAL_LOG),
+ *        log_entry->log_entry_addr is the first one. One log takes at most one journal page
+ *        plus one entry
+ *
+ * @param log_type
+ * @param nr_entries
+ * @param[out] log_entry
+ * @return int
+ */
+int j_alloc_log_entries(log_type_e log_type, uint32_t nr_entries, j_log_entry_t **log_entry);
+
+/**
+ * @brief copy len bytes into log entries allocated by j_alloc_log_entries(), from the entry_ofs-th one.
+ *        Journal pages are not virtually continuous, do not memcpy() across entries directly
+ *
+ * @return int
+ */
+int j_copy_to_log_entries(j_log_entry_t *log_entry, uint32_t entry_ofs, const uint8_t *src, uint32_t len);
+
 int j_free_log_entry(j_log_entry_t * log_entry);
 
 int alloc_log_entry_test(log_type_e log_type);
@@ -207,26 +238,80 @@ int j_alloc_bio_read(struct f2fs_sb_info *sbi, struct bio **b_out, uint32_t star
 int add_journal_page_2_bio(struct page *p_log, struct bio *b);
 
 /**
- * @brief This function need to iterate all DF logs and writeback data pages
- *        Now, I think we can invoke inode->writepages() just like jbd2 does
+ * @brief Writeback data pages dirtied by an inode in the committing epoch,
+ *        invoke inode->writepages() on exactly the dirty ranges just like jbd2 does.
+ *        IO is only submitted here, wait it by ep_commit_wait_data_pages()
+ *
+ * @param f2fs_i
+ * @param ranges
+ * @return int
+ */
+int ep_commit_writeback_data_pages(struct f2fs_inode_info *f2fs_i, j_dirty_range_set_t *ranges);
+
+/**
+ * @brief Wait data pages submitted by ep_commit_writeback_data_pages()
  *
  * @param f2fs_i
+ * @param ranges
  * @return int
  */
-int ep_commit_writeback_data_pages(struct f2fs_inode_info *f2fs_i);
+int ep_commit_wait_data_pages(struct f2fs_inode_info *f2fs_i, j_dirty_range_set_t *ranges);
 
 /**
- * @brief Submit bio
+ * @brief Write journal pages used since last commit, it returns after they are durable
  *
- * @param bio
+ * @param sbi
  * @return int
  */
 int write_current_mmap_j_file(struct f2fs_sb_info *sbi);
 
+/**
+ * @brief Write journal pages allocated so far without committing an epoch, logs which are
+ *        not in an epoch (ORPHAN_LOG) are durable once it returns.
+ *        Caller serializes it with epoch commit
+ *
+ * @param sbi
+ * @return int
+ */
+int j_flush_journal_logs(struct f2fs_sb_info *sbi);
 
 int get_on_disk_free_journal_space();
 
-int reset_on_disk_journal_space_info();
+/**
+ * @brief How many log entries are allocated since mount, used to model journal fill rate
+ *
+ * @return uint64_t
+ */
+uint64_t get_total_alloc_log_entries();
+
+/**
+ * @brief Log entry the commit before the last one wrote up to, logs before it belong to
+ *        committed epochs. Caller serializes it with epoch commit to pair it with them
+ *
+ * @return uint32_t
+ */
+uint32_t j_get_stable_log_entry(void);
+
+/**
+ * @brief Journal checkpoint applied the logs before tail_log_entry, persist it as the on-disk
+ *        journal tail and give the journal space before it back to log allocation.
+ *        Caller serializes it with epoch commit
+ *
+ * @param sbi
+ * @param tail_log_entry
+ * @return int
+ */
+int j_reset_journal_tail(struct f2fs_sb_info *sbi, uint32_t tail_log_entry);
+
+/**
+ * @brief Frames of a new generation of the compressed journal are durable, point replay at them
+ *        in journal superblock. Called from journal commit
+ *
+ * @param sbi
+ * @param start_blk, journal block of the first frame
+ * @return int
+ */
+int j_write_journal_zframe_start(struct f2fs_sb_info *sbi, uint32_t start_blk);
 /**
  * @brief Writeback inode page also the node page
  * 
@@ -236,6 +321,16 @@ int reset_on_disk_journal_space_info();
  */
 int j_apply_NODE(struct f2fs_sb_info *sbi, uint32_t nid);
 
+/**
+ * @brief Write a data page journaled by DATA_JOURNAL_LOG to its home location and wait it
+ *
+ * @param sbi
+ * @param ino_num
+ * @param page_idx
+ * @return int
+ */
+int j_apply_DATA(struct f2fs_sb_info *sbi, uint32_t ino_num, uint32_t page_idx);
+
 /**
  * @brief Writeback META page
  * 
@@ -262,11 +357,55 @@ int iterate_journal(struct super_block *sb, int j_file_idx);
 
 int is_invalid_log_type(log_type_e log_type);
 
+/**
+ * @brief Get the log starting at log_entry_idx of the journal file, entries of a log crossing a
+ *        journal page are gathered into buf ((J_LOG_ENTRY_PER_BLOCK + 1) log entries)
+ *
+ * @param log_entry_idx
+ * @param buf
+ * @param[out] nr_entries, log entries the log takes
+ * @return uint8_t*, NULL if there is no valid log
+ */
+uint8_t *j_get_journal_log(uint32_t log_entry_idx, uint8_t *buf, uint32_t *nr_entries);
+
+/**
+ * @brief Range of the journal log compaction can work on: replay starts from *tail_log_entry, and
+ *        logs before *stable_log_entry were written by an earlier commit than the last one,
+ *        so their epochs are committed and they are not changed any more
+ *
+ * @return int, F2FSJ_ERROR if log allocation wrapped around the journal file
+ */
+int j_get_compact_range(uint32_t *tail_log_entry, uint32_t *stable_log_entry);
+
+/**
+ * @brief Allocate continuous log entries at the journal head for the copies of log compaction,
+ *        they never wrap around the journal file
+ *
+ * @param nr_entries
+ * @param[out] log_entry
+ * @return int
+ */
+int j_alloc_compact_entries(uint32_t nr_entries, j_log_entry_t *log_entry);
+
+/**
+ * @brief Write the copies of log compaction and then move the on-disk journal tail to
+ *        compact_log_entry. resume_log_entry is the oldest live log afterwards, log allocation
+ *        may reuse the journal space up to its page.
+ *        Caller serializes it with epoch commit
+ *
+ * @return int
+ */
+int j_commit_compacted_journal(struct f2fs_sb_info *sbi, uint32_t compact_log_entry, uint32_t resume_log_entry);
+
+///< replay cost is only calibrated from a journal with enough logs replayed by a handler
+#define J_REPLAY_CALIBRATE_MIN_LOGS (1024)
+
 /**
  * @brief recover file system by journal, should be invoked in the critical path of f2fs_mount()
  * 
  * @param latest_j_file, the latest journal file
- * @return int
+ * @param log_content, the whole log, its entries are continuous in memory
+ * @return int, 1 if the log is replayed, 0 if it is only read (no replay handler for its type)
  */
 int do_recover_from_journal(struct super_block *sb, log_type_e log_type, uint8_t * log_content);
 
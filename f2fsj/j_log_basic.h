@@ -16,33 +16,10 @@
 #include <linux/writeback.h>
 #include "j_log_content.h"
 
-typedef enum __j_page_extend_flag_e
-{
-    PG_Jdirty = PG_unevictable + 1,
-
-}j_page_extend_flag_e;
-
-/** Here is the step:
- *  When doing log collection
- *  1) clear_page_dirty_for_io(page)
- *  2) setJournalDirty(page)
- *  After committing:
- *  3) clearJournalDirty(page)
- *  4) SetPageDirty(page)
+/** Journal dirty of NODE/META pages is kept in f2fs page private (PAGE_PRIVATE_JOURNAL_DIRTY),
+ *  a page flag bit after PG_unevictable would alias PG_mlocked.
+ *  Refer to set_page_journal_dirty() and j_set_NODE_page_j_dirty()
 */
-static __always_inline void setPageJournalDirty(struct page *page)
-{
-    VM_BUG_ON_PAGE(PageTail(page), page);
-    smp_wmb();
-    set_bit(PG_Jdirty, &page->flags);
-}
-
-static __always_inline void clearPageJournalDirty(struct page *page)
-{
-    VM_BUG_ON_PAGE(PageTail(page), page);
-    smp_wmb();
-    clear_bit(PG_Jdirty, &page->flags);
-}
 
 ///< define the type of journal log base on frequency
 typedef enum __j_log
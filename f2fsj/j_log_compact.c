@@ -0,0 +1,583 @@
+/**
+ * @file j_log_compact.c
+ * @author leslie.cui (10033908@github.com)
+ * @brief implementation of journal log compaction
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ */
+#include "j_log_compact.h"
+#include "j_checkpoint.h"
+#include <linux/xarray.h>
+
+#define J_COMPACT_DROP          (0x1)   ///< log is superseded, not copied
+#define J_COMPACT_CANCEL        (0x2)   ///< create or unlink of an inode living only in the range
+
+#define J_COMPACT_SEEN_ATIME    (0x1)   ///< a later log sets access time of the inode
+#define J_COMPACT_SEEN_ATTR     (0x2)   ///< a later setattr log records all attributes of the inode
+
+typedef struct __j_compact_log_desc
+{
+    uint32_t log_entry_idx;
+    uint16_t nr_entries;
+    uint8_t  log_type;
+    uint8_t  flags;             ///< J_COMPACT_DROP, J_COMPACT_CANCEL
+    uint32_t ino;               ///< inode the log is about, 0 if none
+    uint32_t delta_base;        ///< first delta of a META_DELTA_LOG in dropped_deltas
+    uint16_t nr_deltas;
+    uint16_t nr_kept_deltas;
+}j_compact_log_desc_t;
+
+typedef struct __j_compact_ctrl
+{
+    struct f2fs_sb_info *sbi;
+    uint8_t *log_buf;           ///< one log, (J_LOG_ENTRY_PER_BLOCK + 1) log entries
+
+    j_compact_log_desc_t *logs; ///< compacted logs in replay order
+    uint32_t nr_logs;
+    uint32_t max_logs;
+    uint32_t nr_entries;        ///< log entries of the compacted logs
+
+    uint32_t nr_deltas;
+    bool deltas_lost;           ///< deltas are incomplete, keep them as they are
+    unsigned long *dropped_deltas;
+
+    uint32_t nr_dropped;
+}j_compact_ctrl_t;
+
+/**
+ * @brief inode a log is about, its logs go away with it
+ */
+static nid_t j_compact_log_ino(uint8_t *log)
+{
+    j_log_head_t *log_header = (j_log_head_t *)log;
+
+    switch (log_header->log_type)
+    {
+    case CREATE_LOG:
+    case MKDIR_LOG:
+        return ((create_log_t *)log)->j_new_ino_log.i_ino;
+    case SYMLINK_LOG:
+        return ((symlink_log_t *)log)->j_new_inode.i_ino;
+    case UNLINK_LOG:
+        return ((delete_log_t *)log)->ino_num;
+    case DIR_LOG:
+        return ((j_dir_log_t *)log)->ino;
+    case CHOWN_LOG:
+        return ((chown_log_t *)log)->ino_num;
+    case READ_FILE_DATA_LOG:
+    case READ_DIR_LOG:
+    case STAT_LOG:
+        return ((read_stat_log_t *)log)->ino_num;
+    case DATA_WRITE_LOG:
+        return ((data_write_log_t *)log)->ino_num;
+    case DATA_JOURNAL_LOG:
+        return ((data_journal_log_t *)log)->ino_num;
+    case XATTR_LOG:
+        return ((xattr_log_t *)log)->ino_num;
+    case TRUNCATE_LOG:
+    case FALLOCATE_LOG:
+    case PUNCH_LOG:
+        return ((range_log_t *)log)->ino_num;
+    default:
+        // link, rename and orphan logs tie several inodes, meta deltas are about blocks
+        return 0;
+    }
+}
+
+static void j_compact_pin_ino(struct xarray *pinned, nid_t ino, uint32_t log_idx)
+{
+    if (ino)
+    {
+        xa_store(pinned, ino, xa_mk_value(log_idx), GFP_NOFS);
+    }
+}
+
+/**
+ * @brief inodes a log refers to besides the one it is about, they must not be cancelled
+ */
+static void j_compact_pin_log(struct xarray *pinned, uint8_t *log, uint32_t log_idx)
+{
+    j_log_head_t *log_header = (j_log_head_t *)log;
+
+    switch (log_header->log_type)
+    {
+    case CREATE_LOG:
+    case MKDIR_LOG:
+        j_compact_pin_ino(pinned, ((create_log_t *)log)->j_new_ino_log.i_pino, log_idx);
+        break;
+    case SYMLINK_LOG:
+        j_compact_pin_ino(pinned, ((symlink_log_t *)log)->j_new_inode.i_pino, log_idx);
+        break;
+    case UNLINK_LOG:
+        j_compact_pin_ino(pinned, ((delete_log_t *)log)->parent_ino_num, log_idx);
+        break;
+    case DIR_LOG:
+        j_compact_pin_ino(pinned, ((j_dir_log_t *)log)->parent_ino, log_idx);
+        break;
+    case LINK_LOG:
+    {
+        link_log_t *link_log = (link_log_t *)log;
+        j_compact_pin_ino(pinned, link_log->ino_num, log_idx);
+        j_compact_pin_ino(pinned, link_log->parent_ino, log_idx);
+        break;
+    }
+    case RENAME_LOG:
+    {
+        rename_log_t *rename_log = (rename_log_t *)log;
+        j_compact_pin_ino(pinned, rename_log->ino_num, log_idx);
+        j_compact_pin_ino(pinned, rename_log->old_parent_ino, log_idx);
+        j_compact_pin_ino(pinned, rename_log->new_parent_ino, log_idx);
+        j_compact_pin_ino(pinned, rename_log->target_ino, log_idx);
+        j_compact_pin_ino(pinned, rename_log->whiteout_ino, log_idx);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief collect logs of [from, to) in order, stop at an invalid log like replay does
+ *
+ * @param limit, stop once log entries after from reach it
+ * @return uint32_t, where collection stops
+ */
+static uint32_t j_compact_collect(j_compact_ctrl_t *ctrl, uint32_t from, uint32_t to, uint32_t limit)
+{
+    j_compact_log_desc_t *desc = NULL;
+    meta_delta_log_t *delta_log = NULL;
+    uint32_t i = from;
+    uint32_t nr_entries = 0;
+    uint8_t *log = NULL;
+
+    while (i < to && i - from < limit && ctrl->nr_logs < ctrl->max_logs)
+    {
+        log = j_get_journal_log(i, ctrl->log_buf, &nr_entries);
+        if (!log)
+        {
+            break;
+        }
+
+        // copies of an earlier compaction out of the tail, their originals are here
+        if (((j_log_head_t *)log)->log_type == COMPACT_LOG)
+        {
+            i += nr_entries + ((compact_log_t *)log)->nr_entries;
+            continue;
+        }
+
+        desc = &ctrl->logs[ctrl->nr_logs ++];
+        memset(desc, 0, sizeof(j_compact_log_desc_t));
+        desc->log_entry_idx = i;
+        desc->nr_entries    = nr_entries;
+        desc->log_type      = ((j_log_head_t *)log)->log_type;
+        desc->ino           = j_compact_log_ino(log);
+
+        if (desc->log_type == META_DELTA_LOG)
+        {
+            delta_log = (meta_delta_log_t *)log;
+            desc->delta_base     = ctrl->nr_deltas;
+            desc->nr_deltas      = min_t(uint32_t, delta_log->nr_deltas, J_META_DELTAS_PER_LOG);
+            desc->nr_kept_deltas = desc->nr_deltas;
+            ctrl->nr_deltas += desc->nr_deltas;
+            if (delta_log->flags & J_META_DELTA_LOST)
+            {
+                ctrl->deltas_lost = true;
+            }
+        }
+
+        ctrl->nr_entries += nr_entries;
+        i += nr_entries;
+    }
+
+    return i;
+}
+
+/**
+ * @brief forward pass: an inode created in the range and unlinked (nlink 0) later in the range
+ *        is cancelled, unless another log refers to it in between
+ */
+static void j_compact_find_cancelled(j_compact_ctrl_t *ctrl)
+{
+    struct xarray created;
+    struct xarray pinned;
+    j_compact_log_desc_t *desc = NULL;
+    uint8_t *log = NULL;
+    uint32_t nr_entries = 0;
+    uint32_t k = 0;
+    void *create_idx = NULL;
+    void *pin_idx = NULL;
+
+    xa_init(&created);
+    xa_init(&pinned);
+
+    for (k = 0; k < ctrl->nr_logs; k++)
+    {
+        desc = &ctrl->logs[k];
+        log = j_get_journal_log(desc->log_entry_idx, ctrl->log_buf, &nr_entries);
+        if (!log)
+        {
+            continue;
+        }
+
+        j_compact_pin_log(&pinned, log, k);
+
+        if (desc->log_type == CREATE_LOG || desc->log_type == MKDIR_LOG || desc->log_type == SYMLINK_LOG)
+        {
+            xa_store(&created, desc->ino, xa_mk_value(k), GFP_NOFS);
+        }
+        else if (desc->log_type == UNLINK_LOG && ((delete_log_t *)log)->ino_nlink == 0)
+        {
+            create_idx = xa_load(&created, desc->ino);
+            pin_idx    = xa_load(&pinned, desc->ino);
+            if (create_idx && (!pin_idx || xa_to_value(pin_idx) < xa_to_value(create_idx)))
+            {
+                ctrl->logs[xa_to_value(create_idx)].flags |= J_COMPACT_CANCEL;
+                desc->flags |= J_COMPACT_CANCEL;
+            }
+            xa_erase(&created, desc->ino);
+        }
+    }
+
+    xa_destroy(&created);
+    xa_destroy(&pinned);
+}
+
+static void j_compact_drop_log(j_compact_ctrl_t *ctrl, j_compact_log_desc_t *desc)
+{
+    desc->flags |= J_COMPACT_DROP;
+    ctrl->nr_dropped ++;
+}
+
+/**
+ * @brief backward pass: drop logs of cancelled inodes and attribute logs superseded later
+ */
+static void j_compact_find_superseded(j_compact_ctrl_t *ctrl)
+{
+    struct xarray dead;
+    struct xarray attr;
+    j_compact_log_desc_t *desc = NULL;
+    void *seen = NULL;
+    unsigned long seen_flags = 0;
+    int k = 0;
+
+    xa_init(&dead);
+    xa_init(&attr);
+
+    for (k = ctrl->nr_logs - 1; k >= 0; k--)
+    {
+        desc = &ctrl->logs[k];
+
+        // logs between create and unlink of a cancelled inode go with them
+        if (desc->log_type == UNLINK_LOG && (desc->flags & J_COMPACT_CANCEL))
+        {
+            xa_store(&dead, desc->ino, xa_mk_value(1), GFP_NOFS);
+        }
+
+        if (desc->ino && xa_load(&dead, desc->ino))
+        {
+            j_compact_drop_log(ctrl, desc);
+            if (desc->log_type != UNLINK_LOG && (desc->flags & J_COMPACT_CANCEL))
+            {
+                xa_erase(&dead, desc->ino);
+            }
+            continue;
+        }
+
+        seen = xa_load(&attr, desc->ino);
+        seen_flags = seen ? xa_to_value(seen) : 0;
+
+        if (desc->log_type == READ_FILE_DATA_LOG || desc->log_type == READ_DIR_LOG || desc->log_type == STAT_LOG)
+        {
+            if (seen_flags)
+            {
+                j_compact_drop_log(ctrl, desc);
+                continue;
+            }
+            xa_store(&attr, desc->ino, xa_mk_value(J_COMPACT_SEEN_ATIME), GFP_NOFS);
+        }
+        else if (desc->log_type == CHOWN_LOG)
+        {
+            // setattr log records all attributes after the change
+            if (seen_flags & J_COMPACT_SEEN_ATTR)
+            {
+                j_compact_drop_log(ctrl, desc);
+                continue;
+            }
+            xa_store(&attr, desc->ino, xa_mk_value(J_COMPACT_SEEN_ATTR | J_COMPACT_SEEN_ATIME), GFP_NOFS);
+        }
+    }
+
+    xa_destroy(&dead);
+    xa_destroy(&attr);
+}
+
+/**
+ * @brief backward pass over meta deltas: a NAT delta is superseded by a later one of the same nid,
+ *        an SSA delta by a later one of the same summary slot. SIT deltas are relative and GC moves
+ *        read node pages through NAT, so NAT deltas before a GC move are kept
+ */
+static void j_compact_find_superseded_deltas(j_compact_ctrl_t *ctrl)
+{
+    struct xarray nat;
+    struct xarray ssa;
+    j_compact_log_desc_t *desc = NULL;
+    j_meta_delta_t *delta = NULL;
+    uint8_t *log = NULL;
+    uint32_t nr_entries = 0;
+    unsigned long key = 0;
+    int k = 0, j = 0;
+
+    if (ctrl->deltas_lost || !ctrl->nr_deltas)
+    {
+        return;
+    }
+
+    xa_init(&nat);
+    xa_init(&ssa);
+
+    for (k = ctrl->nr_logs - 1; k >= 0; k--)
+    {
+        desc = &ctrl->logs[k];
+        if (desc->log_type != META_DELTA_LOG)
+        {
+            continue;
+        }
+
+        log = j_get_journal_log(desc->log_entry_idx, ctrl->log_buf, &nr_entries);
+        if (!log)
+        {
+            continue;
+        }
+
+        delta = (j_meta_delta_t *)(log + J_LOG_ENTRY_SIZE);
+        for (j = desc->nr_deltas - 1; j >= 0; j--)
+        {
+            if (delta[j].delta_type == J_DELTA_NAT)
+            {
+                key = delta[j].nat.j_nid;
+                if (!xa_load(&nat, key))
+                {
+                    xa_store(&nat, key, xa_mk_value(1), GFP_NOFS);
+                    continue;
+                }
+            }
+            else if (delta[j].delta_type == J_DELTA_SSA)
+            {
+                key = (unsigned long)delta[j].ssa.segno * ctrl->sbi->blocks_per_seg + delta[j].ssa.blkofs;
+                if (!xa_load(&ssa, key))
+                {
+                    xa_store(&ssa, key, xa_mk_value(1), GFP_NOFS);
+                    continue;
+                }
+            }
+            else
+            {
+                if (delta[j].delta_type == J_DELTA_GC_MOVE)
+                {
+                    xa_destroy(&nat);
+                }
+                continue;
+            }
+
+            set_bit(desc->delta_base + j, ctrl->dropped_deltas);
+            desc->nr_kept_deltas --;
+        }
+
+        if (!desc->nr_kept_deltas)
+        {
+            j_compact_drop_log(ctrl, desc);
+        }
+    }
+
+    xa_destroy(&nat);
+    xa_destroy(&ssa);
+}
+
+static uint32_t j_compact_copy_entries(j_compact_log_desc_t *desc)
+{
+    if (desc->log_type == META_DELTA_LOG && desc->nr_kept_deltas != desc->nr_deltas)
+    {
+        return 1 + DIV_ROUND_UP(desc->nr_kept_deltas * sizeof(j_meta_delta_t), J_LOG_ENTRY_SIZE);
+    }
+
+    return desc->nr_entries;
+}
+
+/**
+ * @brief copy a kept log to the compaction entries from entry_ofs, meta delta logs only keep
+ *        their live deltas
+ *
+ * @return uint32_t, log entries taken by the copy
+ */
+static uint32_t j_compact_copy_log(j_compact_ctrl_t *ctrl, j_compact_log_desc_t *desc,
+                                        j_log_entry_t *compact_entry, uint32_t entry_ofs)
+{
+    j_meta_delta_t *delta = NULL;
+    j_meta_delta_t *kept  = NULL;
+    uint8_t *log = NULL;
+    uint32_t nr_entries = 0;
+    uint32_t copy_entries = j_compact_copy_entries(desc);
+    uint32_t j = 0, nr_kept = 0;
+
+    log = j_get_journal_log(desc->log_entry_idx, ctrl->log_buf, &nr_entries);
+    if (!log)
+    {
+        return 0;
+    }
+
+    if (copy_entries != desc->nr_entries)
+    {
+        // pack live deltas in place, buf is not shared with the journal pages
+        if (log != ctrl->log_buf)
+        {
+            memcpy(ctrl->log_buf, log, nr_entries * J_LOG_ENTRY_SIZE);
+            log = ctrl->log_buf;
+        }
+
+        delta = kept = (j_meta_delta_t *)(log + J_LOG_ENTRY_SIZE);
+        for (j = 0; j < desc->nr_deltas; j++)
+        {
+            if (!test_bit(desc->delta_base + j, ctrl->dropped_deltas))
+            {
+                kept[nr_kept ++] = delta[j];
+            }
+        }
+        memset(kept + nr_kept, 0, copy_entries * J_LOG_ENTRY_SIZE - J_LOG_ENTRY_SIZE - nr_kept * sizeof(j_meta_delta_t));
+
+        ((meta_delta_log_t *)log)->nr_deltas = nr_kept;
+        ((j_log_head_t *)log)->log_size = copy_entries * J_LOG_ENTRY_SIZE;
+    }
+
+    j_copy_to_log_entries(compact_entry, entry_ofs, log, copy_entries * J_LOG_ENTRY_SIZE);
+    return copy_entries;
+}
+
+int j_compact_journal(struct f2fs_sb_info *sbi)
+{
+    j_compact_ctrl_t ctrl = { .sbi = sbi };
+    j_log_entry_t compact_entry;
+    compact_log_t compact_log;
+    j_compact_log_desc_t *desc = NULL;
+    uint8_t *log = NULL;
+    uint32_t tail = 0, stable = 0, nr_entries = 0;
+    uint32_t copies_start = 0, copies_end = 0, resume = 0;
+    uint32_t prev_resume = 0;
+    uint32_t copy_entries = 0, entry_ofs = 0;
+    uint32_t k = 0;
+    int ret = F2FSJ_ERROR;
+
+    if (j_get_compact_range(&tail, &stable) != F2FSJ_OK || tail == stable)
+    {
+        return F2FSJ_ERROR;
+    }
+
+    ctrl.log_buf = kmalloc((J_LOG_ENTRY_PER_BLOCK + 1) * J_LOG_ENTRY_SIZE, GFP_NOFS);
+    if (!ctrl.log_buf)
+    {
+        return F2FSJ_ERROR;
+    }
+
+    // tail left by last compaction: its copies, then logs written before them, then the rest
+    copies_start = copies_end = prev_resume = tail;
+    log = j_get_journal_log(tail, ctrl.log_buf, &nr_entries);
+    if (log && ((j_log_head_t *)log)->log_type == COMPACT_LOG)
+    {
+        copies_start = tail + 1;
+        copies_end   = copies_start + ((compact_log_t *)log)->nr_entries;
+        prev_resume  = ((compact_log_t *)log)->resume_log_entry;
+    }
+
+    if (copies_end > stable)
+    {
+        goto out;
+    }
+
+    // at most one log per entry
+    ctrl.max_logs = (copies_end - copies_start) + (tail - prev_resume)
+                  + min_t(uint32_t, stable - copies_end, J_COMPACT_WINDOW_ENTRIES);
+    ctrl.logs = kvmalloc_array(ctrl.max_logs, sizeof(j_compact_log_desc_t), GFP_NOFS);
+    if (!ctrl.logs)
+    {
+        goto out;
+    }
+
+    j_compact_collect(&ctrl, copies_start, copies_end, U32_MAX);
+    j_compact_collect(&ctrl, prev_resume, tail, U32_MAX);
+    resume = j_compact_collect(&ctrl, copies_end, stable, J_COMPACT_WINDOW_ENTRIES);
+    if (!ctrl.nr_logs)
+    {
+        goto out;
+    }
+
+    ctrl.dropped_deltas = kvzalloc(BITS_TO_LONGS(ctrl.nr_deltas + 1) * sizeof(unsigned long), GFP_NOFS);
+    if (!ctrl.dropped_deltas)
+    {
+        goto out;
+    }
+
+    j_compact_find_cancelled(&ctrl);
+    j_compact_find_superseded(&ctrl);
+    j_compact_find_superseded_deltas(&ctrl);
+
+    copy_entries = 1;
+    for (k = 0; k < ctrl.nr_logs; k++)
+    {
+        if (!(ctrl.logs[k].flags & J_COMPACT_DROP))
+        {
+            copy_entries += j_compact_copy_entries(&ctrl.logs[k]);
+        }
+    }
+
+    // copying most of the logs only moves them, let checkpoint free the journal
+    if (copy_entries * J_COMPACT_MIN_SAVING > ctrl.nr_entries * (J_COMPACT_MIN_SAVING - 1))
+    {
+        INFO_REPORT("compaction saves too few log entries, %u of %u\n", copy_entries, ctrl.nr_entries);
+        goto out;
+    }
+
+    if (j_alloc_compact_entries(copy_entries, &compact_entry) != F2FSJ_OK)
+    {
+        goto out;
+    }
+
+    memset(&compact_log, 0, sizeof(compact_log_t));
+    compact_log.log_header.log_type = COMPACT_LOG;
+    compact_log.log_header.log_size = J_LOG_ENTRY_SIZE;
+    compact_log.nr_entries       = copy_entries - 1;
+    compact_log.resume_log_entry = resume;
+    compact_log.nr_logs          = ctrl.nr_logs - ctrl.nr_dropped;
+    compact_log.nr_dropped       = ctrl.nr_dropped;
+
+    memset(compact_entry.log_entry_addr, 0, J_LOG_ENTRY_SIZE);
+    memcpy(compact_entry.log_entry_addr, &compact_log, sizeof(compact_log_t));
+
+    entry_ofs = 1;
+    for (k = 0; k < ctrl.nr_logs; k++)
+    {
+        desc = &ctrl.logs[k];
+        if (!(desc->flags & J_COMPACT_DROP))
+        {
+            entry_ofs += j_compact_copy_log(&ctrl, desc, &compact_entry, entry_ofs);
+        }
+    }
+
+    if (j_commit_compacted_journal(sbi, compact_entry.log_entry_idx, resume) != F2FSJ_OK)
+    {
+        // tail stays, replay skips the copies behind the compaction log
+        STATUS_LOG(STATUS_ERROR, "write compacted journal fail\n");
+        goto out;
+    }
+
+    j_forget_unapplied_logs(ctrl.nr_dropped);
+    INFO_REPORT("journal compacted, %u logs of %u entries -> %u entries, %u logs dropped, tail %u -> %u\n",
+                 ctrl.nr_logs, ctrl.nr_entries, copy_entries, ctrl.nr_dropped, tail, compact_entry.log_entry_idx);
+    ret = F2FSJ_OK;
+
+out:
+    kvfree(ctrl.dropped_deltas);
+    kvfree(ctrl.logs);
+    kfree(ctrl.log_buf);
+    return ret;
+}
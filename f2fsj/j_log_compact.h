@@ -0,0 +1,43 @@
+/**
+ * @file j_log_compact.h
+ * @author leslie.cui (10033908@github.com)
+ * @brief journal log compaction (log cleaning). Live logs of the journal tail are copied to the
+ *        journal head and logs superseded by later ones are dropped, so the tail moves forward
+ *        without applying metadata by checkpoint
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef _J_LOG_COMPACT_H_
+#define _J_LOG_COMPACT_H_
+
+#include "f2fs.h"
+#include "j_journal_file.h"
+
+///< one pass compacts the copies of last pass and the logs of the next journal segment (2MB)
+#define J_COMPACT_WINDOW_BLKS    (512)
+#define J_COMPACT_WINDOW_ENTRIES (J_COMPACT_WINDOW_BLKS * J_LOG_ENTRY_PER_BLOCK)
+
+///< compaction is not worth it unless at least 1/4 of the compacted log entries are dropped
+#define J_COMPACT_MIN_SAVING     (4)
+
+#define J_DEF_LOG_COMPACTION     (1)    ///< compact the journal before falling back to checkpoint
+
+/**
+ * @brief Compact the oldest logs of the journal. Logs superseded later in the compacted range
+ *        are dropped:
+ *        1) access time logs and setattr logs followed by a setattr log of the same inode
+ *        2) logs of an inode created and unlinked (nlink 0) in the range, if no other inode
+ *           refers to it (parent, link, rename)
+ *        3) NAT and SSA deltas followed by a delta of the same nid or summary slot
+ *        The others are copied to the journal head behind a COMPACT_LOG in replay order, which
+ *        becomes the journal tail. Caller serializes it with epoch commit
+ *
+ * @param sbi
+ * @return int, F2FSJ_OK if journal tail moves forward
+ */
+int j_compact_journal(struct f2fs_sb_info *sbi);
+
+#endif // !_J_LOG_COMPACT_H_
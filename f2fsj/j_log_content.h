@@ -97,17 +97,6 @@ static inline unsigned long get_current_time_ns(void)
     return ns;
 }
 
-static inline log2(int n)
-{
-    int cnt = 0;
-    if (n == 1)
-    {
-        return 0;
-    }
-
-    return 1 + log2(n >> 1);
-}
-
 ///< define log type base on file operations
 typedef enum __log_type
 {
@@ -127,7 +116,28 @@ typedef enum __log_type
     STAT_LOG              = 10,
 
     ///< data drived frequent log
-    DATA_WRITE_LOG    = 11
+    DATA_WRITE_LOG    = 11,
+    DATA_JOURNAL_LOG  = 12,
+
+    ///< meta drived log with variable size
+    XATTR_LOG         = 13,
+
+    ///< block range of a file is freed or allocated
+    TRUNCATE_LOG      = 14,
+    FALLOCATE_LOG     = 15,
+    PUNCH_LOG         = 16,
+
+    ///< inode is unlinked but still open
+    ORPHAN_LOG        = 17,
+
+    ///< NAT/SIT/SSA changes of the epoch
+    META_DELTA_LOG    = 18,
+
+    ///< live logs of the journal tail rewritten at the head by log compaction
+    COMPACT_LOG       = 19,
+
+    ///< log entry allocation went back to the start of the journal file, logs go on from entry 0
+    WRAP_LOG          = 20
 }log_type_e;
 
 ///< define log head
@@ -154,7 +164,7 @@ typedef struct __j_nat_entry
 }j_nat_entry_t;
 
 
-///< sit log is for one segment (like nr of valid blocks and also bitmap)
+///< sit log is for one block of a segment, valid block bitmap is rebuilt bit by bit on replay
 typedef struct __sit_log
 {
     /** 
@@ -162,12 +172,10 @@ typedef struct __sit_log
      *
      *  f2fs_get_meta_page(sbi, current_sit_addr(sbi, segno));
      */
-    uint32_t j_sit_cur_seg;
-
     uint32_t segno;
-    uint32_t j_nr_valid_block;
-    uint32_t bitmap_size;     // we should copy this bitmap into log
-    char     * j_bitmap;
+    uint16_t blkofs;            ///< bit offset of the block in the valid map of segment
+    int16_t  valid_delta;       ///< +1 block becomes valid, -1 invalid
+    uint32_t j_nr_valid_block;  ///< valid blocks of segment after this change
 }j_sit_log_t;
 
 ///< ssa: reverse mapping (LBA -> nid) compared with NAT (nid -> LBA)
@@ -180,13 +188,47 @@ typedef struct __ssa_entry_log
      *
      *  f2fs_get_meta_page(sbi, GET_SUM_BLOCK(sbi, segno));
      */
-    uint32_t j_cur_seg_no;
-
-    uint16_t blk_ofs_in_inode;
-    uint32_t block_addr;
-    uint32_t j_nid;
+    uint32_t segno;
+    uint16_t blkofs;            ///< summary slot in the summary block of segment
+    uint16_t ofs_in_node;
+    uint32_t j_nid;             ///< version of summary is j_meta_delta_t.version
 }j_ssa_log_entry_t;
 
+#define J_DELTA_NAT     (0)     ///< nid -> blkaddr
+#define J_DELTA_SIT     (1)     ///< one block of a segment becomes valid or invalid
+#define J_DELTA_SSA     (2)     ///< summary slot of a new block
+#define J_DELTA_GC_MOVE (3)     ///< data block moved by GC, slot of dnode points to new block
+
+///< GC relocation of one data block, SIT and SSA of it are in the SIT and SSA deltas made by the move
+typedef struct __gc_move_log
+{
+    uint32_t j_nid;             ///< dnode, slot is j_meta_delta_t.ofs_in_node
+    uint32_t old_blkaddr;
+    uint32_t new_blkaddr;
+}j_gc_move_log_t;
+
+/**
+ * @brief one NAT, SIT, SSA change or GC move, 16 bytes
+ */
+typedef struct __j_meta_delta
+{
+    uint8_t  delta_type;        ///< J_DELTA_*
+    uint8_t  version;           ///< node version of NAT and SSA
+    uint16_t ofs_in_node;       ///< GC move only
+    union
+    {
+        j_nat_entry_t     nat;
+        j_sit_log_t       sit;
+        j_ssa_log_entry_t ssa;
+        j_gc_move_log_t   move;
+    };
+}j_meta_delta_t;
+
+///< deltas of one META_DELTA_LOG, they fill one journal page after the log header
+#define J_META_DELTAS_PER_LOG   ((J_LOG_ENTRY_PER_BLOCK * J_LOG_ENTRY_SIZE) / sizeof(j_meta_delta_t))
+
+#define J_META_DELTA_LOST       (0x1)   ///< deltas before this log were dropped, replay them no more
+
 typedef struct __j_new_inode_log
 {
     __le16 i_mode;          /* file mode */
@@ -257,13 +299,39 @@ typedef struct __data_write_log  ///< data writeback
     // we just invoke writepage() and use page_ofs to find corresponding page 
 }data_write_log_t;
 
+/**
+ * @brief data journaling: bytes of a small buffered write are copied into the journal,
+ *        so fsync only waits for the epoch commit. The record takes 1 + nr_data_slots
+ *        continuous log entries, this header in the first one and the data in the others,
+ *        and log_header.log_size covers all of them.
+ *        Home location of the data page is written lazily by journal checkpoint.
+ */
+typedef struct __data_journal_log
+{
+    j_log_head_t log_header;
+
+    uint32_t ino_num;
+    uint32_t page_idx;      ///< page index in file
+    uint16_t data_ofs;      ///< offset of data in page
+    uint16_t data_len;
+    uint64_t file_size;     ///< file size after this write
+
+    uint32_t nr_data_slots; ///< how many log entries are followed for data
+    uint32_t data_crc;      ///< crc32 of data, a torn record ends replay
+}data_journal_log_t;
+
+/**
+ * @brief access time update by read (READ_FILE_DATA_LOG), readdir (READ_DIR_LOG) or
+ *        others (STAT_LOG). One log per inode per epoch, it is updated in place by later
+ *        accesses in the same epoch
+ */
 typedef struct __read_stat_log  ///< read file or listdir directory
 {
     j_log_head_t log_header;
 
     uint32_t ino_num;
-    time64_t access_time_s;
-    long     access_time_ns;
+    uint32_t access_time_ns;
+    uint64_t access_time_s;
 }read_stat_log_t;
 
 typedef struct __create_log    ///< create file or directory
@@ -359,49 +427,170 @@ typedef struct __delete_log    ///< delete file or directory
 }delete_log_t;
 
 /**
- * @brief for symlink, firstly a new inode will be created and write the symlink contents
- *        Then, a directory entry will be added into parent inode local log list
- *        ---> j_dir_log_t for parent log list
+ * @brief for symlink, a new inode is created and the symlink contents are written into it,
+ *        and a directory entry is added into parent directory.
+ *        The full file name (j_new_inode.i_namelen bytes) and then the symlink target
+ *        (j_new_inode.i_size bytes) follow in the next log entries, so log_size is larger than 128.
+ *        Cause block address of new inode will be allocated during writepages(NODE),
+ *        no need to record nat/sit/ssa (no apply means no need to record)
  */
 typedef struct __symlink_log   ///< file symlink
 {
     j_log_head_t log_header;
 
-    ///< firstly, new inode contents should be recorded
+    ///< new inode contents, i_name only keeps the first 16 bytes of file name
     j_new_inode_log_t j_new_inode;
+}symlink_log_t;
 
-    ///< symlink contents
-    uint16_t j_symlink_name_len;
-    char j_symlink_name[32];
+/**
+ * @brief hard link adds a directory entry of ino_num into parent_ino,
+ *        the file name (name_len bytes) follows in the next log entries
+ */
+typedef struct __link_log      ///< hard link
+{
+    j_log_head_t log_header;
 
-    ///< cause block address of new inode will be allocated during writepages(NODE)
-    ///< so no need to record nat/sit/ssa (no apply means no need to record) 
-    j_nat_entry_t     nat_en_log;
-    j_sit_log_t       sit_log;
-    j_ssa_log_entry_t ssa_en_log;
-}symlink_log_t;
+    uint32_t ino_num;
+    uint32_t parent_ino;
+    uint32_t ino_nlink;     ///< nlink after link
+    uint16_t i_mode;
+    uint16_t name_len;
+}link_log_t;
+
+#define J_RENAME_EXCHANGE   (0x1)   ///< RENAME_EXCHANGE, ino_num and target_ino swap names
+#define J_RENAME_WHITEOUT   (0x2)   ///< RENAME_WHITEOUT, whiteout_ino is left at old name
 
 /**
- * @brief for rename, firstly an old directory entry should be deleted from old parent directory block
- *        -> a j_dir_log_t for old parent log list
- *        Then, a new directory entry would be added into new parent directory block
- *        -> a j_dir_log_t for new parent log list
- *        lastly, this inode also need to update some attributes (time)
+ * @brief for rename, directory entry of old name is deleted from old parent and a directory entry
+ *        of new name is added into (or replaced in) new parent; ".." of a directory is updated when
+ *        parent changes. One log covers both directories, so cross directory rename is atomic.
+ *        Old name (old_name_len bytes) and then new name (new_name_len bytes) follow in the next log entries
  */
 typedef struct __rename_log    ///< rename file or directory
 {
-    j_new_inode_log_t j_inode;
+    j_log_head_t log_header;
 
+    uint32_t ino_num;           ///< renamed inode
+    uint32_t old_parent_ino;
+    uint32_t new_parent_ino;
+    uint32_t target_ino;        ///< inode at new name that is replaced or exchanged, 0 means none
+    uint32_t target_nlink;      ///< nlink of target_ino after rename
+    uint32_t whiteout_ino;
+    uint16_t i_mode;
+    uint16_t target_mode;
+    uint16_t old_name_len;
+    uint16_t new_name_len;
+    uint32_t flags;             ///< J_RENAME_EXCHANGE, J_RENAME_WHITEOUT
 }rename_log_t;
 
-typedef struct __chown_log    ///< change the owner
+/**
+ * @brief truncate (TRUNCATE_LOG), fallocate (FALLOCATE_LOG) and punch hole (PUNCH_LOG).
+ *        Blocks are freed or reserved in node pages, NAT and SIT in memory, which are written
+ *        by checkpoint; replay runs the operation again on [offset, offset + len)
+ */
+typedef struct __range_log
+{
+    j_log_head_t log_header;
+
+    uint32_t ino_num;
+    uint32_t mode;          ///< FALLOC_FL_* of fallocate, 0 for truncate
+    uint64_t old_size;      ///< i_size before the operation
+    uint64_t new_size;      ///< i_size after the operation
+    uint64_t offset;        ///< truncate: new size
+    uint64_t len;           ///< truncate: freed bytes
+}range_log_t;
+
+/**
+ * @brief NAT, SIT and SSA changes made by block allocation and free, in the order they are made.
+ *        nr_deltas j_meta_delta_t follow from the second log entry. NAT and SIT entries are still
+ *        flushed by checkpoint, deltas roll in-memory NAT/SIT/SSA forward from the last checkpoint
+ *        on replay, so data written back by epoch commit is reachable without a checkpoint.
+ *        Deltas made before the checkpoint replay starts from are in it already, they are skipped
+ */
+typedef struct __meta_delta_log
+{
+    j_log_head_t log_header;
+
+    uint32_t nr_deltas;
+    uint32_t flags;         ///< J_META_DELTA_LOST
+    uint64_t cp_ver;        ///< deltas are made after the checkpoint of this version
+}meta_delta_log_t;
+
+#define J_ORPHAN_RELINK     (0x1)   ///< orphan is linked again (tmpfile linkat)
+
+/**
+ * @brief orphan inode (nlink is 0 while inode is still open) instead of orphan blocks of checkpoint.
+ *        Log is not inserted into inode log list, inode is freed before the epoch commits mostly.
+ *        Orphans alive at checkpoint are logged again into the reset journal, so replay sees all
+ *        orphans since the last checkpoint and frees those not relinked
+ */
+typedef struct __orphan_log
+{
+    j_log_head_t log_header;
+
+    uint32_t ino_num;
+    uint32_t flags;         ///< J_ORPHAN_RELINK
+}orphan_log_t;
+
+#define J_XATTR_REMOVE      (0x1)   ///< xattr is removed, no value follows
+
+/**
+ * @brief set or remove one xattr (including ACL and security label). Name (name_len bytes) and
+ *        value (value_len bytes) follow in the next log entries. xattr is written into inode page
+ *        (inline xattr) or xattr node, which stay in memory until checkpoint like other journaled pages
+ */
+typedef struct __xattr_log
+{
+    j_log_head_t log_header;
+
+    uint32_t ino_num;
+    uint32_t xattr_nid;     ///< xattr node after this update, 0 means inline only
+    uint16_t i_mode;        ///< mode may be changed together with ACL
+    uint8_t  name_index;    ///< F2FS_XATTR_INDEX_*
+    uint8_t  name_len;
+    uint16_t value_len;
+    uint16_t flags;         ///< J_XATTR_REMOVE
+}xattr_log_t;
+
+/**
+ * @brief for setattr (chmod, chown, utimes, size change), attributes after the change are recorded,
+ *        the change is absorbed in in-core inode and inode page is written by checkpoint
+ */
+typedef struct __chown_log    ///< change the owner, mode, times or size
 {
+    j_log_head_t log_header;
+
     uint32_t ino_num;
-    kuid_t user_id;
-    kgid_t group_id;
-    loff_t i_size;
-    struct timespec64   mtime;
-    struct timespec64   ctime;
+    uint32_t ia_valid;      ///< ATTR_* of the setattr, for debug
+    uint32_t i_uid;
+    uint32_t i_gid;
+    uint16_t i_mode;
+    uint16_t reserved;
+    uint64_t i_size;
+    uint64_t i_atime;
+    uint64_t i_ctime;
+    uint64_t i_mtime;
+    uint32_t i_atime_nsec;
+    uint32_t i_ctime_nsec;
+    uint32_t i_mtime_nsec;
 }chown_log_t;
 
+/**
+ * @brief log compaction copies the live logs of the oldest journal range to the head, dropping
+ *        logs superseded later in the range. This log leads the copies (nr_entries log entries
+ *        follow it) and becomes the journal tail. Logs in [resume_log_entry, this log) were written
+ *        after the compacted range, replay starting here applies the copies, then that range, then
+ *        what follows the copies. Replay starting before this log has applied the originals and
+ *        skips the copies
+ */
+typedef struct __compact_log
+{
+    j_log_head_t log_header;
+
+    uint32_t nr_entries;        ///< log entries of the copies following this log
+    uint32_t resume_log_entry;  ///< end of the compacted range
+    uint32_t nr_logs;           ///< logs copied
+    uint32_t nr_dropped;        ///< logs dropped as superseded
+}compact_log_t;
+
 #endif // !J_LOG_CONTENT_H
\ No newline at end of file
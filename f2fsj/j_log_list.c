@@ -0,0 +1,361 @@
+/**
+ * @file j_log_list.c
+ * @author leslie.cui (10033908@github.com)
+ * @brief inode check-in to the running epoch and per-inode log lists, such as insert, aggregate...
+ *        Nothing here touches f2fs internals, jsim/ builds this file in userspace as it is
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "j_log_operate.h"
+#include "j_epoch.h"
+#include "j_op_lat.h"
+#include "j_trace.h"
+
+int is_already_checkin_g_epoch(struct f2fs_inode_info *f2fs_i, uint8_t * ep_no, struct list_head ** g_ep_head)
+{
+    uint8_t g_active_ep_no = NONE_EPOCH;
+    struct list_head * g_cur_active_epoch = NULL;
+
+    uint8_t is_checkin = 0;
+    uint8_t local_log_list_idx = NONE_EPOCH;
+
+    global_epoch_t *g_running_epoch = get_cur_g_running_epoch();
+
+    g_active_ep_no     = g_running_epoch->g_epoch_type;
+    g_cur_active_epoch = &g_running_epoch->global_ino_epoch_list;
+    * ep_no = g_active_ep_no;
+    * g_ep_head = g_cur_active_epoch;
+    if (!g_cur_active_epoch || g_active_ep_no >= NONE_EPOCH)
+    {
+        STATUS_LOG(STATUS_ERROR, "get global active epoch error\n");
+        is_checkin = 0;
+    }
+    else
+    {
+        local_log_list_idx = f2fs_i->g2l_ep_map[g_active_ep_no];
+
+        ///< Please notice that g_ep_no is from 0 - 7,
+        ///< if >= NONE_EPOCH, it represents that this inode is not been checkin g_epoch
+        if (local_log_list_idx >= NONE_EPOCH)
+        {
+            is_checkin = 0;
+        }
+        if (local_log_list_idx >= 0 && local_log_list_idx < NONE_EPOCH)
+        {
+            is_checkin = 1;
+        }
+    }
+
+    return is_checkin;
+}
+
+int get_idle_local_epoch(struct f2fs_inode_info *f2fs_i)
+{
+    uint8_t i = 0;
+    for (i = 0; i < MAX_GLOBAL_EP_NUM; i++)
+    {
+        if (f2fs_i->j_ino_log_list[i].log_list_status == LOG_LIST_IDLE)
+        {
+            break;
+        }
+    }
+
+    if (i == MAX_GLOBAL_EP_NUM)
+    {
+        STATUS_LOG(STATUS_ERROR, "Every local epoch of ino[%lu] is not idle, need to wait checkpoint finish\n",
+                   f2fs_i->vfs_inode.i_ino);
+
+        /** Find again*/
+        for (i = 0; i < MAX_GLOBAL_EP_NUM; i++)
+        {
+            if (f2fs_i->j_ino_log_list[i].log_list_status == LOG_LIST_IDLE)
+            {
+                break;
+            }
+        }
+    }
+
+    return i;
+}
+
+int ino_checkin_global_epoch(struct f2fs_inode_info *f2fs_i)
+{
+    uint8_t g_active_ep_no = MAX_GLOBAL_EP_NUM;
+    uint8_t idle_local_ep_no = MAX_GLOBAL_EP_NUM;
+    struct list_head * g_cur_active_epoch = NULL;
+
+    ///< if this inode has not been added into global_ep
+    ///< Then need to add it into current running global epoch
+    ///< And also enable a local epoch to running
+    if (!is_already_checkin_g_epoch(f2fs_i, &g_active_ep_no, &g_cur_active_epoch))
+    {
+        ///< For debug
+        //if (f2fs_i->vfs_inode.i_ino == 10){STATUS_LOG(STATUS_INFO, "This ino-[%d] is firstly added into global epoch\n", f2fs_i->vfs_inode.i_ino);}
+
+        if (!g_cur_active_epoch || g_active_ep_no >= MAX_GLOBAL_EP_NUM)
+        {
+            STATUS_LOG(STATUS_ERROR, "get current active global epoch failed\n");
+            goto out;
+        }
+
+        /** enable inode local epoch, find an idle local epoch*/
+        idle_local_ep_no = get_idle_local_epoch(f2fs_i);
+        if (idle_local_ep_no >= MAX_GLOBAL_EP_NUM)
+        {
+            STATUS_LOG(STATUS_ERROR, "Didn't find an idle local epoch\n");
+        }
+        else
+        {
+            spin_lock(&f2fs_i->ino_spin_lock_local_ep);
+
+            f2fs_i->g2l_ep_map[g_active_ep_no] = idle_local_ep_no;
+            f2fs_i->j_ino_log_list[idle_local_ep_no].log_list_status = LOG_LIST_INUSE;
+            f2fs_i->j_local_active_epoch = idle_local_ep_no;
+            //INFO_REPORT("active local log list %d\n", idle_local_ep_no);
+
+            // insert inode into global epoch, should use [global_ep_idx] for register
+            ino_register_lock(g_active_ep_no);
+            list_add_tail(&f2fs_i->ino_regis_global_epoch_list[g_active_ep_no], g_cur_active_epoch);
+            ino_register_unlock(g_active_ep_no);
+            //INFO_REPORT("add ino %d into global epoch-[%d]\n", f2fs_i->vfs_inode.i_ino, g_active_ep_no);
+
+            spin_unlock(&f2fs_i->ino_spin_lock_local_ep);
+
+            if (trace_f2fsj_inode_checkin_enabled())
+            {
+                trace_f2fsj_inode_checkin(f2fs_i->vfs_inode.i_ino, get_cur_g_running_epoch()->epoch_seq,
+                                          g_active_ep_no, idle_local_ep_no);
+            }
+        }
+    }
+    else
+    {
+        ///< This inode is already in current running epoch, do nothing
+    }
+
+out:
+    return g_active_ep_no;
+}
+
+
+/**
+ * @brief insert [start_idx, end_idx] into a dirty range set, refer to j_dirty_range_set_t
+ *
+ */
+static void j_insert_dirty_range(j_dirty_range_set_t *set, pgoff_t start_idx, pgoff_t end_idx)
+{
+    j_dirty_range_t *r = set->ranges;
+    uint8_t i = 0, j = 0, merge_idx = 0;
+    pgoff_t gap = 0, min_gap = ULONG_MAX;
+
+    // skip ranges that end before the new one and do not touch it
+    while (i < set->nr_ranges && r[i].end_idx + 1 < start_idx)
+    {
+        i ++;
+    }
+
+    // absorb ranges that overlap or touch the new one
+    j = i;
+    while (j < set->nr_ranges && r[j].start_idx <= end_idx + 1)
+    {
+        start_idx = min_t(pgoff_t, start_idx, r[j].start_idx);
+        end_idx   = max_t(pgoff_t, end_idx, r[j].end_idx);
+        j ++;
+    }
+
+    if (j == i)
+    {
+        memmove(&r[i + 1], &r[i], (set->nr_ranges - i) * sizeof(j_dirty_range_t));
+        set->nr_ranges ++;
+    }
+    else if (j > i + 1)
+    {
+        memmove(&r[i + 1], &r[j], (set->nr_ranges - j) * sizeof(j_dirty_range_t));
+        set->nr_ranges -= j - i - 1;
+    }
+    r[i].start_idx = start_idx;
+    r[i].end_idx   = end_idx;
+
+    if (set->nr_ranges <= J_MAX_DIRTY_RANGES)
+    {
+        return;
+    }
+
+    // too many ranges, merge the two closest ones
+    for (i = 0; i + 1 < set->nr_ranges; i ++)
+    {
+        gap = r[i + 1].start_idx - r[i].end_idx;
+        if (gap < min_gap)
+        {
+            min_gap = gap;
+            merge_idx = i;
+        }
+    }
+    r[merge_idx].end_idx = r[merge_idx + 1].end_idx;
+    memmove(&r[merge_idx + 1], &r[merge_idx + 2], (set->nr_ranges - merge_idx - 2) * sizeof(j_dirty_range_t));
+    set->nr_ranges --;
+}
+
+/**
+ * @brief Check in the running epoch and return the local epoch for a new log with
+ *        ino_spin_lock_local_ep held. The ep switch lock is held until then, so the epoch
+ *        checked in can not be sealed and taken by commit before the log is in its local epoch
+ *
+ * @param f2fs_i
+ * @return uint8_t local epoch index, NONE_EPOCH (lock is not held) if no local epoch is running
+ */
+static uint8_t j_lock_running_local_epoch(struct f2fs_inode_info *f2fs_i)
+{
+    uint8_t local_ep_idx = NONE_EPOCH;
+
+    j_lock_running_epoch();
+    ino_checkin_global_epoch(f2fs_i);
+    spin_lock(&f2fs_i->ino_spin_lock_local_ep);
+    j_unlock_running_epoch();
+
+    local_ep_idx = f2fs_i->j_local_active_epoch;
+    if (local_ep_idx < MAX_GLOBAL_EP_NUM
+     && f2fs_i->j_ino_log_list[local_ep_idx].log_list_status == LOG_LIST_INUSE)
+    {
+        return local_ep_idx;
+    }
+    spin_unlock(&f2fs_i->ino_spin_lock_local_ep);
+
+    return NONE_EPOCH;
+}
+
+int j_record_dirty_data_range(struct f2fs_inode_info *f2fs_i, pgoff_t start_idx, pgoff_t end_idx)
+{
+    uint8_t local_ep_idx = NONE_EPOCH;
+    j_ino_local_epoch_t *local_ep = NULL;
+
+    local_ep_idx = j_lock_running_local_epoch(f2fs_i);
+    if (local_ep_idx >= MAX_GLOBAL_EP_NUM)
+    {
+        STATUS_LOG(STATUS_ERROR, "invalid epoch number, dirty data range of ino-[%lu] is not recorded\n",
+                   f2fs_i->vfs_inode.i_ino);
+        return F2FSJ_ERROR;
+    }
+
+    local_ep = &f2fs_i->j_ino_log_list[local_ep_idx];
+    j_insert_dirty_range(&local_ep->dirty_data_ranges, start_idx, end_idx);
+    spin_unlock(&f2fs_i->ino_spin_lock_local_ep);
+
+    return F2FSJ_OK;
+}
+
+void j_fetch_dirty_data_ranges(struct f2fs_inode_info *f2fs_i, uint8_t local_ep_idx, j_dirty_range_set_t *ranges)
+{
+    j_dirty_range_set_t *ep_ranges = &f2fs_i->j_ino_log_list[local_ep_idx].dirty_data_ranges;
+
+    spin_lock(&f2fs_i->ino_spin_lock_local_ep);
+    memcpy(ranges, ep_ranges, sizeof(j_dirty_range_set_t));
+    ep_ranges->nr_ranges = 0;
+    spin_unlock(&f2fs_i->ino_spin_lock_local_ep);
+}
+
+int insert_log_into_inode(struct f2fs_inode_info *f2fs_i, j_log_entry_t *j_log_entry)
+{
+    struct list_head *inode_log_list = NULL;
+    uint8_t ino_active_log_list_idx = MAX_GLOBAL_EP_NUM;
+    uint64_t start_ns = j_op_lat_now();
+
+    /** Firstly, check this inode is already checkin current running epoch*/
+    ino_active_log_list_idx = j_lock_running_local_epoch(f2fs_i);
+    if (ino_active_log_list_idx >= MAX_GLOBAL_EP_NUM)
+    {
+        STATUS_LOG(STATUS_ERROR, "invalid epoch number, fatal error, please check\n");
+        return F2FSJ_ERROR;
+    }
+
+    //INFO_REPORT("local inode active log list is %d\n", ino_active_log_list_idx);
+
+    inode_log_list = &(f2fs_i->j_ino_log_list[ino_active_log_list_idx].inode_log_list_head);
+
+    // for debug
+#if 0
+    if (list_empty(inode_log_list))
+    {
+        INFO_REPORT("Empty ino log list first insert log\n");
+    }
+#endif
+
+    // insert log into inode, commit takes the list only after it is not INUSE
+    list_add_tail(&j_log_entry->log_node, inode_log_list);
+    spin_unlock(&f2fs_i->ino_spin_lock_local_ep);
+    trace_f2fsj_insert_log(f2fs_i->vfs_inode.i_ino, ino_active_log_list_idx,
+                           ((j_log_head_t *)j_log_entry->log_entry_addr)->log_type,
+                           ((j_log_head_t *)j_log_entry->log_entry_addr)->log_size,
+                           j_log_entry->log_entry_idx);
+    j_op_lat_log_phase(j_log_entry->log_type, J_OP_PHASE_INSERT, start_ns);
+
+    return F2FSJ_OK;
+}
+
+
+int aggregate_per_ino_log(struct f2fs_inode_info *f2fs_i, j_checkpoint_list_t *cp_info_list_head, uint8_t global_ep_idx, uint8_t local_log_list_idx)
+{
+    // head node
+    struct list_head * log_list_head = NULL;
+
+    // delta log
+    j_log_entry_t * ino_log_entry = NULL;
+    j_log_entry_t * ino_log_entry_next  = NULL;
+
+    if (f2fs_i)
+    {
+        // find list head for each log list type
+        if (local_log_list_idx >= MAX_GLOBAL_EP_NUM)
+        {
+            /* not enable log list*/
+            INFO_REPORT("not enable log list\n");
+            return 0;
+        }
+        log_list_head = &(f2fs_i->j_ino_log_list[local_log_list_idx].inode_log_list_head);
+    }
+    else
+    {
+        return 0;
+    }
+
+
+    // firstly, iterate log list
+    if (list_empty(log_list_head))
+    {
+        INFO_REPORT("ino-[%lu] log list-[%d] is empty, cur inode active log list is-[%d]\n",
+                     f2fs_i->vfs_inode.i_ino, local_log_list_idx, f2fs_i->j_local_active_epoch);
+        goto out;
+    }
+
+    list_for_each_entry_safe(ino_log_entry, ino_log_entry_next, log_list_head, log_node)
+    {
+        if (ino_log_entry)
+        {
+            //INFO_REPORT("log entry in inode, addr is %p\n", ino_log_entry);
+
+            // get cp_info here
+            get_cp_info_from_log(f2fs_i, cp_info_list_head, ino_log_entry);
+
+            // delte this log from ino_log_list
+            list_del(&ino_log_entry->log_node);
+
+            // free log_entry_info
+            j_free_log_entry(ino_log_entry);
+        }
+        else
+        {
+            INFO_REPORT("log_entry_info in inode is NULL, pls check\n");
+            break;
+        }
+    }
+
+out:
+
+    // delete this inode from epoch
+    list_del(&f2fs_i->ino_regis_global_epoch_list[global_ep_idx]);
+
+    return STILL_REMAIN_SPACE;
+}
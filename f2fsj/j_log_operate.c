@@ -1,7 +1,7 @@
 /**
  * @file j_log_operate.c
  * @author leslie.cui (10033908@github.com)
- * @brief This file contains some log list operations, such as insert, iterate...
+ * @brief This file builds logs of file operations and meta deltas, log lists are in j_log_list.c
  * @version 0.1
  * @date 2023-09
  * 
@@ -9,127 +9,63 @@
  * 
  */
 #include <linux/pagemap.h>
+#include <linux/crc32.h>
 #include "j_log_operate.h"
 #include "j_epoch.h"
+#include "j_op_lat.h"
+#include "j_stats.h"
+#include "j_trace.h"
 #include "node.h"
 #include "segment.h"
 
-int is_already_checkin_g_epoch(struct f2fs_inode_info *f2fs_i, uint8_t * ep_no, struct list_head ** g_ep_head)
+int j_record_data_write(struct f2fs_inode_info *f2fs_i, struct page *page, uint32_t ofs, uint32_t len)
 {
-    uint8_t g_active_ep_no = NONE_EPOCH;
-    struct list_head * g_cur_active_epoch = NULL;
+    struct inode *inode = &f2fs_i->vfs_inode;
+    j_log_entry_t *log_entry = NULL;
+    data_journal_log_t dj_log = {0};
+    uint8_t *kaddr = NULL;
 
-    uint8_t is_checkin = 0;
-    uint8_t local_log_list_idx = NONE_EPOCH;
-
-    get_global_epoch(&g_active_ep_no, &g_cur_active_epoch);
-    * ep_no = g_active_ep_no;
-    * g_ep_head = g_cur_active_epoch;
-    if (!g_cur_active_epoch || g_active_ep_no >= NONE_EPOCH)
-    {
-        STATUS_LOG(STATUS_ERROR, "get global active epoch error\n");
-        is_checkin = 0;
-    }
-    else
-    {
-        local_log_list_idx = f2fs_i->g2l_ep_map[g_active_ep_no];
-
-        ///< Please notice that g_ep_no is from 0 - 7,
-        ///< if >= NONE_EPOCH, it represents that this inode is not been checkin g_epoch
-        if (local_log_list_idx >= NONE_EPOCH)
-        {
-            is_checkin = 0;
-        }
-        if (local_log_list_idx >= 0 && local_log_list_idx < NONE_EPOCH)
-        {
-            is_checkin = 1;
-        }
-    }
-
-    return is_checkin;
-}
-
-int get_idle_local_epoch(struct f2fs_inode_info *f2fs_i)
-{
-    uint8_t i = 0;
-    for (i = 0; i < MAX_GLOBAL_EP_NUM; i++)
+    if (!f2fsj_data_journal_file(inode) || len > F2FS_I_SB(inode)->j_data_journal_max_bytes
+     || ofs + len > PAGE_SIZE)
     {
-        if (f2fs_i->j_ino_log_list[i].log_list_status == LOG_LIST_IDLE)
-        {
-            break;
-        }
+        goto ordered;
     }
 
-    if (i == MAX_GLOBAL_EP_NUM)
+    dj_log.nr_data_slots = DIV_ROUND_UP(len, J_LOG_ENTRY_SIZE);
+    if (j_alloc_log_entries(DATA_JOURNAL_LOG, dj_log.nr_data_slots + 1, &log_entry) != F2FSJ_OK)
     {
-        STATUS_LOG(STATUS_ERROR, "Every local epoch of ino[%d] is not idle, need to wait checkpoint finish\n");
-
-        /** Find again*/
-        for (i = 0; i < MAX_GLOBAL_EP_NUM; i++)
-        {
-            if (f2fs_i->j_ino_log_list[i].log_list_status == LOG_LIST_IDLE)
-            {
-                break;
-            }
-        }
+        goto ordered;
     }
 
-    return i;
-}
-
-int ino_checkin_global_epoch(struct f2fs_inode_info *f2fs_i)
-{
-    uint8_t g_active_ep_no = MAX_GLOBAL_EP_NUM;
-    uint8_t idle_local_ep_no = MAX_GLOBAL_EP_NUM;
-    struct list_head * g_cur_active_epoch = NULL;
-
-    ///< if this inode has not been added into global_ep
-    ///< Then need to add it into current running global epoch
-    ///< And also enable a local epoch to running
-    if (!is_already_checkin_g_epoch(f2fs_i, &g_active_ep_no, &g_cur_active_epoch))
-    {
-        ///< For debug
-        //if (f2fs_i->vfs_inode.i_ino == 10){STATUS_LOG(STATUS_INFO, "This ino-[%d] is firstly added into global epoch\n", f2fs_i->vfs_inode.i_ino);}
-
-        if (!g_cur_active_epoch || g_active_ep_no >= MAX_GLOBAL_EP_NUM)
-        {
-            STATUS_LOG(STATUS_ERROR, "get current active global epoch failed\n");
-            goto out;
-        }
-
-        /** enable inode local epoch, find an idle local epoch*/
-        idle_local_ep_no = get_idle_local_epoch(f2fs_i);
-        if (idle_local_ep_no >= MAX_GLOBAL_EP_NUM)
-        {
-            STATUS_LOG(STATUS_ERROR, "Didn't find an idle local epoch\n");
-        }
-        else
-        {
-            spin_lock(&f2fs_i->ino_spin_lock_local_ep);
+    dj_log.log_header.log_type = DATA_JOURNAL_LOG;
+    dj_log.log_header.log_size = (dj_log.nr_data_slots + 1) * J_LOG_ENTRY_SIZE;
+    dj_log.ino_num   = inode->i_ino;
+    dj_log.page_idx  = page->index;
+    dj_log.data_ofs  = ofs;
+    dj_log.data_len  = len;
+    dj_log.file_size = i_size_read(inode);
 
-            f2fs_i->g2l_ep_map[g_active_ep_no] = idle_local_ep_no;
-            f2fs_i->j_ino_log_list[idle_local_ep_no].log_list_status = LOG_LIST_INUSE;
-            f2fs_i->j_local_active_epoch = idle_local_ep_no;
-            //INFO_REPORT("active local log list %d\n", idle_local_ep_no);
+    // page is locked, its bytes cannot change while being copied
+    kaddr = kmap_atomic(page);
+    dj_log.data_crc = crc32_le(~0, kaddr + ofs, len);
+    j_copy_to_log_entries(log_entry, 1, kaddr + ofs, len);
+    kunmap_atomic(kaddr);
 
-            // insert inode into global epoch, should use [global_ep_idx] for register
-            ino_register_lock(g_active_ep_no);
-            list_add_tail(&f2fs_i->ino_regis_global_epoch_list[g_active_ep_no], g_cur_active_epoch);
-            ino_register_unlock(g_active_ep_no);
-            //INFO_REPORT("add ino %d into global epoch-[%d]\n", f2fs_i->vfs_inode.i_ino, g_active_ep_no);
+    j_copy_to_log_entries(log_entry, 0, (uint8_t *)&dj_log, sizeof(data_journal_log_t));
 
-            spin_unlock(&f2fs_i->ino_spin_lock_local_ep);
-        }
-    }
-    else
+    if (insert_log_into_inode(f2fs_i, log_entry) != F2FSJ_OK)
     {
-        ///< This inode is already in current running epoch, do nothing
+        // the log is never committed, write the page back instead
+        j_free_log_entry(log_entry);
+        goto ordered;
     }
 
-out:
-    return g_active_ep_no;
-}
+    return F2FSJ_OK;
 
+ordered:
+    f2fsj_mark_unjournaled(inode);
+    return j_record_dirty_data_range(f2fs_i, page->index, page->index);
+}
 
 int get_inode_log_from_f2fs_inode(struct f2fs_sb_info *sbi, 
                                       struct f2fs_inode_info *f2fs_i,
@@ -246,112 +182,569 @@ int get_delete_log_from_f2fs_inode(struct f2fs_sb_info *sbi, struct f2fs_inode_i
 }
 
 
-int insert_log_into_inode(struct f2fs_inode_info *f2fs_i, j_log_entry_t *j_log_entry)
+/**
+ * @brief one variable size log (namespace, xattr, meta delta) takes one log entry for its fixed part,
+ *        names, symlink target, xattr value or deltas follow it from the second log entry.
+ *        Log is built in a temporary buffer cause journal pages are not virtually continuous
+ */
+static int j_insert_variable_log(struct f2fs_inode_info *f2fs_i, j_log_head_t *log, uint32_t log_len,
+                                  const uint8_t *payload0, uint32_t len0,
+                                  const uint8_t *payload1, uint32_t len1)
 {
-    struct list_head *inode_log_list = NULL;
-    uint8_t ino_active_log_list_idx = MAX_GLOBAL_EP_NUM;
+    j_log_entry_t *log_entry = NULL;
+    uint32_t total_len = J_LOG_ENTRY_SIZE + len0 + len1;
+    uint32_t nr_entries = DIV_ROUND_UP(total_len, J_LOG_ENTRY_SIZE);
+    uint8_t *buf = NULL;
 
-    /** Firstly, check this inode is already checkin current running epoch*/
-    ino_checkin_global_epoch(f2fs_i);
+    if (log_len > J_LOG_ENTRY_SIZE || nr_entries > J_LOG_ENTRY_PER_BLOCK + 1)
+    {
+        return F2FSJ_ERROR;
+    }
 
-    ino_active_log_list_idx = f2fs_i->j_local_active_epoch;
-    if (ino_active_log_list_idx >= MAX_GLOBAL_EP_NUM)
+    buf = kzalloc(total_len, GFP_NOFS);
+    if (!buf)
     {
-        STATUS_LOG(STATUS_ERROR, "invalid epoch number, fatal error, please check\n");
         return F2FSJ_ERROR;
     }
 
-    if (f2fs_i->j_ino_log_list[ino_active_log_list_idx].log_list_status != LOG_LIST_INUSE)
+    log->log_size = nr_entries * J_LOG_ENTRY_SIZE;
+    memcpy(buf, log, log_len);
+    memcpy(buf + J_LOG_ENTRY_SIZE, payload0, len0);
+    memcpy(buf + J_LOG_ENTRY_SIZE + len0, payload1, len1);
+
+    if (j_alloc_log_entries(log->log_type, nr_entries, &log_entry) != F2FSJ_OK)
     {
-        STATUS_LOG(STATUS_ERROR, "inode local epoch status is not running, pls check ep status switch\n");
+        kfree(buf);
         return F2FSJ_ERROR;
     }
 
-    //INFO_REPORT("local inode active log list is %d\n", ino_active_log_list_idx);
+    j_copy_to_log_entries(log_entry, 0, buf, total_len);
+    kfree(buf);
 
-    inode_log_list = &(f2fs_i->j_ino_log_list[ino_active_log_list_idx].inode_log_list_head);
-    if (inode_log_list == NULL)
+    // log of no inode is committed with the epoch, only entries in journal file are kept
+    if (!f2fs_i)
     {
-        STATUS_LOG(STATUS_ERROR, "NULL list, fatal error");
+        j_free_log_entry(log_entry);
+        return F2FSJ_OK;
+    }
+
+    if (insert_log_into_inode(f2fs_i, log_entry) != F2FSJ_OK)
+    {
+        // entries stay in journal file and are replayed, caller still checkpoints for dirsync
+        j_free_log_entry(log_entry);
         return F2FSJ_ERROR;
     }
 
-    // for debug
-#if 0
-    if (list_empty(inode_log_list))
+    return F2FSJ_OK;
+}
+
+/**
+ * @brief name in encrypted directory cannot be replayed without the key
+ */
+static inline int j_namespace_log_supported(struct inode *dir)
+{
+    return !IS_ENCRYPTED(dir);
+}
+
+int j_log_link(struct inode *dir, struct inode *inode, const struct qstr *name)
+{
+    link_log_t link_log;
+
+    if (!j_namespace_log_supported(dir))
     {
-        INFO_REPORT("Empty ino log list first insert log\n");
+        return F2FSJ_ERROR;
     }
-#endif
 
-    // insert log into inode
-    list_add_tail(&j_log_entry->log_node, inode_log_list);
+    memset(&link_log, 0, sizeof(link_log_t));
+    link_log.log_header.log_type = LINK_LOG;
+    link_log.ino_num    = inode->i_ino;
+    link_log.parent_ino = dir->i_ino;
+    link_log.ino_nlink  = inode->i_nlink;
+    link_log.i_mode     = inode->i_mode;
+    link_log.name_len   = name->len;
+
+    return j_insert_variable_log(F2FS_I(inode), &link_log.log_header, sizeof(link_log_t),
+                                  name->name, name->len, NULL, 0);
 }
 
+int j_log_symlink(struct inode *dir, struct inode *inode, const struct qstr *name,
+                  const uint8_t *target, uint32_t target_len)
+{
+    create_log_t symlink_log;
+
+    if (!j_namespace_log_supported(dir) || IS_ENCRYPTED(inode))
+    {
+        return F2FSJ_ERROR;
+    }
+
+    // symlink_log_t is laid out as create_log_t, the new inode log is shared
+    memset(&symlink_log, 0, sizeof(create_log_t));
+    get_inode_log_from_f2fs_inode(F2FS_I_SB(inode), F2FS_I(inode), (char *)name->name, &symlink_log);
+    symlink_log.log_header.log_type = SYMLINK_LOG;
+    symlink_log.j_new_ino_log.i_namelen = cpu_to_le32(name->len);
+    symlink_log.j_new_ino_log.i_size = cpu_to_le64(target_len);
 
-int aggregate_per_ino_log(struct f2fs_inode_info *f2fs_i, j_checkpoint_list_t *cp_info_list_head, uint8_t global_ep_idx, uint8_t local_log_list_idx)
+    return j_insert_variable_log(F2FS_I(inode), &symlink_log.log_header, sizeof(create_log_t),
+                                  name->name, name->len, target, target_len);
+}
+
+int j_log_rename(struct inode *old_dir, const struct qstr *old_name,
+                 struct inode *new_dir, const struct qstr *new_name,
+                 struct inode *inode, struct inode *target, nid_t whiteout_ino, uint32_t flags)
 {
-    // head node
-    struct list_head * log_list_head = NULL;
+    rename_log_t rename_log;
+
+    if (!j_namespace_log_supported(old_dir) || !j_namespace_log_supported(new_dir))
+    {
+        return F2FSJ_ERROR;
+    }
+
+    memset(&rename_log, 0, sizeof(rename_log_t));
+    rename_log.log_header.log_type = RENAME_LOG;
+    rename_log.ino_num        = inode->i_ino;
+    rename_log.old_parent_ino = old_dir->i_ino;
+    rename_log.new_parent_ino = new_dir->i_ino;
+    rename_log.i_mode         = inode->i_mode;
+    if (target)
+    {
+        rename_log.target_ino   = target->i_ino;
+        rename_log.target_nlink = target->i_nlink;
+        rename_log.target_mode  = target->i_mode;
+    }
+    rename_log.whiteout_ino   = whiteout_ino;
+    rename_log.old_name_len   = old_name->len;
+    rename_log.new_name_len   = new_name->len;
+    rename_log.flags          = flags;
 
-    // delta log
-    j_log_entry_t * ino_log_entry = NULL;
-    j_log_entry_t * ino_log_entry_next  = NULL;
-    uint8_t ino_log_list_idx = 0;
+    return j_insert_variable_log(F2FS_I(inode), &rename_log.log_header, sizeof(rename_log_t),
+                                  old_name->name, old_name->len, new_name->name, new_name->len);
+}
 
-    if (f2fs_i)
+int j_log_xattr(struct inode *inode, int index, const char *name, size_t name_len,
+                const void *value, size_t value_len)
+{
+    xattr_log_t xattr_log;
+
+    memset(&xattr_log, 0, sizeof(xattr_log_t));
+    xattr_log.log_header.log_type = XATTR_LOG;
+    xattr_log.ino_num    = inode->i_ino;
+    xattr_log.xattr_nid  = F2FS_I(inode)->i_xattr_nid;
+    xattr_log.i_mode     = is_inode_flag_set(inode, FI_ACL_MODE) ?
+                                F2FS_I(inode)->i_acl_mode : inode->i_mode;
+    xattr_log.name_index = index;
+    xattr_log.name_len   = name_len;
+    if (value)
     {
-        // find list head for each log list type
-        if (local_log_list_idx >= MAX_GLOBAL_EP_NUM)
-        {
-            /* not enable log list*/
-            INFO_REPORT("not enable log list\n");
-            return 0;
-        }
-        log_list_head = &(f2fs_i->j_ino_log_list[local_log_list_idx].inode_log_list_head);
+        xattr_log.value_len = value_len;
     }
     else
     {
-        return 0;
+        xattr_log.flags = J_XATTR_REMOVE;
+        value_len = 0;
     }
 
+    return j_insert_variable_log(F2FS_I(inode), &xattr_log.log_header, sizeof(xattr_log_t),
+                                 (const uint8_t *)name, name_len, value, value_len);
+}
 
-    // firstly, iterate log list
-    if (list_empty(log_list_head))
+int j_log_range(struct inode *inode, log_type_e log_type, int mode, loff_t old_size,
+                loff_t offset, loff_t len)
+{
+    j_log_entry_t *log_entry = NULL;
+    range_log_t range_log;
+
+    if (j_alloc_log_entry(log_type, &log_entry) != F2FSJ_OK)
+    {
+        return F2FSJ_ERROR;
+    }
+
+    memset(&range_log, 0, sizeof(range_log_t));
+    range_log.log_header.log_type = log_type;
+    range_log.log_header.log_size = J_LOG_ENTRY_SIZE;
+    range_log.ino_num  = inode->i_ino;
+    range_log.mode     = mode;
+    range_log.old_size = old_size;
+    range_log.new_size = i_size_read(inode);
+    range_log.offset   = offset;
+    range_log.len      = len;
+    memcpy(log_entry->log_entry_addr, &range_log, sizeof(range_log_t));
+
+    if (insert_log_into_inode(F2FS_I(inode), log_entry) != F2FSJ_OK)
+    {
+        j_free_log_entry(log_entry);
+        return F2FSJ_ERROR;
+    }
+
+    return F2FSJ_OK;
+}
+
+int j_log_orphan(nid_t ino, uint32_t flags)
+{
+    j_log_entry_t *log_entry = NULL;
+    orphan_log_t orphan_log;
+
+    if (j_alloc_log_entry(ORPHAN_LOG, &log_entry) != F2FSJ_OK)
+    {
+        return F2FSJ_ERROR;
+    }
+
+    memset(&orphan_log, 0, sizeof(orphan_log_t));
+    orphan_log.log_header.log_type = ORPHAN_LOG;
+    orphan_log.log_header.log_size = J_LOG_ENTRY_SIZE;
+    orphan_log.ino_num = ino;
+    orphan_log.flags   = flags;
+    memcpy(log_entry->log_entry_addr, &orphan_log, sizeof(orphan_log_t));
+
+    // log is already in mapped journal and committed with the epoch, orphan inode may be
+    // freed before that, so it is not inserted into inode log list
+    j_free_log_entry(log_entry);
+
+    return F2FSJ_OK;
+}
+
+///< a chunk takes one page, its deltas fit in one META_DELTA_LOG
+#define J_META_DELTAS_PER_CHUNK ((PAGE_SIZE - sizeof(struct list_head) - sizeof(uint32_t) - sizeof(uint64_t)) \
+                                / sizeof(j_meta_delta_t))
+
+///< deltas of one META_DELTA_LOG, chunks grow with the deltas of an epoch and are logged in order
+typedef struct __j_meta_delta_chunk
+{
+    struct list_head list;
+    uint32_t nr_deltas;
+    uint64_t cp_ver;    ///< deltas of one chunk are made after the same checkpoint
+    j_meta_delta_t deltas[J_META_DELTAS_PER_CHUNK];
+}j_meta_delta_chunk_t;
+
+///< NAT/SIT/SSA deltas made since last commit
+static struct
+{
+    spinlock_t lock;
+    struct list_head chunks;
+    uint32_t flags;     ///< J_META_DELTA_LOST once a chunk cannot be allocated
+    bool lost_since_cp; ///< replay stops at the first hole, so deltas are useless till checkpoint
+    uint64_t cp_ver;    ///< version of the last checkpoint, stamped on deltas recorded from now on
+
+    ///< holes not logged yet, recording stops at a hole so chunks after the first one are newer
+    uint64_t lost_first_cp_ver;
+    uint64_t lost_last_cp_ver;
+}g_meta_delta_buf = {
+    .lock   = __SPIN_LOCK_UNLOCKED(g_meta_delta_buf.lock),
+    .chunks = LIST_HEAD_INIT(g_meta_delta_buf.chunks),
+};
+
+/**
+ * @brief deltas are made under f2fs locks (nat_tree_lock, sentry_lock, curseg_mutex),
+ *        only appended here and logged by epoch commit. A new chunk is allocated out of
+ *        the spinlock, which only covers the append
+ */
+static void j_record_meta_delta(j_meta_delta_t *delta)
+{
+    j_meta_delta_chunk_t *chunk = NULL;
+    j_meta_delta_chunk_t *new_chunk = NULL;
+
+    // nothing recorded after a hole is replayed
+    if (READ_ONCE(g_meta_delta_buf.lost_since_cp))
     {
-        INFO_REPORT("ino-[%d] log list-[%d] is empty, cur inode active log list is-[%d]\n",
-                     f2fs_i->vfs_inode.i_ino, ino_log_list_idx, ino_log_list_idx, f2fs_i->j_local_active_epoch);
-        goto out;
+        return;
     }
 
-    list_for_each_entry_safe(ino_log_entry, ino_log_entry_next, log_list_head, log_node)
+    while (1)
     {
-        if (ino_log_entry)
+        j_stat_spin_lock(&g_meta_delta_buf.lock, J_STAT_LOCK_META_DELTA);
+        chunk = list_empty(&g_meta_delta_buf.chunks) ? NULL
+              : list_last_entry(&g_meta_delta_buf.chunks, j_meta_delta_chunk_t, list);
+        if (!chunk || chunk->nr_deltas == J_META_DELTAS_PER_CHUNK || chunk->cp_ver != g_meta_delta_buf.cp_ver)
+        {
+            chunk = new_chunk;
+            new_chunk = NULL;
+            if (chunk)
+            {
+                chunk->cp_ver = g_meta_delta_buf.cp_ver;
+                list_add_tail(&chunk->list, &g_meta_delta_buf.chunks);
+            }
+        }
+        if (chunk)
         {
-            //INFO_REPORT("log entry in inode, addr is %p\n", ino_log_entry);
+            chunk->deltas[chunk->nr_deltas++] = *delta;
+            j_stat_spin_unlock(&g_meta_delta_buf.lock, J_STAT_LOCK_META_DELTA);
+            break;
+        }
+        j_stat_spin_unlock(&g_meta_delta_buf.lock, J_STAT_LOCK_META_DELTA);
 
-            // get cp_info here
-            get_cp_info_from_log(f2fs_i, cp_info_list_head, ino_log_entry);
+        new_chunk = kmalloc(sizeof(j_meta_delta_chunk_t), GFP_NOFS);
+        if (!new_chunk)
+        {
+            // logged deltas are still replayed, the hole is logged after them
+            j_stat_spin_lock(&g_meta_delta_buf.lock, J_STAT_LOCK_META_DELTA);
+            if (!(g_meta_delta_buf.flags & J_META_DELTA_LOST))
+            {
+                g_meta_delta_buf.lost_first_cp_ver = g_meta_delta_buf.cp_ver;
+            }
+            g_meta_delta_buf.lost_last_cp_ver = g_meta_delta_buf.cp_ver;
+            g_meta_delta_buf.flags |= J_META_DELTA_LOST;
+            g_meta_delta_buf.lost_since_cp = true;
+            j_stat_spin_unlock(&g_meta_delta_buf.lock, J_STAT_LOCK_META_DELTA);
+            return;
+        }
+        new_chunk->nr_deltas = 0;
+    }
 
-            // delte this log from ino_log_list
-            list_del(&ino_log_entry->log_node);
+    // another recorder added a chunk meanwhile
+    kfree(new_chunk);
+}
 
-            // free log_entry_info
-            j_free_log_entry(ino_log_entry);
+void j_record_nat_delta(nid_t nid, nid_t ino, block_t blkaddr, unsigned char version)
+{
+    j_meta_delta_t delta = {
+        .delta_type = J_DELTA_NAT,
+        .version    = version,
+    };
+
+    delta.nat.j_nid      = nid;
+    delta.nat.j_ino      = ino;
+    delta.nat.j_node_lba = blkaddr;
+    j_record_meta_delta(&delta);
+}
+
+void j_record_sit_delta(unsigned int segno, unsigned int blkofs, int del, unsigned int valid_blocks)
+{
+    j_meta_delta_t delta = {
+        .delta_type = J_DELTA_SIT,
+    };
+
+    delta.sit.segno            = segno;
+    delta.sit.blkofs           = blkofs;
+    delta.sit.valid_delta      = del;
+    delta.sit.j_nr_valid_block = valid_blocks;
+    j_record_meta_delta(&delta);
+}
+
+void j_record_ssa_delta(unsigned int segno, unsigned int blkofs, struct f2fs_summary *sum)
+{
+    j_meta_delta_t delta = {
+        .delta_type = J_DELTA_SSA,
+        .version    = sum->version,
+    };
+
+    delta.ssa.segno       = segno;
+    delta.ssa.blkofs      = blkofs;
+    delta.ssa.ofs_in_node = le16_to_cpu(sum->ofs_in_node);
+    delta.ssa.j_nid       = le32_to_cpu(sum->nid);
+    j_record_meta_delta(&delta);
+}
+
+void j_record_gc_move(nid_t nid, unsigned int ofs_in_node, block_t old_blkaddr, block_t new_blkaddr)
+{
+    j_meta_delta_t delta = {
+        .delta_type  = J_DELTA_GC_MOVE,
+        .ofs_in_node = ofs_in_node,
+    };
+
+    delta.move.j_nid       = nid;
+    delta.move.old_blkaddr = old_blkaddr;
+    delta.move.new_blkaddr = new_blkaddr;
+    j_record_meta_delta(&delta);
+}
+
+void j_meta_deltas_new_checkpoint(uint64_t cp_ver)
+{
+    // deltas recorded so far are still logged, replay skips them if the checkpoint is written
+    j_stat_spin_lock(&g_meta_delta_buf.lock, J_STAT_LOCK_META_DELTA);
+    g_meta_delta_buf.cp_ver = cp_ver;
+    WRITE_ONCE(g_meta_delta_buf.lost_since_cp, false);
+    j_stat_spin_unlock(&g_meta_delta_buf.lock, J_STAT_LOCK_META_DELTA);
+}
+
+bool j_meta_deltas_replayable(void)
+{
+    return !READ_ONCE(g_meta_delta_buf.lost_since_cp);
+}
+
+/**
+ * @brief Log the holes of dropped deltas as one, replay stops at it unless the checkpoint it
+ *        starts from is newer than cp_ver of the last hole
+ */
+static int j_log_meta_delta_lost(uint32_t flags, uint64_t cp_ver)
+{
+    meta_delta_log_t delta_log;
+
+    memset(&delta_log, 0, sizeof(meta_delta_log_t));
+    delta_log.log_header.log_type = META_DELTA_LOG;
+    delta_log.flags  = flags;
+    delta_log.cp_ver = cp_ver;
+    return j_insert_variable_log(NULL, &delta_log.log_header, sizeof(meta_delta_log_t), NULL, 0, NULL, 0);
+}
+
+int j_log_meta_deltas(void)
+{
+    meta_delta_log_t delta_log;
+    j_meta_delta_chunk_t *chunk = NULL;
+    j_meta_delta_chunk_t *chunk_next = NULL;
+    LIST_HEAD(chunks);
+    uint32_t flags = 0;
+    uint64_t lost_first_cp_ver = 0;
+    uint64_t lost_last_cp_ver = 0;
+    int ret = F2FSJ_OK;
+
+    // take all chunks at once, recorders go on with new ones
+    j_stat_spin_lock(&g_meta_delta_buf.lock, J_STAT_LOCK_META_DELTA);
+    list_splice_init(&g_meta_delta_buf.chunks, &chunks);
+    flags = g_meta_delta_buf.flags;
+    lost_first_cp_ver = g_meta_delta_buf.lost_first_cp_ver;
+    lost_last_cp_ver  = g_meta_delta_buf.lost_last_cp_ver;
+    g_meta_delta_buf.flags = 0;
+    j_stat_spin_unlock(&g_meta_delta_buf.lock, J_STAT_LOCK_META_DELTA);
+
+    list_for_each_entry_safe(chunk, chunk_next, &chunks, list)
+    {
+        // recording stopped at the first hole until the next checkpoint, newer deltas follow it
+        if ((flags & J_META_DELTA_LOST) && chunk->cp_ver > lost_first_cp_ver)
+        {
+            if (j_log_meta_delta_lost(flags, lost_last_cp_ver) != F2FSJ_OK)
+            {
+                ret = F2FSJ_ERROR;
+                break;
+            }
+            flags = 0;
         }
-        else
+
+        memset(&delta_log, 0, sizeof(meta_delta_log_t));
+        delta_log.log_header.log_type = META_DELTA_LOG;
+        delta_log.nr_deltas = chunk->nr_deltas;
+        delta_log.cp_ver    = chunk->cp_ver;
+        if (j_insert_variable_log(NULL, &delta_log.log_header, sizeof(meta_delta_log_t),
+                                  (uint8_t *)chunk->deltas, chunk->nr_deltas * sizeof(j_meta_delta_t),
+                                  NULL, 0) != F2FSJ_OK)
         {
-            INFO_REPORT("log_entry_info in inode is NULL, pls check\n");
+            ret = F2FSJ_ERROR;
             break;
         }
+        list_del(&chunk->list);
+        kfree(chunk);
     }
 
-out:
+    if (ret == F2FSJ_OK && (flags & J_META_DELTA_LOST))
+    {
+        if (j_log_meta_delta_lost(flags, lost_last_cp_ver) != F2FSJ_OK)
+        {
+            ret = F2FSJ_ERROR;
+        }
+        else
+        {
+            flags = 0;
+        }
+    }
 
-    // delete this inode from epoch
-    list_del(&f2fs_i->ino_regis_global_epoch_list[global_ep_idx]);
+    if (ret != F2FSJ_OK)
+    {
+        // deltas not logged go back before the ones recorded since, next commit logs them in order
+        j_stat_spin_lock(&g_meta_delta_buf.lock, J_STAT_LOCK_META_DELTA);
+        list_splice(&chunks, &g_meta_delta_buf.chunks);
+        if ((flags & J_META_DELTA_LOST) && !(g_meta_delta_buf.flags & J_META_DELTA_LOST))
+        {
+            g_meta_delta_buf.lost_last_cp_ver = lost_last_cp_ver;
+        }
+        if (flags & J_META_DELTA_LOST)
+        {
+            g_meta_delta_buf.lost_first_cp_ver = lost_first_cp_ver;
+        }
+        g_meta_delta_buf.flags |= flags;
+        j_stat_spin_unlock(&g_meta_delta_buf.lock, J_STAT_LOCK_META_DELTA);
+    }
+
+    return ret;
+}
+
+int j_log_setattr(struct inode *inode, unsigned int ia_valid)
+{
+    j_log_entry_t *log_entry = NULL;
+    chown_log_t chown_log;
+
+    if (j_alloc_log_entry(CHOWN_LOG, &log_entry) != F2FSJ_OK)
+    {
+        return F2FSJ_ERROR;
+    }
+
+    memset(&chown_log, 0, sizeof(chown_log_t));
+    chown_log.log_header.log_type = CHOWN_LOG;
+    chown_log.log_header.log_size = J_LOG_ENTRY_SIZE;
+    chown_log.ino_num      = inode->i_ino;
+    chown_log.ia_valid     = ia_valid;
+    chown_log.i_uid        = i_uid_read(inode);
+    chown_log.i_gid        = i_gid_read(inode);
+    chown_log.i_mode       = inode->i_mode;
+    chown_log.i_size       = i_size_read(inode);
+    chown_log.i_atime      = inode->i_atime.tv_sec;
+    chown_log.i_ctime      = inode->i_ctime.tv_sec;
+    chown_log.i_mtime      = inode->i_mtime.tv_sec;
+    chown_log.i_atime_nsec = inode->i_atime.tv_nsec;
+    chown_log.i_ctime_nsec = inode->i_ctime.tv_nsec;
+    chown_log.i_mtime_nsec = inode->i_mtime.tv_nsec;
+    memcpy(log_entry->log_entry_addr, &chown_log, sizeof(chown_log_t));
+
+    if (insert_log_into_inode(F2FS_I(inode), log_entry) != F2FSJ_OK)
+    {
+        j_free_log_entry(log_entry);
+        return F2FSJ_ERROR;
+    }
+
+    return F2FSJ_OK;
+}
+
+int j_log_atime(struct inode *inode)
+{
+    struct f2fs_inode_info *f2fs_i = F2FS_I(inode);
+    j_log_entry_t *log_entry = NULL;
+    read_stat_log_t *atime_log = NULL;
+    log_type_e log_type = STAT_LOG;
+    uint64_t ep_seq = 0;
+
+    // the inode already has an access time log in running epoch, overwrite it
+    ep_seq = j_lock_running_epoch();
+    if (f2fs_i->j_atime_log && f2fs_i->j_atime_log_ep == ep_seq)
+    {
+        f2fs_i->j_atime_log->access_time_s  = inode->i_atime.tv_sec;
+        f2fs_i->j_atime_log->access_time_ns = inode->i_atime.tv_nsec;
+        j_unlock_running_epoch();
+        return F2FSJ_OK;
+    }
+    j_unlock_running_epoch();
+
+    if (S_ISREG(inode->i_mode))
+    {
+        log_type = READ_FILE_DATA_LOG;
+    }
+    else if (S_ISDIR(inode->i_mode))
+    {
+        log_type = READ_DIR_LOG;
+    }
+
+    if (j_alloc_log_entry(log_type, &log_entry) != F2FSJ_OK)
+    {
+        return F2FSJ_ERROR;
+    }
+
+    atime_log = (read_stat_log_t *)log_entry->log_entry_addr;
+    memset(atime_log, 0, sizeof(read_stat_log_t));
+    atime_log->log_header.log_type = log_type;
+    atime_log->log_header.log_size = J_LOG_ENTRY_SIZE;
+    atime_log->ino_num        = inode->i_ino;
+    atime_log->access_time_s  = inode->i_atime.tv_sec;
+    atime_log->access_time_ns = inode->i_atime.tv_nsec;
+
+    if (insert_log_into_inode(f2fs_i, log_entry) != F2FSJ_OK)
+    {
+        j_free_log_entry(log_entry);
+        return F2FSJ_ERROR;
+    }
+
+    // epoch may switch before insertion, then ep_seq is not running and next access takes a new log
+    j_lock_running_epoch();
+    f2fs_i->j_atime_log    = atime_log;
+    f2fs_i->j_atime_log_ep = ep_seq;
+    j_unlock_running_epoch();
 
-    return STILL_REMAIN_SPACE;
+    return F2FSJ_OK;
 }
 
 int j_get_nat_log_entry(struct f2fs_sb_info *sbi, nid_t node_id, j_nat_entry_t *j_nat_e)
@@ -381,16 +774,6 @@ int j_get_nat_log_entry(struct f2fs_sb_info *sbi, nid_t node_id, j_nat_entry_t *
         STATUS_LOG(STATUS_ERROR, "get nat entry from nat_radix_tree failed, nid is %d\n", node_id);
     }
 
-    /** page-flag-ctrl: clear page dirty here and set it to journal dirty*/
-    j_clear_NODE_page_dirty(sbi, nat_e->ni.ino);
-    j_set_NODE_page_j_dirty(sbi, nat_e->ni.ino);
-
-    j_clear_NODE_page_dirty(sbi, nat_e->ni.nid);
-    j_set_NODE_page_j_dirty(sbi, nat_e->ni.nid);
-
-    j_clear_META_nat_page_dirty(sbi, nat_e->ni.nid);
-    j_set_META_nat_page_j_dirty(sbi, nat_e->ni.nid);
-
     return F2FSJ_OK;
 }
 
@@ -400,333 +783,127 @@ int j_get_sit_log_entry(struct f2fs_sb_info *sbi, nid_t node_id, f2fs_current_se
      *  file ops that related to new inode page or data blk
      */
     struct curseg_info *curseg = CURSEG_I(sbi, seg_type);
-    struct seg_entry   *seg_e  = NULL;
-
-    uint32_t bitmap_size = 0;
-    uint32_t discard_map = f2fs_block_unit_discard(sbi) ? 1 : 0;
-
-    /** refer to build_sit_info()*/
-#ifdef CONFIG_F2FS_CHECK_FS
-    bitmap_size = MAIN_SEGS(sbi) * SIT_VBLOCK_MAP_SIZE * (3 + discard_map);
-#else
-    bitmap_size = MAIN_SEGS(sbi) * SIT_VBLOCK_MAP_SIZE * (2 + discard_map);
-#endif
-
-    INFO_REPORT("bitmap size is %d\n", bitmap_size);
-
-    // allocate memory for bitmap
-    // TODO-f2fsj, bitmap canbe stored at array
-    //j_sit_e->j_bitmap = kmalloc(bitmap_size, GFP_KERNEL);
 
-    // get seg info
-    seg_e = get_sec_entry(sbi, curseg->segno);
-
-    // get sit entry log
-    //memcpy(j_sit_e->j_bitmap, seg_e->cur_valid_map, bitmap_size);
-    j_sit_e->bitmap_size      = bitmap_size;
+    // only the block just allocated in current segment, not the valid map of segment
     j_sit_e->segno            = curseg->segno;
-    j_sit_e->j_nr_valid_block = seg_e->valid_blocks;
-    j_sit_e->j_sit_cur_seg    = curseg->segno;
-
-    /** page-flag-ctrl */
-    j_clear_META_sit_page_dirty(sbi, curseg->segno);
-    j_set_META_sit_page_j_dirty(sbi, curseg->segno);
+    j_sit_e->blkofs           = curseg->next_blkoff;
+    j_sit_e->valid_delta      = 1;
+    j_sit_e->j_nr_valid_block = get_seg_entry(sbi, curseg->segno)->valid_blocks;
 
-    return 0;
+    return F2FSJ_OK;
 }
 
 int j_get_ssa_log_entry(struct f2fs_sb_info *sbi, nid_t node_id, uint32_t node_or_data_blk_addr,
                                             f2fs_current_seg_e seg_type, j_ssa_log_entry_t *j_ssa_e)
 {
+    struct curseg_info *curseg = CURSEG_I(sbi, seg_type);
     struct f2fs_summary *target_sum_e = NULL;
+    uint32_t segno  = GET_SEGNO(sbi, node_or_data_blk_addr);
+    uint32_t blkofs = GET_BLKOFF_FROM_SEG0(sbi, node_or_data_blk_addr);
 
-    struct f2fs_sm_info *sm_info = SM_I(sbi);
-    // main area is sequential logging area
-    uint32_t main_area_start_blk = sm_info->main_blkaddr;
-
-    // each f2fs_summary_blk contains 512 ssa entry
-    uint32_t cur_ssa_blk_no      = (node_or_data_blk_addr - main_area_start_blk) / 512;
-
-    // the first blk recorded in this ssa blk
-    uint32_t first_blk_addr      = cur_ssa_blk_no * 512 + main_area_start_blk;
-
-    uint32_t offset_in_ssa_blk   = node_or_data_blk_addr - first_blk_addr;
-    if (offset_in_ssa_blk >= 512)
+    // summary of a block in current segment is only in curseg->sum_blk
+    if (segno != curseg->segno || blkofs >= ENTRIES_IN_SUM)
     {
-        STATUS_LOG(STATUS_ERROR, "invalid ssa entry ofs - %d\n", offset_in_ssa_blk);
+        STATUS_LOG(STATUS_ERROR, "blk %u is not in current segment %u\n", node_or_data_blk_addr, curseg->segno);
         return F2FSJ_ERROR;
     }
 
-    struct curseg_info *curseg = CURSEG_I(sbi, seg_type);
-    uint32_t curssa_blk        = GET_SUM_BLOCK(sbi, curseg->segno);
-    void  *sum_addr = curseg->sum_blk; // the address of current segment's summary block
-
-    target_sum_e = (struct f2fs_summary *)sum_addr + (sizeof(struct f2fs_summary) * offset_in_ssa_blk);
-    j_ssa_e->block_addr        = node_or_data_blk_addr;
-    j_ssa_e->j_nid             = node_id;
-    j_ssa_e->blk_ofs_in_inode  = target_sum_e->ofs_in_node;
-
-    j_ssa_e->j_cur_seg_no      = curseg->segno;
-
-    /** page-flag-ctrl */
-    j_clear_META_ssa_page_dirty(sbi, curseg->segno);
-    j_set_META_ssa_page_j_dirty(sbi, curseg->segno);
+    target_sum_e = &curseg->sum_blk->entries[blkofs];
+    j_ssa_e->segno       = segno;
+    j_ssa_e->blkofs      = blkofs;
+    j_ssa_e->ofs_in_node = le16_to_cpu(target_sum_e->ofs_in_node);
+    j_ssa_e->j_nid       = node_id;
 
     return F2FSJ_OK;
 }
 
-void j_clear_NODE_page_dirty(struct f2fs_sb_info *sbi, uint32_t nid)
+/**
+ * @brief Set or clear journal dirty of a cached NODE/META page.
+ *        Never read a page from disk here, a page that is not cached has nothing to hold,
+ *        and only a dirty page can be held from background writeback.
+ *
+ * @param sbi
+ * @param mapping NODE_MAPPING or META_MAPPING
+ * @param index nid or meta blkaddr
+ * @param set
+ */
+static void j_update_cached_page_j_dirty(struct f2fs_sb_info *sbi, struct address_space *mapping,
+                                                        pgoff_t index, bool set)
 {
-    struct page * NODE_page = NULL;
-    NODE_page = f2fs_get_node_page(sbi, nid);
-    if (NODE_page == NULL)
-    {
-        STATUS_LOG(STATUS_ERROR, "get inode page err, clear node page dirty abort\n");
-    }
-    else
-    {
-#if ENABLE_F2FSJ
-        clear_page_dirty_for_io(NODE_page);
-#endif
-    }
-}
+    struct page *page = NULL;
 
-void j_set_NODE_page_j_dirty(struct f2fs_sb_info *sbi, uint32_t nid)
-{
-    struct page * NODE_page = NULL;
-    NODE_page = f2fs_get_node_page(sbi, nid);
-    if (NODE_page == NULL)
+    page = find_get_page(mapping, index);
+    if (page == NULL)
     {
-        STATUS_LOG(STATUS_ERROR, "get inode page err, set node page journal dirty abort\n");
+        return;
     }
-    else
-    {
-#if ENABLE_F2FSJ
-        setPageJournalDirty(NODE_page);
-#endif
-    }
-}
 
-void j_clear_NODE_page_j_dirty(struct f2fs_sb_info *sbi, uint32_t nid)
-{
-    struct page * NODE_page = NULL;
-    NODE_page = f2fs_get_node_page(sbi, nid);
-    if (NODE_page == NULL)
+    if (set)
     {
-        STATUS_LOG(STATUS_ERROR, "get inode page err, set node page journal dirty abort\n");
+        // page is locked by writeback or updater, let the normal path handle it
+        if (!trylock_page(page))
+        {
+            put_page(page);
+            return;
+        }
     }
     else
     {
-#if ENABLE_F2FSJ
-        clearPageJournalDirty(NODE_page);
-#endif
+        lock_page(page);
     }
-}
 
-void j_set_NODE_page_dirty(struct f2fs_sb_info *sbi, uint32_t nid)
-{
-    struct page * NODE_page = NULL;
-    NODE_page = f2fs_get_node_page(sbi, nid);
-    if (NODE_page == NULL)
+    if (page->mapping == mapping)
     {
-        STATUS_LOG(STATUS_ERROR, "get inode page err, set node page dirty abort\n");
-    }
-    else
-    {
-#if ENABLE_F2FSJ
-        SetPageDirty(NODE_page);
-#endif
+        if (!set)
+        {
+            clear_page_journal_dirty(sbi, page);
+        }
+        else if (PageDirty(page)
+              && get_pages(sbi, F2FSJ_JDIRTY_PAGES) < sbi->j_absorb_max_pages)
+        {
+            set_page_journal_dirty(sbi, page);
+        }
     }
-}
 
-void j_clear_META_nat_page_dirty(struct f2fs_sb_info *sbi, uint32_t nid)
-{
-    struct page * META_page = NULL;
-    META_page = f2fs_get_meta_page(sbi, current_nat_addr(sbi, nid));
-    if (META_page == NULL)
-    {
-        STATUS_LOG(STATUS_ERROR, "get inode page err, clear node page dirty abort\n");
-    }
-    else
-    {
-#if ENABLE_F2FSJ
-        clear_page_dirty_for_io(META_page);
-#endif
-    }
+    f2fs_put_page(page, 1);
 }
 
-void j_set_META_nat_page_j_dirty(struct f2fs_sb_info *sbi, uint32_t nid)
+void j_set_NODE_page_j_dirty(struct f2fs_sb_info *sbi, uint32_t nid)
 {
-    struct page * META_page = NULL;
-    META_page = f2fs_get_meta_page(sbi, current_nat_addr(sbi, nid));
-    if (META_page == NULL)
-    {
-        STATUS_LOG(STATUS_ERROR, "get inode page err, clear node page dirty abort\n");
-    }
-    else
-    {
-#if ENABLE_F2FSJ
-        setPageJournalDirty(META_page);
-#endif
-    }
+    j_update_cached_page_j_dirty(sbi, NODE_MAPPING(sbi), nid, true);
 }
 
-void j_clear_META_nat_page_j_dirty(struct f2fs_sb_info *sbi, uint32_t nid)
+void j_clear_NODE_page_j_dirty(struct f2fs_sb_info *sbi, uint32_t nid)
 {
-    struct page * META_page = NULL;
-    META_page = f2fs_get_meta_page(sbi, current_nat_addr(sbi, nid));
-    if (META_page == NULL)
-    {
-        STATUS_LOG(STATUS_ERROR, "get inode page err, clear node page dirty abort\n");
-    }
-    else
-    {
-#if ENABLE_F2FSJ
-        clearPageJournalDirty(META_page);
-#endif
-    }
+    j_update_cached_page_j_dirty(sbi, NODE_MAPPING(sbi), nid, false);
 }
 
-void j_set_META_nat_page_dirty(struct f2fs_sb_info *sbi, uint32_t nid)
+void j_set_META_nat_page_j_dirty(struct f2fs_sb_info *sbi, uint32_t nid)
 {
-    struct page * META_page = NULL;
-    META_page = f2fs_get_meta_page(sbi, current_nat_addr(sbi, nid));
-    if (META_page == NULL)
-    {
-        STATUS_LOG(STATUS_ERROR, "get inode page err, clear node page dirty abort\n");
-    }
-    else
-    {
-#if ENABLE_F2FSJ
-        SetPageDirty(META_page);
-#endif
-    }
+    j_update_cached_page_j_dirty(sbi, META_MAPPING(sbi), current_nat_addr(sbi, nid), true);
 }
 
-void j_clear_META_sit_page_dirty(struct f2fs_sb_info *sbi, uint32_t segno)
+void j_clear_META_nat_page_j_dirty(struct f2fs_sb_info *sbi, uint32_t nid)
 {
-    struct page * META_page = NULL;
-    META_page = f2fs_get_meta_page(sbi, current_sit_addr(sbi, segno));
-    if (META_page == NULL)
-    {
-        STATUS_LOG(STATUS_ERROR, "get inode page err, clear meta sit page dirty abort\n");
-    }
-    else
-    {
-#if ENABLE_F2FSJ
-        clear_page_dirty_for_io(META_page);
-#endif
-    }
+    j_update_cached_page_j_dirty(sbi, META_MAPPING(sbi), current_nat_addr(sbi, nid), false);
 }
 
 void j_set_META_sit_page_j_dirty(struct f2fs_sb_info *sbi, uint32_t segno)
 {
-    struct page * META_page = NULL;
-    META_page = f2fs_get_meta_page(sbi, current_sit_addr(sbi, segno));
-    if (META_page == NULL)
-    {
-        STATUS_LOG(STATUS_ERROR, "get inode page err, clear meta sit page dirty abort\n");
-    }
-    else
-    {
-#if ENABLE_F2FSJ
-        setPageJournalDirty(META_page);
-#endif
-    }
+    j_update_cached_page_j_dirty(sbi, META_MAPPING(sbi), current_sit_addr(sbi, segno), true);
 }
 
 void j_clear_META_sit_page_j_dirty(struct f2fs_sb_info *sbi, uint32_t segno)
 {
-    struct page * META_page = NULL;
-    META_page = f2fs_get_meta_page(sbi, current_sit_addr(sbi, segno));
-    if (META_page == NULL)
-    {
-        STATUS_LOG(STATUS_ERROR, "get inode page err, clear meta sit page dirty abort\n");
-    }
-    else
-    {
-#if ENABLE_F2FSJ
-        clearPageJournalDirty(META_page);
-#endif
-    }
-}
-
-void j_set_META_sit_page_dirty(struct f2fs_sb_info *sbi, uint32_t segno)
-{
-    struct page * META_page = NULL;
-    META_page = f2fs_get_meta_page(sbi, current_sit_addr(sbi, segno));
-    if (META_page == NULL)
-    {
-        STATUS_LOG(STATUS_ERROR, "get inode page err, clear META sit page dirty abort\n");
-    }
-    else
-    {
-#if ENABLE_F2FSJ
-        SetPageDirty(META_page);
-#endif
-    }
-}
-
-void j_clear_META_ssa_page_dirty(struct f2fs_sb_info *sbi, uint32_t segno)
-{
-    struct page * META_page = NULL;
-    META_page = f2fs_get_meta_page(sbi, GET_SUM_BLOCK(sbi, segno));
-    if (META_page == NULL)
-    {
-        STATUS_LOG(STATUS_ERROR, "get inode page err, clear meta sit page dirty abort\n");
-    }
-    else
-    {
-#if ENABLE_F2FSJ
-        clear_page_dirty_for_io(META_page);
-#endif
-    }
+    j_update_cached_page_j_dirty(sbi, META_MAPPING(sbi), current_sit_addr(sbi, segno), false);
 }
 
 void j_set_META_ssa_page_j_dirty(struct f2fs_sb_info *sbi, uint32_t segno)
 {
-    struct page * META_page = NULL;
-    META_page = f2fs_get_meta_page(sbi, GET_SUM_BLOCK(sbi, segno));
-    if (META_page == NULL)
-    {
-        STATUS_LOG(STATUS_ERROR, "get inode page err, clear meta sit page dirty abort\n");
-    }
-    else
-    {
-#if ENABLE_F2FSJ
-        setPageJournalDirty(META_page);
-#endif
-    }
+    j_update_cached_page_j_dirty(sbi, META_MAPPING(sbi), GET_SUM_BLOCK(sbi, segno), true);
 }
 
 void j_clear_META_ssa_page_j_dirty(struct f2fs_sb_info *sbi, uint32_t segno)
 {
-    struct page * META_page = NULL;
-    META_page = f2fs_get_meta_page(sbi, GET_SUM_BLOCK(sbi, segno));
-    if (META_page == NULL)
-    {
-        STATUS_LOG(STATUS_ERROR, "get inode page err, clear meta sit page dirty abort\n");
-    }
-    else
-    {
-#if ENABLE_F2FSJ
-        clearPageJournalDirty(META_page);
-#endif
-    }
+    j_update_cached_page_j_dirty(sbi, META_MAPPING(sbi), GET_SUM_BLOCK(sbi, segno), false);
 }
-
-void j_set_META_ssa_page_dirty(struct f2fs_sb_info *sbi, uint32_t segno)
-{
-    struct page * META_page = NULL;
-    META_page = f2fs_get_meta_page(sbi, GET_SUM_BLOCK(sbi, segno));
-    if (META_page == NULL)
-    {
-        STATUS_LOG(STATUS_ERROR, "get inode page err, clear META sit page dirty abort\n");
-    }
-    else
-    {
-#if ENABLE_F2FSJ
-        SetPageDirty(META_page);
-#endif
-    }
-}
\ No newline at end of file
@@ -25,7 +25,7 @@ typedef enum __aggregate_logs_e
 /**
  * @brief This function is to verify if the inode is already registered into g_epoch
  *        If not, this inode should be registered into current running g_epoch and also
- *        enable local epoch
+ *        enable local epoch. Should be protected by ep switch lock
  * 
  * @param f2fs_i 
  * @return int 
@@ -45,6 +45,7 @@ int get_idle_local_epoch(struct f2fs_inode_info *f2fs_i);
  *        1)invoke is_already_checkin_g_epoch() to check if this inode checked in global inode list
  *          if not, register this inode into current running 
  *        2)invoke get_idle_local_epoch() to enable a local epoch
+ *        Should be protected by ep switch lock, the running epoch must not be sealed meanwhile
  * 
  * @param f2fs_i 
  * @return int 
@@ -53,6 +54,37 @@ int ino_checkin_global_epoch(struct f2fs_inode_info *f2fs_i);
 
 /************** Specific functions that is invoked to insert log into inode **************/
 
+/**
+ * @brief Record data pages [start_idx, end_idx] dirtied by buffered write or mmap,
+ *        they are written back once per inode before the running epoch commits (ordered mode)
+ *
+ * @param f2fs_i
+ * @param start_idx
+ * @param end_idx, inclusive
+ * @return int
+ */
+int j_record_dirty_data_range(struct f2fs_inode_info *f2fs_i, pgoff_t start_idx, pgoff_t end_idx);
+
+/**
+ * @brief Record a buffered write of len bytes at ofs of page.
+ *        For a data journaling file (f2fsj_data_journal_file()) and a write not larger than
+ *        sbi->j_data_journal_max_bytes, the bytes are copied into a DATA_JOURNAL_LOG.
+ *        Otherwise, the page is written back at epoch commit like j_record_dirty_data_range()
+ *
+ * @param f2fs_i
+ * @param page, locked
+ * @param ofs, offset in page
+ * @param len
+ * @return int
+ */
+int j_record_data_write(struct f2fs_inode_info *f2fs_i, struct page *page, uint32_t ofs, uint32_t len);
+
+/**
+ * @brief Move dirty data ranges of a committing local epoch to ranges
+ *
+ */
+void j_fetch_dirty_data_ranges(struct f2fs_inode_info *f2fs_i, uint8_t local_ep_idx, j_dirty_range_set_t *ranges);
+
 int insert_log_into_inode(struct f2fs_inode_info *f2fs_i, j_log_entry_t *j_log_entry);
 
 /// @brief collect new inode log from vfs inode and f2fs_inode
@@ -68,6 +100,107 @@ int get_delete_log_from_f2fs_inode(struct f2fs_sb_info *sbi,
                                     struct f2fs_inode_info *f2fs_i,
                                     char * fname,
                                     delete_log_t *j_delete_log);
+/**
+ * @brief Journal namespace operations, names and symlink target are kept in the log so that
+ *        dirsync is made durable by an epoch commit (j_sync_epoch_commit()) instead of a checkpoint.
+ *        Invoked after the operation succeeded, under f2fs_lock_op() for rename
+ *
+ * @return F2FSJ_ERROR if the operation cannot be journaled (e.g., encrypted directory, too long
+ *         symlink target), caller falls back to checkpoint for dirsync
+ */
+int j_log_link(struct inode *dir, struct inode *inode, const struct qstr *name);
+
+int j_log_symlink(struct inode *dir, struct inode *inode, const struct qstr *name,
+                  const uint8_t *target, uint32_t target_len);
+
+/**
+ * @param target, inode replaced (or exchanged if J_RENAME_EXCHANGE) at new_name, NULL if none
+ * @param whiteout_ino, whiteout left at old_name if J_RENAME_WHITEOUT
+ */
+int j_log_rename(struct inode *old_dir, const struct qstr *old_name,
+                 struct inode *new_dir, const struct qstr *new_name,
+                 struct inode *inode, struct inode *target, nid_t whiteout_ino, uint32_t flags);
+/**
+ * @brief Journal attributes of inode after setattr, so the change can be absorbed in the in-core
+ *        inode (f2fsj_absorb_inode_dirty()) and the inode page is only written by checkpoint
+ *
+ * @return F2FSJ_ERROR if no log entry, caller dirties inode as usual
+ */
+int j_log_setattr(struct inode *inode, unsigned int ia_valid);
+
+/**
+ * @brief Journal truncate/fallocate/punch hole of [offset, offset + len), after the operation
+ *
+ * @param log_type, TRUNCATE_LOG, FALLOCATE_LOG or PUNCH_LOG
+ * @param mode, FALLOC_FL_* of fallocate
+ * @return F2FSJ_ERROR if no log entry, caller dirties inode as usual
+ */
+int j_log_range(struct inode *inode, log_type_e log_type, int mode, loff_t old_size,
+                loff_t offset, loff_t len);
+
+/**
+ * @brief Journal one xattr set (value != NULL) or removal, invoked under i_xattr_sem after
+ *        xattrs are written into inode page or xattr node
+ *
+ * @return F2FSJ_ERROR if name and value do not fit in one log, caller dirties inode as usual
+ */
+int j_log_xattr(struct inode *inode, int index, const char *name, size_t name_len,
+                const void *value, size_t value_len);
+
+/**
+ * @brief Journal access time of inode. Accesses of one inode in one epoch share a log,
+ *        which is overwritten in place while the epoch is running
+ *
+ * @return F2FSJ_ERROR if no log entry, caller dirties inode as usual
+ */
+int j_log_atime(struct inode *inode);
+
+/**
+ * @brief Journal an orphan inode, or its relink by linkat of tmpfile (J_ORPHAN_RELINK).
+ *        Invoked under f2fs_lock_op() like orphan list updates
+ *
+ * @return F2FSJ_ERROR if no log entry, caller keeps the orphan in orphan blocks
+ */
+int j_log_orphan(nid_t ino, uint32_t flags);
+
+/**
+ * @brief Record one NAT (nid -> blkaddr), SIT (valid bit of a block) or SSA (summary slot) change.
+ *        Invoked by set_node_addr(), update_sit_entry() and __add_sum_entry() under their locks
+ */
+void j_record_nat_delta(nid_t nid, nid_t ino, block_t blkaddr, unsigned char version);
+
+void j_record_sit_delta(unsigned int segno, unsigned int blkofs, int del, unsigned int valid_blocks);
+
+void j_record_ssa_delta(unsigned int segno, unsigned int blkofs, struct f2fs_summary *sum);
+
+/**
+ * @brief Record a data block moved by foreground GC, after dnode points to new_blkaddr
+ */
+void j_record_gc_move(nid_t nid, unsigned int ofs_in_node, block_t old_blkaddr, block_t new_blkaddr);
+
+/**
+ * @brief Whether every delta since last checkpoint can be replayed, i.e. none was dropped
+ */
+bool j_meta_deltas_replayable(void);
+
+/**
+ * @brief Log deltas recorded so far as META_DELTA_LOG, invoked by epoch commit after data of the
+ *        epoch is written back, so block allocation of the data is covered
+ *
+ * @return F2FSJ_ERROR if deltas cannot be logged, the ones not logged are kept for next commit
+ *         and the epoch must not be committed without them
+ */
+int j_log_meta_deltas(void);
+
+/**
+ * @brief Checkpoint of cp_ver is being written with NAT/SIT/SSA of the deltas recorded so far,
+ *        stamp the ones recorded from now on with it. Deltas are not dropped here, the
+ *        checkpoint may still fail, replay skips the ones older than the checkpoint it starts from
+ *
+ * @param cp_ver
+ */
+void j_meta_deltas_new_checkpoint(uint64_t cp_ver);
+
 /*************** Specific functions that is invoked to insert log into inode **************/
 
 /**
@@ -93,9 +226,9 @@ int aggregate_per_ino_log(struct f2fs_inode_info *f2fs_i, j_checkpoint_list_t *c
 int j_get_nat_log_entry(struct f2fs_sb_info *sbi, nid_t node_id, j_nat_entry_t *j_nat_e);
 
 /**
- * @brief refer to get_sec_entry() and get_seg_entry() and current_sit_addr()
- *        we get number of valid blocks and also the bitmap of this segment
- *        For bitmap size, I refer to build_sit_info()
+ * @brief refer to get_seg_entry() and current_sit_addr()
+ *        we get the block just allocated in current segment and number of valid blocks of it,
+ *        valid map of the segment is not copied
  */
 int j_get_sit_log_entry(struct f2fs_sb_info *sbi, nid_t node_id, f2fs_current_seg_e seg_type, j_sit_log_t *j_sit_e);
 
@@ -108,38 +241,30 @@ int j_get_ssa_log_entry(struct f2fs_sb_info *sbi, nid_t node_id, uint32_t node_o
 
 
 /**
- * As considering that We cannot directly get META and NODE page
- * So we can package one level by using nid and seg to get correspoing page and set flag
- * 
- *   f2fs_get_node_page(sbi, nid); 
- *   f2fs_get_meta_page(sbi, current_nat_addr(sbi, nid));
- *   f2fs_get_meta_page(sbi, current_sit_addr(sbi, segno));
- *   f2fs_get_meta_page(sbi, GET_SUM_BLOCK(sbi, segno));
- * 
- *  When doing log collection
- *   1) clear_page_dirty_for_io(page)
- *   2) setJournalDirty(page)
+ * Journal dirty (page private bit, see set_page_journal_dirty()) marks a dirty NODE/META page
+ * whose update is already covered by a committed journal. Such page stays in memory and is
+ * skipped by background writeback, so it is written once when journal is applied.
+ * Locate the page by nid or segno:
+ *
+ *   NODE_MAPPING(sbi), nid
+ *   META_MAPPING(sbi), current_nat_addr(sbi, nid)
+ *   META_MAPPING(sbi), current_sit_addr(sbi, segno)
+ *   META_MAPPING(sbi), GET_SUM_BLOCK(sbi, segno)
+ *
  *   After committing:
- *   3) SetPageDirty(page)
+ *   1) set journal dirty, if page is cached and dirty
+ *   Applying (checkpoint):
+ *   2) page is written and journal dirty is cleared
  */
-
-void j_clear_NODE_page_dirty(struct f2fs_sb_info *sbi, uint32_t nid);
-void j_set_NODE_page_dirty(struct f2fs_sb_info *sbi, uint32_t nid);
 void j_set_NODE_page_j_dirty(struct f2fs_sb_info *sbi, uint32_t nid);
 void j_clear_NODE_page_j_dirty(struct f2fs_sb_info *sbi, uint32_t nid);
 
-void j_clear_META_nat_page_dirty(struct f2fs_sb_info *sbi, uint32_t nid);
-void j_set_META_nat_page_dirty(struct f2fs_sb_info *sbi, uint32_t nid);
 void j_set_META_nat_page_j_dirty(struct f2fs_sb_info *sbi, uint32_t nid);
 void j_clear_META_nat_page_j_dirty(struct f2fs_sb_info *sbi, uint32_t nid);
 
-void j_clear_META_sit_page_dirty(struct f2fs_sb_info *sbi, uint32_t segno);
-void j_set_META_sit_page_dirty(struct f2fs_sb_info *sbi, uint32_t segno);
 void j_set_META_sit_page_j_dirty(struct f2fs_sb_info *sbi, uint32_t segno);
 void j_clear_META_sit_page_j_dirty(struct f2fs_sb_info *sbi, uint32_t segno);
 
-void j_clear_META_ssa_page_dirty(struct f2fs_sb_info *sbi, uint32_t segno);
-void j_set_META_ssa_page_dirty(struct f2fs_sb_info *sbi, uint32_t segno);
 void j_set_META_ssa_page_j_dirty(struct f2fs_sb_info *sbi, uint32_t segno);
 void j_clear_META_ssa_page_j_dirty(struct f2fs_sb_info *sbi, uint32_t segno);
 
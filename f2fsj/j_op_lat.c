@@ -0,0 +1,263 @@
+/**
+ * @file j_op_lat.c
+ * @author leslie.cui (10033908@github.com)
+ * @brief implementation of per operation latency histograms
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ */
+#include "j_op_lat.h"
+#include <linux/percpu.h>
+#include <linux/log2.h>
+
+typedef struct __j_op_lat_hist
+{
+    uint64_t buckets[J_OP_LAT_BUCKETS];
+    uint64_t total_ns;
+}j_op_lat_hist_t;
+
+typedef struct __j_op_lat_cpu
+{
+    j_op_lat_hist_t hist[J_OP_NR][J_OP_NR_PHASES];
+}j_op_lat_cpu_t;
+
+///< counters are only added on local cpu, readers sum them up without lock
+static DEFINE_PER_CPU(j_op_lat_cpu_t, j_op_lat_cpu);
+
+bool g_j_op_lat_on = false;
+
+static const char *j_op_name[J_OP_NR] =
+{
+    [J_OP_CREATE]      = "create",
+    [J_OP_MKDIR]       = "mkdir",
+    [J_OP_UNLINK]      = "unlink",
+    [J_OP_RENAME]      = "rename",
+    [J_OP_SETATTR]     = "setattr",
+    [J_OP_WRITE_BEGIN] = "write_begin",
+    [J_OP_WRITE_END]   = "write_end",
+    [J_OP_FSYNC]       = "fsync",
+};
+
+static const char *j_op_phase_name[J_OP_NR_PHASES] =
+{
+    [J_OP_PHASE_TOTAL]  = "total",
+    [J_OP_PHASE_CORE]   = "core",
+    [J_OP_PHASE_LOG]    = "log",
+    [J_OP_PHASE_ALLOC]  = "alloc",
+    [J_OP_PHASE_INSERT] = "insert",
+    [J_OP_PHASE_COMMIT] = "commit",
+};
+
+static void j_op_lat_add(j_op_e op, j_op_phase_e phase, uint64_t lat_ns)
+{
+    uint32_t bucket = lat_ns < 256 ? 0 : min_t(uint32_t, ilog2(lat_ns) - 7, J_OP_LAT_BUCKETS - 1);
+
+    this_cpu_inc(j_op_lat_cpu.hist[op][phase].buckets[bucket]);
+    this_cpu_add(j_op_lat_cpu.hist[op][phase].total_ns, lat_ns);
+}
+
+void j_op_lat_end(j_op_lat_t *lat)
+{
+    uint64_t total_ns = 0;
+    uint64_t core_ns = 0;
+
+    if (!lat->start_ns)
+    {
+        return;
+    }
+
+    total_ns = get_current_time_ns() - lat->start_ns;
+    if (total_ns > lat->log_ns + lat->commit_ns)
+    {
+        core_ns = total_ns - lat->log_ns - lat->commit_ns;
+    }
+
+    j_op_lat_add(lat->op, J_OP_PHASE_TOTAL, total_ns);
+    j_op_lat_add(lat->op, J_OP_PHASE_CORE, core_ns);
+    if (lat->log_ns)
+    {
+        j_op_lat_add(lat->op, J_OP_PHASE_LOG, lat->log_ns);
+    }
+    if (lat->commit_ns)
+    {
+        j_op_lat_add(lat->op, J_OP_PHASE_COMMIT, lat->commit_ns);
+    }
+}
+
+static j_op_e j_op_of_log_type(log_type_e log_type)
+{
+    switch (log_type)
+    {
+        case CREATE_LOG:
+            return J_OP_CREATE;
+        case MKDIR_LOG:
+            return J_OP_MKDIR;
+        case UNLINK_LOG:
+            return J_OP_UNLINK;
+        case RENAME_LOG:
+            return J_OP_RENAME;
+        case CHOWN_LOG:
+        case TRUNCATE_LOG:
+            return J_OP_SETATTR;
+        case DATA_WRITE_LOG:
+        case DATA_JOURNAL_LOG:
+            return J_OP_WRITE_END;
+        default:
+            return J_OP_NR;
+    }
+}
+
+void j_op_lat_log_phase(log_type_e log_type, j_op_phase_e phase, uint64_t start_ns)
+{
+    j_op_e op = j_op_of_log_type(log_type);
+
+    if (!start_ns || op == J_OP_NR)
+    {
+        return;
+    }
+
+    j_op_lat_add(op, phase, get_current_time_ns() - start_ns);
+}
+
+void j_op_lat_enable(bool on)
+{
+    int cpu = 0;
+
+    if (on && !READ_ONCE(g_j_op_lat_on))
+    {
+        for_each_possible_cpu(cpu)
+        {
+            memset(per_cpu_ptr(&j_op_lat_cpu, cpu), 0, sizeof(j_op_lat_cpu_t));
+        }
+    }
+
+    WRITE_ONCE(g_j_op_lat_on, on);
+}
+
+static void j_op_lat_sum(j_op_e op, j_op_phase_e phase, j_op_lat_hist_t *sum)
+{
+    j_op_lat_hist_t *hist = NULL;
+    int cpu = 0;
+    int i = 0;
+
+    memset(sum, 0, sizeof(*sum));
+    for_each_possible_cpu(cpu)
+    {
+        hist = &per_cpu_ptr(&j_op_lat_cpu, cpu)->hist[op][phase];
+        for (i = 0; i < J_OP_LAT_BUCKETS; i++)
+        {
+            sum->buckets[i] += READ_ONCE(hist->buckets[i]);
+        }
+        sum->total_ns += READ_ONCE(hist->total_ns);
+    }
+}
+
+static uint64_t j_op_lat_count(j_op_lat_hist_t *hist)
+{
+    uint64_t count = 0;
+    int i = 0;
+
+    for (i = 0; i < J_OP_LAT_BUCKETS; i++)
+    {
+        count += hist->buckets[i];
+    }
+
+    return count;
+}
+
+/**
+ * @brief upper bound of bucket, in ns/us/ms so that lines stay short
+ */
+static void j_op_lat_show_bound(struct seq_file *s, uint32_t bucket)
+{
+    uint64_t bound_ns = 1ULL << (bucket + 8);
+
+    if (bound_ns < 1000)
+    {
+        seq_printf(s, " <%lluns", bound_ns);
+    }
+    else if (bound_ns < 1000000)
+    {
+        seq_printf(s, " <%lluus", div_u64(bound_ns, 1000));
+    }
+    else
+    {
+        seq_printf(s, " <%llums", div_u64(bound_ns, 1000000));
+    }
+}
+
+void j_op_lat_show(struct seq_file *s)
+{
+    j_op_lat_hist_t hist;
+    uint64_t phase_ns[J_OP_NR_PHASES];
+    uint64_t nr_ops = 0;
+    uint64_t build_ns = 0;
+    int op = 0;
+    int phase = 0;
+    int i = 0;
+
+    seq_printf(s, "timing: %s\n", READ_ONCE(g_j_op_lat_on) ? "on" : "off");
+    seq_puts(s, "avg ns per operation, log = build + alloc + insert\n");
+
+    for (op = 0; op < J_OP_NR; op++)
+    {
+        for (phase = 0; phase < J_OP_NR_PHASES; phase++)
+        {
+            j_op_lat_sum(op, phase, &hist);
+            phase_ns[phase] = hist.total_ns;
+            if (phase == J_OP_PHASE_TOTAL)
+            {
+                nr_ops = j_op_lat_count(&hist);
+            }
+        }
+
+        if (!nr_ops)
+        {
+            continue;
+        }
+
+        // build is not timed by itself, allocation and insertion are taken off the logging step
+        build_ns = phase_ns[J_OP_PHASE_LOG];
+        build_ns -= min(build_ns, phase_ns[J_OP_PHASE_ALLOC] + phase_ns[J_OP_PHASE_INSERT]);
+
+        seq_printf(s, "%s: %llu ops, total %llu, core %llu, build %llu, alloc %llu, insert %llu, commit %llu\n",
+                   j_op_name[op], nr_ops,
+                   div64_u64(phase_ns[J_OP_PHASE_TOTAL], nr_ops),
+                   div64_u64(phase_ns[J_OP_PHASE_CORE], nr_ops),
+                   div64_u64(build_ns, nr_ops),
+                   div64_u64(phase_ns[J_OP_PHASE_ALLOC], nr_ops),
+                   div64_u64(phase_ns[J_OP_PHASE_INSERT], nr_ops),
+                   div64_u64(phase_ns[J_OP_PHASE_COMMIT], nr_ops));
+
+        // only phases and buckets in use
+        for (phase = 0; phase < J_OP_NR_PHASES; phase++)
+        {
+            j_op_lat_sum(op, phase, &hist);
+            if (!j_op_lat_count(&hist))
+            {
+                continue;
+            }
+
+            seq_printf(s, "  %-6s:", j_op_phase_name[phase]);
+            for (i = 0; i < J_OP_LAT_BUCKETS; i++)
+            {
+                if (!hist.buckets[i])
+                {
+                    continue;
+                }
+
+                if (i == J_OP_LAT_BUCKETS - 1)
+                {
+                    seq_puts(s, " more");
+                }
+                else
+                {
+                    j_op_lat_show_bound(s, i);
+                }
+                seq_printf(s, " %llu", hist.buckets[i]);
+            }
+            seq_putc(s, '\n');
+        }
+    }
+}
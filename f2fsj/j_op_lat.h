@@ -0,0 +1,120 @@
+/**
+ * @file j_op_lat.h
+ * @author leslie.cui (10033908@github.com)
+ * @brief per operation latency, split into f2fs core work and journal phases, in per-cpu histograms.
+ *        Shown in /proc/fs/f2fsj/<dev>/j_op_latency, timing is on while sysfs j_op_latency is set.
+ *
+ *        An operation keeps a j_op_lat_t on its stack, the journal logging step (log construction with
+ *        log entry allocation and insertion) and the wait for epoch commit are timed around their call
+ *        sites, core is what remains of the operation. Log entry allocation and insertion run deep in
+ *        the log helpers, they are attributed to the operation by log type.
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef _J_OP_LAT_H_
+#define _J_OP_LAT_H_
+
+#include <linux/seq_file.h>
+#include "j_log_content.h"
+
+#define J_DEF_OP_LATENCY    (0)     ///< timing costs two clock reads per phase, off by default
+
+///< bucket 0 counts latency below 256 ns, bucket i counts [2^(i+7), 2^(i+8)) ns, the last one everything above
+#define J_OP_LAT_BUCKETS    (24)
+
+typedef enum __j_op_e
+{
+    J_OP_CREATE      = 0,
+    J_OP_MKDIR       = 1,
+    J_OP_UNLINK      = 2,
+    J_OP_RENAME      = 3,
+    J_OP_SETATTR     = 4,
+    J_OP_WRITE_BEGIN = 5,
+    J_OP_WRITE_END   = 6,
+    J_OP_FSYNC       = 7,
+    J_OP_NR,
+}j_op_e;
+
+typedef enum __j_op_phase_e
+{
+    J_OP_PHASE_TOTAL  = 0,
+    J_OP_PHASE_CORE   = 1,      ///< f2fs work, total minus log and commit wait
+    J_OP_PHASE_LOG    = 2,      ///< journal logging step, includes alloc and insert below
+    J_OP_PHASE_ALLOC  = 3,      ///< j_alloc_log_entries()
+    J_OP_PHASE_INSERT = 4,      ///< insert_log_into_inode()
+    J_OP_PHASE_COMMIT = 5,      ///< waiting on epoch commit
+    J_OP_NR_PHASES,
+}j_op_phase_e;
+
+typedef struct __j_op_lat
+{
+    uint64_t start_ns;          ///< 0: operation is not timed
+    uint64_t phase_start_ns;
+    uint64_t log_ns;
+    uint64_t commit_ns;
+    j_op_e   op;
+}j_op_lat_t;
+
+extern bool g_j_op_lat_on;
+
+static inline uint64_t j_op_lat_now(void)
+{
+    return READ_ONCE(g_j_op_lat_on) ? get_current_time_ns() : 0;
+}
+
+static inline void j_op_lat_begin(j_op_lat_t *lat, j_op_e op)
+{
+    lat->start_ns = j_op_lat_now();
+    lat->log_ns = 0;
+    lat->commit_ns = 0;
+    lat->op = op;
+}
+
+/**
+ * @brief Start timing J_OP_PHASE_LOG or J_OP_PHASE_COMMIT, lat may be NULL
+ */
+static inline void j_op_lat_phase_begin(j_op_lat_t *lat)
+{
+    if (lat && lat->start_ns)
+    {
+        lat->phase_start_ns = get_current_time_ns();
+    }
+}
+
+static inline void j_op_lat_phase_end(j_op_lat_t *lat, j_op_phase_e phase)
+{
+    if (lat && lat->start_ns)
+    {
+        if (phase == J_OP_PHASE_COMMIT)
+        {
+            lat->commit_ns += get_current_time_ns() - lat->phase_start_ns;
+        }
+        else
+        {
+            lat->log_ns += get_current_time_ns() - lat->phase_start_ns;
+        }
+    }
+}
+
+void j_op_lat_end(j_op_lat_t *lat);
+
+/**
+ * @brief Account log entry allocation or insertion to the operation which writes this log type
+ *
+ * @param log_type
+ * @param phase J_OP_PHASE_ALLOC or J_OP_PHASE_INSERT
+ * @param start_ns from j_op_lat_now(), 0 is not timed
+ */
+void j_op_lat_log_phase(log_type_e log_type, j_op_phase_e phase, uint64_t start_ns);
+
+/**
+ * @brief Turn timing on or off, turning it on clears the histograms
+ */
+void j_op_lat_enable(bool on);
+
+void j_op_lat_show(struct seq_file *s);
+
+#endif // !_J_OP_LAT_H_
@@ -1,5 +1,9 @@
 #include <linux/f2fs_fs.h>
 #include "j_recovery.h"
+#include "j_journal_file.h"
+#include "j_log_operate.h"
+#include "xattr.h"
+#include <linux/falloc.h>
 #include <trace/events/f2fs.h>
 #include <asm/unaligned.h>
 
@@ -374,4 +378,641 @@ err:
     INFO_REPORT("recovery unlink log happens err\n");
     return err;
 
-}
\ No newline at end of file
+}
+/**
+ * @brief name of a namespace log is stored from the second log entry
+ */
+static inline struct qstr j_log_name(void *log, uint32_t ofs, uint32_t len)
+{
+    struct qstr name = QSTR_INIT((uint8_t *)log + J_LOG_ENTRY_SIZE + ofs, len);
+    return name;
+}
+
+static void j_recover_dotdot(struct inode *inode, struct inode *new_parent)
+{
+    struct page *dotdot_page = NULL;
+    struct f2fs_dir_entry *dotdot = NULL;
+
+    dotdot = f2fs_parent_dir(inode, &dotdot_page);
+    if (dotdot)
+    {
+        f2fs_set_link(inode, dotdot, dotdot_page, new_parent);
+    }
+    f2fs_i_pino_write(inode, new_parent->i_ino);
+}
+
+int j_recover_link(struct super_block *sb, link_log_t *link_log)
+{
+    int err;
+    struct inode *p_dir = NULL;
+    struct inode *inode = NULL;
+    struct qstr name = j_log_name(link_log, 0, link_log->name_len);
+
+    p_dir = f2fs_iget_retry(sb, link_log->parent_ino);
+    if (IS_ERR(p_dir))
+    {
+        INFO_REPORT("get parent ino %d failed\n", link_log->parent_ino);
+        return PTR_ERR(p_dir);
+    }
+
+    inode = f2fs_iget_retry(sb, link_log->ino_num);
+    if (IS_ERR(inode))
+    {
+        INFO_REPORT("get linked inode %d err\n", link_log->ino_num);
+        iput(p_dir);
+        return PTR_ERR(inode);
+    }
+
+    // a replayed link may already be applied by checkpoint
+    err = f2fs_do_add_link(p_dir, &name, inode, inode->i_ino, inode->i_mode);
+    if (err == -EEXIST)
+    {
+        err = 0;
+    }
+
+    if (!err && inode->i_nlink < link_log->ino_nlink)
+    {
+        set_nlink(inode, link_log->ino_nlink);
+        f2fs_mark_inode_dirty_sync(inode, true);
+    }
+
+    iput(inode);
+    iput(p_dir);
+    return err;
+}
+
+int j_recover_symlink(struct super_block *sb, symlink_log_t *symlink_log)
+{
+    int err;
+    struct inode *p_dir = NULL;
+    struct inode *inode = NULL;
+    struct page *page = NULL;
+    struct f2fs_filename fname;
+    uint32_t name_len = le32_to_cpu(symlink_log->j_new_inode.i_namelen);
+    uint32_t target_len = le64_to_cpu(symlink_log->j_new_inode.i_size);
+    struct qstr name = j_log_name(symlink_log, 0, name_len);
+    char *target = NULL;
+
+    p_dir = f2fs_iget_retry(sb, symlink_log->j_new_inode.i_pino);
+    if (IS_ERR(p_dir))
+    {
+        INFO_REPORT("get parent ino %d failed\n", symlink_log->j_new_inode.i_pino);
+        return PTR_ERR(p_dir);
+    }
+
+    // already applied by checkpoint
+    if (f2fs_find_entry(p_dir, &name, &page))
+    {
+        f2fs_put_page(page, 0);
+        err = 0;
+        goto out_dir;
+    }
+
+    // page_symlink() writes the terminating NUL
+    target = kmalloc(target_len + 1, GFP_KERNEL);
+    if (!target)
+    {
+        err = -ENOMEM;
+        goto out_dir;
+    }
+    memcpy(target, (uint8_t *)symlink_log + J_LOG_ENTRY_SIZE + name_len, target_len);
+    target[target_len] = '\0';
+
+    inode = f2fs_new_inode_from_journal(p_dir, &symlink_log->j_new_inode);
+    if (IS_ERR(inode))
+    {
+        err = PTR_ERR(inode);
+        goto out_target;
+    }
+
+    inode->i_op = &f2fs_symlink_inode_operations;
+    inode_nohighmem(inode);
+    inode->i_mapping->a_ops = &f2fs_dblock_aops;
+
+    err = f2fs_setup_filename(p_dir, &name, 0, &fname);
+    if (err)
+    {
+        goto out_inode;
+    }
+    err = f2fs_add_dentry(p_dir, &fname, inode, inode->i_ino, inode->i_mode);
+    f2fs_free_filename(&fname);
+    if (err)
+    {
+        INFO_REPORT("recover symlink dentry fail\n");
+        goto out_inode;
+    }
+    f2fs_alloc_nid_done(F2FS_I_SB(p_dir), inode->i_ino);
+
+    err = page_symlink(inode, target, target_len + 1);
+    iput(inode);
+    goto out_target;
+
+out_inode:
+    f2fs_handle_failed_inode(inode);
+out_target:
+    kfree(target);
+out_dir:
+    iput(p_dir);
+    return err;
+}
+
+int j_recover_rename(struct super_block *sb, rename_log_t *rename_log)
+{
+    int err = 0;
+    struct inode *old_dir = NULL, *new_dir = NULL;
+    struct inode *inode = NULL, *target = NULL, *whiteout = NULL;
+    struct page *old_page = NULL, *new_page = NULL;
+    struct f2fs_dir_entry *old_entry = NULL, *new_entry = NULL;
+    struct qstr old_name = j_log_name(rename_log, 0, rename_log->old_name_len);
+    struct qstr new_name = j_log_name(rename_log, rename_log->old_name_len, rename_log->new_name_len);
+    bool is_dir = S_ISDIR(rename_log->i_mode);
+
+    old_dir = f2fs_iget_retry(sb, rename_log->old_parent_ino);
+    if (IS_ERR(old_dir))
+    {
+        return PTR_ERR(old_dir);
+    }
+    new_dir = f2fs_iget_retry(sb, rename_log->new_parent_ino);
+    if (IS_ERR(new_dir))
+    {
+        err = PTR_ERR(new_dir);
+        new_dir = NULL;
+        goto out;
+    }
+    inode = f2fs_iget_retry(sb, rename_log->ino_num);
+    if (IS_ERR(inode))
+    {
+        err = PTR_ERR(inode);
+        inode = NULL;
+        goto out;
+    }
+
+    // old name is gone or points to another inode (exchanged, whiteout): already applied
+    old_entry = f2fs_find_entry(old_dir, &old_name, &old_page);
+    if (!old_entry || le32_to_cpu(old_entry->ino) != rename_log->ino_num)
+    {
+        if (!old_entry)
+        {
+            old_page = NULL;
+        }
+        goto out_old;
+    }
+
+    new_entry = f2fs_find_entry(new_dir, &new_name, &new_page);
+    if (new_entry)
+    {
+        target = f2fs_iget_retry(sb, le32_to_cpu(new_entry->ino));
+        if (IS_ERR(target))
+        {
+            err = PTR_ERR(target);
+            target = NULL;
+            f2fs_put_page(new_page, 0);
+            goto out_old;
+        }
+    }
+
+    if (rename_log->flags & J_RENAME_EXCHANGE)
+    {
+        if (!target || target->i_ino != rename_log->target_ino)
+        {
+            f2fs_put_page(new_page, 0);
+            goto out_old;
+        }
+
+        f2fs_set_link(old_dir, old_entry, old_page, target);
+        f2fs_set_link(new_dir, new_entry, new_page, inode);
+        if (old_dir != new_dir)
+        {
+            if (is_dir)
+            {
+                j_recover_dotdot(inode, new_dir);
+            }
+            if (S_ISDIR(target->i_mode))
+            {
+                j_recover_dotdot(target, old_dir);
+            }
+            if (is_dir != S_ISDIR(target->i_mode))
+            {
+                f2fs_i_links_write(old_dir, !is_dir);
+                f2fs_i_links_write(new_dir, is_dir);
+            }
+        }
+        goto out;
+    }
+
+    if (target)
+    {
+        f2fs_set_link(new_dir, new_entry, new_page, inode);
+        if (target->i_nlink > rename_log->target_nlink)
+        {
+            set_nlink(target, rename_log->target_nlink);
+            f2fs_mark_inode_dirty_sync(target, true);
+        }
+        if (!target->i_nlink && !f2fs_acquire_orphan_inode(F2FS_I_SB(target)))
+        {
+            f2fs_add_orphan_inode(target);
+        }
+    }
+    else
+    {
+        err = f2fs_do_add_link(new_dir, &new_name, inode, inode->i_ino, inode->i_mode);
+        if (err)
+        {
+            goto out_old;
+        }
+        if (is_dir)
+        {
+            f2fs_i_links_write(new_dir, true);
+        }
+    }
+
+    f2fs_delete_entry(old_entry, old_page, old_dir, NULL);
+    old_page = NULL;
+
+    if (rename_log->flags & J_RENAME_WHITEOUT)
+    {
+        // whiteout inode is not journaled, it may be lost with the crash
+        whiteout = f2fs_iget_retry(sb, rename_log->whiteout_ino);
+        if (!IS_ERR(whiteout))
+        {
+            if (!whiteout->i_nlink)
+            {
+                set_inode_flag(whiteout, FI_INC_LINK);
+            }
+            f2fs_do_add_link(old_dir, &old_name, whiteout, whiteout->i_ino, whiteout->i_mode);
+            clear_inode_flag(whiteout, FI_INC_LINK);
+            iput(whiteout);
+        }
+    }
+
+    if (is_dir)
+    {
+        if (old_dir != new_dir && !(rename_log->flags & J_RENAME_WHITEOUT))
+        {
+            j_recover_dotdot(inode, new_dir);
+        }
+        f2fs_i_links_write(old_dir, false);
+    }
+
+out_old:
+    if (old_page)
+    {
+        f2fs_put_page(old_page, 0);
+    }
+out:
+    if (target)
+    {
+        iput(target);
+    }
+    if (inode)
+    {
+        iput(inode);
+    }
+    if (new_dir)
+    {
+        iput(new_dir);
+    }
+    iput(old_dir);
+    return err;
+}
+
+int j_recover_setattr(struct super_block *sb, chown_log_t *chown_log)
+{
+    struct inode *inode = NULL;
+
+    inode = f2fs_iget_retry(sb, chown_log->ino_num);
+    if (IS_ERR(inode))
+    {
+        INFO_REPORT("get setattr inode %d err\n", chown_log->ino_num);
+        return PTR_ERR(inode);
+    }
+
+    inode->i_mode = chown_log->i_mode;
+    i_uid_write(inode, chown_log->i_uid);
+    i_gid_write(inode, chown_log->i_gid);
+    inode->i_atime.tv_sec  = chown_log->i_atime;
+    inode->i_ctime.tv_sec  = chown_log->i_ctime;
+    inode->i_mtime.tv_sec  = chown_log->i_mtime;
+    inode->i_atime.tv_nsec = chown_log->i_atime_nsec;
+    inode->i_ctime.tv_nsec = chown_log->i_ctime_nsec;
+    inode->i_mtime.tv_nsec = chown_log->i_mtime_nsec;
+    if (chown_log->ia_valid & ATTR_SIZE)
+    {
+        f2fs_i_size_write(inode, chown_log->i_size);
+    }
+    f2fs_mark_inode_dirty_sync(inode, true);
+
+    iput(inode);
+    return F2FSJ_OK;
+}
+
+int j_recover_atime(struct super_block *sb, read_stat_log_t *atime_log)
+{
+    struct inode *inode = NULL;
+    struct timespec64 atime = {
+        .tv_sec  = atime_log->access_time_s,
+        .tv_nsec = atime_log->access_time_ns,
+    };
+
+    inode = f2fs_iget_retry(sb, atime_log->ino_num);
+    if (IS_ERR(inode))
+    {
+        INFO_REPORT("get accessed inode %d err\n", atime_log->ino_num);
+        return PTR_ERR(inode);
+    }
+
+    if (timespec64_compare(&atime, &inode->i_atime) > 0)
+    {
+        inode->i_atime = atime;
+        f2fs_mark_inode_dirty_sync(inode, true);
+    }
+
+    iput(inode);
+    return F2FSJ_OK;
+}
+
+int j_recover_xattr(struct super_block *sb, xattr_log_t *xattr_log)
+{
+    int err;
+    struct inode *inode = NULL;
+    char name[F2FS_NAME_LEN + 1];
+    uint8_t *value = (uint8_t *)xattr_log + J_LOG_ENTRY_SIZE + xattr_log->name_len;
+
+    inode = f2fs_iget_retry(sb, xattr_log->ino_num);
+    if (IS_ERR(inode))
+    {
+        INFO_REPORT("get xattr inode %d err\n", xattr_log->ino_num);
+        return PTR_ERR(inode);
+    }
+
+    // f2fs_setxattr() takes a NUL terminated name
+    memcpy(name, (uint8_t *)xattr_log + J_LOG_ENTRY_SIZE, xattr_log->name_len);
+    name[xattr_log->name_len] = '\0';
+
+    err = f2fs_setxattr(inode, xattr_log->name_index, name,
+                        (xattr_log->flags & J_XATTR_REMOVE) ? NULL : value,
+                        xattr_log->value_len, NULL, 0);
+    // removing an xattr which is not on disk
+    if (err == -ENODATA)
+    {
+        err = 0;
+    }
+
+    if (!err && inode->i_mode != xattr_log->i_mode)
+    {
+        inode->i_mode = xattr_log->i_mode;
+        f2fs_mark_inode_dirty_sync(inode, true);
+    }
+
+    iput(inode);
+    return err;
+}
+
+int j_recover_range(struct super_block *sb, range_log_t *range_log)
+{
+    int err = 0;
+    struct inode *inode = NULL;
+
+    inode = f2fs_iget_retry(sb, range_log->ino_num);
+    if (IS_ERR(inode))
+    {
+        INFO_REPORT("get inode %d of range log err\n", range_log->ino_num);
+        return PTR_ERR(inode);
+    }
+
+    inode_lock(inode);
+    if (range_log->log_header.log_type == TRUNCATE_LOG)
+    {
+        if (i_size_read(inode) > range_log->new_size)
+        {
+            truncate_setsize(inode, range_log->new_size);
+            err = f2fsj_truncate(inode);
+        }
+        else
+        {
+            f2fs_i_size_write(inode, range_log->new_size);
+        }
+    }
+    else if (!(range_log->mode & (FALLOC_FL_COLLAPSE_RANGE | FALLOC_FL_INSERT_RANGE))
+          || i_size_read(inode) == range_log->old_size)
+    {
+        err = f2fsj_do_fallocate(inode, range_log->mode, range_log->offset, range_log->len);
+    }
+    inode_unlock(inode);
+
+    iput(inode);
+    return err;
+}
+
+///< orphans replayed from journal, freed by f2fs_recover_orphan_inodes() once mount is ready
+typedef struct __j_orphan_ino
+{
+    struct list_head list;
+    nid_t ino;
+}j_orphan_ino_t;
+
+static LIST_HEAD(g_j_orphan_list);
+
+int j_recover_orphan(struct super_block *sb, orphan_log_t *orphan_log)
+{
+    j_orphan_ino_t *orphan = NULL;
+    j_orphan_ino_t *tmp = NULL;
+
+    // one inode is logged again by every checkpoint while it is open
+    list_for_each_entry_safe(orphan, tmp, &g_j_orphan_list, list)
+    {
+        if (orphan->ino == orphan_log->ino_num)
+        {
+            if (orphan_log->flags & J_ORPHAN_RELINK)
+            {
+                list_del(&orphan->list);
+                kfree(orphan);
+            }
+            return F2FSJ_OK;
+        }
+    }
+
+    if (orphan_log->flags & J_ORPHAN_RELINK)
+    {
+        return F2FSJ_OK;
+    }
+
+    orphan = kmalloc(sizeof(j_orphan_ino_t), GFP_KERNEL);
+    if (!orphan)
+    {
+        STATUS_LOG(STATUS_ERROR, "alloc orphan %u fail\n", orphan_log->ino_num);
+        set_sbi_flag(F2FS_SB(sb), SBI_NEED_FSCK);
+        return -ENOMEM;
+    }
+    orphan->ino = orphan_log->ino_num;
+    list_add_tail(&orphan->list, &g_j_orphan_list);
+
+    return F2FSJ_OK;
+}
+
+bool j_has_journal_orphans(void)
+{
+    return !list_empty(&g_j_orphan_list);
+}
+
+nid_t j_pop_journal_orphan(void)
+{
+    j_orphan_ino_t *orphan = NULL;
+    nid_t ino = 0;
+
+    orphan = list_first_entry_or_null(&g_j_orphan_list, j_orphan_ino_t, list);
+    if (orphan)
+    {
+        ino = orphan->ino;
+        list_del(&orphan->list);
+        kfree(orphan);
+    }
+    return ino;
+}
+
+void j_drop_journal_orphans(void)
+{
+    while (j_pop_journal_orphan())
+        ;
+}
+
+///< META_DELTA_LOGs read from journal, replayed by j_replay_journal_meta_deltas() once managers are built
+typedef struct __j_meta_delta_rec
+{
+    struct list_head list;
+    uint32_t nr_deltas;
+    uint32_t flags;
+    uint64_t cp_ver;
+    j_meta_delta_t deltas[];
+}j_meta_delta_rec_t;
+
+static LIST_HEAD(g_j_meta_delta_list);
+
+int j_recover_meta_delta(struct super_block *sb, meta_delta_log_t *delta_log)
+{
+    j_meta_delta_rec_t *rec = NULL;
+
+    if (delta_log->nr_deltas > J_META_DELTAS_PER_LOG)
+    {
+        set_sbi_flag(F2FS_SB(sb), SBI_NEED_FSCK);
+        return -EFSCORRUPTED;
+    }
+
+    // journal is reused once it is read, keep the deltas
+    rec = kmalloc(struct_size(rec, deltas, delta_log->nr_deltas), GFP_KERNEL);
+    if (!rec)
+    {
+        STATUS_LOG(STATUS_ERROR, "alloc %u meta deltas fail\n", delta_log->nr_deltas);
+        set_sbi_flag(F2FS_SB(sb), SBI_NEED_FSCK);
+        return -ENOMEM;
+    }
+    rec->nr_deltas = delta_log->nr_deltas;
+    rec->flags     = delta_log->flags;
+    rec->cp_ver    = delta_log->cp_ver;
+    memcpy(rec->deltas, (uint8_t *)delta_log + J_LOG_ENTRY_SIZE, rec->nr_deltas * sizeof(j_meta_delta_t));
+    list_add_tail(&rec->list, &g_j_meta_delta_list);
+
+    return F2FSJ_OK;
+}
+
+static int j_replay_meta_delta_rec(struct f2fs_sb_info *sbi, j_meta_delta_rec_t *rec)
+{
+    j_meta_delta_t *delta = rec->deltas;
+    uint32_t i = 0;
+    int err = 0;
+
+    for (i = 0; i < rec->nr_deltas; i++, delta++)
+    {
+        if (delta->delta_type == J_DELTA_NAT)
+        {
+            err = f2fsj_replay_nat_delta(sbi, delta->nat.j_nid, delta->nat.j_ino,
+                                         delta->nat.j_node_lba, delta->version);
+        }
+        else if (delta->delta_type == J_DELTA_SIT)
+        {
+            f2fsj_replay_sit_delta(sbi, delta->sit.segno, delta->sit.blkofs, delta->sit.valid_delta);
+        }
+        else if (delta->delta_type == J_DELTA_SSA)
+        {
+            f2fsj_replay_ssa_delta(sbi, delta->ssa.segno, delta->ssa.blkofs, delta->ssa.j_nid,
+                                   delta->ssa.ofs_in_node, delta->version);
+        }
+        else if (delta->delta_type == J_DELTA_GC_MOVE)
+        {
+            err = f2fsj_replay_gc_move(sbi, delta->move.j_nid, delta->ofs_in_node,
+                                       delta->move.old_blkaddr, delta->move.new_blkaddr);
+        }
+
+        if (err)
+        {
+            INFO_REPORT("replay meta delta type %u err %d\n", delta->delta_type, err);
+            set_sbi_flag(sbi, SBI_NEED_FSCK);
+            return err;
+        }
+    }
+
+    return 0;
+}
+
+int j_replay_journal_meta_deltas(struct f2fs_sb_info *sbi)
+{
+    j_meta_delta_rec_t *rec = NULL;
+    uint64_t cp_ver = cur_cp_version(F2FS_CKPT(sbi));
+    uint64_t nr_deltas = 0;
+    int err = 0;
+
+    // deltas made from now on, replayed ones included, are after the checkpoint mount starts from
+    j_meta_deltas_new_checkpoint(cp_ver);
+
+    if (list_empty(&g_j_meta_delta_list))
+    {
+        return 0;
+    }
+
+    if (f2fs_hw_is_readonly(sbi))
+    {
+        INFO_REPORT("read only device, meta deltas are not replayed\n");
+        j_drop_journal_meta_deltas();
+        return 0;
+    }
+
+    list_for_each_entry(rec, &g_j_meta_delta_list, list)
+    {
+        // NAT/SIT/SSA of deltas made before the checkpoint are in it, so is a hole among them
+        if (rec->cp_ver < cp_ver)
+        {
+            continue;
+        }
+
+        // a hole before this log, deltas after it may depend on dropped ones
+        if (rec->flags & J_META_DELTA_LOST)
+        {
+            INFO_REPORT("meta deltas were dropped, stop replaying deltas\n");
+            set_sbi_flag(sbi, SBI_NEED_FSCK);
+            break;
+        }
+
+        err = j_replay_meta_delta_rec(sbi, rec);
+        if (err)
+        {
+            break;
+        }
+        nr_deltas += rec->nr_deltas;
+    }
+
+    INFO_REPORT("replay %llu meta deltas, err %d\n", nr_deltas, err);
+    j_drop_journal_meta_deltas();
+    return err;
+}
+
+void j_drop_journal_meta_deltas(void)
+{
+    j_meta_delta_rec_t *rec = NULL;
+    j_meta_delta_rec_t *rec_next = NULL;
+
+    list_for_each_entry_safe(rec, rec_next, &g_j_meta_delta_list, list)
+    {
+        list_del(&rec->list);
+        kfree(rec);
+    }
+}
@@ -8,4 +8,65 @@
 int j_recover_new_inode(struct super_block *sb, j_new_inode_log_t * new_inode_log);
 
 int j_recover_unlink(struct super_block *sb, delete_log_t *delete_log);
+
+/**
+ * @brief replay namespace logs, names follow the fixed part of the log (log is continuous in memory).
+ *        A log may be already applied by checkpoint, replay skips what is already on disk
+ */
+int j_recover_link(struct super_block *sb, link_log_t *link_log);
+
+int j_recover_symlink(struct super_block *sb, symlink_log_t *symlink_log);
+
+int j_recover_rename(struct super_block *sb, rename_log_t *rename_log);
+
+/**
+ * @brief attributes in the log are absolute, replay is idempotent.
+ *        Blocks beyond a smaller i_size are not truncated (they are not journaled)
+ */
+int j_recover_setattr(struct super_block *sb, chown_log_t *chown_log);
+
+/**
+ * @brief access time only moves forward, an older log does not overwrite a newer atime
+ */
+int j_recover_atime(struct super_block *sb, read_stat_log_t *atime_log);
+
+/**
+ * @brief set or remove the xattr again, setting the same value is a no-op of f2fs_setxattr()
+ */
+int j_recover_xattr(struct super_block *sb, xattr_log_t *xattr_log);
+
+/**
+ * @brief truncate, preallocate, punch and zero range are idempotent; collapse and insert range
+ *        are replayed only if i_size is still the one before the operation
+ */
+int j_recover_range(struct super_block *sb, range_log_t *range_log);
+
+/**
+ * @brief meta deltas are collected while journal is read at mount, node and segment managers
+ *        are not built yet. They are replayed by j_replay_journal_meta_deltas()
+ */
+int j_recover_meta_delta(struct super_block *sb, meta_delta_log_t *delta_log);
+
+/**
+ * @brief roll NAT, SIT and SSA forward in the order deltas were made, up to the first hole.
+ *        Deltas made before the current checkpoint are skipped. Node and segment managers must be built
+ *
+ * @return 0 or the error of the first delta that cannot be replayed
+ */
+int j_replay_journal_meta_deltas(struct f2fs_sb_info *sbi);
+
+void j_drop_journal_meta_deltas(void);
+
+/**
+ * @brief orphans are collected while journal is read at mount, relink drops the orphan.
+ *        They are freed by f2fs_recover_orphan_inodes() with orphans of checkpoint
+ */
+int j_recover_orphan(struct super_block *sb, orphan_log_t *orphan_log);
+
+bool j_has_journal_orphans(void);
+
+///< @return 0 if no orphan is left
+nid_t j_pop_journal_orphan(void);
+
+void j_drop_journal_orphans(void);
 #endif // !__J_RECOVERY_H__
\ No newline at end of file
@@ -0,0 +1,227 @@
+/**
+ * @file j_stats.c
+ * @author leslie.cui (10033908@github.com)
+ * @brief implementation of journal statistics
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ */
+#include "j_stats.h"
+#include "j_journal_file.h"
+#include "j_epoch.h"
+#include "j_checkpoint.h"
+#include <linux/log2.h>
+
+#define CREATE_TRACE_POINTS
+#include "j_trace.h"
+
+j_journal_stats_t g_j_stats;
+bool g_j_stat_lock_hold_on = false;
+
+static DECLARE_WAIT_QUEUE_HEAD(j_crash_wq);
+
+static const char *j_log_type_name[J_STAT_NR_LOG_TYPES] =
+{
+    [CREATE_LOG]         = "create",
+    [MKDIR_LOG]          = "mkdir",
+    [UNLINK_LOG]         = "unlink",
+    [LINK_LOG]           = "link",
+    [RENAME_LOG]         = "rename",
+    [SYMLINK_LOG]        = "symlink",
+    [CHOWN_LOG]          = "setattr",
+    [DIR_LOG]            = "dir",
+    [READ_FILE_DATA_LOG] = "read_file",
+    [READ_DIR_LOG]       = "read_dir",
+    [STAT_LOG]           = "stat",
+    [DATA_WRITE_LOG]     = "data_write",
+    [DATA_JOURNAL_LOG]   = "data_journal",
+    [XATTR_LOG]          = "xattr",
+    [TRUNCATE_LOG]       = "truncate",
+    [FALLOCATE_LOG]      = "fallocate",
+    [PUNCH_LOG]          = "punch",
+    [ORPHAN_LOG]         = "orphan",
+    [META_DELTA_LOG]     = "meta_delta",
+    [COMPACT_LOG]        = "compact",
+};
+
+static const char *j_lock_name[J_STAT_NR_LOCKS] =
+{
+    [J_STAT_LOCK_EPOCH_SWITCH] = "epoch_switch_spin_lock",
+    [J_STAT_LOCK_JFILE_MEMAP]  = "j_file_memap_lock",
+    [J_STAT_LOCK_META_DELTA]   = "meta_delta_lock",
+};
+
+const char *j_stat_lock_name(j_stat_lock_e lock_idx)
+{
+    return j_lock_name[lock_idx];
+}
+
+void j_stat_latency(j_stat_lat_hist_t *hist, uint64_t start_ns)
+{
+    uint64_t lat_us = div_u64(get_current_time_ns() - start_ns, 1000);
+    uint64_t max_us = atomic64_read(&hist->max_us);
+    uint32_t bucket = lat_us ? ilog2(lat_us) + 1 : 0;
+
+    atomic64_inc(&hist->buckets[min_t(uint32_t, bucket, J_STAT_LAT_BUCKETS - 1)]);
+    atomic64_add(lat_us, &hist->total_us);
+
+    while (lat_us > max_us)
+    {
+        max_us = atomic64_cmpxchg(&hist->max_us, max_us, lat_us);
+    }
+}
+
+void j_stat_stall(uint64_t start_ns)
+{
+    atomic64_inc(&g_j_stats.nr_stalls);
+    atomic64_add(div_u64(get_current_time_ns() - start_ns, 1000), &g_j_stats.stall_us);
+}
+
+void j_stat_lock_hold(j_stat_lock_e lock_idx)
+{
+    uint64_t hold_ns = get_current_time_ns() - g_j_stats.lock_acquired_ns[lock_idx];
+    uint64_t max_ns = atomic64_read(&g_j_stats.lock_max_hold_ns[lock_idx]);
+
+    g_j_stats.lock_acquired_ns[lock_idx] = 0;
+    atomic64_inc(&g_j_stats.lock_nr_held[lock_idx]);
+    atomic64_add(hold_ns, &g_j_stats.lock_hold_ns[lock_idx]);
+
+    while (hold_ns > max_ns)
+    {
+        max_ns = atomic64_cmpxchg(&g_j_stats.lock_max_hold_ns[lock_idx], max_ns, hold_ns);
+    }
+}
+
+void j_stat_lock_hold_enable(bool on)
+{
+    int i = 0;
+
+    if (on)
+    {
+        for (i = 0; i < J_STAT_NR_LOCKS; i++)
+        {
+            atomic64_set(&g_j_stats.lock_nr_held[i], 0);
+            atomic64_set(&g_j_stats.lock_hold_ns[i], 0);
+            atomic64_set(&g_j_stats.lock_max_hold_ns[i], 0);
+        }
+    }
+    WRITE_ONCE(g_j_stat_lock_hold_on, on);
+}
+
+unsigned int j_stat_journal_fill(void)
+{
+    int free_space = get_on_disk_free_journal_space();
+
+    return 100 - div_u64((uint64_t)free_space * 100, JOURNAL_FILE_SIZE);
+}
+
+void j_stats_reset(void)
+{
+    memset(&g_j_stats, 0, sizeof(g_j_stats));
+}
+
+void j_crash_point(struct f2fs_sb_info *sbi, j_crash_point_e point)
+{
+    if (likely(READ_ONCE(sbi->j_crash_point) != point))
+    {
+        return;
+    }
+
+    INFO_REPORT("crash point %d reached, hold journal\n", point);
+    WRITE_ONCE(sbi->j_crash_hit, point);
+    if (!wait_event_timeout(j_crash_wq, READ_ONCE(sbi->j_crash_point) != point, J_CRASH_HOLD_SEC * HZ))
+    {
+        STATUS_LOG(STATUS_WARNING, "crash point %d is not released in %d s, go on\n", point, J_CRASH_HOLD_SEC);
+        WRITE_ONCE(sbi->j_crash_point, J_CRASH_NONE);
+    }
+}
+
+void j_crash_release(void)
+{
+    wake_up_all(&j_crash_wq);
+}
+
+static void j_stats_show_latency(struct seq_file *s, const char *name, j_stat_lat_hist_t *hist)
+{
+    uint64_t count = 0;
+    int i = 0;
+
+    for (i = 0; i < J_STAT_LAT_BUCKETS; i++)
+    {
+        count += atomic64_read(&hist->buckets[i]);
+    }
+
+    seq_printf(s, "  - %s: %llu, avg %llu us, max %llu us\n", name, count,
+               count ? div64_u64(atomic64_read(&hist->total_us), count) : 0,
+               (uint64_t)atomic64_read(&hist->max_us));
+
+    // only buckets in use, "<N us"
+    for (i = 0; i < J_STAT_LAT_BUCKETS; i++)
+    {
+        if (!atomic64_read(&hist->buckets[i]))
+        {
+            continue;
+        }
+
+        if (i == J_STAT_LAT_BUCKETS - 1)
+        {
+            seq_printf(s, "    >=%9llu us: %llu\n", 1ULL << (i - 1), (uint64_t)atomic64_read(&hist->buckets[i]));
+        }
+        else
+        {
+            seq_printf(s, "    < %9llu us: %llu\n", 1ULL << i, (uint64_t)atomic64_read(&hist->buckets[i]));
+        }
+    }
+}
+
+void j_stats_show(struct seq_file *s)
+{
+    int i = 0;
+
+    seq_puts(s, "\nJournal:\n");
+    seq_printf(s, "  - fill: %u%%, unapplied logs: %llu\n", j_stat_journal_fill(), get_nr_unapplied_logs());
+    seq_printf(s, "  - epoch ring: %d/%d in use\n", get_nr_busy_epochs(), MAX_GLOBAL_EP_NUM);
+    seq_printf(s, "  - epochs sealed: %llu, committed: %llu, applied: %llu\n",
+               (uint64_t)atomic64_read(&g_j_stats.epochs[J_STAT_EP_SEALED]),
+               (uint64_t)atomic64_read(&g_j_stats.epochs[J_STAT_EP_COMMITTED]),
+               (uint64_t)atomic64_read(&g_j_stats.epochs[J_STAT_EP_APPLIED]));
+    seq_printf(s, "  - logged: %llu KB, log alloc fail: %llu\n",
+               (uint64_t)atomic64_read(&g_j_stats.logged_bytes) >> 10,
+               (uint64_t)atomic64_read(&g_j_stats.nr_alloc_fail));
+
+    seq_puts(s, "  - logs:");
+    for (i = 0; i < J_STAT_NR_LOG_TYPES; i++)
+    {
+        if (atomic64_read(&g_j_stats.nr_logs[i]))
+        {
+            seq_printf(s, " %s %llu", j_log_type_name[i], (uint64_t)atomic64_read(&g_j_stats.nr_logs[i]));
+        }
+    }
+    seq_putc(s, '\n');
+
+    j_stats_show_latency(s, "commit", &g_j_stats.commit_lat);
+    j_stats_show_latency(s, "checkpoint", &g_j_stats.checkpoint_lat);
+
+    seq_printf(s, "  - fsync stalls: %llu, %llu us\n",
+               (uint64_t)atomic64_read(&g_j_stats.nr_stalls),
+               (uint64_t)atomic64_read(&g_j_stats.stall_us));
+
+    for (i = 0; i < J_STAT_NR_LOCKS; i++)
+    {
+        seq_printf(s, "  - %s contended: %llu\n", j_lock_name[i],
+                   (uint64_t)atomic64_read(&g_j_stats.lock_contended[i]));
+
+        if (atomic64_read(&g_j_stats.lock_nr_held[i]))
+        {
+            seq_printf(s, "    held: %llu, avg %llu ns, max %llu ns\n",
+                       (uint64_t)atomic64_read(&g_j_stats.lock_nr_held[i]),
+                       div64_u64(atomic64_read(&g_j_stats.lock_hold_ns[i]),
+                                 atomic64_read(&g_j_stats.lock_nr_held[i])),
+                       (uint64_t)atomic64_read(&g_j_stats.lock_max_hold_ns[i]));
+        }
+    }
+
+    seq_printf(s, "  - recovery: read %llu us, replay %llu us, %llu logs\n",
+               g_j_stats.recovery.read_us, g_j_stats.recovery.replay_us, g_j_stats.recovery.nr_logs);
+}
@@ -0,0 +1,174 @@
+/**
+ * @file j_stats.h
+ * @author leslie.cui (10033908@github.com)
+ * @brief journal statistics. Logs per type, epochs, commit/checkpoint latency, journal fill and
+ *        lock contention are counted here and shown in /proc/fs/f2fsj/<dev>/j_stats,
+ *        /sys/kernel/debug/f2fsj/status and a few sysfs entries. Journal (epochs, journal file) is
+ *        shared by the module, so are its statistics, they are reset at mount.
+ *        Crash points for recovery tests (sysfs j_crash_point) are here as well
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef _J_STATS_H_
+#define _J_STATS_H_
+
+#include <linux/atomic.h>
+#include <linux/spinlock.h>
+#include <linux/seq_file.h>
+#include "j_log_content.h"
+
+#define J_STAT_NR_LOG_TYPES (COMPACT_LOG + 1)
+
+///< bucket i counts latency in [2^(i-1), 2^i) us, the last one counts everything above
+#define J_STAT_LAT_BUCKETS  (20)
+
+typedef enum __j_stat_lock_e
+{
+    J_STAT_LOCK_EPOCH_SWITCH = 0,   ///< epoch_switch_spin_lock
+    J_STAT_LOCK_JFILE_MEMAP  = 1,   ///< j_file_memap_lock
+    J_STAT_LOCK_META_DELTA   = 2,   ///< lock of meta delta buffer, taken by every block allocation
+    J_STAT_NR_LOCKS,
+}j_stat_lock_e;
+
+typedef enum __j_stat_epoch_e
+{
+    J_STAT_EP_SEALED    = 0,    ///< running epoch is switched and waits for commit
+    J_STAT_EP_COMMITTED = 1,    ///< logs of the epoch are durable
+    J_STAT_EP_APPLIED   = 2,    ///< metadata of the epoch is written by checkpoint
+    J_STAT_NR_EPOCH_EVENTS,
+}j_stat_epoch_e;
+
+///< where sysfs j_crash_point holds the journal so that a test can cut writes to the device
+typedef enum __j_crash_point_e
+{
+    J_CRASH_NONE           = 0,
+    J_CRASH_COMMIT_DATA    = 1,     ///< epoch data is on disk, its logs are not
+    J_CRASH_COMMIT_JOURNAL = 2,     ///< logs of the epoch are on disk, its metadata is not applied
+    J_CRASH_CHECKPOINT     = 3,     ///< committed epochs are about to be applied by checkpoint
+    J_CRASH_NR_POINTS,
+}j_crash_point_e;
+
+#define J_CRASH_HOLD_SEC    (30)    ///< a point holds the journal at most this long
+
+typedef struct __j_stat_lat_hist
+{
+    atomic64_t buckets[J_STAT_LAT_BUCKETS];
+    atomic64_t total_us;
+    atomic64_t max_us;
+}j_stat_lat_hist_t;
+
+typedef struct __j_journal_stats
+{
+    atomic64_t nr_logs[J_STAT_NR_LOG_TYPES];
+    atomic64_t logged_bytes;
+    atomic64_t nr_alloc_fail;                   ///< log entry allocation refused, journal file waits for commit
+
+    atomic64_t epochs[J_STAT_NR_EPOCH_EVENTS];
+
+    j_stat_lat_hist_t commit_lat;               ///< one epoch_commit(), all sealed epochs
+    j_stat_lat_hist_t checkpoint_lat;
+
+    atomic64_t nr_stalls;                       ///< fsync waits for a running commit
+    atomic64_t stall_us;
+
+    atomic64_t lock_contended[J_STAT_NR_LOCKS];
+    atomic64_t lock_nr_held[J_STAT_NR_LOCKS];  ///< hold times, only while g_j_stat_lock_hold_on
+    atomic64_t lock_hold_ns[J_STAT_NR_LOCKS];
+    atomic64_t lock_max_hold_ns[J_STAT_NR_LOCKS];
+    uint64_t lock_acquired_ns[J_STAT_NR_LOCKS]; ///< written by the lock holder
+
+    struct
+    {
+        uint64_t read_us;                       ///< reading journal file, decompression included
+        uint64_t replay_us;                     ///< iterate_journal()
+        uint64_t nr_logs;                       ///< replayed
+    }recovery;                                  ///< of this mount
+}j_journal_stats_t;
+
+extern j_journal_stats_t g_j_stats;
+extern bool g_j_stat_lock_hold_on;
+
+static inline void j_stat_log(log_type_e log_type, uint32_t nr_bytes)
+{
+    if (log_type < J_STAT_NR_LOG_TYPES)
+    {
+        atomic64_inc(&g_j_stats.nr_logs[log_type]);
+    }
+    atomic64_add(nr_bytes, &g_j_stats.logged_bytes);
+}
+
+static inline void j_stat_epoch(j_stat_epoch_e event, uint64_t nr_epochs)
+{
+    atomic64_add(nr_epochs, &g_j_stats.epochs[event]);
+}
+
+void j_stat_latency(j_stat_lat_hist_t *hist, uint64_t start_ns);
+
+void j_stat_stall(uint64_t start_ns);
+
+/**
+ * @brief spin_lock() which counts how often the lock is held by someone else
+ */
+#define j_stat_spin_lock(__lock, __lock_idx)                                \
+do                                                                          \
+{                                                                           \
+    if (!spin_trylock(__lock))                                              \
+    {                                                                       \
+        atomic64_inc(&g_j_stats.lock_contended[__lock_idx]);                \
+        spin_lock(__lock);                                                  \
+    }                                                                       \
+    if (unlikely(READ_ONCE(g_j_stat_lock_hold_on)))                         \
+    {                                                                       \
+        g_j_stats.lock_acquired_ns[__lock_idx] = get_current_time_ns();     \
+    }                                                                       \
+} while (0)
+
+void j_stat_lock_hold(j_stat_lock_e lock_idx);
+
+/**
+ * @brief spin_unlock() of a lock taken by j_stat_spin_lock(), accounts how long it was held
+ *        while g_j_stat_lock_hold_on is set (j_stat_lock_hold_enable())
+ */
+#define j_stat_spin_unlock(__lock, __lock_idx)                              \
+do                                                                          \
+{                                                                           \
+    if (unlikely(g_j_stats.lock_acquired_ns[__lock_idx]))                   \
+    {                                                                       \
+        j_stat_lock_hold(__lock_idx);                                       \
+    }                                                                       \
+    spin_unlock(__lock);                                                    \
+} while (0)
+
+/**
+ * @brief Turn lock hold time accounting on or off, turning it on clears hold times
+ */
+void j_stat_lock_hold_enable(bool on);
+
+/**
+ * @brief Journal file in use, in percent
+ */
+unsigned int j_stat_journal_fill(void);
+
+void j_stats_reset(void);
+
+struct f2fs_sb_info;
+
+/**
+ * @brief Hold the caller while sysfs j_crash_point is set to point, at most J_CRASH_HOLD_SEC.
+ *        sysfs j_crash_hit tells the test that the point is reached
+ */
+void j_crash_point(struct f2fs_sb_info *sbi, j_crash_point_e point);
+
+/**
+ * @brief Wake up callers held by j_crash_point(), after sysfs j_crash_point is changed
+ */
+void j_crash_release(void);
+
+const char *j_stat_lock_name(j_stat_lock_e lock_idx);
+
+void j_stats_show(struct seq_file *s);
+
+#endif // !_J_STATS_H_
@@ -0,0 +1,669 @@
+/**
+ * @file j_stress.c
+ * @author leslie.cui (10033908@github.com)
+ * @brief implementation of the journal stress test
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ */
+#include <linux/kthread.h>
+#include <linux/cpumask.h>
+#include <linux/delay.h>
+#include <linux/random.h>
+#include <linux/log2.h>
+#include <linux/timex.h>
+#include "f2fs.h"
+#include "j_stress.h"
+#include "j_journal_file.h"
+#include "j_log_operate.h"
+#include "j_epoch_process.h"
+#include "j_stats.h"
+
+///< record number in i_size of a stress log: run | thread | log of the thread
+#define J_STRESS_RUN_SHIFT      (56)
+#define J_STRESS_THREAD_SHIFT   (40)
+
+typedef struct __j_stress_call
+{
+    uint64_t nr;
+    uint64_t cycles;
+    uint64_t max_cycles;
+    uint64_t buckets[J_STRESS_BUCKETS];
+}j_stress_call_t;
+
+typedef struct __j_stress j_stress_t;
+
+typedef struct __j_stress_thread
+{
+    j_stress_t *st;
+    uint32_t idx;
+    int cpu;
+    unsigned long *inserted;        ///< bitmaps of the records of this thread
+    unsigned long *committed;
+    j_stress_call_t calls[J_STRESS_NR_CALLS];
+    uint64_t nr_alloc_err;
+    uint64_t nr_insert_err;
+    uint64_t nr_commit_err;
+}j_stress_thread_t;
+
+struct __j_stress
+{
+    struct f2fs_sb_info *sbi;
+    uint8_t run;
+    uint32_t nr_threads;
+    uint64_t nr_ops;                ///< per thread
+    uint32_t commit_ops;
+    struct inode **files;
+    uint32_t nr_files;
+    j_stress_thread_t *threads;
+    j_stress_call_t cp_call;        ///< only touched by checkpoint kthread
+    struct completion start;
+    struct completion done;
+    atomic_t nr_running;
+    atomic64_t nr_dup;
+    atomic64_t nr_stray;
+};
+
+typedef struct __j_stress_result
+{
+    bool valid;
+    uint32_t nr_threads;
+    uint32_t nr_cpus;
+    uint32_t nr_files;
+    uint64_t nr_ops;
+    uint32_t commit_ops;
+    uint64_t elapsed_ns;
+    j_stress_call_t calls[J_STRESS_NR_CALLS];
+    uint64_t nr_inserted;
+    uint64_t nr_committed;
+    uint64_t nr_lost;
+    uint64_t nr_dup;
+    uint64_t nr_stray;
+    uint64_t nr_alloc_err;
+    uint64_t nr_insert_err;
+    uint64_t nr_commit_err;
+    uint64_t logged_bytes;
+    uint64_t nr_epochs;
+    uint64_t lock_contended[J_STAT_NR_LOCKS];
+    uint64_t lock_nr_held[J_STAT_NR_LOCKS];
+    uint64_t lock_hold_ns[J_STAT_NR_LOCKS];
+    uint64_t lock_max_hold_ns[J_STAT_NR_LOCKS];
+}j_stress_result_t;
+
+static DEFINE_MUTEX(g_j_stress_mutex);      ///< one run at a time, protects g_j_stress_result
+static j_stress_t *g_j_stress = NULL;       ///< run in progress, read by epoch commit
+static uint8_t g_j_stress_run = 0;
+static j_stress_result_t g_j_stress_result;
+
+static const char *j_stress_call_name[J_STRESS_NR_CALLS] =
+{
+    [J_STRESS_ALLOC]      = "alloc",
+    [J_STRESS_INSERT]     = "insert",
+    [J_STRESS_COMMIT]     = "commit",
+    [J_STRESS_CHECKPOINT] = "checkpoint",
+};
+
+static void j_stress_account(j_stress_call_t *call, cycles_t start)
+{
+    uint64_t cycles = get_cycles() - start;
+    uint32_t bucket = cycles ? ilog2(cycles) + 1 : 0;
+
+    call->nr ++;
+    call->cycles += cycles;
+    call->max_cycles = max_t(uint64_t, call->max_cycles, cycles);
+    call->buckets[min_t(uint32_t, bucket, J_STRESS_BUCKETS - 1)] ++;
+}
+
+static void j_stress_merge(j_stress_call_t *dst, j_stress_call_t *src)
+{
+    int i = 0;
+
+    dst->nr += src->nr;
+    dst->cycles += src->cycles;
+    dst->max_cycles = max_t(uint64_t, dst->max_cycles, src->max_cycles);
+    for (i = 0; i < J_STRESS_BUCKETS; i++)
+    {
+        dst->buckets[i] += src->buckets[i];
+    }
+}
+
+///< same log as j_log_setattr(), ia_valid 0 and the record number in i_size
+static void j_stress_fill_log(struct inode *inode, j_log_entry_t *log_entry, uint64_t record)
+{
+    chown_log_t chown_log;
+
+    memset(&chown_log, 0, sizeof(chown_log_t));
+    chown_log.log_header.log_type = CHOWN_LOG;
+    chown_log.log_header.log_size = J_LOG_ENTRY_SIZE;
+    chown_log.ino_num      = inode->i_ino;
+    chown_log.ia_valid     = 0;
+    chown_log.i_uid        = i_uid_read(inode);
+    chown_log.i_gid        = i_gid_read(inode);
+    chown_log.i_mode       = inode->i_mode;
+    chown_log.i_size       = record;
+    chown_log.i_atime      = inode->i_atime.tv_sec;
+    chown_log.i_ctime      = inode->i_ctime.tv_sec;
+    chown_log.i_mtime      = inode->i_mtime.tv_sec;
+    chown_log.i_atime_nsec = inode->i_atime.tv_nsec;
+    chown_log.i_ctime_nsec = inode->i_ctime.tv_nsec;
+    chown_log.i_mtime_nsec = inode->i_mtime.tv_nsec;
+    memcpy(log_entry->log_entry_addr, &chown_log, sizeof(chown_log_t));
+}
+
+static int j_stress_thread_fn(void *param)
+{
+    j_stress_thread_t *t = (j_stress_thread_t *)param;
+    j_stress_t *st = t->st;
+    j_log_entry_t *log_entry = NULL;
+    struct inode *inode = NULL;
+    uint64_t record_base = ((uint64_t)st->run << J_STRESS_RUN_SHIFT) | ((uint64_t)t->idx << J_STRESS_THREAD_SHIFT);
+    uint64_t op = 0;
+    cycles_t start = 0;
+    int ret = F2FSJ_OK;
+
+    wait_for_completion(&st->start);
+
+    for (op = 0; op < st->nr_ops; op++)
+    {
+        inode = st->files[prandom_u32_max(st->nr_files)];
+
+        // like setattr, the log is built and inserted under the inode lock
+        inode_lock(inode);
+
+        start = get_cycles();
+        ret = j_alloc_log_entry(CHOWN_LOG, &log_entry);
+        j_stress_account(&t->calls[J_STRESS_ALLOC], start);
+        if (ret != F2FSJ_OK)
+        {
+            inode_unlock(inode);
+            t->nr_alloc_err ++;
+            continue;
+        }
+
+        j_stress_fill_log(inode, log_entry, record_base | op);
+
+        start = get_cycles();
+        ret = insert_log_into_inode(F2FS_I(inode), log_entry);
+        j_stress_account(&t->calls[J_STRESS_INSERT], start);
+        if (ret == F2FSJ_OK)
+        {
+            __set_bit(op, t->inserted);
+        }
+        else
+        {
+            j_free_log_entry(log_entry);
+            t->nr_insert_err ++;
+        }
+
+        inode_unlock(inode);
+
+        if (st->commit_ops && (op + 1) % st->commit_ops == 0)
+        {
+            start = get_cycles();
+            if (j_sync_epoch_commit(st->sbi))
+            {
+                t->nr_commit_err ++;
+            }
+            j_stress_account(&t->calls[J_STRESS_COMMIT], start);
+        }
+
+        cond_resched();
+    }
+
+    if (atomic_dec_and_test(&st->nr_running))
+    {
+        complete(&st->done);
+    }
+
+    return 0;
+}
+
+static int j_stress_cp_thread_fn(void *param)
+{
+    j_stress_t *st = (j_stress_t *)param;
+    cycles_t start = 0;
+
+    wait_for_completion(&st->start);
+
+    while (!kthread_should_stop())
+    {
+        msleep_interruptible(J_STRESS_CP_INTERVAL_MS);
+        if (kthread_should_stop())
+        {
+            break;
+        }
+
+        start = get_cycles();
+        j_sync_epoch_checkpoint(st->sbi);
+        j_stress_account(&st->cp_call, start);
+    }
+
+    return 0;
+}
+
+void j_stress_log_committed(uint64_t record)
+{
+    j_stress_t *st = READ_ONCE(g_j_stress);
+    uint32_t thread_idx = (record >> J_STRESS_THREAD_SHIFT) & ((1 << (J_STRESS_RUN_SHIFT - J_STRESS_THREAD_SHIFT)) - 1);
+    uint64_t op = record & ((1ULL << J_STRESS_THREAD_SHIFT) - 1);
+
+    if (!st)
+    {
+        return;
+    }
+
+    // a record of another run, or a real setattr log with ia_valid 0
+    if ((uint8_t)(record >> J_STRESS_RUN_SHIFT) != st->run || thread_idx >= st->nr_threads || op >= st->nr_ops)
+    {
+        atomic64_inc(&st->nr_stray);
+        return;
+    }
+
+    if (test_and_set_bit(op, st->threads[thread_idx].committed))
+    {
+        atomic64_inc(&st->nr_dup);
+    }
+}
+
+/**
+ * @brief Files "0" .. "nr_files - 1" of directory dir_ino
+ */
+static int j_stress_get_files(j_stress_t *st, unsigned int dir_ino, unsigned int nr_files)
+{
+    struct super_block *sb = st->sbi->sb;
+    struct inode *dir = NULL;
+    struct inode *inode = NULL;
+    struct page *page = NULL;
+    struct qstr name;
+    char name_buf[16];
+    ino_t ino = 0;
+    int err = 0;
+
+    dir = f2fs_iget(sb, dir_ino);
+    if (IS_ERR(dir))
+    {
+        STATUS_LOG(STATUS_ERROR, "stress dir ino %u err %ld\n", dir_ino, PTR_ERR(dir));
+        return PTR_ERR(dir);
+    }
+    if (!S_ISDIR(dir->i_mode))
+    {
+        iput(dir);
+        return -ENOTDIR;
+    }
+
+    st->files = kvcalloc(nr_files, sizeof(struct inode *), GFP_KERNEL);
+    if (!st->files)
+    {
+        iput(dir);
+        return -ENOMEM;
+    }
+
+    inode_lock_shared(dir);
+    for (st->nr_files = 0; st->nr_files < nr_files; st->nr_files++)
+    {
+        snprintf(name_buf, sizeof(name_buf), "%u", st->nr_files);
+        name = (struct qstr)QSTR_INIT(name_buf, strlen(name_buf));
+
+        ino = f2fs_inode_by_name(dir, &name, &page);
+        if (!ino)
+        {
+            STATUS_LOG(STATUS_ERROR, "stress file %s is not in dir ino %u\n", name_buf, dir_ino);
+            err = -ENOENT;
+            break;
+        }
+
+        inode = f2fs_iget(sb, ino);
+        if (IS_ERR(inode))
+        {
+            err = PTR_ERR(inode);
+            break;
+        }
+        if (!S_ISREG(inode->i_mode))
+        {
+            iput(inode);
+            err = -EINVAL;
+            break;
+        }
+        st->files[st->nr_files] = inode;
+    }
+    inode_unlock_shared(dir);
+    iput(dir);
+
+    return err;
+}
+
+static void j_stress_put_files(j_stress_t *st)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < st->nr_files; i++)
+    {
+        iput(st->files[i]);
+    }
+    kvfree(st->files);
+}
+
+static void j_stress_free_threads(j_stress_t *st)
+{
+    uint32_t i = 0;
+
+    if (!st->threads)
+    {
+        return;
+    }
+
+    for (i = 0; i < st->nr_threads; i++)
+    {
+        kvfree(st->threads[i].inserted);
+        kvfree(st->threads[i].committed);
+    }
+    kvfree(st->threads);
+}
+
+static int j_stress_alloc_threads(j_stress_t *st)
+{
+    size_t bitmap_size = BITS_TO_LONGS(st->nr_ops) * sizeof(unsigned long);
+    j_stress_thread_t *t = NULL;
+    int cpu = cpumask_first(cpu_online_mask);
+    uint32_t i = 0;
+
+    st->threads = kvcalloc(st->nr_threads, sizeof(j_stress_thread_t), GFP_KERNEL);
+    if (!st->threads)
+    {
+        return -ENOMEM;
+    }
+
+    for (i = 0; i < st->nr_threads; i++)
+    {
+        t = &st->threads[i];
+        t->st = st;
+        t->idx = i;
+        t->cpu = cpu;
+        t->inserted = kvzalloc(bitmap_size, GFP_KERNEL);
+        t->committed = kvzalloc(bitmap_size, GFP_KERNEL);
+        if (!t->inserted || !t->committed)
+        {
+            return -ENOMEM;
+        }
+
+        // online CPUs round robin
+        cpu = cpumask_next(cpu, cpu_online_mask);
+        if (cpu >= nr_cpu_ids)
+        {
+            cpu = cpumask_first(cpu_online_mask);
+        }
+    }
+
+    return 0;
+}
+
+static void j_stress_collect(j_stress_t *st, j_stress_result_t *res)
+{
+    j_stress_thread_t *t = NULL;
+    uint64_t inserted = 0, committed = 0, both = 0;
+    uint32_t i = 0;
+    int j = 0;
+
+    for (i = 0; i < st->nr_threads; i++)
+    {
+        t = &st->threads[i];
+        for (j = 0; j < J_STRESS_NR_CALLS; j++)
+        {
+            j_stress_merge(&res->calls[j], &t->calls[j]);
+        }
+        res->nr_alloc_err += t->nr_alloc_err;
+        res->nr_insert_err += t->nr_insert_err;
+        res->nr_commit_err += t->nr_commit_err;
+
+        inserted = bitmap_weight(t->inserted, st->nr_ops);
+        committed = bitmap_weight(t->committed, st->nr_ops);
+
+        // inserted and not committed: lost, committed and not inserted: stray
+        bitmap_and(t->inserted, t->inserted, t->committed, st->nr_ops);
+        both = bitmap_weight(t->inserted, st->nr_ops);
+
+        res->nr_inserted += inserted;
+        res->nr_committed += committed;
+        res->nr_lost += inserted - both;
+        res->nr_stray += committed - both;
+    }
+    j_stress_merge(&res->calls[J_STRESS_CHECKPOINT], &st->cp_call);
+
+    res->nr_dup = atomic64_read(&st->nr_dup);
+    res->nr_stray += atomic64_read(&st->nr_stray);
+}
+
+int j_stress_run(struct f2fs_sb_info *sbi, unsigned int nr_threads)
+{
+    j_stress_t *st = NULL;
+    j_stress_result_t *res = &g_j_stress_result;
+    struct task_struct *task = NULL;
+    struct task_struct *cp_task = NULL;
+    uint64_t start_ns = 0;
+    uint64_t logged_bytes = 0;
+    uint64_t nr_epochs = 0;
+    uint64_t lock_contended[J_STAT_NR_LOCKS];
+    uint32_t nr_started = 0;
+    uint32_t i = 0;
+    int err = 0;
+
+    if (!nr_threads || nr_threads > J_STRESS_MAX_THREADS || !sbi->j_stress_ops
+     || sbi->j_stress_ops > J_STRESS_MAX_OPS || !sbi->j_stress_files || !sbi->j_stress_dir_ino)
+    {
+        return -EINVAL;
+    }
+
+    if (!mutex_trylock(&g_j_stress_mutex))
+    {
+        return -EBUSY;
+    }
+
+    // like gc_urgent, no umount while kthreads drive the journal
+    if (!down_read_trylock(&sbi->sb->s_umount))
+    {
+        mutex_unlock(&g_j_stress_mutex);
+        return -EAGAIN;
+    }
+
+    st = kzalloc(sizeof(j_stress_t), GFP_KERNEL);
+    if (!st)
+    {
+        err = -ENOMEM;
+        goto out_unlock;
+    }
+
+    st->sbi = sbi;
+    st->run = ++ g_j_stress_run;
+    st->nr_threads = nr_threads;
+    st->nr_ops = sbi->j_stress_ops;
+    st->commit_ops = sbi->j_stress_commit_ops;
+    init_completion(&st->start);
+    init_completion(&st->done);
+    atomic_set(&st->nr_running, nr_threads);
+
+    err = j_stress_get_files(st, sbi->j_stress_dir_ino, sbi->j_stress_files);
+    if (err)
+    {
+        goto out_files;
+    }
+
+    err = j_stress_alloc_threads(st);
+    if (err)
+    {
+        goto out_threads;
+    }
+
+    // threads wait for st->start, nothing runs until all of them exist
+    for (nr_started = 0; nr_started < nr_threads; nr_started++)
+    {
+        task = kthread_create(j_stress_thread_fn, &st->threads[nr_started], "j_stress/%u", nr_started);
+        if (IS_ERR(task))
+        {
+            err = PTR_ERR(task);
+            break;
+        }
+        kthread_bind(task, st->threads[nr_started].cpu);
+        wake_up_process(task);
+    }
+
+    if (!err)
+    {
+        cp_task = kthread_run(j_stress_cp_thread_fn, st, "j_stress_cp");
+        if (IS_ERR(cp_task))
+        {
+            err = PTR_ERR(cp_task);
+            cp_task = NULL;
+        }
+    }
+
+    if (err)
+    {
+        // started threads run without records, let them go
+        st->nr_ops = 0;
+        atomic_sub(nr_threads - nr_started, &st->nr_running);
+        complete_all(&st->start);
+        if (nr_started)
+        {
+            wait_for_completion(&st->done);
+        }
+        goto out_threads;
+    }
+
+    j_sync_epoch_commit(sbi);
+    logged_bytes = atomic64_read(&g_j_stats.logged_bytes);
+    nr_epochs = atomic64_read(&g_j_stats.epochs[J_STAT_EP_COMMITTED]);
+    for (i = 0; i < J_STAT_NR_LOCKS; i++)
+    {
+        lock_contended[i] = atomic64_read(&g_j_stats.lock_contended[i]);
+    }
+    j_stat_lock_hold_enable(true);
+    WRITE_ONCE(g_j_stress, st);
+
+    INFO_REPORT("journal stress run %u: %u threads, %llu logs each, %u files\n",
+                st->run, nr_threads, st->nr_ops, st->nr_files);
+    start_ns = get_current_time_ns();
+    complete_all(&st->start);
+    wait_for_completion(&st->done);
+
+    // every inserted record is committed before the result is taken
+    j_sync_epoch_commit(sbi);
+    memset(res, 0, sizeof(j_stress_result_t));
+    res->elapsed_ns = get_current_time_ns() - start_ns;
+
+    kthread_stop(cp_task);
+    j_stat_lock_hold_enable(false);
+    WRITE_ONCE(g_j_stress, NULL);
+    // a commit which read g_j_stress before is done once the commit mutex is free again
+    j_sync_epoch_commit(sbi);
+
+    res->nr_threads = nr_threads;
+    res->nr_cpus = min_t(uint32_t, nr_threads, num_online_cpus());
+    res->nr_files = st->nr_files;
+    res->nr_ops = st->nr_ops;
+    res->commit_ops = st->commit_ops;
+    res->logged_bytes = atomic64_read(&g_j_stats.logged_bytes) - logged_bytes;
+    res->nr_epochs = atomic64_read(&g_j_stats.epochs[J_STAT_EP_COMMITTED]) - nr_epochs;
+    for (i = 0; i < J_STAT_NR_LOCKS; i++)
+    {
+        res->lock_contended[i] = atomic64_read(&g_j_stats.lock_contended[i]) - lock_contended[i];
+        res->lock_nr_held[i] = atomic64_read(&g_j_stats.lock_nr_held[i]);
+        res->lock_hold_ns[i] = atomic64_read(&g_j_stats.lock_hold_ns[i]);
+        res->lock_max_hold_ns[i] = atomic64_read(&g_j_stats.lock_max_hold_ns[i]);
+    }
+    j_stress_collect(st, res);
+    res->valid = true;
+
+    if (res->nr_lost || res->nr_dup)
+    {
+        STATUS_LOG(STATUS_ERROR, "journal stress run %u: %llu records lost, %llu duplicated\n",
+                   st->run, res->nr_lost, res->nr_dup);
+    }
+    INFO_REPORT("journal stress run %u done in %llu us\n", st->run, div_u64(res->elapsed_ns, 1000));
+
+out_threads:
+    j_stress_free_threads(st);
+out_files:
+    j_stress_put_files(st);
+    kfree(st);
+out_unlock:
+    up_read(&sbi->sb->s_umount);
+    mutex_unlock(&g_j_stress_mutex);
+    return err;
+}
+
+static void j_stress_show_call(struct seq_file *s, const char *name, j_stress_call_t *call)
+{
+    int i = 0;
+
+    seq_printf(s, "  - %s: %llu calls, avg %llu cycles, max %llu cycles\n", name, call->nr,
+               call->nr ? div64_u64(call->cycles, call->nr) : 0, call->max_cycles);
+
+    for (i = 0; i < J_STRESS_BUCKETS; i++)
+    {
+        if (!call->buckets[i])
+        {
+            continue;
+        }
+
+        if (i == J_STRESS_BUCKETS - 1)
+        {
+            seq_printf(s, "    >=%11llu cycles: %llu\n", 1ULL << (i - 1), call->buckets[i]);
+        }
+        else
+        {
+            seq_printf(s, "    < %11llu cycles: %llu\n", 1ULL << i, call->buckets[i]);
+        }
+    }
+}
+
+void j_stress_show(struct seq_file *s)
+{
+    j_stress_result_t *res = &g_j_stress_result;
+    uint64_t nr_logs = 0;
+    int i = 0;
+
+    seq_puts(s, "\nJournal stress:\n");
+
+    if (!mutex_trylock(&g_j_stress_mutex))
+    {
+        seq_puts(s, "  - running\n");
+        return;
+    }
+
+    if (!res->valid)
+    {
+        seq_puts(s, "  - no run, write the thread count to sysfs j_stress\n");
+        mutex_unlock(&g_j_stress_mutex);
+        return;
+    }
+
+    nr_logs = res->calls[J_STRESS_ALLOC].nr;
+    seq_printf(s, "  - threads: %u on %u cpus, files: %u, logs per thread: %llu, commit every %u logs\n",
+               res->nr_threads, res->nr_cpus, res->nr_files, res->nr_ops, res->commit_ops);
+    seq_printf(s, "  - elapsed: %llu us, %llu logs/s, logged: %llu KB, epochs committed: %llu\n",
+               div_u64(res->elapsed_ns, 1000),
+               res->elapsed_ns ? div64_u64(nr_logs * NSEC_PER_SEC, res->elapsed_ns) : 0,
+               res->logged_bytes >> 10, res->nr_epochs);
+
+    for (i = 0; i < J_STRESS_NR_CALLS; i++)
+    {
+        j_stress_show_call(s, j_stress_call_name[i], &res->calls[i]);
+    }
+
+    for (i = 0; i < J_STAT_NR_LOCKS; i++)
+    {
+        seq_printf(s, "  - %s: contended %llu, held %llu, avg %llu ns, max %llu ns\n",
+                   j_stat_lock_name(i), res->lock_contended[i], res->lock_nr_held[i],
+                   res->lock_nr_held[i] ? div64_u64(res->lock_hold_ns[i], res->lock_nr_held[i]) : 0,
+                   res->lock_max_hold_ns[i]);
+    }
+
+    seq_printf(s, "  - errors: alloc %llu, insert %llu, commit %llu\n",
+               res->nr_alloc_err, res->nr_insert_err, res->nr_commit_err);
+    seq_printf(s, "  - records: inserted %llu, committed %llu, lost %llu, duplicated %llu, stray %llu\n",
+               res->nr_inserted, res->nr_committed, res->nr_lost, res->nr_dup, res->nr_stray);
+    seq_printf(s, "  - result: %s\n", (res->nr_lost || res->nr_dup || res->nr_stray) ? "FAIL" : "PASS");
+
+    mutex_unlock(&g_j_stress_mutex);
+}
@@ -0,0 +1,68 @@
+/**
+ * @file j_stress.h
+ * @author leslie.cui (10033908@github.com)
+ * @brief journal stress test and microbenchmark. Writing N to sysfs j_stress starts N kthreads
+ *        pinned to online CPUs round robin, each one drives j_alloc_log_entry() and
+ *        insert_log_into_inode() on the files "0" .. "j_stress_files - 1" of the directory
+ *        j_stress_dir_ino, commits with j_sync_epoch_commit() every j_stress_commit_ops logs,
+ *        while another kthread applies committed epochs with j_sync_epoch_checkpoint().
+ *        The write returns when the run is over, results are in /proc/fs/f2fsj/<dev>/j_stress:
+ *        cycles per call, throughput, journal lock hold times and lost or duplicated records.
+ *
+ *        Records are setattr logs of the current attributes of a file, a crash during the run
+ *        replays them without changing anything. ia_valid 0, which a real setattr never logs,
+ *        marks them, i_size carries their record number. Epoch commit hands every record it
+ *        aggregates to j_stress_log_committed(), records inserted but not committed are lost
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef _J_STRESS_H_
+#define _J_STRESS_H_
+
+#include <linux/seq_file.h>
+#include "j_log_content.h"
+
+#define J_DEF_STRESS_OPS        (100000)    ///< logs per thread
+#define J_DEF_STRESS_FILES      (64)
+#define J_DEF_STRESS_COMMIT_OPS (1000)      ///< logs of a thread between two commits, 0: commit thread only
+
+#define J_STRESS_MAX_THREADS    (256)
+#define J_STRESS_MAX_OPS        (1U << 26)  ///< logs per thread, each one takes 2 bits of record bitmaps
+#define J_STRESS_CP_INTERVAL_MS (100)
+
+///< bucket i counts calls in [2^(i-1), 2^i) cycles, the last one everything above
+#define J_STRESS_BUCKETS        (32)
+
+typedef enum __j_stress_call_e
+{
+    J_STRESS_ALLOC      = 0,    ///< j_alloc_log_entry()
+    J_STRESS_INSERT     = 1,    ///< insert_log_into_inode()
+    J_STRESS_COMMIT     = 2,    ///< j_sync_epoch_commit(), waiting for a running commit included
+    J_STRESS_CHECKPOINT = 3,    ///< j_sync_epoch_checkpoint()
+    J_STRESS_NR_CALLS,
+}j_stress_call_e;
+
+struct f2fs_sb_info;
+
+/**
+ * @brief Run the stress test, invoked by sysfs j_stress. Only one run at a time
+ *
+ * @param sbi
+ * @param nr_threads
+ * @return int, 0 or -errno
+ */
+int j_stress_run(struct f2fs_sb_info *sbi, unsigned int nr_threads);
+
+/**
+ * @brief A setattr log with ia_valid 0 is aggregated by epoch commit
+ *
+ * @param record, i_size of the log
+ */
+void j_stress_log_committed(uint64_t record);
+
+void j_stress_show(struct seq_file *s);
+
+#endif // !_J_STRESS_H_
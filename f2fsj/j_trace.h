@@ -0,0 +1,318 @@
+/**
+ * @file j_trace.h
+ * @author leslie.cui (10033908@github.com)
+ * @brief tracepoints of journal lifecycle: log allocation, inode check-in, epoch seal,
+ *        aggregation, journal bio, checkpoint apply and replay. Events are under
+ *        /sys/kernel/tracing/events/f2fsj/
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM f2fsj
+
+#if !defined(_J_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define _J_TRACE_H_
+
+#include <linux/tracepoint.h>
+#include "j_log_content.h"
+
+#define show_j_log_type(type)                                   \
+    __print_symbolic(type,                                      \
+        { CREATE_LOG,           "CREATE" },                     \
+        { MKDIR_LOG,            "MKDIR" },                      \
+        { UNLINK_LOG,           "UNLINK" },                     \
+        { LINK_LOG,             "LINK" },                       \
+        { RENAME_LOG,           "RENAME" },                     \
+        { SYMLINK_LOG,          "SYMLINK" },                    \
+        { CHOWN_LOG,            "SETATTR" },                    \
+        { DIR_LOG,              "DIR" },                        \
+        { READ_FILE_DATA_LOG,   "READ_FILE" },                  \
+        { READ_DIR_LOG,         "READ_DIR" },                   \
+        { STAT_LOG,             "STAT" },                       \
+        { DATA_WRITE_LOG,       "DATA_WRITE" },                 \
+        { DATA_JOURNAL_LOG,     "DATA_JOURNAL" },               \
+        { XATTR_LOG,            "XATTR" },                      \
+        { TRUNCATE_LOG,         "TRUNCATE" },                   \
+        { FALLOCATE_LOG,        "FALLOCATE" },                  \
+        { PUNCH_LOG,            "PUNCH" },                      \
+        { ORPHAN_LOG,           "ORPHAN" },                     \
+        { META_DELTA_LOG,       "META_DELTA" },                 \
+        { COMPACT_LOG,          "COMPACT" })
+
+TRACE_EVENT(f2fsj_alloc_log,
+
+    TP_PROTO(int log_type, uint32_t log_entry_idx, uint32_t nr_entries),
+
+    TP_ARGS(log_type, log_entry_idx, nr_entries),
+
+    TP_STRUCT__entry(
+        __field(int,        log_type)
+        __field(uint32_t,   log_entry_idx)
+        __field(uint32_t,   nr_entries)
+    ),
+
+    TP_fast_assign(
+        __entry->log_type       = log_type;
+        __entry->log_entry_idx  = log_entry_idx;
+        __entry->nr_entries     = nr_entries;
+    ),
+
+    TP_printk("type = %s, log entry = %u, entries = %u",
+        show_j_log_type(__entry->log_type),
+        __entry->log_entry_idx,
+        __entry->nr_entries)
+);
+
+TRACE_EVENT(f2fsj_insert_log,
+
+    TP_PROTO(unsigned long ino, uint8_t local_ep, int log_type, uint32_t log_size,
+             uint32_t log_entry_idx),
+
+    TP_ARGS(ino, local_ep, log_type, log_size, log_entry_idx),
+
+    TP_STRUCT__entry(
+        __field(unsigned long,  ino)
+        __field(uint8_t,        local_ep)
+        __field(int,            log_type)
+        __field(uint32_t,       log_size)
+        __field(uint32_t,       log_entry_idx)
+    ),
+
+    TP_fast_assign(
+        __entry->ino            = ino;
+        __entry->local_ep       = local_ep;
+        __entry->log_type       = log_type;
+        __entry->log_size       = log_size;
+        __entry->log_entry_idx  = log_entry_idx;
+    ),
+
+    TP_printk("ino = %lu, local epoch = %u, type = %s, size = %u, log entry = %u",
+        __entry->ino,
+        __entry->local_ep,
+        show_j_log_type(__entry->log_type),
+        __entry->log_size,
+        __entry->log_entry_idx)
+);
+
+TRACE_EVENT(f2fsj_inode_checkin,
+
+    TP_PROTO(unsigned long ino, uint64_t ep_seq, uint8_t global_ep, uint8_t local_ep),
+
+    TP_ARGS(ino, ep_seq, global_ep, local_ep),
+
+    TP_STRUCT__entry(
+        __field(unsigned long,  ino)
+        __field(uint64_t,       ep_seq)
+        __field(uint8_t,        global_ep)
+        __field(uint8_t,        local_ep)
+    ),
+
+    TP_fast_assign(
+        __entry->ino        = ino;
+        __entry->ep_seq     = ep_seq;
+        __entry->global_ep  = global_ep;
+        __entry->local_ep   = local_ep;
+    ),
+
+    TP_printk("ino = %lu, epoch seq = %llu, global epoch = %u, local epoch = %u",
+        __entry->ino,
+        __entry->ep_seq,
+        __entry->global_ep,
+        __entry->local_ep)
+);
+
+TRACE_EVENT(f2fsj_epoch_seal,
+
+    TP_PROTO(uint64_t ep_seq, uint8_t global_ep),
+
+    TP_ARGS(ep_seq, global_ep),
+
+    TP_STRUCT__entry(
+        __field(uint64_t,   ep_seq)
+        __field(uint8_t,    global_ep)
+    ),
+
+    TP_fast_assign(
+        __entry->ep_seq     = ep_seq;
+        __entry->global_ep  = global_ep;
+    ),
+
+    TP_printk("epoch seq = %llu, global epoch = %u",
+        __entry->ep_seq,
+        __entry->global_ep)
+);
+
+DECLARE_EVENT_CLASS(f2fsj_aggregate_template,
+
+    TP_PROTO(uint64_t ep_seq, uint8_t global_ep, uint32_t nr_inodes, uint32_t nr_logs),
+
+    TP_ARGS(ep_seq, global_ep, nr_inodes, nr_logs),
+
+    TP_STRUCT__entry(
+        __field(uint64_t,   ep_seq)
+        __field(uint8_t,    global_ep)
+        __field(uint32_t,   nr_inodes)
+        __field(uint32_t,   nr_logs)
+    ),
+
+    TP_fast_assign(
+        __entry->ep_seq     = ep_seq;
+        __entry->global_ep  = global_ep;
+        __entry->nr_inodes  = nr_inodes;
+        __entry->nr_logs    = nr_logs;
+    ),
+
+    TP_printk("epoch seq = %llu, global epoch = %u, inodes = %u, logs = %u",
+        __entry->ep_seq,
+        __entry->global_ep,
+        __entry->nr_inodes,
+        __entry->nr_logs)
+);
+
+DEFINE_EVENT(f2fsj_aggregate_template, f2fsj_aggregate_start,
+
+    TP_PROTO(uint64_t ep_seq, uint8_t global_ep, uint32_t nr_inodes, uint32_t nr_logs),
+
+    TP_ARGS(ep_seq, global_ep, nr_inodes, nr_logs)
+);
+
+DEFINE_EVENT(f2fsj_aggregate_template, f2fsj_aggregate_end,
+
+    TP_PROTO(uint64_t ep_seq, uint8_t global_ep, uint32_t nr_inodes, uint32_t nr_logs),
+
+    TP_ARGS(ep_seq, global_ep, nr_inodes, nr_logs)
+);
+
+DECLARE_EVENT_CLASS(f2fsj_journal_bio_template,
+
+    TP_PROTO(struct super_block *sb, uint32_t blk_addr, uint32_t nr_blks, int op_flags, int err),
+
+    TP_ARGS(sb, blk_addr, nr_blks, op_flags, err),
+
+    TP_STRUCT__entry(
+        __field(dev_t,      dev)
+        __field(uint32_t,   blk_addr)
+        __field(uint32_t,   nr_blks)
+        __field(int,        op_flags)
+        __field(int,        err)
+    ),
+
+    TP_fast_assign(
+        __entry->dev        = sb->s_dev;
+        __entry->blk_addr   = blk_addr;
+        __entry->nr_blks    = nr_blks;
+        __entry->op_flags   = op_flags;
+        __entry->err        = err;
+    ),
+
+    TP_printk("dev = (%d,%d), blkaddr = 0x%x, blocks = %u, flags = 0x%x, err = %d",
+        MAJOR(__entry->dev), MINOR(__entry->dev),
+        __entry->blk_addr,
+        __entry->nr_blks,
+        __entry->op_flags,
+        __entry->err)
+);
+
+DEFINE_EVENT(f2fsj_journal_bio_template, f2fsj_journal_bio_submit,
+
+    TP_PROTO(struct super_block *sb, uint32_t blk_addr, uint32_t nr_blks, int op_flags, int err),
+
+    TP_ARGS(sb, blk_addr, nr_blks, op_flags, err)
+);
+
+DEFINE_EVENT(f2fsj_journal_bio_template, f2fsj_journal_bio_complete,
+
+    TP_PROTO(struct super_block *sb, uint32_t blk_addr, uint32_t nr_blks, int op_flags, int err),
+
+    TP_ARGS(sb, blk_addr, nr_blks, op_flags, err)
+);
+
+TRACE_EVENT(f2fsj_checkpoint_apply_start,
+
+    TP_PROTO(struct super_block *sb, uint32_t nr_epochs, uint64_t nr_unapplied_logs),
+
+    TP_ARGS(sb, nr_epochs, nr_unapplied_logs),
+
+    TP_STRUCT__entry(
+        __field(dev_t,      dev)
+        __field(uint32_t,   nr_epochs)
+        __field(uint64_t,   nr_unapplied_logs)
+    ),
+
+    TP_fast_assign(
+        __entry->dev                = sb->s_dev;
+        __entry->nr_epochs          = nr_epochs;
+        __entry->nr_unapplied_logs  = nr_unapplied_logs;
+    ),
+
+    TP_printk("dev = (%d,%d), epochs = %u, unapplied logs = %llu",
+        MAJOR(__entry->dev), MINOR(__entry->dev),
+        __entry->nr_epochs,
+        __entry->nr_unapplied_logs)
+);
+
+TRACE_EVENT(f2fsj_checkpoint_apply_end,
+
+    TP_PROTO(struct super_block *sb, uint64_t applied_ep_seq, uint64_t applied_logs, int err),
+
+    TP_ARGS(sb, applied_ep_seq, applied_logs, err),
+
+    TP_STRUCT__entry(
+        __field(dev_t,      dev)
+        __field(uint64_t,   applied_ep_seq)
+        __field(uint64_t,   applied_logs)
+        __field(int,        err)
+    ),
+
+    TP_fast_assign(
+        __entry->dev            = sb->s_dev;
+        __entry->applied_ep_seq = applied_ep_seq;
+        __entry->applied_logs   = applied_logs;
+        __entry->err            = err;
+    ),
+
+    TP_printk("dev = (%d,%d), applied epoch seq = %llu, applied logs = %llu, err = %d",
+        MAJOR(__entry->dev), MINOR(__entry->dev),
+        __entry->applied_ep_seq,
+        __entry->applied_logs,
+        __entry->err)
+);
+
+TRACE_EVENT(f2fsj_replay_log,
+
+    TP_PROTO(struct super_block *sb, uint32_t log_entry_idx, int log_type, uint32_t log_size),
+
+    TP_ARGS(sb, log_entry_idx, log_type, log_size),
+
+    TP_STRUCT__entry(
+        __field(dev_t,      dev)
+        __field(uint32_t,   log_entry_idx)
+        __field(int,        log_type)
+        __field(uint32_t,   log_size)
+    ),
+
+    TP_fast_assign(
+        __entry->dev            = sb->s_dev;
+        __entry->log_entry_idx  = log_entry_idx;
+        __entry->log_type       = log_type;
+        __entry->log_size       = log_size;
+    ),
+
+    TP_printk("dev = (%d,%d), log entry = %u, type = %s, size = %u",
+        MAJOR(__entry->dev), MINOR(__entry->dev),
+        __entry->log_entry_idx,
+        show_j_log_type(__entry->log_type),
+        __entry->log_size)
+);
+
+#endif // !_J_TRACE_H_
+
+// module-local trace header, see CFLAGS_j_stats.o in Makefile
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE j_trace
+#include <trace/define_trace.h>
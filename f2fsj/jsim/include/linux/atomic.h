@@ -0,0 +1,41 @@
+/**
+ * @file atomic.h
+ * @author leslie.cui (10033908@github.com)
+ * @brief userspace shim of <linux/atomic.h> for jsim
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef _JSIM_LINUX_ATOMIC_H_
+#define _JSIM_LINUX_ATOMIC_H_
+
+#include <linux/types.h>
+
+typedef struct
+{
+    int counter;
+}atomic_t;
+
+typedef struct
+{
+    int64_t counter;
+}atomic64_t;
+
+#define ATOMIC_INIT(i)   { (i) }
+#define ATOMIC64_INIT(i) { (i) }
+
+#define atomic_read(v)      __atomic_load_n(&(v)->counter, __ATOMIC_RELAXED)
+#define atomic_set(v, i)    __atomic_store_n(&(v)->counter, (i), __ATOMIC_RELAXED)
+#define atomic_inc(v)       __atomic_add_fetch(&(v)->counter, 1, __ATOMIC_RELAXED)
+#define atomic_dec(v)       __atomic_sub_fetch(&(v)->counter, 1, __ATOMIC_RELAXED)
+
+#define atomic64_read(v)    __atomic_load_n(&(v)->counter, __ATOMIC_RELAXED)
+#define atomic64_set(v, i)  __atomic_store_n(&(v)->counter, (i), __ATOMIC_RELAXED)
+#define atomic64_inc(v)     __atomic_add_fetch(&(v)->counter, 1, __ATOMIC_RELAXED)
+#define atomic64_dec(v)     __atomic_sub_fetch(&(v)->counter, 1, __ATOMIC_RELAXED)
+#define atomic64_add(i, v)  __atomic_add_fetch(&(v)->counter, (i), __ATOMIC_RELAXED)
+#define atomic64_inc_return(v) __atomic_add_fetch(&(v)->counter, 1, __ATOMIC_RELAXED)
+
+#endif // !_JSIM_LINUX_ATOMIC_H_
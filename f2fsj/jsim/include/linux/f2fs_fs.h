@@ -0,0 +1,24 @@
+/**
+ * @file f2fs_fs.h
+ * @author leslie.cui (10033908@github.com)
+ * @brief userspace shim of <linux/f2fs_fs.h> for jsim, on-disk types used by journal logs
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef _JSIM_LINUX_F2FS_FS_H_
+#define _JSIM_LINUX_F2FS_FS_H_
+
+#include <linux/types.h>
+
+#define F2FS_LOG_SECTORS_PER_BLOCK (3)
+
+typedef u32 block_t;
+typedef u32 nid_t;
+typedef __le32 f2fs_hash_t;
+
+struct f2fs_summary;
+
+#endif // !_JSIM_LINUX_F2FS_FS_H_
@@ -0,0 +1,48 @@
+/**
+ * @file kernel.h
+ * @author leslie.cui (10033908@github.com)
+ * @brief userspace shim of <linux/kernel.h> for jsim, printk goes to stderr and is
+ *        counted, see jsim_printk()
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef _JSIM_LINUX_KERNEL_H_
+#define _JSIM_LINUX_KERNEL_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <linux/types.h>
+
+#define container_of(ptr, type, member) \
+    ((type *)((char *)(ptr) - offsetof(type, member)))
+
+#define min_t(type, x, y) ((type)(x) < (type)(y) ? (type)(x) : (type)(y))
+#define max_t(type, x, y) ((type)(x) > (type)(y) ? (type)(x) : (type)(y))
+#define min(x, y) ((x) < (y) ? (x) : (y))
+#define max(x, y) ((x) > (y) ? (x) : (y))
+#define DIV_ROUND_UP(n, d) (((n) + (d) - 1) / (d))
+#define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+#define U32_MAX ((u32)~0U)
+#ifndef ULONG_MAX
+#define ULONG_MAX (~0UL)
+#endif
+
+#define likely(x)   __builtin_expect(!!(x), 1)
+#define unlikely(x) __builtin_expect(!!(x), 0)
+
+#define READ_ONCE(x)     __atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define WRITE_ONCE(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+
+///< journal code may complain once per op, only the first messages are printed
+int jsim_printk(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+#define printk(fmt, args...)   jsim_printk(fmt, ##args)
+#define pr_info(fmt, args...)  jsim_printk(fmt, ##args)
+#define pr_warn(fmt, args...)  jsim_printk(fmt, ##args)
+#define pr_err(fmt, args...)   jsim_printk(fmt, ##args)
+#define pr_emerg(fmt, args...) jsim_printk(fmt, ##args)
+
+#endif // !_JSIM_LINUX_KERNEL_H_
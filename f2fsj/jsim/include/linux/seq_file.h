@@ -0,0 +1,23 @@
+/**
+ * @file seq_file.h
+ * @author leslie.cui (10033908@github.com)
+ * @brief userspace shim of <linux/seq_file.h> for jsim
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef _JSIM_LINUX_SEQ_FILE_H_
+#define _JSIM_LINUX_SEQ_FILE_H_
+
+#include <stdio.h>
+
+struct seq_file
+{
+    FILE *fp;
+};
+
+#define seq_printf(s, fmt, args...) fprintf((s)->fp, fmt, ##args)
+
+#endif // !_JSIM_LINUX_SEQ_FILE_H_
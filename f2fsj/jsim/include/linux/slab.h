@@ -0,0 +1,60 @@
+/**
+ * @file slab.h
+ * @author leslie.cui (10033908@github.com)
+ * @brief userspace shim of <linux/slab.h> and page allocation for jsim, backed by malloc
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef _JSIM_LINUX_SLAB_H_
+#define _JSIM_LINUX_SLAB_H_
+
+#include <stdlib.h>
+#include <linux/types.h>
+
+#define GFP_KERNEL (0x1)
+#define GFP_NOFS   (0x2)
+#define GFP_NOIO   (0x4)
+
+#define PAGE_SHIFT (12)
+#define PAGE_SIZE  (1UL << PAGE_SHIFT)
+
+#define kmalloc(size, flags) malloc(size)
+#define kzalloc(size, flags) calloc(1, size)
+#define kfree(p)             free(p)
+
+struct kmem_cache
+{
+    size_t size;
+};
+
+static inline struct kmem_cache *kmem_cache_create(const char *name, size_t size, size_t align,
+                                                    unsigned long flags, void (*ctor)(void *))
+{
+    struct kmem_cache *cache = malloc(sizeof(struct kmem_cache));
+
+    if (cache)
+    {
+        cache->size = size;
+    }
+    return cache;
+}
+
+#define kmem_cache_alloc(cache, flags) malloc((cache)->size)
+#define kmem_cache_free(cache, p)      free(p)
+#define kmem_cache_destroy(cache)      free(cache)
+
+///< a page is its own memory, page_address() is the page itself
+struct page;
+
+static inline struct page *alloc_page(gfp_t flags)
+{
+    return aligned_alloc(PAGE_SIZE, PAGE_SIZE);
+}
+
+#define __free_page(p)   free(p)
+#define page_address(p)  ((void *)(p))
+
+#endif // !_JSIM_LINUX_SLAB_H_
@@ -0,0 +1,19 @@
+/**
+ * @file smp.h
+ * @author leslie.cui (10033908@github.com)
+ * @brief userspace shim of <linux/smp.h> for jsim
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef _JSIM_LINUX_SMP_H_
+#define _JSIM_LINUX_SMP_H_
+
+#include <sched.h>
+
+#define get_cpu() sched_getcpu()
+#define put_cpu()
+
+#endif // !_JSIM_LINUX_SMP_H_
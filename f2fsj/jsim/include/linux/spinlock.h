@@ -0,0 +1,58 @@
+/**
+ * @file spinlock.h
+ * @author leslie.cui (10033908@github.com)
+ * @brief userspace shim of <linux/spinlock.h> for jsim. Threads are preempted while holding
+ *        a lock in userspace, so the lock yields the cpu after spinning for a while
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef _JSIM_LINUX_SPINLOCK_H_
+#define _JSIM_LINUX_SPINLOCK_H_
+
+#include <sched.h>
+#include <linux/types.h>
+
+#define JSIM_SPIN_BEFORE_YIELD (256)
+
+typedef struct
+{
+    int locked;
+}spinlock_t;
+
+#define __SPIN_LOCK_UNLOCKED(name) { 0 }
+#define DEFINE_SPINLOCK(name) spinlock_t name = __SPIN_LOCK_UNLOCKED(name)
+
+static inline void spin_lock_init(spinlock_t *lock)
+{
+    __atomic_store_n(&lock->locked, 0, __ATOMIC_RELAXED);
+}
+
+static inline int spin_trylock(spinlock_t *lock)
+{
+    return !__atomic_load_n(&lock->locked, __ATOMIC_RELAXED)
+        && !__atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE);
+}
+
+static inline void spin_lock(spinlock_t *lock)
+{
+    int spins = 0;
+
+    while (!spin_trylock(lock))
+    {
+        if (++spins == JSIM_SPIN_BEFORE_YIELD)
+        {
+            spins = 0;
+            sched_yield();
+        }
+    }
+}
+
+static inline void spin_unlock(spinlock_t *lock)
+{
+    __atomic_store_n(&lock->locked, 0, __ATOMIC_RELEASE);
+}
+
+#endif // !_JSIM_LINUX_SPINLOCK_H_
@@ -0,0 +1,37 @@
+/**
+ * @file time.h
+ * @author leslie.cui (10033908@github.com)
+ * @brief userspace shim of <linux/time.h> for jsim
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef _JSIM_LINUX_TIME_H_
+#define _JSIM_LINUX_TIME_H_
+
+#include <time.h>
+#include <linux/types.h>
+
+struct timespec64
+{
+    int64_t tv_sec;
+    long    tv_nsec;
+};
+
+static inline void ktime_get_ts64(struct timespec64 *ts)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    ts->tv_sec  = t.tv_sec;
+    ts->tv_nsec = t.tv_nsec;
+}
+
+static inline int64_t timespec64_to_ns(const struct timespec64 *ts)
+{
+    return ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+#endif // !_JSIM_LINUX_TIME_H_
@@ -0,0 +1,45 @@
+/**
+ * @file types.h
+ * @author leslie.cui (10033908@github.com)
+ * @brief userspace shim of <linux/types.h> for jsim
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef _JSIM_LINUX_TYPES_H_
+#define _JSIM_LINUX_TYPES_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+///< 64-bit types are long long as in the kernel, so %llu fits uint64_t like it does there
+typedef unsigned char      uint8_t;
+typedef unsigned short     uint16_t;
+typedef unsigned int       uint32_t;
+typedef unsigned long long uint64_t;
+typedef unsigned long      uintptr_t;
+
+typedef uint8_t  __u8;
+typedef uint16_t __u16;
+typedef uint32_t __u32;
+typedef uint64_t __u64;
+
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int32_t  s32;
+typedef long long s64;
+
+typedef uint16_t __le16;
+typedef uint32_t __le32;
+typedef uint64_t __le64;
+
+typedef uint64_t sector_t;
+typedef unsigned long pgoff_t;
+typedef unsigned int gfp_t;
+
+#endif // !_JSIM_LINUX_TYPES_H_
@@ -0,0 +1,14 @@
+/**
+ * @file writeback.h
+ * @author leslie.cui (10033908@github.com)
+ * @brief userspace shim of <linux/writeback.h> for jsim, nothing is needed by the journal
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef _JSIM_LINUX_WRITEBACK_H_
+#define _JSIM_LINUX_WRITEBACK_H_
+
+#endif // !_JSIM_LINUX_WRITEBACK_H_
@@ -0,0 +1,10 @@
+/**
+ * @file define_trace.h
+ * @author leslie.cui (10033908@github.com)
+ * @brief userspace shim of <trace/define_trace.h> for jsim, tracepoints are not created
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
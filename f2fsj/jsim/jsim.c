@@ -0,0 +1,759 @@
+/**
+ * @file jsim.c
+ * @author leslie.cui (10033908@github.com)
+ * @brief Driver of jsim: every thread count of -t replays operations on simulated inodes,
+ *        each operation allocates its log entries, fills them and inserts the log into the
+ *        inode like namei.c/file.c do. A commit thread commits the running epoch every -c ms
+ *        like j_ep_commit_kthread(), fsync commits it at once like j_sync_epoch_commit().
+ *        Operations come from a trace (-f) or are drawn from a mix (-m), prints ops/s, logs,
+ *        journal bytes, commit latency and lock contention of each thread count. A log that
+ *        can not be inserted (i_err) fails the run
+ *
+ *        Trace, one operation per line, '#' starts a comment:
+ *            <thread> <op> <ino> [arg]
+ *        op is create, mkdir, unlink, link, rename, symlink, setattr, xattr, write, djwrite or
+ *        fsync. arg is the page index of write and the bytes of djwrite (data journaling)
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "jsim.h"
+#include "j_epoch_commit.h"
+#include "j_log_operate.h"
+#include "j_stats.h"
+
+#define JSIM_MAX_THREADS    (256)
+#define JSIM_MAX_COUNTS     (32)
+#define JSIM_MAX_TRACE_INO  (1 << 22)
+#define JSIM_FILE_PAGES     (1024)      ///< write touches a page of the first 4MB of a file
+
+typedef enum __jsim_op_e
+{
+    JSIM_CREATE  = 0,
+    JSIM_MKDIR   = 1,
+    JSIM_UNLINK  = 2,
+    JSIM_LINK    = 3,
+    JSIM_RENAME  = 4,
+    JSIM_SYMLINK = 5,
+    JSIM_SETATTR = 6,
+    JSIM_XATTR   = 7,
+    JSIM_WRITE   = 8,
+    JSIM_DJWRITE = 9,
+    JSIM_FSYNC   = 10,
+    JSIM_NR_OPS,
+}jsim_op_e;
+
+///< logs of an operation, same sizes and log lists as the f2fsj code paths
+typedef struct __jsim_op_desc
+{
+    const char *name;
+    log_type_e  log_type;
+    uint32_t    nr_entries;         ///< 0: no log
+    int         insert;             ///< log goes to the inode log list, unlink logs do not
+}jsim_op_desc_t;
+
+static const jsim_op_desc_t g_op_desc[JSIM_NR_OPS] =
+{
+    [JSIM_CREATE]  = {"create",  CREATE_LOG,       1, 1},
+    [JSIM_MKDIR]   = {"mkdir",   MKDIR_LOG,        1, 1},
+    [JSIM_UNLINK]  = {"unlink",  UNLINK_LOG,       1, 0},
+    [JSIM_LINK]    = {"link",    LINK_LOG,         2, 1},   ///< fixed part and name, j_insert_variable_log()
+    [JSIM_RENAME]  = {"rename",  RENAME_LOG,       2, 1},
+    [JSIM_SYMLINK] = {"symlink", SYMLINK_LOG,      2, 1},
+    [JSIM_SETATTR] = {"setattr", CHOWN_LOG,        1, 1},
+    [JSIM_XATTR]   = {"xattr",   XATTR_LOG,        2, 1},
+    [JSIM_WRITE]   = {"write",   DATA_WRITE_LOG,   0, 0},   ///< ordered data, a dirty range only
+    [JSIM_DJWRITE] = {"djwrite", DATA_JOURNAL_LOG, 1, 1},   ///< plus the data slots
+    [JSIM_FSYNC]   = {"fsync",   DATA_WRITE_LOG,   0, 0},
+};
+
+typedef struct __jsim_req
+{
+    uint8_t  op;
+    uint32_t ino;                   ///< index in the inode table
+    uint32_t arg;
+}jsim_req_t;
+
+///< f2fs_inode_info with the inode lock taken by the VFS around an operation
+typedef struct __jsim_inode
+{
+    struct f2fs_inode_info fi;
+    pthread_mutex_t i_rwsem;
+}jsim_inode_t;
+
+typedef struct __jsim_thread
+{
+    pthread_t   tid;
+    uint32_t    idx;
+    jsim_req_t *reqs;
+    uint64_t    nr_reqs;
+    uint64_t    cap_reqs;
+    uint64_t    seed;
+
+    uint64_t    nr_ops[JSIM_NR_OPS];
+    uint64_t    nr_alloc_err;
+    uint64_t    nr_insert_err;
+    uint64_t    nr_inode_contended;
+}jsim_thread_t;
+
+typedef struct __jsim_conf
+{
+    uint32_t    counts[JSIM_MAX_COUNTS];
+    uint32_t    nr_counts;
+    uint64_t    nr_reqs;            ///< per thread, mix only
+    uint32_t    nr_inodes;          ///< per thread, or in all with -s
+    int         shared;
+    uint32_t    mix[JSIM_NR_OPS];   ///< weights
+    uint32_t    fsync_every;        ///< a thread fsyncs after this many ops, 0: never
+    uint32_t    commit_ms;
+    const char *trace;
+    const char *dump;
+    const char *dev;
+    int         dev_sync;
+    int         csv;
+}jsim_conf_t;
+
+static jsim_conf_t g_conf =
+{
+    .counts     = {1, 2, 4, 8},
+    .nr_counts  = 4,
+    .nr_reqs    = 1000000,
+    .nr_inodes  = 4096,
+    .mix        = {[JSIM_CREATE] = 10, [JSIM_UNLINK] = 5, [JSIM_RENAME] = 5, [JSIM_SETATTR] = 30,
+                   [JSIM_WRITE] = 45, [JSIM_DJWRITE] = 5},
+    .commit_ms  = 100,
+    .dev        = "jsim.dev",
+};
+
+static struct super_block g_sb;
+static struct f2fs_sb_info g_sbi = {.sb = &g_sb, .j_data_journal_max_bytes = J_DEF_DATA_JOURNAL_MAX_BYTES};
+
+static jsim_thread_t g_threads[JSIM_MAX_THREADS];
+static jsim_inode_t *g_inodes = NULL;
+static uint32_t g_nr_inodes = 0;
+static uint32_t g_trace_threads = 0;
+static pthread_barrier_t g_barrier;
+
+///< j_epoch_process.c: epochs are committed by commit thread or by fsync, one at a time
+static pthread_mutex_t g_ep_commit_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t g_committed_ep_seq = 0;
+static volatile int g_stop_commit = 0;
+
+static uint64_t jsim_rand(uint64_t *seed)
+{
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 7;
+    *seed ^= *seed << 17;
+    return *seed;
+}
+
+///< f2fs_alloc_inode() in super.c
+static void jsim_init_inode(jsim_inode_t *inode, uint32_t ino)
+{
+    struct f2fs_inode_info *fi = &inode->fi;
+    int i = 0;
+
+    memset(inode, 0, sizeof(jsim_inode_t));
+    fi->vfs_inode.i_ino = ino;
+    fi->j_local_active_epoch = 0;
+    for (i = 0; i < MAX_GLOBAL_EP_NUM; i++)
+    {
+        INIT_LIST_HEAD(&fi->ino_regis_global_epoch_list[i]);
+        INIT_LIST_HEAD(&fi->j_ino_log_list[i].inode_log_list_head);
+        fi->j_ino_log_list[i].log_list_status = LOG_LIST_IDLE;
+        fi->j_ino_log_list[i].dirty_data_ranges.nr_ranges = 0;
+        fi->g2l_ep_map[i] = NONE_EPOCH;
+    }
+    spin_lock_init(&fi->ino_spin_lock_local_ep);
+    spin_lock_init(&fi->ino_spin_lock_global_ep);
+    pthread_mutex_init(&inode->i_rwsem, NULL);
+}
+
+///< j_commit_running_epoch(), caller holds g_ep_commit_mutex
+static int jsim_commit_running_epoch(void)
+{
+    uint64_t ep_seq = get_running_epoch_seq();
+    uint64_t start_ns = 0;
+    int ret = F2FSJ_OK;
+
+    trigger_epoch_commit();
+
+    if (!is_g_commit_ep_empty())
+    {
+        start_ns = get_current_time_ns();
+        ret = epoch_commit(&g_sbi);
+        j_stat_latency(&g_j_stats.commit_lat, start_ns);
+    }
+
+    if (ret == F2FSJ_OK)
+    {
+        g_committed_ep_seq = ep_seq + 1;
+    }
+    return ret;
+}
+
+///< j_sync_epoch_commit(), group commit of fsync
+static int jsim_sync_epoch_commit(void)
+{
+    uint64_t ep_seq = get_running_epoch_seq();
+    uint64_t start_ns = 0;
+    int ret = F2FSJ_OK;
+
+    if (pthread_mutex_trylock(&g_ep_commit_mutex))
+    {
+        start_ns = get_current_time_ns();
+        pthread_mutex_lock(&g_ep_commit_mutex);
+        j_stat_stall(start_ns);
+    }
+
+    if (g_committed_ep_seq <= ep_seq)
+    {
+        ret = jsim_commit_running_epoch();
+    }
+
+    pthread_mutex_unlock(&g_ep_commit_mutex);
+    return ret;
+}
+
+static void *jsim_commit_thread_fn(void *arg)
+{
+    while (!g_stop_commit)
+    {
+        usleep(g_conf.commit_ms * 1000);
+
+        pthread_mutex_lock(&g_ep_commit_mutex);
+        jsim_commit_running_epoch();
+        pthread_mutex_unlock(&g_ep_commit_mutex);
+    }
+    return NULL;
+}
+
+static void jsim_do_op(jsim_thread_t *t, jsim_req_t *req)
+{
+    const jsim_op_desc_t *desc = &g_op_desc[req->op];
+    jsim_inode_t *inode = &g_inodes[req->ino];
+    j_log_entry_t *log_entry = NULL;
+    uint8_t log[J_LOG_ENTRY_SIZE] = {0};
+    j_log_head_t *head = (j_log_head_t *)log;
+    uint32_t nr_entries = desc->nr_entries;
+
+    t->nr_ops[req->op] ++;
+    if (req->op == JSIM_FSYNC)
+    {
+        jsim_sync_epoch_commit();
+        return;
+    }
+
+    if (pthread_mutex_trylock(&inode->i_rwsem))
+    {
+        t->nr_inode_contended ++;
+        pthread_mutex_lock(&inode->i_rwsem);
+    }
+
+    if (req->op == JSIM_WRITE)
+    {
+        j_record_dirty_data_range(&inode->fi, req->arg, req->arg);
+        goto unlock;
+    }
+
+    if (req->op == JSIM_DJWRITE)
+    {
+        nr_entries += DIV_ROUND_UP(min_t(uint32_t, req->arg, PAGE_SIZE), J_LOG_ENTRY_SIZE);
+        nr_entries = min_t(uint32_t, nr_entries, J_LOG_ENTRY_PER_BLOCK + 1);
+    }
+
+    if (j_alloc_log_entries(desc->log_type, nr_entries, &log_entry) != F2FSJ_OK)
+    {
+        t->nr_alloc_err ++;
+        goto unlock;
+    }
+
+    // header and inode number, payload of the other entries is left as it is
+    head->log_type = desc->log_type;
+    head->log_size = nr_entries * J_LOG_ENTRY_SIZE;
+    memcpy(log + sizeof(j_log_head_t), &req->ino, sizeof(uint32_t));
+    j_copy_to_log_entries(log_entry, 0, log, J_LOG_ENTRY_SIZE);
+
+    if (!desc->insert)
+    {
+        j_free_log_entry(log_entry);
+    }
+    else if (insert_log_into_inode(&inode->fi, log_entry) != F2FSJ_OK)
+    {
+        t->nr_insert_err ++;
+        j_free_log_entry(log_entry);
+    }
+
+unlock:
+    pthread_mutex_unlock(&inode->i_rwsem);
+}
+
+static void *jsim_thread_fn(void *arg)
+{
+    jsim_thread_t *t = arg;
+    uint64_t i = 0;
+
+    pthread_barrier_wait(&g_barrier);
+    for (i = 0; i < t->nr_reqs; i++)
+    {
+        jsim_do_op(t, &t->reqs[i]);
+    }
+    return NULL;
+}
+
+static int jsim_add_req(jsim_thread_t *t, uint8_t op, uint32_t ino, uint32_t arg)
+{
+    jsim_req_t *reqs = NULL;
+
+    if (t->nr_reqs == t->cap_reqs)
+    {
+        t->cap_reqs = t->cap_reqs ? t->cap_reqs * 2 : 4096;
+        reqs = realloc(t->reqs, t->cap_reqs * sizeof(jsim_req_t));
+        if (!reqs)
+        {
+            fprintf(stderr, "no memory for %llu requests\n", (unsigned long long)t->cap_reqs);
+            return -1;
+        }
+        t->reqs = reqs;
+    }
+
+    t->reqs[t->nr_reqs].op  = op;
+    t->reqs[t->nr_reqs].ino = ino;
+    t->reqs[t->nr_reqs].arg = arg;
+    t->nr_reqs ++;
+    return 0;
+}
+
+static int jsim_op_of_name(const char *name)
+{
+    int op = 0;
+
+    for (op = 0; op < JSIM_NR_OPS; op++)
+    {
+        if (!strcmp(name, g_op_desc[op].name))
+        {
+            return op;
+        }
+    }
+    return -1;
+}
+
+///< requests of a trace go to thread (tid % threads), inode numbers index one shared table
+static int jsim_load_trace(void)
+{
+    FILE *fp = fopen(g_conf.trace, "r");
+    char line[256];
+    char name[32];
+    uint32_t tid = 0, ino = 0, arg = 0;
+    uint64_t line_no = 0;
+    int op = 0;
+
+    if (!fp)
+    {
+        perror(g_conf.trace);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp))
+    {
+        line_no ++;
+        if (line[0] == '#' || line[0] == '\n')
+        {
+            continue;
+        }
+
+        arg = 0;
+        if (sscanf(line, "%u %31s %u %u", &tid, name, &ino, &arg) < 3
+         || (op = jsim_op_of_name(name)) < 0 || ino >= JSIM_MAX_TRACE_INO)
+        {
+            fprintf(stderr, "%s:%llu: invalid request\n", g_conf.trace, (unsigned long long)line_no);
+            fclose(fp);
+            return -1;
+        }
+
+        tid %= JSIM_MAX_THREADS;
+        g_trace_threads = max(g_trace_threads, tid + 1);
+        g_nr_inodes = max(g_nr_inodes, ino + 1);
+        if (jsim_add_req(&g_threads[tid], op, ino, arg))
+        {
+            fclose(fp);
+            return -1;
+        }
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+static int jsim_gen_reqs(uint32_t nr_threads)
+{
+    uint32_t total = 0;
+    uint32_t i = 0, op = 0;
+    uint64_t j = 0, r = 0;
+    uint32_t ino = 0;
+    jsim_thread_t *t = NULL;
+
+    for (op = 0; op < JSIM_NR_OPS; op++)
+    {
+        total += g_conf.mix[op];
+    }
+
+    g_nr_inodes = g_conf.shared ? g_conf.nr_inodes : g_conf.nr_inodes * nr_threads;
+    for (i = 0; i < nr_threads; i++)
+    {
+        t = &g_threads[i];
+        t->nr_reqs = 0;
+        t->seed = 0x9e3779b97f4a7c15ULL * (i + 1);
+        for (j = 0; j < g_conf.nr_reqs; j++)
+        {
+            ino = jsim_rand(&t->seed) % g_conf.nr_inodes;
+            if (!g_conf.shared)
+            {
+                ino += i * g_conf.nr_inodes;
+            }
+
+            if (g_conf.fsync_every && (j + 1) % g_conf.fsync_every == 0)
+            {
+                op = JSIM_FSYNC;
+            }
+            else
+            {
+                r = jsim_rand(&t->seed) % total;
+                for (op = 0; r >= g_conf.mix[op]; op++)
+                {
+                    r -= g_conf.mix[op];
+                }
+            }
+
+            if (jsim_add_req(t, op, ino, jsim_rand(&t->seed) % (op == JSIM_DJWRITE ? 2048 : JSIM_FILE_PAGES)))
+            {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int jsim_dump_reqs(uint32_t nr_threads)
+{
+    FILE *fp = fopen(g_conf.dump, "w");
+    uint32_t i = 0;
+    uint64_t j = 0;
+    jsim_req_t *req = NULL;
+
+    if (!fp)
+    {
+        perror(g_conf.dump);
+        return -1;
+    }
+
+    fprintf(fp, "# <thread> <op> <ino> [arg]\n");
+    for (i = 0; i < nr_threads; i++)
+    {
+        for (j = 0; j < g_threads[i].nr_reqs; j++)
+        {
+            req = &g_threads[i].reqs[j];
+            fprintf(fp, "%u %s %u %u\n", i, g_op_desc[req->op].name, req->ino, req->arg);
+        }
+    }
+    fclose(fp);
+    return 0;
+}
+
+static int jsim_run(uint32_t nr_threads)
+{
+    pthread_t commit_tid;
+    uint64_t start_ns = 0, elapsed_ns = 0;
+    uint64_t nr_ops = 0, nr_alloc_err = 0, nr_insert_err = 0, nr_inode_contended = 0;
+    uint64_t nr_commits = 0, commit_us = 0;
+    double secs = 0;
+    uint32_t i = 0;
+    int op = 0;
+
+    if (!g_conf.trace && jsim_gen_reqs(nr_threads))
+    {
+        return -1;
+    }
+    if (g_conf.dump && jsim_dump_reqs(nr_threads))
+    {
+        return -1;
+    }
+
+    g_inodes = malloc(g_nr_inodes * sizeof(jsim_inode_t));
+    if (!g_inodes)
+    {
+        fprintf(stderr, "no memory for %u inodes\n", g_nr_inodes);
+        return -1;
+    }
+    for (i = 0; i < g_nr_inodes; i++)
+    {
+        jsim_init_inode(&g_inodes[i], i);
+    }
+
+    // a fresh journal for every thread count
+    j_stats_reset();
+    memset(&g_jsim_jfile_stats, 0, sizeof(g_jsim_jfile_stats));
+    init_global_epoch();
+    g_committed_ep_seq = 0;
+    if (jsim_jfile_init(&g_sb, g_conf.dev, g_conf.dev_sync) != F2FSJ_OK)
+    {
+        free(g_inodes);
+        return -1;
+    }
+
+    pthread_barrier_init(&g_barrier, NULL, nr_threads + 1);
+    for (i = 0; i < nr_threads; i++)
+    {
+        g_threads[i].idx = i;
+        memset(g_threads[i].nr_ops, 0, sizeof(g_threads[i].nr_ops));
+        g_threads[i].nr_alloc_err = 0;
+        g_threads[i].nr_insert_err = 0;
+        g_threads[i].nr_inode_contended = 0;
+        if (pthread_create(&g_threads[i].tid, NULL, jsim_thread_fn, &g_threads[i]))
+        {
+            fprintf(stderr, "pthread_create failed\n");
+            exit(1);
+        }
+    }
+
+    g_stop_commit = 0;
+    if (g_conf.commit_ms && pthread_create(&commit_tid, NULL, jsim_commit_thread_fn, NULL))
+    {
+        fprintf(stderr, "pthread_create failed\n");
+        exit(1);
+    }
+
+    start_ns = get_current_time_ns();
+    pthread_barrier_wait(&g_barrier);
+    for (i = 0; i < nr_threads; i++)
+    {
+        pthread_join(g_threads[i].tid, NULL);
+    }
+    elapsed_ns = get_current_time_ns() - start_ns;
+
+    g_stop_commit = 1;
+    if (g_conf.commit_ms)
+    {
+        pthread_join(commit_tid, NULL);
+    }
+
+    // commit what is left, log entries are freed by commit
+    pthread_mutex_lock(&g_ep_commit_mutex);
+    jsim_commit_running_epoch();
+    pthread_mutex_unlock(&g_ep_commit_mutex);
+
+    for (i = 0; i < nr_threads; i++)
+    {
+        for (op = 0; op < JSIM_NR_OPS; op++)
+        {
+            nr_ops += g_threads[i].nr_ops[op];
+        }
+        nr_alloc_err += g_threads[i].nr_alloc_err;
+        nr_insert_err += g_threads[i].nr_insert_err;
+        nr_inode_contended += g_threads[i].nr_inode_contended;
+    }
+
+    secs = elapsed_ns / 1e9;
+    for (i = 0; i < J_STAT_LAT_BUCKETS; i++)
+    {
+        nr_commits += atomic64_read(&g_j_stats.commit_lat.buckets[i]);
+    }
+    commit_us = atomic64_read(&g_j_stats.commit_lat.total_us);
+
+    printf(g_conf.csv ? "%u,%llu,%.3f,%.0f,%.1f,%.1f,%llu,%llu,%.1f,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n"
+                      : "%7u %10llu %8.3f %11.0f %9.1f %9.1f %8llu %8llu %9.1f %8llu %7llu %9llu %9llu %9llu %6llu %6llu %6llu\n",
+           nr_threads,
+           (unsigned long long)nr_ops, secs, nr_ops / secs,
+           atomic64_read(&g_j_stats.logged_bytes) / 1048576.0,
+           atomic64_read(&g_jsim_jfile_stats.written_bytes) / 1048576.0,
+           (unsigned long long)atomic64_read(&g_j_stats.epochs[J_STAT_EP_COMMITTED]),
+           (unsigned long long)nr_commits,
+           nr_commits ? (double)commit_us / nr_commits : 0.0,
+           (unsigned long long)atomic64_read(&g_j_stats.commit_lat.max_us),
+           (unsigned long long)atomic64_read(&g_j_stats.nr_stalls),
+           (unsigned long long)atomic64_read(&g_j_stats.lock_contended[J_STAT_LOCK_EPOCH_SWITCH]),
+           (unsigned long long)atomic64_read(&g_j_stats.lock_contended[J_STAT_LOCK_JFILE_MEMAP]),
+           (unsigned long long)nr_inode_contended,
+           (unsigned long long)atomic64_read(&g_jsim_jfile_stats.nr_wraps),
+           (unsigned long long)nr_alloc_err,
+           (unsigned long long)nr_insert_err);
+    fflush(stdout);
+
+    jsim_jfile_exit(&g_sb);
+    free(g_inodes);
+    g_inodes = NULL;
+
+    if (nr_insert_err)
+    {
+        fprintf(stderr, "%llu logs not inserted with %u threads\n", (unsigned long long)nr_insert_err, nr_threads);
+        return -1;
+    }
+    return 0;
+}
+
+static int jsim_parse_mix(char *arg)
+{
+    char *tok = NULL;
+    char *val = NULL;
+    int op = 0;
+
+    memset(g_conf.mix, 0, sizeof(g_conf.mix));
+    for (tok = strtok(arg, ","); tok; tok = strtok(NULL, ","))
+    {
+        val = strchr(tok, '=');
+        if (val)
+        {
+            *val++ = '\0';
+        }
+        op = jsim_op_of_name(tok);
+        if (op < 0 || op == JSIM_FSYNC || !val)
+        {
+            fprintf(stderr, "invalid mix %s, op=weight, fsync is given by -F\n", tok);
+            return -1;
+        }
+        g_conf.mix[op] = atoi(val);
+    }
+
+    for (op = 0; op < JSIM_NR_OPS; op++)
+    {
+        if (g_conf.mix[op])
+        {
+            return 0;
+        }
+    }
+    fprintf(stderr, "mix has no weight\n");
+    return -1;
+}
+
+static int jsim_parse_counts(char *arg)
+{
+    char *tok = NULL;
+    int n = 0;
+
+    g_conf.nr_counts = 0;
+    for (tok = strtok(arg, ","); tok && g_conf.nr_counts < JSIM_MAX_COUNTS; tok = strtok(NULL, ","))
+    {
+        n = atoi(tok);
+        if (n <= 0 || n > JSIM_MAX_THREADS)
+        {
+            fprintf(stderr, "invalid thread count %s, 1..%d\n", tok, JSIM_MAX_THREADS);
+            return -1;
+        }
+        g_conf.counts[g_conf.nr_counts++] = n;
+    }
+    return g_conf.nr_counts ? 0 : -1;
+}
+
+static void jsim_usage(const char *prog)
+{
+    fprintf(stderr,
+        "%s [options]\n"
+        "  -t 1,2,4,8        thread counts, ignored with -f\n"
+        "  -n 1000000        requests per thread\n"
+        "  -i 4096           inodes per thread, in all with -s\n"
+        "  -s                threads share the inodes\n"
+        "  -m create=10,unlink=5,rename=5,setattr=30,write=45,djwrite=5\n"
+        "                    op weights: create mkdir unlink link rename symlink setattr xattr write djwrite\n"
+        "  -F 0              fsync every N requests of a thread, 0: commit thread only\n"
+        "  -c 100            commit thread interval in ms, 0: no commit thread\n"
+        "  -f trace          replay a trace instead of the mix\n"
+        "  -w trace          write the requests as a trace\n"
+        "  -d jsim.dev       fake block device, a regular file\n"
+        "  -S                fdatasync the fake device at each commit\n"
+        "  -C                csv output\n",
+        prog);
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t i = 0;
+    int opt = 0;
+
+    while ((opt = getopt(argc, argv, "t:n:i:sm:F:c:f:w:d:SCh")) != -1)
+    {
+        switch (opt)
+        {
+            case 't':
+                if (jsim_parse_counts(optarg))
+                {
+                    return 1;
+                }
+                break;
+            case 'n': g_conf.nr_reqs = strtoull(optarg, NULL, 0); break;
+            case 'i': g_conf.nr_inodes = strtoul(optarg, NULL, 0); break;
+            case 's': g_conf.shared = 1; break;
+            case 'm':
+                if (jsim_parse_mix(optarg))
+                {
+                    return 1;
+                }
+                break;
+            case 'F': g_conf.fsync_every = strtoul(optarg, NULL, 0); break;
+            case 'c': g_conf.commit_ms = strtoul(optarg, NULL, 0); break;
+            case 'f': g_conf.trace = optarg; break;
+            case 'w': g_conf.dump = optarg; break;
+            case 'd': g_conf.dev = optarg; break;
+            case 'S': g_conf.dev_sync = 1; break;
+            case 'C': g_conf.csv = 1; break;
+            default:
+                jsim_usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (!g_conf.nr_inodes || (!g_conf.trace && !g_conf.nr_reqs))
+    {
+        jsim_usage(argv[0]);
+        return 1;
+    }
+
+    if (g_conf.trace)
+    {
+        if (jsim_load_trace())
+        {
+            return 1;
+        }
+        g_conf.counts[0] = g_trace_threads;
+        g_conf.nr_counts = 1;
+    }
+
+    if (g_conf.csv)
+    {
+        printf("threads,ops,secs,ops_s,logged_mb,journal_mb,epochs,commits,commit_avg_us,commit_max_us,"
+               "fsync_stalls,epoch_lock_cont,jfile_lock_cont,inode_lock_cont,wraps,alloc_err,insert_err\n");
+    }
+    else
+    {
+        printf("# %s, commit every %u ms, fsync every %u requests\n",
+               g_conf.trace ? g_conf.trace : (g_conf.shared ? "shared inodes" : "private inodes"),
+               g_conf.commit_ms, g_conf.fsync_every);
+        printf("%7s %10s %8s %11s %9s %9s %8s %8s %9s %8s %7s %9s %9s %9s %6s %6s %6s\n",
+               "threads", "ops", "secs", "ops/s", "log_MB", "jfile_MB", "epochs", "commits", "cmt_avg", "cmt_max",
+               "stalls", "ep_lock", "jf_lock", "ino_lock", "wraps", "a_err", "i_err");
+    }
+
+    for (i = 0; i < g_conf.nr_counts; i++)
+    {
+        if (jsim_run(g_conf.counts[i]))
+        {
+            return 1;
+        }
+    }
+
+    if (jsim_nr_printk())
+    {
+        fprintf(stderr, "%llu messages from the journal code\n", (unsigned long long)jsim_nr_printk());
+    }
+
+    for (i = 0; i < JSIM_MAX_THREADS; i++)
+    {
+        free(g_threads[i].reqs);
+    }
+    return 0;
+}
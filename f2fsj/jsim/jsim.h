@@ -0,0 +1,43 @@
+/**
+ * @file jsim.h
+ * @author leslie.cui (10033908@github.com)
+ * @brief jsim, userspace simulator of the journal engine. j_epoch.c, j_log_list.c and
+ *        j_epoch_commit.c are built as they are against a shim of the kernel (include/) and of
+ *        f2fs (shim/), the memory mapped journal file of j_journal_file.c is mirrored by
+ *        jsim_jfile.c and written to a regular file that stands for the block device
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef _JSIM_H_
+#define _JSIM_H_
+
+#include "f2fs.h"
+#include "j_journal_file.h"
+
+typedef struct __jsim_jfile_stats
+{
+    atomic64_t nr_commits;          ///< write_current_mmap_j_file()
+    atomic64_t written_bytes;       ///< journal pages written to the fake device
+    atomic64_t nr_wraps;            ///< log entry allocation went back to the file start
+    atomic64_t nr_data_ranges;      ///< dirty data ranges written back at commit, data is not simulated
+}jsim_jfile_stats_t;
+
+extern jsim_jfile_stats_t g_jsim_jfile_stats;
+
+/**
+ * @brief Map the journal file in memory and open the fake device
+ *
+ * @param dev_path, regular file, created when missing
+ * @param sync, fdatasync() the fake device at each commit
+ */
+int jsim_jfile_init(struct super_block *sb, const char *dev_path, int sync);
+
+void jsim_jfile_exit(struct super_block *sb);
+
+///< messages printed by the journal code, the first ones only are shown
+uint64_t jsim_nr_printk(void);
+
+#endif // !_JSIM_H_
@@ -0,0 +1,365 @@
+/**
+ * @file jsim_jfile.c
+ * @author leslie.cui (10033908@github.com)
+ * @brief Memory mapped journal file of j_journal_file.c over a fake block device. Log entry
+ *        allocation is the same as j_alloc_log_entries(), keep them in sync. Journal pages are
+ *        written like j_write_mmap_j_file() without compression, the fake device is a regular
+ *        file that holds the journal file only, block JORNAL_FILE_0_START_BLK is at offset 0
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "jsim.h"
+#include "j_op_lat.h"
+#include "j_stats.h"
+
+#define JSIM_PAGES_PER_WRITE (256)     ///< pages of one bio in j_write_journal_pages()
+
+jsim_jfile_stats_t g_jsim_jfile_stats;
+
+static struct kmem_cache* j_log_entry_info_slab = NULL;
+static j_file_mapping_t j_file_mmap[4] = {0};
+static j_jsb_info_t g_jsb = {0};
+static j_on_disk_file_into_t g_on_disk_j_file = {0};
+static uint64_t g_total_alloc_log_entries = 0; ///< protected by j_file_memap_lock
+
+///< protected by j_file_memap_lock, epochs are applied once committed so the tail follows g_stable_log_entry
+static uint32_t g_written_log_entry = 0;
+static uint32_t g_stable_log_entry  = 0;
+static uint32_t g_live_log_entry    = 0;
+
+static uint8_t *g_jfile_mem = NULL;
+static int g_dev_sync = 0;
+
+int jsim_jfile_init(struct super_block *sb, const char *dev_path, int sync)
+{
+    int i = 0;
+
+    sb->s_bdev_fd = open(dev_path, O_RDWR | O_CREAT, 0644);
+    if (sb->s_bdev_fd < 0)
+    {
+        perror(dev_path);
+        return F2FSJ_ERROR;
+    }
+    g_dev_sync = sync;
+
+    spin_lock_init(&g_jsb.j_file_memap_lock);
+    j_log_entry_info_slab = kmem_cache_create("f2fsj_log_entry_info_cache_heap", sizeof(j_log_entry_t), 0, 0, NULL);
+
+    // pages are faulted in as logs are written, an untouched journal costs no memory
+    g_jfile_mem = mmap(NULL, JOURNAL_FILE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (g_jfile_mem == MAP_FAILED || !j_log_entry_info_slab)
+    {
+        STATUS_LOG(STATUS_FATAL, "map journal file fail\n");
+        close(sb->s_bdev_fd);
+        return F2FSJ_ERROR;
+    }
+
+    j_file_mmap[0].j_file_state = J_FILE_IDLE;
+    j_file_mmap[0].j_cur_file = 0;
+    j_file_mmap[0].j_cur_log_entry_idx = 0;
+    for (i = 0; i < JOURNAL_BLK_PER_SMALL_FILE; i++)
+    {
+        j_file_mmap[0].j_pages[i] = (struct page *)(g_jfile_mem + (size_t)i * PAGE_SIZE);
+        j_file_mmap[0].j_pages_buf[i] = (char *)(g_jfile_mem + (size_t)i * PAGE_SIZE);
+    }
+    j_file_mmap[0].j_cur_file_start_blk = JORNAL_FILE_0_START_BLK;
+    j_file_mmap[0].j_cur_file_end_blk = JORNAL_FILE_0_START_BLK + JOURNAL_BLK_PER_SMALL_FILE;
+    j_file_mmap[0].j_cur_file_first_inused_blk = JORNAL_FILE_0_START_BLK;
+
+    g_jsb.j_current_small_file = F2FSJ_J_FILE_0;
+    g_total_alloc_log_entries = 0;
+    g_written_log_entry = 0;
+    g_stable_log_entry  = 0;
+    g_live_log_entry    = 0;
+    g_on_disk_j_file.total_file_size = JOURNAL_FILE_SIZE;
+    g_on_disk_j_file.used_file_size  = 0;
+
+    return F2FSJ_OK;
+}
+
+void jsim_jfile_exit(struct super_block *sb)
+{
+    munmap(g_jfile_mem, JOURNAL_FILE_SIZE);
+    kmem_cache_destroy(j_log_entry_info_slab);
+    close(sb->s_bdev_fd);
+}
+
+static uint32_t j_live_journal_pages(uint32_t head_log_entry)
+{
+    return (J_LOG_ENTRY_TO_BLK(head_log_entry) + JOURNAL_BLK_PER_SMALL_FILE
+          - J_LOG_ENTRY_TO_BLK(g_live_log_entry)) % JOURNAL_BLK_PER_SMALL_FILE + 1;
+}
+
+///< j_advance_log_head() of j_journal_file.c, log compaction is not simulated
+static uint32_t j_advance_log_head(j_file_mapping_t *j_f_mapping, uint32_t nr_entries)
+{
+    uint32_t head = j_f_mapping->j_cur_log_entry_idx;
+    uint32_t log_entry_idx = head;
+    uint32_t page = J_LOG_ENTRY_TO_BLK(head);
+    uint32_t new_pages = 0;
+    uint32_t free_pages = 0;
+    j_log_head_t *wrap_log = NULL;
+
+    if (log_entry_idx + nr_entries > J_LOG_WRAP_ENTRY)
+    {
+        log_entry_idx = 0;
+    }
+
+    new_pages  = (J_LOG_ENTRY_TO_BLK(log_entry_idx + nr_entries) + JOURNAL_BLK_PER_SMALL_FILE - page)
+               % JOURNAL_BLK_PER_SMALL_FILE;
+    free_pages = JOURNAL_BLK_PER_SMALL_FILE - j_live_journal_pages(head);
+    if (new_pages > free_pages)
+    {
+        return J_LOG_ENTRY_PER_FILE;
+    }
+
+    while (new_pages--)
+    {
+        page = (page + 1) % JOURNAL_BLK_PER_SMALL_FILE;
+        memset(j_f_mapping->j_pages_buf[page], 0, PAGE_SIZE);
+    }
+
+    if (log_entry_idx != head)
+    {
+        wrap_log = (j_log_head_t *)(J_LOG_ENTRY_ADDR(j_f_mapping, head));
+        wrap_log->log_type = WRAP_LOG;
+        wrap_log->log_size = J_LOG_ENTRY_SIZE;
+        atomic64_inc(&g_jsim_jfile_stats.nr_wraps);
+    }
+
+    j_f_mapping->j_cur_log_entry_idx = log_entry_idx + nr_entries;
+    return log_entry_idx;
+}
+
+int j_alloc_log_entry(log_type_e log_type, j_log_entry_t **log_entry)
+{
+    return j_alloc_log_entries(log_type, 1, log_entry);
+}
+
+int j_alloc_log_entries(log_type_e log_type, uint32_t nr_entries, j_log_entry_t **log_entry)
+{
+    j_file_mapping_t *j_f_mapping = NULL;
+    uint32_t log_entry_idx = 0;
+    uint64_t start_ns = j_op_lat_now();
+
+    *log_entry = NULL;
+    if (nr_entries == 0 || nr_entries > J_LOG_ENTRY_PER_BLOCK + 1)
+    {
+        STATUS_LOG(STATUS_ERROR, "invalid number of log entries %u\n", nr_entries);
+        return F2FSJ_ERROR;
+    }
+
+    *log_entry = kmem_cache_alloc(j_log_entry_info_slab, GFP_NOIO);
+    if (*log_entry == NULL)
+    {
+        INFO_REPORT("allocate memory for log entry info failed\n");
+        return F2FSJ_ERROR;
+    }
+
+    j_stat_spin_lock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+
+    j_f_mapping = &j_file_mmap[g_jsb.j_current_small_file];
+    if (j_f_mapping->j_file_state == J_FILE_IDLE)
+    {
+        j_f_mapping->j_file_state = J_FILE_INUSE;
+    }
+    else if (j_f_mapping->j_file_state == J_WHOLE_FILE_WAIT_COMMIT)
+    {
+        j_stat_spin_unlock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+        atomic64_inc(&g_j_stats.nr_alloc_fail);
+        kmem_cache_free(j_log_entry_info_slab, *log_entry);
+        *log_entry = NULL;
+        return F2FSJ_ERROR;
+    }
+
+    // entries of one log must be continuous, do not split it at the end of journal file
+    log_entry_idx = j_advance_log_head(j_f_mapping, nr_entries);
+    if (log_entry_idx == J_LOG_ENTRY_PER_FILE)
+    {
+        j_stat_spin_unlock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+        atomic64_inc(&g_j_stats.nr_alloc_fail);
+        kmem_cache_free(j_log_entry_info_slab, *log_entry);
+        *log_entry = NULL;
+        return F2FSJ_ERROR;
+    }
+
+    (*log_entry)->log_entry_idx  = log_entry_idx;
+    (*log_entry)->log_entry_addr = (uint8_t *)(J_LOG_ENTRY_ADDR(j_f_mapping, log_entry_idx));
+    (*log_entry)->log_type       = log_type;
+
+    g_total_alloc_log_entries += nr_entries;
+    j_f_mapping->j_file_state = J_PARTIAL_FILE_WAIT_COMMIT;
+
+    j_stat_spin_unlock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+
+    j_stat_log(log_type, nr_entries * J_LOG_ENTRY_SIZE);
+    j_op_lat_log_phase(log_type, J_OP_PHASE_ALLOC, start_ns);
+    return F2FSJ_OK;
+}
+
+int j_copy_to_log_entries(j_log_entry_t *log_entry, uint32_t entry_ofs, const uint8_t *src, uint32_t len)
+{
+    j_file_mapping_t *j_f_mapping = &j_file_mmap[g_jsb.j_current_small_file];
+    uint32_t log_entry_idx = log_entry->log_entry_idx + entry_ofs;
+    uint32_t copy_len = 0;
+
+    // continuous entries in one journal page are continuous in memory, copy page by page
+    while (len)
+    {
+        copy_len = min_t(uint32_t, len,
+                (J_LOG_ENTRY_PER_BLOCK - J_LOG_ENTRY_TO_BLK_OFFSET(log_entry_idx)) * J_LOG_ENTRY_SIZE);
+        memcpy(J_LOG_ENTRY_ADDR(j_f_mapping, log_entry_idx), src, copy_len);
+
+        src += copy_len;
+        len -= copy_len;
+        log_entry_idx += DIV_ROUND_UP(copy_len, J_LOG_ENTRY_SIZE);
+    }
+
+    return F2FSJ_OK;
+}
+
+int j_free_log_entry(j_log_entry_t * log_entry)
+{
+    if (log_entry)
+    {
+        kmem_cache_free(j_log_entry_info_slab, log_entry);
+    }
+    else
+    {
+        INFO_REPORT("NULL log entry, cannot free\n");
+        return F2FSJ_ERROR;
+    }
+    return F2FSJ_OK;
+}
+
+uint64_t get_total_alloc_log_entries()
+{
+    uint64_t nr_logs = 0;
+
+    j_stat_spin_lock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+    nr_logs = g_total_alloc_log_entries;
+    j_stat_spin_unlock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+
+    return nr_logs;
+}
+
+///< j_write_journal_pages(), a pwritev() of up to JSIM_PAGES_PER_WRITE pages stands for a bio
+static int j_write_journal_pages(struct f2fs_sb_info *sbi, int j_file_idx, uint32_t page_idx, uint32_t nr_pages)
+{
+    struct iovec iov[JSIM_PAGES_PER_WRITE];
+    uint32_t nr_bio_pages = 0;
+    uint32_t j = 0;
+    off_t ofs = 0;
+
+    while (nr_pages)
+    {
+        nr_bio_pages = min_t(uint32_t, nr_pages, JSIM_PAGES_PER_WRITE);
+        for (j = 0; j < nr_bio_pages; j++)
+        {
+            iov[j].iov_base = j_file_mmap[j_file_idx].j_pages_buf[page_idx + j];
+            iov[j].iov_len  = PAGE_SIZE;
+        }
+
+        ofs = (off_t)(j_file_mmap[j_file_idx].j_cur_file_start_blk + page_idx - JORNAL_FILE_0_START_BLK) * PAGE_SIZE;
+        if (pwritev(sbi->sb->s_bdev_fd, iov, nr_bio_pages, ofs) != (ssize_t)nr_bio_pages * PAGE_SIZE)
+        {
+            STATUS_LOG(STATUS_ERROR, "write journal pages [%u, %u) fail\n", page_idx, page_idx + nr_bio_pages);
+            return F2FSJ_ERROR;
+        }
+        atomic64_add((uint64_t)nr_bio_pages * PAGE_SIZE, &g_jsim_jfile_stats.written_bytes);
+
+        page_idx += nr_bio_pages;
+        nr_pages -= nr_bio_pages;
+    }
+
+    return F2FSJ_OK;
+}
+
+static int j_write_journal_range(struct f2fs_sb_info *sbi, int j_file_idx, uint32_t start_page, uint32_t nr_pages)
+{
+    uint32_t head_pages = 0;
+    int ret = F2FSJ_OK;
+
+    if (start_page + nr_pages <= JOURNAL_BLK_PER_SMALL_FILE)
+    {
+        return j_write_journal_pages(sbi, j_file_idx, start_page, nr_pages);
+    }
+
+    // log entry allocation wraps around the journal file
+    head_pages = JOURNAL_BLK_PER_SMALL_FILE - start_page;
+    ret = j_write_journal_pages(sbi, j_file_idx, start_page, head_pages);
+    if (ret == F2FSJ_OK)
+    {
+        ret = j_write_journal_pages(sbi, j_file_idx, 0, nr_pages - head_pages);
+    }
+    return ret;
+}
+
+int write_current_mmap_j_file(struct f2fs_sb_info *sbi)
+{
+    int i = 0;
+    uint32_t start_page = 0;
+    uint32_t end_page = 0;
+    uint32_t file_pages = 0;
+    uint32_t cur_log_entry_idx = 0;
+    uint32_t live_pages = 0;
+
+    j_stat_spin_lock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+    cur_log_entry_idx = j_file_mmap[0].j_cur_log_entry_idx;
+    live_pages = j_live_journal_pages(cur_log_entry_idx);
+    j_stat_spin_unlock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+
+    for (i = 0; i < NR_JOUNRAL_SMALL_FILE; i++)
+    {
+        if (j_file_mmap[i].j_file_state != J_WHOLE_FILE_WAIT_COMMIT
+         && j_file_mmap[i].j_file_state != J_PARTIAL_FILE_WAIT_COMMIT)
+        {
+            continue;
+        }
+
+        start_page = j_file_mmap[i].j_cur_file_first_inused_blk - j_file_mmap[i].j_cur_file_start_blk;
+        end_page   = min_t(uint32_t, J_LOG_ENTRY_TO_BLK(cur_log_entry_idx), JOURNAL_BLK_PER_SMALL_FILE - 1);
+
+        if (end_page >= start_page)
+        {
+            file_pages = end_page - start_page + 1;
+        }
+        else
+        {
+            file_pages = JOURNAL_BLK_PER_SMALL_FILE - start_page + end_page + 1;
+        }
+
+        if (j_write_journal_range(sbi, i, start_page, file_pages) != F2FSJ_OK)
+        {
+            return F2FSJ_ERROR;
+        }
+
+        // the last page is partially used and is written again next time
+        j_file_mmap[i].j_cur_file_first_inused_blk = j_file_mmap[i].j_cur_file_start_blk + end_page;
+        g_on_disk_j_file.used_file_size = live_pages * PAGE_SIZE;
+    }
+
+    // REQ_PREFLUSH | REQ_FUA of the journal write
+    if (g_dev_sync && fdatasync(sbi->sb->s_bdev_fd))
+    {
+        STATUS_LOG(STATUS_ERROR, "sync fake device fail\n");
+        return F2FSJ_ERROR;
+    }
+
+    // write_current_mmap_j_file() and j_reset_journal_tail() of a checkpoint run with each commit
+    j_stat_spin_lock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+    g_stable_log_entry  = g_written_log_entry;
+    g_written_log_entry = cur_log_entry_idx;
+    g_live_log_entry    = g_stable_log_entry;
+    j_stat_spin_unlock(&g_jsb.j_file_memap_lock, J_STAT_LOCK_JFILE_MEMAP);
+
+    atomic64_inc(&g_jsim_jfile_stats.nr_commits);
+    return F2FSJ_OK;
+}
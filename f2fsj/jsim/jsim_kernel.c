@@ -0,0 +1,169 @@
+/**
+ * @file jsim_kernel.c
+ * @author leslie.cui (10033908@github.com)
+ * @brief Stand-ins of what the journal engine calls outside of the files jsim builds:
+ *        statistics (j_stats.c, j_op_lat.c), checkpoint list (j_checkpoint.c), data writeback
+ *        at commit and meta deltas. Data pages and f2fs metadata are not simulated, the
+ *        checkpoint list of an epoch is applied (freed) as soon as the epoch is committed
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include <stdarg.h>
+#include "jsim.h"
+#include "j_checkpoint.h"
+#include "j_log_operate.h"
+#include "j_op_lat.h"
+#include "j_stats.h"
+
+#define JSIM_MAX_PRINTK (20)
+
+j_journal_stats_t g_j_stats;
+bool g_j_stat_lock_hold_on = false;
+bool g_j_op_lat_on = false;
+
+static atomic64_t g_nr_printk;
+
+int jsim_printk(const char *fmt, ...)
+{
+    va_list args;
+    int ret = 0;
+
+    if (atomic64_inc_return(&g_nr_printk) > JSIM_MAX_PRINTK)
+    {
+        return 0;
+    }
+
+    va_start(args, fmt);
+    ret = vfprintf(stderr, fmt, args);
+    va_end(args);
+    return ret;
+}
+
+uint64_t jsim_nr_printk(void)
+{
+    return atomic64_read(&g_nr_printk);
+}
+
+void j_stat_latency(j_stat_lat_hist_t *hist, uint64_t start_ns)
+{
+    uint64_t lat_us = (get_current_time_ns() - start_ns) / 1000;
+    uint64_t max_us = atomic64_read(&hist->max_us);
+    uint32_t bucket = lat_us ? 64 - __builtin_clzll(lat_us) : 0;
+
+    atomic64_inc(&hist->buckets[min_t(uint32_t, bucket, J_STAT_LAT_BUCKETS - 1)]);
+    atomic64_add(lat_us, &hist->total_us);
+
+    while (lat_us > max_us
+        && !__atomic_compare_exchange_n(&hist->max_us.counter, &max_us, lat_us, false,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+}
+
+///< hold times are not measured by jsim, g_j_stat_lock_hold_on stays off
+void j_stat_lock_hold(j_stat_lock_e lock_idx)
+{
+    g_j_stats.lock_acquired_ns[lock_idx] = 0;
+}
+
+void j_stat_stall(uint64_t start_ns)
+{
+    atomic64_inc(&g_j_stats.nr_stalls);
+    atomic64_add((get_current_time_ns() - start_ns) / 1000, &g_j_stats.stall_us);
+}
+
+void j_stats_reset(void)
+{
+    memset(&g_j_stats, 0, sizeof(g_j_stats));
+}
+
+void j_crash_point(struct f2fs_sb_info *sbi, j_crash_point_e point)
+{
+}
+
+void j_op_lat_log_phase(log_type_e log_type, j_op_phase_e phase, uint64_t start_ns)
+{
+}
+
+int alloc_log_cp_head_node_memory(j_checkpoint_list_t **cp_head_node)
+{
+    *cp_head_node = kmalloc(sizeof(j_checkpoint_list_t), GFP_NOIO);
+    if (!(*cp_head_node))
+    {
+        STATUS_LOG(STATUS_ERROR, "allocate cp_head_node memory failed\n");
+        return F2FSJ_ERROR;
+    }
+
+    INIT_LIST_HEAD(&((*cp_head_node)->ep_log_cp_info_list_head));
+    (*cp_head_node)->nr_logs = 0;
+
+    return F2FSJ_OK;
+}
+
+///< one cp_info per log like j_checkpoint.c, only the inode is recorded
+int get_cp_info_from_log(struct f2fs_inode_info *f2fs_i, j_checkpoint_list_t *cp_head_node, j_log_entry_t *log_entry)
+{
+    j_log_cp_info_t *cp_info = kzalloc(sizeof(j_log_cp_info_t), GFP_NOIO);
+
+    if (!cp_info)
+    {
+        STATUS_LOG(STATUS_ERROR, "alloc mem for cp_info fail\n");
+        return F2FSJ_ERROR;
+    }
+
+    cp_info->log_inode_id = f2fs_i->vfs_inode.i_ino;
+    list_add_tail(&cp_info->log_cp_list, &cp_head_node->ep_log_cp_info_list_head);
+    cp_head_node->nr_logs ++;
+
+    return F2FSJ_OK;
+}
+
+int set_page_dirty_and_ready_do_cp(struct f2fs_sb_info *sbi, j_checkpoint_list_t *cp_head_node)
+{
+    return F2FSJ_OK;
+}
+
+int free_log_cp_list(j_checkpoint_list_t *cp_head_node)
+{
+    j_log_cp_info_t *cp_info = NULL;
+    j_log_cp_info_t *cp_info_next = NULL;
+
+    list_for_each_entry_safe(cp_info, cp_info_next, &cp_head_node->ep_log_cp_info_list_head, log_cp_list)
+    {
+        list_del(&cp_info->log_cp_list);
+        kfree(cp_info);
+    }
+    kfree(cp_head_node);
+
+    return F2FSJ_OK;
+}
+
+///< the epoch is applied at once, journal space is reclaimed by wrapping around. Local epochs
+///< and g2l_ep_map of its inodes are already recycled by epoch_commit() as in the module
+int insert_cp_info_list_head_2_g_cp_list(j_checkpoint_list_t *cp_head_node)
+{
+    free_log_cp_list(cp_head_node);
+
+    j_stat_epoch(J_STAT_EP_APPLIED, 1);
+    return F2FSJ_OK;
+}
+
+int ep_commit_writeback_data_pages(struct f2fs_inode_info *f2fs_i, j_dirty_range_set_t *ranges)
+{
+    atomic64_add(ranges->nr_ranges, &g_jsim_jfile_stats.nr_data_ranges);
+    return F2FSJ_OK;
+}
+
+int ep_commit_wait_data_pages(struct f2fs_inode_info *f2fs_i, j_dirty_range_set_t *ranges)
+{
+    return F2FSJ_OK;
+}
+
+///< block allocation is not simulated, there are no meta deltas
+int j_log_meta_deltas(void)
+{
+    return F2FSJ_OK;
+}
@@ -0,0 +1,110 @@
+/**
+ * @file f2fs.h
+ * @author leslie.cui (10033908@github.com)
+ * @brief jsim stand-in of f2fs.h. Only what the journal engine touches is kept: the journal
+ *        fields of f2fs_inode_info (same as F2FSJ_CTRL_CP part of ../../f2fs.h, keep them in sync),
+ *        the sb_info tunables and a superblock over the fake block device
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef _JSIM_F2FS_H_
+#define _JSIM_F2FS_H_
+
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/slab.h>
+#include <linux/atomic.h>
+
+#define ENABLE_F2FSJ (0)
+#define F2FSJ_CTRL_CP (1)
+
+#include "j_epoch.h"
+
+///< segment types appear in log prototypes only
+typedef enum {
+    CURSEG_HOT_DATA = 0,
+    CURSEG_WARM_DATA,
+    CURSEG_COLD_DATA,
+    CURSEG_HOT_NODE,
+    CURSEG_WARM_NODE,
+    CURSEG_COLD_NODE,
+    NO_CHECK_TYPE,
+}f2fs_current_seg_e;
+
+///< fake block device, a regular file
+struct super_block
+{
+    int s_bdev_fd;
+};
+
+struct inode
+{
+    unsigned long i_ino;
+    atomic_t i_count;
+};
+
+struct f2fs_sb_info
+{
+    struct super_block *sb;
+
+    unsigned int j_data_journal_max_bytes;
+};
+
+struct f2fs_inode_info
+{
+    struct inode vfs_inode;
+
+    ///< Epoch
+    uint8_t j_local_active_epoch;
+
+    j_ino_local_epoch_t j_ino_log_list[MAX_GLOBAL_EP_NUM];
+
+    ///< register into global epoch
+    struct list_head ino_regis_global_epoch_list[MAX_GLOBAL_EP_NUM];
+
+    ///< global -> local epoch mapping
+    uint8_t g2l_ep_map[MAX_GLOBAL_EP_NUM];
+
+    spinlock_t ino_spin_lock_local_ep;
+
+    spinlock_t ino_spin_lock_global_ep;
+
+    read_stat_log_t *j_atime_log;
+    uint64_t j_atime_log_ep;
+};
+
+static inline struct f2fs_inode_info *F2FS_I(struct inode *inode)
+{
+    return container_of(inode, struct f2fs_inode_info, vfs_inode);
+}
+
+static inline struct inode *igrab(struct inode *inode)
+{
+    atomic_inc(&inode->i_count);
+    return inode;
+}
+
+static inline void iput(struct inode *inode)
+{
+    atomic_dec(&inode->i_count);
+}
+
+///< data pages are not simulated, plugging does nothing
+struct blk_plug
+{
+    int unused;
+};
+
+#define blk_start_plug(plug)  ((void)(plug))
+#define blk_finish_plug(plug) ((void)(plug))
+
+///< only passed by pointer in the prototypes of the journal headers
+struct bio;
+struct qstr;
+
+#endif // !_JSIM_F2FS_H_
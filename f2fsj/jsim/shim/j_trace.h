@@ -0,0 +1,27 @@
+/**
+ * @file j_trace.h
+ * @author leslie.cui (10033908@github.com)
+ * @brief jsim stand-in of j_trace.h, tracepoints compile to nothing
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef _JSIM_J_TRACE_H_
+#define _JSIM_J_TRACE_H_
+
+#define trace_f2fsj_alloc_log(...)
+#define trace_f2fsj_inode_checkin(...)
+#define trace_f2fsj_inode_checkin_enabled() (0)
+#define trace_f2fsj_insert_log(...)
+#define trace_f2fsj_epoch_seal(...)
+#define trace_f2fsj_aggregate_start(...)
+#define trace_f2fsj_aggregate_end(...)
+#define trace_f2fsj_journal_bio_submit(...)
+#define trace_f2fsj_journal_bio_complete(...)
+#define trace_f2fsj_checkpoint_apply_start(...)
+#define trace_f2fsj_checkpoint_apply_end(...)
+#define trace_f2fsj_replay_log(...)
+
+#endif // !_JSIM_J_TRACE_H_
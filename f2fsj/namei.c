@@ -23,6 +23,27 @@
 #include <trace/events/f2fs.h>
 
 #include "j_log_operate.h"
+#include "j_epoch_process.h"
+#include "j_op_lat.h"
+
+#if F2FSJ_CTRL_CP
+/*
+ * A journaled namespace operation is durable once the running epoch
+ * commits, only fall back to checkpoint for what was not journaled.
+ *
+ * Recovery does not replay link, symlink and rename logs yet, so until
+ * it does (F2FSJ_DIRSYNC_COMMIT) they are not logged and dirsync always
+ * writes a checkpoint.
+ */
+static void f2fsj_sync_dir(struct f2fs_sb_info *sbi, bool journaled)
+{
+#if F2FSJ_DIRSYNC_COMMIT
+	if (journaled && !j_sync_epoch_commit(sbi))
+		return;
+#endif
+	f2fs_sync_fs(sbi->sb, 1);
+}
+#endif
 
 static struct inode *f2fs_new_inode(struct inode *dir, umode_t mode)
 {
@@ -334,8 +355,8 @@ static void set_compress_inode(struct f2fs_sb_info *sbi, struct inode *inode,
 	}
 }
 
-static int f2fs_create(struct user_namespace *mnt_userns, struct inode *dir,
-		       struct dentry *dentry, umode_t mode, bool excl)
+static int __f2fs_create(struct inode *dir, struct dentry *dentry,
+			 umode_t mode, j_op_lat_t *lat)
 {
 	struct f2fs_sb_info *sbi = F2FS_I_SB(dir);
 	struct inode *inode;
@@ -384,6 +405,7 @@ static int f2fs_create(struct user_namespace *mnt_userns, struct inode *dir,
 
     /************ Journal begin ************/
 #if 1
+    j_op_lat_phase_begin(lat);
     j_log_entry_t *log_create_file;
     j_alloc_log_entry(CREATE_LOG, &log_create_file);
 
@@ -405,6 +427,7 @@ static int f2fs_create(struct user_namespace *mnt_userns, struct inode *dir,
 
     // insert log into per-inode log list
     insert_log_into_inode(F2FS_I(inode), log_create_file);
+    j_op_lat_phase_end(lat, J_OP_PHASE_LOG);
 #endif
     /************ Journal end ************/
 
@@ -416,6 +439,18 @@ out:
 	return err;
 }
 
+static int f2fs_create(struct user_namespace *mnt_userns, struct inode *dir,
+		       struct dentry *dentry, umode_t mode, bool excl)
+{
+	j_op_lat_t lat;
+	int err;
+
+	j_op_lat_begin(&lat, J_OP_CREATE);
+	err = __f2fs_create(dir, dentry, mode, &lat);
+	j_op_lat_end(&lat);
+	return err;
+}
+
 static int f2fs_link(struct dentry *old_dentry, struct inode *dir,
 		struct dentry *dentry)
 {
@@ -423,8 +458,7 @@ static int f2fs_link(struct dentry *old_dentry, struct inode *dir,
 	struct f2fs_sb_info *sbi = F2FS_I_SB(dir);
 	int err;
 
-    ///< hard link just add a new directory entry into dir
-    delta_log_t *dlog_dir = NULL;
+	bool journaled = false;
 
 	if (unlikely(f2fs_cp_error(sbi)))
 		return -EIO;
@@ -444,46 +478,6 @@ static int f2fs_link(struct dentry *old_dentry, struct inode *dir,
 	if (err)
 		return err;
 
-    /** collect log before link()*/
-#if ENABLE_F2FSJ
-    alloc_log_entry_memory(&dlog_dir);
-    struct f2fs_filename fname;
-    if (dlog_dir)
-    {
-        ///< prepare log head
-        dlog_dir->delta_log_head.log_type = DIR_LOG; //LINK_LOG;
-        dlog_dir->delta_log_head.checksum = 0;    /** TODO, crc*/
-        dlog_dir->delta_log_head.log_size = sizeof(j_log_contents_t);
-
-        ///< log contents
-        err = f2fs_setup_filename(dir, &dentry->d_name, 0, &fname);
-        if (err)
-        {
-            STATUS_LOG(STATUS_ERROR, "setup filename failed, lost new dir entry log\n");
-            goto original_link_path;
-        }
-        dlog_dir->delta_log_contents.log_dir_mi.inline_dir_or_regular = f2fs_has_inline_dentry(dir);
-        dlog_dir->delta_log_contents.log_dir_mi.hash_code = fname.hash;
-        dlog_dir->delta_log_contents.log_dir_mi.ino = inode->i_ino;
-        dlog_dir->delta_log_contents.log_dir_mi.parent_ino = dir->i_ino;
-        dlog_dir->delta_log_contents.log_dir_mi.file_type = inode->i_mode;
-        dlog_dir->delta_log_contents.log_dir_mi.name_len = fname.disk_name.len;
-        memcpy(dlog_dir->delta_log_contents.log_dir_mi.file_name, fname.disk_name.name, fname.disk_name.len);
-        ///< also would modify parent inode attr
-        dlog_dir->delta_log_contents.log_dir_mi.pino_basic_attr.c_time  = dir->i_ctime;
-        dlog_dir->delta_log_contents.log_dir_mi.pino_basic_attr.m_time  = dir->i_mtime;
-        dlog_dir->delta_log_contents.log_dir_mi.pino_basic_attr.i_size  = dir->i_size;
-
-        insert_log_into_inode(F2FS_I(dir), dlog_dir);
-    }
-    else
-    {
-        STATUS_LOG(STATUS_ERROR, "apply log memory fail\n");
-    }
-
-original_link_path:
-#endif
-
 	f2fs_balance_fs(sbi, true);
 
 	inode->i_ctime = current_time(inode);
@@ -494,12 +488,19 @@ original_link_path:
 	err = f2fs_add_link(dentry, inode);
 	if (err)
 		goto out;
+#if F2FSJ_CTRL_CP && F2FSJ_DIRSYNC_COMMIT
+	journaled = j_log_link(dir, inode, &dentry->d_name) == F2FSJ_OK;
+#endif
 	f2fs_unlock_op(sbi);
 
 	d_instantiate(dentry, inode);
 
 	if (IS_DIRSYNC(dir))
+#if F2FSJ_CTRL_CP
+		f2fsj_sync_dir(sbi, journaled);
+#else
 		f2fs_sync_fs(sbi->sb, 1);
+#endif
 	return 0;
 out:
 	clear_inode_flag(inode, FI_INC_LINK);
@@ -660,7 +661,8 @@ out:
 	return ERR_PTR(err);
 }
 
-static int f2fs_unlink(struct inode *dir, struct dentry *dentry)
+static int __f2fs_unlink(struct inode *dir, struct dentry *dentry,
+			 j_op_lat_t *lat)
 {
 	struct f2fs_sb_info *sbi = F2FS_I_SB(dir);
 	struct inode *inode = d_inode(dentry);
@@ -695,6 +697,7 @@ static int f2fs_unlink(struct inode *dir, struct dentry *dentry)
 
     /************ Journal begin ************/
 #if 1
+    j_op_lat_phase_begin(lat);
     j_log_entry_t *unlink_log;
     j_alloc_log_entry(UNLINK_LOG, &unlink_log);
 
@@ -717,6 +720,7 @@ static int f2fs_unlink(struct inode *dir, struct dentry *dentry)
 	// Cause using mmap journal file, log is already in mapped journal; to avoid inode is free before journal commit; don't add it into log list
     // insert log into per-inode log list
     //insert_log_into_inode(F2FS_I(inode), unlink_log);
+    j_op_lat_phase_end(lat, J_OP_PHASE_LOG);
 #endif
     /************ Journal end ************/
 
@@ -749,6 +753,17 @@ fail:
 	return err;
 }
 
+static int f2fs_unlink(struct inode *dir, struct dentry *dentry)
+{
+	j_op_lat_t lat;
+	int err;
+
+	j_op_lat_begin(&lat, J_OP_UNLINK);
+	err = __f2fs_unlink(dir, dentry, &lat);
+	j_op_lat_end(&lat);
+	return err;
+}
+
 static const char *f2fs_get_link(struct dentry *dentry,
 				 struct inode *inode,
 				 struct delayed_call *done)
@@ -771,12 +786,9 @@ static int f2fs_symlink(struct user_namespace *mnt_userns, struct inode *dir,
 	struct inode *inode;
 	size_t len = strlen(symname);
 	struct fscrypt_str disk_link;
+	bool journaled = false;
 	int err;
 
-    /** For log collection*/
-    delta_log_t *dlog_symlink_log = NULL;
-    delta_log_t *dlog_dir = NULL;
-
 	if (unlikely(f2fs_cp_error(sbi)))
 		return -EIO;
 	if (!f2fs_is_checkpoint_ready(sbi))
@@ -818,73 +830,6 @@ static int f2fs_symlink(struct user_namespace *mnt_userns, struct inode *dir,
 err_out:
 	d_instantiate_new(dentry, inode);
 
-#if ENABLE_F2FSJ
-    /** Add journal here, before f2fs_balance_fs()*/
-    alloc_log_entry_memory(&dlog_symlink_log);
-    if (dlog_symlink_log)
-    {
-        ///< prepare log head
-        dlog_symlink_log->delta_log_head.log_type = SYMLINK_LOG;
-        dlog_symlink_log->delta_log_head.checksum = 0;    /** TODO, crc*/
-        dlog_symlink_log->delta_log_head.log_size = sizeof(j_log_contents_t);
-
-        ///< prepare log contents
-        get_inode_log_from_f2fs_inode(sbi, F2FS_I(inode), &dlog_symlink_log->delta_log_contents.log_symlink_mi.j_new_inode);
-        dlog_symlink_log->delta_log_contents.log_symlink_mi.j_symlink_name_len = disk_link.len;
-        memcpy(dlog_symlink_log->delta_log_contents.log_symlink_mi.j_symlink_name, disk_link.name, disk_link.len);
-        j_get_nat_log_entry(sbi, inode->i_ino, &dlog_symlink_log->delta_log_contents.log_symlink_mi.nat_en_log);
-        j_get_sit_log_entry(sbi, inode->i_ino, CURSEG_WARM_NODE, &dlog_symlink_log->delta_log_contents.log_symlink_mi.sit_log);
-        j_get_ssa_log_entry(sbi, inode->i_ino, dlog_symlink_log->delta_log_contents.log_symlink_mi.nat_en_log.j_node_lba,
-                                CURSEG_WARM_NODE, &dlog_symlink_log->delta_log_contents.log_symlink_mi.ssa_en_log);
-
-        ///< insert this log into inode's local log list (MI)
-        insert_log_into_inode(F2FS_I(inode), dlog_symlink_log);
-    }
-    else
-    {
-        STATUS_LOG(STATUS_ERROR, "alloca memory for log entry failed\n");
-    }
-#endif
-
-    /** Log for new directory that will added to parent inode*/
-#if ENABLE_F2FSJ
-    alloc_log_entry_memory(&dlog_dir);
-    struct f2fs_filename fname;
-    if (dlog_dir)
-    {
-        ///< prepare log head
-        dlog_dir->delta_log_head.log_type = DIR_LOG;
-        dlog_dir->delta_log_head.checksum = 0;    /** TODO, crc*/
-        dlog_dir->delta_log_head.log_size = sizeof(j_log_contents_t);
-
-        ///< log contents
-        err = f2fs_setup_filename(dir, &dentry->d_name, 0, &fname);
-        if (err)
-        {
-            STATUS_LOG(STATUS_ERROR, "setup filename failed, lost new dir entry log\n");
-            goto original_symlink_path;
-        }
-        dlog_dir->delta_log_contents.log_dir_mi.inline_dir_or_regular = f2fs_has_inline_dentry(dir);
-        dlog_dir->delta_log_contents.log_dir_mi.hash_code = fname.hash;
-        dlog_dir->delta_log_contents.log_dir_mi.ino = inode->i_ino;
-        dlog_dir->delta_log_contents.log_dir_mi.parent_ino = dir->i_ino;
-        dlog_dir->delta_log_contents.log_dir_mi.file_type = inode->i_mode;
-        dlog_dir->delta_log_contents.log_dir_mi.name_len = fname.disk_name.len;
-        memcpy(dlog_dir->delta_log_contents.log_dir_mi.file_name, fname.disk_name.name, fname.disk_name.len);
-        ///< also would modify parent inode attr
-        dlog_dir->delta_log_contents.log_dir_mi.pino_basic_attr.c_time  = dir->i_ctime;
-        dlog_dir->delta_log_contents.log_dir_mi.pino_basic_attr.m_time  = dir->i_mtime;
-        dlog_dir->delta_log_contents.log_dir_mi.pino_basic_attr.i_size  = dir->i_size;
-
-        insert_log_into_inode(F2FS_I(dir), dlog_dir);
-    }
-    else
-    {
-        STATUS_LOG(STATUS_ERROR, "alloca memory for log entry failed\n");
-    }
-#endif
-
-original_symlink_path:
 	/*
 	 * Let's flush symlink data in order to avoid broken symlink as much as
 	 * possible. Nevertheless, fsyncing is the best way, but there is no
@@ -898,8 +843,16 @@ original_symlink_path:
 		filemap_write_and_wait_range(inode->i_mapping, 0,
 							disk_link.len - 1);
 
+#if F2FSJ_CTRL_CP && F2FSJ_DIRSYNC_COMMIT
+		journaled = j_log_symlink(dir, inode, &dentry->d_name,
+					disk_link.name, disk_link.len - 1) == F2FSJ_OK;
+#endif
 		if (IS_DIRSYNC(dir))
+#if F2FSJ_CTRL_CP
+			f2fsj_sync_dir(sbi, journaled);
+#else
 			f2fs_sync_fs(sbi->sb, 1);
+#endif
 	} else {
 		f2fs_unlink(dir, dentry);
 	}
@@ -915,8 +868,8 @@ out_free_encrypted_link:
 	return err;
 }
 
-static int f2fs_mkdir(struct user_namespace *mnt_userns, struct inode *dir,
-		      struct dentry *dentry, umode_t mode)
+static int __f2fs_mkdir(struct inode *dir, struct dentry *dentry,
+			umode_t mode, j_op_lat_t *lat)
 {
 	struct f2fs_sb_info *sbi = F2FS_I_SB(dir);
 	struct inode *inode;
@@ -958,6 +911,7 @@ static int f2fs_mkdir(struct user_namespace *mnt_userns, struct inode *dir,
 
     /************ Journal begin ************/
 #if 1
+    j_op_lat_phase_begin(lat);
     j_log_entry_t *log_create_file;
     j_alloc_log_entry(MKDIR_LOG, &log_create_file);
 
@@ -979,6 +933,7 @@ static int f2fs_mkdir(struct user_namespace *mnt_userns, struct inode *dir,
 
     // insert log into per-inode log list
     insert_log_into_inode(F2FS_I(inode), log_create_file);
+    j_op_lat_phase_end(lat, J_OP_PHASE_LOG);
 #endif
     /************ Journal end ************/
 
@@ -992,6 +947,18 @@ out_fail:
 	return err;
 }
 
+static int f2fs_mkdir(struct user_namespace *mnt_userns, struct inode *dir,
+		      struct dentry *dentry, umode_t mode)
+{
+	j_op_lat_t lat;
+	int err;
+
+	j_op_lat_begin(&lat, J_OP_MKDIR);
+	err = __f2fs_mkdir(dir, dentry, mode, &lat);
+	j_op_lat_end(&lat);
+	return err;
+}
+
 static int f2fs_rmdir(struct inode *dir, struct dentry *dentry)
 {
 	struct inode *inode = d_inode(dentry);
@@ -1204,7 +1171,7 @@ static int f2fs_create_whiteout(struct inode *dir, struct inode **whiteout)
 
 static int f2fs_rename(struct inode *old_dir, struct dentry *old_dentry,
 			struct inode *new_dir, struct dentry *new_dentry,
-			unsigned int flags)
+			unsigned int flags, j_op_lat_t *lat)
 {
 	struct f2fs_sb_info *sbi = F2FS_I_SB(old_dir);
 	struct inode *old_inode = d_inode(old_dentry);
@@ -1215,12 +1182,10 @@ static int f2fs_rename(struct inode *old_dir, struct dentry *old_dentry,
 	struct f2fs_dir_entry *old_dir_entry = NULL;
 	struct f2fs_dir_entry *old_entry;
 	struct f2fs_dir_entry *new_entry;
+	nid_t whiteout_ino = 0;
+	bool journaled = false;
 	int err;
 
-    delta_log_t *dlog_rename  = NULL;
-    delta_log_t *dlog_old_dir = NULL;
-    delta_log_t *dlog_new_dir = NULL;
-
 	if (unlikely(f2fs_cp_error(sbi)))
 		return -EIO;
 	if (!f2fs_is_checkpoint_ready(sbi))
@@ -1282,84 +1247,6 @@ static int f2fs_rename(struct inode *old_dir, struct dentry *old_dentry,
 		}
 	}
 
-    /** collect log for old directory entry and new directory entry*/
-#if ENABLE_F2FSJ
-    alloc_log_entry_memory(&dlog_old_dir);
-    struct f2fs_filename fname_old;
-    if (dlog_old_dir)
-    {
-        ///< prepare log head
-        dlog_old_dir->delta_log_head.log_type = DIR_LOG; //RENAME_LOG;
-        dlog_old_dir->delta_log_head.checksum = 0;    /** TODO, crc*/
-        dlog_old_dir->delta_log_head.log_size = sizeof(j_log_contents_t);
-
-        ///< log contents
-        err = f2fs_setup_filename(old_dir, &old_dentry->d_name, 0, &fname_old);
-        if (err)
-        {
-            STATUS_LOG(STATUS_ERROR, "setup filename failed, lost new dir entry log\n");
-            goto original_rename_path;
-        }
-        dlog_old_dir->delta_log_contents.log_dir_mi.inline_dir_or_regular = f2fs_has_inline_dentry(old_dir);
-        dlog_old_dir->delta_log_contents.log_dir_mi.hash_code = fname_old.hash;
-        dlog_old_dir->delta_log_contents.log_dir_mi.ino = old_inode->i_ino;
-        dlog_old_dir->delta_log_contents.log_dir_mi.parent_ino = old_dir->i_ino;
-        dlog_old_dir->delta_log_contents.log_dir_mi.file_type = old_inode->i_mode;
-        dlog_old_dir->delta_log_contents.log_dir_mi.name_len = fname_old.disk_name.len;
-        memcpy(dlog_old_dir->delta_log_contents.log_dir_mi.file_name, fname_old.disk_name.name, fname_old.disk_name.len);
-        ///< also would modify parent inode attr
-        dlog_old_dir->delta_log_contents.log_dir_mi.pino_basic_attr.c_time  = old_dir->i_ctime;
-        dlog_old_dir->delta_log_contents.log_dir_mi.pino_basic_attr.m_time  = old_dir->i_mtime;
-        dlog_old_dir->delta_log_contents.log_dir_mi.pino_basic_attr.i_size  = old_dir->i_size;
-
-        insert_log_into_inode(F2FS_I(old_dir), dlog_old_dir);
-    }
-    else
-    {
-        STATUS_LOG(STATUS_ERROR, "apply log memory fail\n");
-    }
-#endif
-
-#if ENABLE_F2FSJ
-    alloc_log_entry_memory(&dlog_new_dir);
-    struct f2fs_filename fname_new;
-    if (dlog_new_dir)
-    {
-        ///< prepare log head
-        dlog_new_dir->delta_log_head.log_type = DIR_LOG;//RENAME_LOG;
-        dlog_new_dir->delta_log_head.checksum = 0;    /** TODO, crc*/
-        dlog_new_dir->delta_log_head.log_size = sizeof(j_log_contents_t);
-
-        ///< log contents
-        err = f2fs_setup_filename(new_dir, &new_dentry->d_name, 0, &fname_new);
-        if (err)
-        {
-            STATUS_LOG(STATUS_ERROR, "setup filename failed, lost new dir entry log\n");
-            goto original_rename_path;
-        }
-        dlog_new_dir->delta_log_contents.log_dir_mi.inline_dir_or_regular = f2fs_has_inline_dentry(new_dir);
-        dlog_new_dir->delta_log_contents.log_dir_mi.hash_code  = fname_new.hash;
-        dlog_new_dir->delta_log_contents.log_dir_mi.ino        = old_inode->i_ino;
-        dlog_new_dir->delta_log_contents.log_dir_mi.parent_ino = new_dir->i_ino;
-        dlog_new_dir->delta_log_contents.log_dir_mi.file_type  = old_inode->i_mode;
-        dlog_new_dir->delta_log_contents.log_dir_mi.name_len   = fname_new.disk_name.len;
-        memcpy(dlog_new_dir->delta_log_contents.log_dir_mi.file_name, fname_new.disk_name.name, fname_new.disk_name.len);
-        ///< also would modify parent inode attr
-        dlog_new_dir->delta_log_contents.log_dir_mi.pino_basic_attr.c_time  = new_dir->i_ctime;
-        dlog_new_dir->delta_log_contents.log_dir_mi.pino_basic_attr.m_time  = new_dir->i_mtime;
-        dlog_new_dir->delta_log_contents.log_dir_mi.pino_basic_attr.i_size  = new_dir->i_size;
-
-        insert_log_into_inode(F2FS_I(new_dir), dlog_new_dir);
-    }
-    else
-    {
-
-        STATUS_LOG(STATUS_ERROR, "apply log memory fail\n");
-    }
-#endif
-
-
-original_rename_path:
 	if (new_inode) {
 
 		err = -ENOTEMPTY;
@@ -1436,6 +1323,7 @@ original_rename_path:
 		whiteout->i_state &= ~I_LINKABLE;
 		spin_unlock(&whiteout->i_lock);
 
+		whiteout_ino = whiteout->i_ino;
 		iput(whiteout);
 	}
 
@@ -1454,30 +1342,26 @@ original_rename_path:
 							TRANS_DIR_INO);
 	}
 
-    /** collect inode log*/
-    // alloc_log_entry_memory(&dlog_rename);
-    // if (dlog_rename)
-    // {
-    //     ///< prepare log head
-    //     dlog_rename->delta_log_head.log_type = RENAME_LOG;
-    //     dlog_rename->delta_log_head.checksum = 0;    /** TODO, crc*/
-    //     dlog_rename->delta_log_head.log_size = sizeof(j_log_contents_t);
-
-    //     ///< prepare log contents
-    //     get_inode_log_from_f2fs_inode(sbi, F2FS_I(old_inode), &dlog_rename->delta_log_contents.log_rename_mi.j_inode);
-
-    //     ///< insert this log into inode's local log list (MI)
-    //     insert_log_into_inode(F2FS_I(old_inode), dlog_rename);
-    // }
-    // else
-    // {
-    //     STATUS_LOG(STATUS_ERROR, "apply log memory fail, pls check\n");
-    // }
+#if F2FSJ_CTRL_CP && F2FSJ_DIRSYNC_COMMIT
+	j_op_lat_phase_begin(lat);
+	journaled = j_log_rename(old_dir, &old_dentry->d_name,
+				new_dir, &new_dentry->d_name, old_inode, new_inode,
+				whiteout_ino,
+				whiteout ? J_RENAME_WHITEOUT : 0) == F2FSJ_OK;
+	j_op_lat_phase_end(lat, J_OP_PHASE_LOG);
+#endif
 
 	f2fs_unlock_op(sbi);
 
-	if (IS_DIRSYNC(old_dir) || IS_DIRSYNC(new_dir))
+	if (IS_DIRSYNC(old_dir) || IS_DIRSYNC(new_dir)) {
+#if F2FSJ_CTRL_CP
+		j_op_lat_phase_begin(lat);
+		f2fsj_sync_dir(sbi, journaled);
+		j_op_lat_phase_end(lat, J_OP_PHASE_COMMIT);
+#else
 		f2fs_sync_fs(sbi->sb, 1);
+#endif
+	}
 
 	f2fs_update_time(sbi, REQ_TIME);
 	return 0;
@@ -1497,7 +1381,8 @@ out:
 }
 
 static int f2fs_cross_rename(struct inode *old_dir, struct dentry *old_dentry,
-			     struct inode *new_dir, struct dentry *new_dentry)
+			     struct inode *new_dir, struct dentry *new_dentry,
+			     j_op_lat_t *lat)
 {
 	struct f2fs_sb_info *sbi = F2FS_I_SB(old_dir);
 	struct inode *old_inode = d_inode(old_dentry);
@@ -1507,6 +1392,7 @@ static int f2fs_cross_rename(struct inode *old_dir, struct dentry *old_dentry,
 	struct f2fs_dir_entry *old_dir_entry = NULL, *new_dir_entry = NULL;
 	struct f2fs_dir_entry *old_entry, *new_entry;
 	int old_nlink = 0, new_nlink = 0;
+	bool journaled = false;
 	int err;
 
 	if (unlikely(f2fs_cp_error(sbi)))
@@ -1638,10 +1524,25 @@ static int f2fs_cross_rename(struct inode *old_dir, struct dentry *old_dentry,
 		f2fs_add_ino_entry(sbi, new_dir->i_ino, TRANS_DIR_INO);
 	}
 
+#if F2FSJ_CTRL_CP && F2FSJ_DIRSYNC_COMMIT
+	j_op_lat_phase_begin(lat);
+	journaled = j_log_rename(old_dir, &old_dentry->d_name,
+				new_dir, &new_dentry->d_name, old_inode, new_inode,
+				0, J_RENAME_EXCHANGE) == F2FSJ_OK;
+	j_op_lat_phase_end(lat, J_OP_PHASE_LOG);
+#endif
+
 	f2fs_unlock_op(sbi);
 
-	if (IS_DIRSYNC(old_dir) || IS_DIRSYNC(new_dir))
+	if (IS_DIRSYNC(old_dir) || IS_DIRSYNC(new_dir)) {
+#if F2FSJ_CTRL_CP
+		j_op_lat_phase_begin(lat);
+		f2fsj_sync_dir(sbi, journaled);
+		j_op_lat_phase_end(lat, J_OP_PHASE_COMMIT);
+#else
 		f2fs_sync_fs(sbi->sb, 1);
+#endif
+	}
 
 	f2fs_update_time(sbi, REQ_TIME);
 	return 0;
@@ -1666,6 +1567,7 @@ static int f2fs_rename2(struct user_namespace *mnt_userns,
 			struct inode *new_dir, struct dentry *new_dentry,
 			unsigned int flags)
 {
+	j_op_lat_t lat;
 	int err;
 
 	if (flags & ~(RENAME_NOREPLACE | RENAME_EXCHANGE | RENAME_WHITEOUT))
@@ -1676,15 +1578,20 @@ static int f2fs_rename2(struct user_namespace *mnt_userns,
 	if (err)
 		return err;
 
+	j_op_lat_begin(&lat, J_OP_RENAME);
 	if (flags & RENAME_EXCHANGE) {
-		return f2fs_cross_rename(old_dir, old_dentry,
-					 new_dir, new_dentry);
+		err = f2fs_cross_rename(old_dir, old_dentry,
+					new_dir, new_dentry, &lat);
+	} else {
+		/*
+		 * VFS has already handled the new dentry existence case,
+		 * here, we just deal with "RENAME_NOREPLACE" as regular rename.
+		 */
+		err = f2fs_rename(old_dir, old_dentry, new_dir, new_dentry,
+				  flags, &lat);
 	}
-	/*
-	 * VFS has already handled the new dentry existence case,
-	 * here, we just deal with "RENAME_NOREPLACE" as regular rename.
-	 */
-	return f2fs_rename(old_dir, old_dentry, new_dir, new_dentry, flags);
+	j_op_lat_end(&lat);
+	return err;
 }
 
 static const char *f2fs_encrypted_get_link(struct dentry *dentry,
@@ -1737,6 +1644,9 @@ const struct inode_operations f2fs_dir_inode_operations = {
 	.tmpfile	= f2fs_tmpfile,
 	.getattr	= f2fs_getattr,
 	.setattr	= f2fs_setattr,
+#if F2FSJ_CTRL_CP
+	.update_time	= f2fsj_update_time,
+#endif
 	.get_acl	= f2fs_get_acl,
 	.set_acl	= f2fs_set_acl,
 	.listxattr	= f2fs_listxattr,
@@ -1749,12 +1659,18 @@ const struct inode_operations f2fs_symlink_inode_operations = {
 	.get_link	= f2fs_get_link,
 	.getattr	= f2fs_getattr,
 	.setattr	= f2fs_setattr,
+#if F2FSJ_CTRL_CP
+	.update_time	= f2fsj_update_time,
+#endif
 	.listxattr	= f2fs_listxattr,
 };
 
 const struct inode_operations f2fs_special_inode_operations = {
 	.getattr	= f2fs_getattr,
 	.setattr	= f2fs_setattr,
+#if F2FSJ_CTRL_CP
+	.update_time	= f2fsj_update_time,
+#endif
 	.get_acl	= f2fs_get_acl,
 	.set_acl	= f2fs_set_acl,
 	.listxattr	= f2fs_listxattr,
@@ -19,6 +19,7 @@
 #include "xattr.h"
 #include "iostat.h"
 #include <trace/events/f2fs.h>
+#include "j_log_operate.h"
 
 #define on_f2fs_build_free_nids(nmi) mutex_is_locked(&(nm_i)->build_lock)
 
@@ -496,6 +497,9 @@ static void set_node_addr(struct f2fs_sb_info *sbi, struct node_info *ni,
 	if (!__is_valid_data_blkaddr(new_blkaddr))
 		set_nat_flag(e, IS_CHECKPOINTED, false);
 	__set_nat_cache_dirty(nm_i, e);
+#if F2FSJ_CTRL_CP
+	j_record_nat_delta(ni->nid, ni->ino, new_blkaddr, nat_get_version(e));
+#endif
 
 	/* update fsync_mark if its inode nat entry is still alive */
 	if (ni->nid != ni->ino)
@@ -508,6 +512,45 @@ static void set_node_addr(struct f2fs_sb_info *sbi, struct node_info *ni,
 	up_write(&nm_i->nat_tree_lock);
 }
 
+#if F2FSJ_CTRL_CP
+/*
+ * roll a NAT entry forward by a journaled delta at mount, it is written
+ * by the next checkpoint like other dirty NAT entries.
+ */
+int f2fsj_replay_nat_delta(struct f2fs_sb_info *sbi, nid_t nid, nid_t ino,
+				block_t blkaddr, unsigned char version)
+{
+	struct f2fs_nm_info *nm_i = NM_I(sbi);
+	struct node_info ni;
+	struct nat_entry *e;
+	int err;
+
+	/* load the checkpointed entry into nat cache */
+	err = f2fs_get_node_info(sbi, nid, &ni);
+	if (err)
+		return err;
+
+	down_write(&nm_i->nat_tree_lock);
+	e = __lookup_nat_cache(nm_i, nid);
+	if (!e) {
+		up_write(&nm_i->nat_tree_lock);
+		return -ENOENT;
+	}
+	if (nat_get_blkaddr(e) != blkaddr || nat_get_version(e) != version) {
+		e->ni.ino = ino;
+		nat_set_blkaddr(e, blkaddr);
+		nat_set_version(e, version);
+		if (!__is_valid_data_blkaddr(blkaddr))
+			set_nat_flag(e, IS_CHECKPOINTED, false);
+		__set_nat_cache_dirty(nm_i, e);
+		/* logged again, journal is reused from its start after mount */
+		j_record_nat_delta(nid, ino, blkaddr, version);
+	}
+	up_write(&nm_i->nat_tree_lock);
+	return 0;
+}
+#endif
+
 int f2fs_try_to_free_nats(struct f2fs_sb_info *sbi, int nr_shrink)
 {
 	struct f2fs_nm_info *nm_i = NM_I(sbi);
@@ -1596,6 +1639,12 @@ static int __write_node_page(struct page *page, bool atomic, bool *submitted,
 			IS_DNODE(page) && is_cold_node(page))
 		goto redirty_out;
 
+#if F2FSJ_CTRL_CP
+	/* journal covers it, write it once at journal apply */
+	if (f2fsj_absorb_page_write(sbi, page, wbc, io_type))
+		goto redirty_out;
+#endif
+
 	/* get old block addr of this node page */
 	nid = nid_of_node(page);
 	f2fs_bug_on(sbi, page->index != nid);
@@ -1638,6 +1687,9 @@ static int __write_node_page(struct page *page, bool atomic, bool *submitted,
 
 	set_page_writeback(page);
 	ClearPageError(page);
+#if F2FSJ_CTRL_CP
+	clear_page_journal_dirty(sbi, page);
+#endif
 
 	fio.old_blkaddr = ni.blk_addr;
 	f2fs_do_write_node_page(nid, &fio);
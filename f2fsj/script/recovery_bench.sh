@@ -0,0 +1,309 @@
+#!/bin/bash
+# Crash recovery time of f2fsj, as a function of journal fill and crash point.
+#
+# flakey mode (default): the fs runs on a dm-flakey target. For every crash point and fill
+# target the journal is filled by ../../filebench/mdbench, files with known contents are
+# fsynced, the journal is held at the crash point (sysfs j_crash_point) and the target is
+# switched to drop_writes, which cuts power for everything after that point. The module is
+# reloaded, mount is timed and j_stats tells read and replay time of the journal.
+#
+# log-writes mode (-L logdev): one run is recorded by dm-log-writes with a mark at every fill
+# target, then replay-log (xfstests src/log-writes) rebuilds the device at each mark.
+#
+# After mount, fsynced files are checked against their contents and fsck.f2fs checks
+# the checkpoint. Results: <out>/recovery.csv
+
+script_path=$(cd $(dirname $0) && pwd)
+mdbench_path=$script_path/../../filebench/mdbench
+
+dev_path=""
+log_dev=""
+mount_path=/mnt/f2fsj_crash
+fill_list="5 25 50 75"
+point_list="none commit_data commit_journal checkpoint"
+nr_verify=200
+out_path=$script_path/../recovery_results/$(date +%Y%m%d-%H%M%S)
+
+flakey_name=f2fsj_crash
+lw_name=f2fsj_lw
+dm_dev=""
+sysfs_path=""
+proc_path=""
+
+# crash point name -> sysfs j_crash_point, see j_crash_point_e
+declare -A point_idx=(
+    [none]=0
+    [commit_data]=1
+    [commit_journal]=2
+    [checkpoint]=3
+)
+
+function help_cmd(){
+    echo "---------------------------------------------"
+    echo "./recovery_bench.sh -D /dev/xxx [options]"
+    echo "  -D /dev/xxx              device, its contents are lost"
+    echo "  -L /dev/yyy              dm-log-writes mode, log device for the recording"
+    echo "  -j \"5 25 50 75\"          journal fill targets in percent"
+    echo "  -c \"none commit_data commit_journal checkpoint\""
+    echo "                           crash points, flakey mode only"
+    echo "  -n 200                   fsynced files checked after recovery"
+    echo "  -o dir                   output dir"
+    echo "---------------------------------------------"
+}
+
+function info(){
+    echo -e "\e[32m $* \e[0m"
+}
+
+function fail(){
+    echo -e "\e[31m $* \e[0m"
+}
+
+function load_flakey(){
+    local mode=$1
+    local size=$(sudo blockdev --getsz $dev_path)
+    local table="0 $size flakey $dev_path 0 180 0"
+
+    if [ $mode == "drop" ]; then
+        table="0 $size flakey $dev_path 0 0 180 1 drop_writes"
+    fi
+
+    if [ -z "$dm_dev" ]; then
+        sudo dmsetup create $flakey_name --table "$table" || return 1
+        dm_dev=/dev/mapper/$flakey_name
+        return 0
+    fi
+    # no fs freeze, the journal may be held at a crash point
+    sudo dmsetup suspend --nolockfs $flakey_name
+    sudo dmsetup load $flakey_name --table "$table"
+    sudo dmsetup resume $flakey_name
+}
+
+function remove_dm(){
+    local name=$1
+
+    sudo dmsetup remove $name 2>/dev/null
+    dm_dev=""
+}
+
+function mount_f2fsj(){
+    local dev=$1
+
+    sudo modprobe f2fsj || return 1
+    sudo mount -t f2fsj $dev $mount_path || return 1
+    sysfs_path=/sys/fs/f2fsj/$(basename $(readlink -f $dev))
+    proc_path=/proc/fs/f2fsj/$(basename $(readlink -f $dev))
+}
+
+function umount_f2fsj(){
+    sudo umount $mount_path
+    # journal state is kept by the module, a reload is what a reboot gives
+    sudo rmmod f2fsj
+}
+
+function sysfs_set(){
+    echo $2 | sudo tee $sysfs_path/$1 > /dev/null
+}
+
+function journal_fill(){
+    cat $sysfs_path/j_journal_fill
+}
+
+# create and unlink files until the journal is fill% in use
+function fill_journal(){
+    local fill=$1
+
+    mkdir -p $mount_path/fill
+    while [ $(journal_fill) -lt $fill ]; do
+        $mdbench_path/mdbench -d $mount_path/fill -t 4 -n 5000 -o create,unlink > /dev/null || return 1
+    done
+}
+
+# write nr_verify files with contents made of their names, the ones fsynced go to the manifest
+function write_verified(){
+    local manifest=$1
+    local tag=$2
+    local i=0
+    local f=""
+
+    mkdir -p $mount_path/verify
+    for i in $(seq 1 $nr_verify); do
+        f=$mount_path/verify/$tag.$i
+        yes $tag.$i | head -c 8192 > $f
+        sync $f && echo $tag.$i >> $manifest
+    done
+}
+
+# -> "verified,missing,corrupt"
+function check_verified(){
+    local manifest=$1
+    local ok=0
+    local missing=0
+    local corrupt=0
+    local name=""
+
+    while read name; do
+        if [ ! -f $mount_path/verify/$name ]; then
+            missing=$((missing + 1))
+        elif cmp -s $mount_path/verify/$name <(yes $name | head -c 8192); then
+            ok=$((ok + 1))
+        else
+            corrupt=$((corrupt + 1))
+        fi
+    done < $manifest
+    echo "$ok,$missing,$corrupt"
+}
+
+# -> "mount_ms,read_us,replay_us,logs,verified,missing,corrupt,fsck"
+function measure_recovery(){
+    local dev=$1
+    local manifest=$2
+    local start=0
+    local mount_ms=0
+    local rec=""
+    local verified=""
+    local fsck="ok"
+
+    start=$(date +%s%N)
+    if ! mount_f2fsj $dev; then
+        echo "-1,0,0,0,0,0,0,mount_fail"
+        return 1
+    fi
+    mount_ms=$((($(date +%s%N) - start) / 1000000))
+
+    # "  - recovery: read N us, replay N us, N logs"
+    rec=$(sudo cat $proc_path/j_stats | awk '/- recovery:/ { print $4 "," $7 "," $9 }')
+    verified=$(check_verified $manifest)
+    umount_f2fsj
+
+    sudo fsck.f2fs --dry-run $dev > ${manifest%.manifest}.fsck 2>&1 || fsck="fail"
+    echo "$mount_ms,$rec,$verified,$fsck"
+}
+
+function run_flakey(){
+    local point=$1
+    local fill=$2
+    local tag=${point}_$fill
+    local manifest=$out_path/$tag.manifest
+    local crash_fill=0
+    local unapplied=0
+    local hit=0
+    local i=0
+
+    info "$(date +%T) crash at $point, journal fill $fill%"
+    load_flakey allow || return 1
+    sudo mkfs.f2fs -f $dm_dev > /dev/null || return 1
+    mount_f2fsj $dm_dev || return 1
+    # let the journal grow, checkpoint comes with a full journal only
+    sysfs_set j_max_recovery_ms 3600000
+
+    : > $manifest
+    fill_journal $fill || return 1
+    write_verified $manifest $tag
+    crash_fill=$(journal_fill)
+    unapplied=$(sudo cat $proc_path/j_stats | awk '/unapplied logs:/ { print $NF }')
+
+    if [ $point != "none" ]; then
+        sysfs_set j_crash_point ${point_idx[$point]}
+        # fsync commits an epoch, a tiny recovery objective makes the checkpoint thread apply it
+        if [ $point == "checkpoint" ]; then
+            sysfs_set j_max_recovery_ms 1
+        fi
+        touch $mount_path/verify/trigger
+        sync $mount_path/verify/trigger &
+        for i in $(seq 1 100); do
+            hit=$(cat $sysfs_path/j_crash_hit)
+            [ "$hit" == "${point_idx[$point]}" ] && break
+            sleep 0.1
+        done
+        if [ "$hit" != "${point_idx[$point]}" ]; then
+            fail "crash point $point not reached"
+        fi
+    fi
+
+    # power cut: nothing written from now on reaches the device
+    load_flakey drop
+    sysfs_set j_crash_point 0
+    wait
+    umount_f2fsj
+    load_flakey allow
+
+    echo "flakey,$point,$fill,$crash_fill,$unapplied,$(measure_recovery $dm_dev $manifest)" >> $out_path/recovery.csv
+    remove_dm $flakey_name
+}
+
+function run_log_writes(){
+    local size=$(sudo blockdev --getsz $dev_path)
+    local fill=0
+    local manifest=$out_path/lw.manifest
+    local crash_fill=0
+
+    info "$(date +%T) record with dm-log-writes, marks at $fill_list"
+    sudo dmsetup create $lw_name --table "0 $size log-writes $dev_path $log_dev" || return 1
+    dm_dev=/dev/mapper/$lw_name
+    sudo mkfs.f2fs -f $dm_dev > /dev/null || return 1
+    mount_f2fsj $dm_dev || return 1
+    sysfs_set j_max_recovery_ms 3600000
+
+    : > $manifest
+    for fill in $fill_list; do
+        fill_journal $fill || return 1
+        write_verified $manifest lw_$fill
+        # a mark only covers what is on the device, the manifest is what was fsynced before it
+        sudo dmsetup message $lw_name 0 mark fill_$fill
+        cp $manifest $out_path/lw_$fill.manifest
+        echo $(journal_fill) > $out_path/lw_$fill.fill
+    done
+    sudo umount $mount_path
+    sudo rmmod f2fsj
+    remove_dm $lw_name
+
+    for fill in $fill_list; do
+        info "$(date +%T) replay to mark fill_$fill"
+        sudo replay-log --log $log_dev --replay $dev_path --end-mark fill_$fill || return 1
+        crash_fill=$(cat $out_path/lw_$fill.fill)
+        echo "log_writes,mark,$fill,$crash_fill,-,$(measure_recovery $dev_path $out_path/lw_$fill.manifest)" >> $out_path/recovery.csv
+    done
+}
+
+while getopts "D:L:j:c:n:o:h" opt; do
+    case $opt in
+        D) dev_path=$OPTARG ;;
+        L) log_dev=$OPTARG ;;
+        j) fill_list=$OPTARG ;;
+        c) point_list=$OPTARG ;;
+        n) nr_verify=$OPTARG ;;
+        o) out_path=$OPTARG ;;
+        h) help_cmd; exit 0 ;;
+        *) help_cmd; exit 1 ;;
+    esac
+done
+
+if [ ! -b "$dev_path" ]; then
+    help_cmd
+    exit 1
+fi
+for p in $point_list; do
+    if [ -z "${point_idx[$p]}" ]; then
+        fail "invalid crash point $p, plz check"
+        exit 1
+    fi
+done
+
+make -C $mdbench_path > /dev/null || exit 1
+mkdir -p $out_path
+sudo mkdir -p $mount_path
+echo "mode,point,fill_target,fill_at_crash,unapplied_logs,mount_ms,read_us,replay_us,replayed_logs,verified,missing,corrupt,fsck" > $out_path/recovery.csv
+
+if [ -n "$log_dev" ]; then
+    run_log_writes || fail "log-writes run fail"
+else
+    for point in $point_list; do
+        for fill in $fill_list; do
+            run_flakey $point $fill || { fail "crash at $point, fill $fill fail"; umount_f2fsj; remove_dm $flakey_name; }
+        done
+    done
+fi
+
+column -s, -t $out_path/recovery.csv
+info "recovery test Over, results in $out_path"
@@ -0,0 +1,143 @@
+#!/bin/bash
+# Journal stress test and microbenchmark of f2fsj, see j_stress.h.
+#
+# f2fsj is made on a loop device (or -D device), files "0".."N-1" are created in a stress dir,
+# then for every thread count sysfs j_stress runs kthreads pinned to CPUs which allocate, insert,
+# commit and checkpoint journal logs directly. Every run checks that no record is lost or
+# duplicated. Results: <out>/stress.csv and /proc/fs/f2fsj/<dev>/j_stress of every run.
+
+dev_path=""
+loop_file=""
+loop_size=4G
+mount_path=/mnt/f2fsj_stress
+thread_list="1 2 4 8 16"
+nr_ops=100000
+nr_files=64
+commit_ops=1000
+out_path=$(cd $(dirname $0) && pwd)/../stress_results/$(date +%Y%m%d-%H%M%S)
+
+loop_dev=""
+sysfs_path=""
+proc_path=""
+
+function help_cmd(){
+    echo "---------------------------------------------"
+    echo "./stress_bench.sh [options]"
+    echo "  -D /dev/xxx              device, its contents are lost, default is a loop device"
+    echo "  -l 4G                    size of the loop device file"
+    echo "  -t \"1 2 4 8 16\"          thread counts"
+    echo "  -n 100000                logs per thread"
+    echo "  -f 64                    files shared by the threads"
+    echo "  -c 1000                  logs of a thread between commits, 0: commit thread only"
+    echo "  -o dir                   output dir"
+    echo "---------------------------------------------"
+}
+
+function info(){
+    echo -e "\e[32m $* \e[0m"
+}
+
+function fail(){
+    echo -e "\e[31m $* \e[0m"
+}
+
+function setup_dev(){
+    if [ -n "$dev_path" ]; then
+        return 0
+    fi
+
+    loop_file=$out_path/stress.img
+    truncate -s $loop_size $loop_file || return 1
+    loop_dev=$(sudo losetup -f --show $loop_file) || return 1
+    dev_path=$loop_dev
+}
+
+function cleanup(){
+    mountpoint -q $mount_path && sudo umount $mount_path
+    if [ -n "$loop_dev" ]; then
+        sudo losetup -d $loop_dev
+        rm -f $loop_file
+    fi
+}
+
+function sysfs_set(){
+    echo $2 | sudo tee $sysfs_path/$1 > /dev/null
+}
+
+# "  - name: N calls, avg N cycles, max N cycles" -> "avg,max"
+function call_cycles(){
+    awk -v name="- $1:" 'index($0, name) { print $6 "," $9 }' $2
+}
+
+# "  - lock: contended N, held N, avg N ns, max N ns" -> "contended,avg,max"
+function lock_hold(){
+    awk -v name="- $1:" 'index($0, name) { sub(",", "", $4); print $4 "," $8 "," $11 }' $2
+}
+
+while getopts "D:l:t:n:f:c:o:h" opt; do
+    case $opt in
+        D) dev_path=$OPTARG ;;
+        l) loop_size=$OPTARG ;;
+        t) thread_list=$OPTARG ;;
+        n) nr_ops=$OPTARG ;;
+        f) nr_files=$OPTARG ;;
+        c) commit_ops=$OPTARG ;;
+        o) out_path=$OPTARG ;;
+        h) help_cmd; exit 0 ;;
+        *) help_cmd; exit 1 ;;
+    esac
+done
+
+if [ -n "$dev_path" ] && [ ! -b "$dev_path" ]; then
+    help_cmd
+    exit 1
+fi
+
+mkdir -p $out_path
+sudo mkdir -p $mount_path
+trap cleanup EXIT
+
+setup_dev || { fail "loop device setup fail"; exit 1; }
+sudo mkfs.f2fs -f $dev_path > /dev/null || exit 1
+sudo modprobe f2fsj || exit 1
+sudo mount -t f2fsj $dev_path $mount_path || exit 1
+sysfs_path=/sys/fs/f2fsj/$(basename $(readlink -f $dev_path))
+proc_path=/proc/fs/f2fsj/$(basename $(readlink -f $dev_path))
+
+sudo mkdir -p $mount_path/stress
+for i in $(seq 0 $((nr_files - 1))); do
+    sudo touch $mount_path/stress/$i
+done
+sync
+
+sysfs_set j_stress_dir_ino $(stat -c %i $mount_path/stress)
+sysfs_set j_stress_files $nr_files
+sysfs_set j_stress_ops $nr_ops
+sysfs_set j_stress_commit_ops $commit_ops
+
+echo "threads,logs,elapsed_us,logs_s,alloc_avg,alloc_max,insert_avg,insert_max,commit_avg,commit_max,cp_avg,cp_max,ep_lock_cont,ep_hold_avg_ns,ep_hold_max_ns,jf_lock_cont,jf_hold_avg_ns,jf_hold_max_ns,insert_err,lost,dup,result" > $out_path/stress.csv
+
+for threads in $thread_list; do
+    info "$(date +%T) $threads threads, $nr_ops logs each"
+    if ! sysfs_set j_stress $threads; then
+        fail "stress run with $threads threads fail, see dmesg"
+        continue
+    fi
+
+    res=$out_path/j_stress_$threads.txt
+    sudo cat $proc_path/j_stress > $res
+    sudo cat $proc_path/j_stats > $out_path/j_stats_$threads.txt
+
+    logs=$((threads * nr_ops))
+    elapsed=$(awk '/- elapsed:/ { print $3 }' $res)
+    rate=$(awk '/- elapsed:/ { print $5 }' $res)
+    errors=$(awk '/- errors:/ { sub(",", "", $6); print $6 }' $res)
+    records=$(awk '/- records:/ { gsub(",", ""); print $8 "," $10 }' $res)
+    result=$(awk '/- result:/ { print $3 }' $res)
+
+    echo "$threads,$logs,$elapsed,$rate,$(call_cycles alloc $res),$(call_cycles insert $res),$(call_cycles commit $res),$(call_cycles checkpoint $res),$(lock_hold epoch_switch_spin_lock $res),$(lock_hold j_file_memap_lock $res),$errors,$records,$result" >> $out_path/stress.csv
+    [ "$result" == "PASS" ] || fail "$threads threads: records lost or duplicated, see $res"
+done
+
+column -s, -t $out_path/stress.csv
+info "stress test Over, results in $out_path"
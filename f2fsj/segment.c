@@ -22,6 +22,7 @@
 #include "gc.h"
 #include "iostat.h"
 #include <trace/events/f2fs.h>
+#include "j_log_operate.h"
 
 #define __reverse_ffz(x) __reverse_ffs(~(x))
 
@@ -2353,6 +2354,10 @@ static void update_sit_entry(struct f2fs_sb_info *sbi, block_t blkaddr, int del)
 		se->ckpt_valid_blocks += del;
 
 	__mark_sit_entry_dirty(sbi, segno);
+#if F2FSJ_CTRL_CP
+	if (del)
+		j_record_sit_delta(segno, offset, del, se->valid_blocks);
+#endif
 
 	/* update total number of valid blocks to be written in ckpt area */
 	SIT_I(sbi)->written_valid_blocks += del;
@@ -2361,6 +2366,131 @@ static void update_sit_entry(struct f2fs_sb_info *sbi, block_t blkaddr, int del)
 		get_sec_entry(sbi, segno)->valid_blocks += del;
 }
 
+#if F2FSJ_CTRL_CP
+/*
+ * roll valid map of a segment forward by a journaled delta at mount,
+ * a bit already in the checkpointed map is skipped.
+ */
+void f2fsj_replay_sit_delta(struct f2fs_sb_info *sbi, unsigned int segno,
+				unsigned int blkofs, int del)
+{
+	struct sit_info *sit_i = SIT_I(sbi);
+	struct seg_entry *se;
+
+	if (segno >= MAIN_SEGS(sbi) || blkofs >= sbi->blocks_per_seg)
+		return;
+
+	down_write(&sit_i->sentry_lock);
+	se = get_seg_entry(sbi, segno);
+	if (f2fs_test_bit(blkofs, se->cur_valid_map) != (del > 0)) {
+		if (del > 0)
+			__set_test_and_inuse(sbi, segno);
+		update_sit_entry(sbi, START_BLOCK(sbi, segno) + blkofs, del);
+		locate_dirty_segment(sbi, segno);
+	}
+	up_write(&sit_i->sentry_lock);
+}
+
+void f2fsj_replay_ssa_delta(struct f2fs_sb_info *sbi, unsigned int segno,
+				unsigned int blkofs, nid_t nid,
+				unsigned int ofs_in_node, unsigned char version)
+{
+	struct f2fs_summary_block *sum_blk;
+	struct f2fs_summary sum;
+	struct page *page;
+	int i;
+
+	if (segno >= MAIN_SEGS(sbi) || blkofs >= ENTRIES_IN_SUM)
+		return;
+
+	set_summary(&sum, nid, ofs_in_node, version);
+
+	/* summary of current segment is only in memory */
+	for (i = CURSEG_HOT_DATA; i < NR_PERSISTENT_LOG; i++) {
+		struct curseg_info *curseg = CURSEG_I(sbi, i);
+
+		mutex_lock(&curseg->curseg_mutex);
+		if (curseg->segno == segno) {
+			curseg->sum_blk->entries[blkofs] = sum;
+			mutex_unlock(&curseg->curseg_mutex);
+			return;
+		}
+		mutex_unlock(&curseg->curseg_mutex);
+	}
+
+	page = f2fs_get_sum_page(sbi, segno);
+	if (IS_ERR(page))
+		return;
+	sum_blk = (struct f2fs_summary_block *)page_address(page);
+	sum_blk->entries[blkofs] = sum;
+	set_page_dirty(page);
+	f2fs_put_page(page, 1);
+}
+#endif
+
+#if F2FSJ_CTRL_CP && F2FSJ_GC_COMMIT_REUSE
+/*
+ * foreground GC moved a data block, the move is journaled so the block is
+ * not needed by recovery once the epoch of it is committed.
+ */
+void f2fsj_gc_moved_block(struct f2fs_sb_info *sbi, nid_t nid,
+			unsigned int ofs_in_node, block_t old_blkaddr,
+			block_t new_blkaddr)
+{
+	struct sit_info *sit_i = SIT_I(sbi);
+
+	if (!__is_valid_data_blkaddr(old_blkaddr))
+		return;
+
+	j_record_gc_move(nid, ofs_in_node, old_blkaddr, new_blkaddr);
+
+	down_write(&sit_i->sentry_lock);
+	sit_i->j_gc_moved[GET_SEGNO(sbi, old_blkaddr)]++;
+	up_write(&sit_i->sentry_lock);
+}
+
+/*
+ * free prefree segments without checkpoint. Only a segment whose blocks of
+ * checkpoint (and blocks written since then) are all moved by journaled GC
+ * can be reused, a block invalidated by other writes is still needed by
+ * checkpointed node pages. Caller commits the GC moves before.
+ */
+unsigned int f2fsj_reclaim_gc_segments(struct f2fs_sb_info *sbi)
+{
+	struct sit_info *sit_i = SIT_I(sbi);
+	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
+	unsigned long *prefree_map = dirty_i->dirty_segmap[PRE];
+	unsigned int segno, nr_freed = 0;
+
+	/* moves after a dropped delta are not replayed */
+	if (!j_meta_deltas_replayable())
+		return 0;
+
+	down_write(&sit_i->sentry_lock);
+	mutex_lock(&dirty_i->seglist_lock);
+	for_each_set_bit(segno, prefree_map, MAIN_SEGS(sbi)) {
+		struct seg_entry *se = get_seg_entry(sbi, segno);
+
+		if (!se->ckpt_valid_blocks ||
+			sit_i->j_gc_moved[segno] != se->ckpt_valid_blocks)
+			continue;
+
+		memset(se->ckpt_valid_map, 0, SIT_VBLOCK_MAP_SIZE);
+		se->ckpt_valid_blocks = 0;
+		sit_i->j_gc_moved[segno] = 0;
+
+		clear_bit(segno, prefree_map);
+		dirty_i->nr_dirty[PRE]--;
+		__set_test_and_free(sbi, segno, false);
+		nr_freed++;
+	}
+	mutex_unlock(&dirty_i->seglist_lock);
+	up_write(&sit_i->sentry_lock);
+
+	return nr_freed;
+}
+#endif
+
 void f2fs_invalidate_blocks(struct f2fs_sb_info *sbi, block_t addr)
 {
 	unsigned int segno = GET_SEGNO(sbi, addr);
@@ -2420,6 +2550,9 @@ static void __add_sum_entry(struct f2fs_sb_info *sbi, int type,
 
 	addr += curseg->next_blkoff * sizeof(struct f2fs_summary);
 	memcpy(addr, sum, sizeof(struct f2fs_summary));
+#if F2FSJ_CTRL_CP
+	j_record_ssa_delta(curseg->segno, curseg->next_blkoff, sum);
+#endif
 }
 
 /*
@@ -3566,6 +3699,7 @@ void f2fs_do_write_meta_page(struct f2fs_sb_info *sbi, struct page *page,
 
 	stat_inc_meta_count(sbi, page->index);
 	f2fs_update_iostat(sbi, io_type, F2FS_BLKSIZE);
+	f2fsj_account_iostat(sbi, io_type, F2FS_BLKSIZE);
 }
 
 void f2fs_do_write_node_page(unsigned int nid, struct f2fs_io_info *fio)
@@ -3576,6 +3710,7 @@ void f2fs_do_write_node_page(unsigned int nid, struct f2fs_io_info *fio)
 	do_write_page(&sum, fio);
 
 	f2fs_update_iostat(fio->sbi, fio->io_type, F2FS_BLKSIZE);
+	f2fsj_account_iostat(fio->sbi, fio->io_type, F2FS_BLKSIZE);
 }
 
 void f2fs_outplace_write_data(struct dnode_of_data *dn,
@@ -3588,8 +3723,14 @@ void f2fs_outplace_write_data(struct dnode_of_data *dn,
 	set_summary(&sum, dn->nid, dn->ofs_in_node, fio->version);
 	do_write_page(&sum, fio);
 	f2fs_update_data_blkaddr(dn, fio->new_blkaddr);
+#if F2FSJ_CTRL_CP && F2FSJ_GC_COMMIT_REUSE
+	if (fio->io_type == FS_GC_DATA_IO)
+		f2fsj_gc_moved_block(sbi, dn->nid, dn->ofs_in_node,
+					fio->old_blkaddr, fio->new_blkaddr);
+#endif
 
 	f2fs_update_iostat(sbi, fio->io_type, F2FS_BLKSIZE);
+	f2fsj_account_iostat(sbi, fio->io_type, F2FS_BLKSIZE);
 }
 
 int f2fs_inplace_write_data(struct f2fs_io_info *fio)
@@ -3626,6 +3767,7 @@ int f2fs_inplace_write_data(struct f2fs_io_info *fio)
 	if (!err) {
 		update_device_state(fio);
 		f2fs_update_iostat(fio->sbi, fio->io_type, F2FS_BLKSIZE);
+		f2fsj_account_iostat(fio->sbi, fio->io_type, F2FS_BLKSIZE);
 	}
 
 	return err;
@@ -4320,6 +4462,10 @@ out:
 
 		cpc->trim_start = trim_start;
 	}
+#if F2FSJ_CTRL_CP && F2FSJ_GC_COMMIT_REUSE
+	/* ckpt_valid_map covers GC moves from now on */
+	memset(sit_i->j_gc_moved, 0, MAIN_SEGS(sbi) * sizeof(unsigned short));
+#endif
 	up_write(&sit_i->sentry_lock);
 
 	set_prefree_as_free_segments(sbi);
@@ -4419,6 +4565,13 @@ static int build_sit_info(struct f2fs_sb_info *sbi)
 		return -ENOMEM;
 #endif
 
+#if F2FSJ_CTRL_CP && F2FSJ_GC_COMMIT_REUSE
+	sit_i->j_gc_moved = f2fs_kvzalloc(sbi, MAIN_SEGS(sbi) *
+					sizeof(unsigned short), GFP_KERNEL);
+	if (!sit_i->j_gc_moved)
+		return -ENOMEM;
+#endif
+
 	/* init SIT information */
 	sit_i->s_ops = &default_salloc_ops;
 
@@ -5350,6 +5503,9 @@ static void destroy_sit_info(struct f2fs_sb_info *sbi)
 #ifdef CONFIG_F2FS_CHECK_FS
 	kvfree(sit_i->sit_bitmap_mir);
 	kvfree(sit_i->invalid_segmap);
+#endif
+#if F2FSJ_CTRL_CP && F2FSJ_GC_COMMIT_REUSE
+	kvfree(sit_i->j_gc_moved);
 #endif
 	kfree(sit_i);
 }
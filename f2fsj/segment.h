@@ -263,6 +263,10 @@ struct sit_info {
 	unsigned long long dirty_max_mtime;	/* rerange candidates in GC_AT */
 
 	unsigned int last_victim[MAX_GC_POLICY]; /* last victim segment # */
+#if F2FSJ_CTRL_CP && F2FSJ_GC_COMMIT_REUSE
+	/* blocks moved out by journaled GC since last checkpoint */
+	unsigned short *j_gc_moved;
+#endif
 };
 
 struct free_segmap_info {
@@ -39,8 +39,14 @@
 #include <trace/events/f2fs.h>
 
 #include "j_journal_file.h"
+#include "j_recovery.h"
 #include "j_epoch_process.h"
 #include "j_checkpoint.h"
+#include "j_log_compact.h"
+#include "j_journal_compress.h"
+#include "j_stats.h"
+#include "j_op_lat.h"
+#include "j_stress.h"
 
 static struct kmem_cache *f2fs_inode_cachep;
 
@@ -162,6 +168,7 @@ enum {
 	Opt_gc_merge,
 	Opt_nogc_merge,
 	Opt_discard_unit,
+	Opt_data_journal,
 	Opt_err,
 };
 
@@ -239,6 +246,7 @@ static match_table_t f2fs_tokens = {
 	{Opt_gc_merge, "gc_merge"},
 	{Opt_nogc_merge, "nogc_merge"},
 	{Opt_discard_unit, "discard_unit=%s"},
+	{Opt_data_journal, "data_journal"},
 	{Opt_err, NULL},
 };
 
@@ -761,6 +769,9 @@ static int parse_options(struct super_block *sb, char *options, bool is_remount)
 		case Opt_nobarrier:
 			set_opt(sbi, NOBARRIER);
 			break;
+		case Opt_data_journal:
+			set_opt(sbi, DATA_JOURNAL);
+			break;
 		case Opt_fastboot:
 			set_opt(sbi, FASTBOOT);
 			break;
@@ -1345,12 +1356,15 @@ static struct inode *f2fs_alloc_inode(struct super_block *sb)
         INIT_LIST_HEAD(&fi->j_ino_log_list[i].inode_log_list_head);
 
         fi->j_ino_log_list[i].log_list_status = LOG_LIST_IDLE;
+        fi->j_ino_log_list[i].dirty_data_ranges.nr_ranges = 0;
 
         ///< initially, each local ep is corresponding to invalid epoch
         fi->g2l_ep_map[i] = NONE_EPOCH;
     }
     spin_lock_init(&fi->ino_spin_lock_local_ep);
     spin_lock_init(&fi->ino_spin_lock_global_ep);
+    fi->j_atime_log = NULL;
+    fi->j_atime_log_ep = 0;
     //INFO_REPORT("alloc new f2fs inode completed\n");
 #endif
 	/* Will be used by directory only */
@@ -1461,6 +1475,22 @@ void f2fs_inode_synced(struct inode *inode)
 	spin_unlock(&sbi->inode_lock[DIRTY_META]);
 }
 
+#if F2FSJ_CTRL_CP
+/*
+ * The change of inode is in the journal, keep it in the in-core inode
+ * instead of dirtying VFS inode: it stays on DIRTY_META list and its node
+ * page is updated once by checkpoint (f2fs_sync_inode_meta()), fsync or
+ * eviction.
+ */
+void f2fsj_absorb_inode_dirty(struct inode *inode)
+{
+	if (is_inode_flag_set(inode, FI_NEW_INODE))
+		return;
+
+	f2fs_inode_dirtied(inode, true);
+}
+#endif
+
 /*
  * f2fs_dirty_inode() is called from __mark_inode_dirty()
  *
@@ -1919,6 +1949,8 @@ static int f2fs_show_options(struct seq_file *seq, struct dentry *root)
 		seq_puts(seq, ",flush_merge");
 	if (test_opt(sbi, NOBARRIER))
 		seq_puts(seq, ",nobarrier");
+	if (test_opt(sbi, DATA_JOURNAL))
+		seq_puts(seq, ",data_journal");
 	if (test_opt(sbi, FASTBOOT))
 		seq_puts(seq, ",fastboot");
 	if (test_opt(sbi, EXTENT_CACHE))
@@ -3569,6 +3601,18 @@ static void init_sb_info(struct f2fs_sb_info *sbi)
 	sbi->interval_time[DISABLE_TIME] = DEF_DISABLE_INTERVAL;
 	sbi->interval_time[UMOUNT_DISCARD_TIMEOUT] =
 				DEF_UMOUNT_DISCARD_TIMEOUT;
+#if F2FSJ_CTRL_CP
+	sbi->j_max_recovery_ms = J_DEF_MAX_RECOVERY_MS;
+	sbi->j_replay_cost_ns = J_DEF_REPLAY_COST_NS;
+	sbi->j_absorb_max_pages = J_DEF_ABSORB_SEGS * sbi->blocks_per_seg;
+	sbi->j_data_journal_max_bytes = J_DEF_DATA_JOURNAL_MAX_BYTES;
+	sbi->j_log_compaction = J_DEF_LOG_COMPACTION;
+	sbi->j_compress_journal = J_DEF_COMPRESS_JOURNAL;
+	sbi->j_op_latency = J_DEF_OP_LATENCY;
+	sbi->j_stress_ops = J_DEF_STRESS_OPS;
+	sbi->j_stress_files = J_DEF_STRESS_FILES;
+	sbi->j_stress_commit_ops = J_DEF_STRESS_COMMIT_OPS;
+#endif
 	clear_sbi_flag(sbi, SBI_NEED_FSCK);
 
 	for (i = 0; i < NR_COUNT_TYPE; i++)
@@ -4106,6 +4150,8 @@ try_onemore:
 
 #if F2FSJ_CTRL_CP
     ///< F2FSJ
+    j_stats_reset();
+    j_op_lat_enable(sbi->j_op_latency);
     init_journal_file_info(sb);
     init_global_epoch();
     init_g_checkpoint_list();
@@ -4251,6 +4297,12 @@ try_onemore:
 		if (err)
 			f2fs_err(sbi, "Cannot turn on quotas: error %d", err);
 	}
+#endif
+#if F2FSJ_CTRL_CP
+	/* roll NAT/SIT/SSA forward by the meta deltas read from journal */
+	err = j_replay_journal_meta_deltas(sbi);
+	if (err)
+		goto free_meta;
 #endif
 	/* if there are any orphan inodes, free them */
 	err = f2fs_recover_orphan_inodes(sbi);
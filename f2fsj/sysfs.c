@@ -18,6 +18,11 @@
 #include "segment.h"
 #include "gc.h"
 #include "iostat.h"
+#include "j_epoch_process.h"
+#include "j_epoch.h"
+#include "j_stats.h"
+#include "j_op_lat.h"
+#include "j_stress.h"
 #include <trace/events/f2fs.h>
 
 static struct proc_dir_entry *f2fs_proc_root;
@@ -249,6 +254,98 @@ static ssize_t main_blkaddr_show(struct f2fs_attr *a,
 			(unsigned long long)MAIN_BLKADDR(sbi));
 }
 
+#if F2FSJ_CTRL_CP
+static ssize_t j_est_recovery_ms_show(struct f2fs_attr *a,
+				struct f2fs_sb_info *sbi, char *buf)
+{
+	return sprintf(buf, "%u\n", j_estimate_recovery_ms(sbi));
+}
+
+static ssize_t j_absorbed_pages_show(struct f2fs_attr *a,
+				struct f2fs_sb_info *sbi, char *buf)
+{
+	return sprintf(buf, "%llu\n",
+			(unsigned long long)get_pages(sbi, F2FSJ_JDIRTY_PAGES));
+}
+
+static ssize_t j_journal_fill_show(struct f2fs_attr *a,
+				struct f2fs_sb_info *sbi, char *buf)
+{
+	return sprintf(buf, "%u\n", j_stat_journal_fill());
+}
+
+static ssize_t j_epochs_busy_show(struct f2fs_attr *a,
+				struct f2fs_sb_info *sbi, char *buf)
+{
+	return sprintf(buf, "%d\n", get_nr_busy_epochs());
+}
+
+static ssize_t j_epochs_committed_show(struct f2fs_attr *a,
+				struct f2fs_sb_info *sbi, char *buf)
+{
+	return sprintf(buf, "%llu\n", (unsigned long long)
+			atomic64_read(&g_j_stats.epochs[J_STAT_EP_COMMITTED]));
+}
+
+static ssize_t j_crash_hit_show(struct f2fs_attr *a,
+				struct f2fs_sb_info *sbi, char *buf)
+{
+	return sprintf(buf, "%u\n", READ_ONCE(sbi->j_crash_hit));
+}
+
+static ssize_t j_fsync_stall_us_show(struct f2fs_attr *a,
+				struct f2fs_sb_info *sbi, char *buf)
+{
+	return sprintf(buf, "%llu\n",
+			(unsigned long long)atomic64_read(&g_j_stats.stall_us));
+}
+
+static const char *j_wa_type_name[NR_J_WA_TYPE] = {
+	[J_WA_LOGICAL]		= "logical",
+	[J_WA_JOURNAL]		= "journal",
+	[J_WA_JOURNAL_ZERO]	= "journal_zero",
+	[J_WA_CHECKPOINT]	= "checkpoint",
+	[J_WA_NODE]		= "node",
+	[J_WA_DATA]		= "data",
+	[J_WA_GC]		= "gc",
+};
+
+static ssize_t j_write_kbytes_show(struct f2fs_attr *a,
+				struct f2fs_sb_info *sbi, char *buf)
+{
+	int len;
+	int i;
+
+	len = sprintf(buf, "%-12s kbytes ios\n", "category");
+	for (i = 0; i < NR_J_WA_TYPE; i++)
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%-12s %llu %llu\n",
+			j_wa_type_name[i],
+			(unsigned long long)atomic64_read(&sbi->j_wa_bytes[i]) >> 10,
+			(unsigned long long)atomic64_read(&sbi->j_wa_ios[i]));
+	return len;
+}
+
+/* device bytes per logical byte, in thousandths */
+static ssize_t j_waf_show(struct f2fs_attr *a,
+				struct f2fs_sb_info *sbi, char *buf)
+{
+	u64 logical = atomic64_read(&sbi->j_wa_bytes[J_WA_LOGICAL]);
+	u64 device = 0;
+	u64 waf;
+	u32 frac;
+	int i;
+
+	for (i = J_WA_LOGICAL + 1; i < NR_J_WA_TYPE; i++)
+		device += atomic64_read(&sbi->j_wa_bytes[i]);
+
+	if (!logical)
+		return sprintf(buf, "0.000\n");
+
+	waf = div_u64_rem(div64_u64(device * 1000, logical), 1000, &frac);
+	return sprintf(buf, "%llu.%03u\n", waf, frac);
+}
+#endif
+
 static ssize_t f2fs_sbi_show(struct f2fs_attr *a,
 			struct f2fs_sb_info *sbi, char *buf)
 {
@@ -445,6 +542,43 @@ out:
 	if (!strcmp(a->attr.name, "trim_sections"))
 		return -EINVAL;
 
+#if F2FSJ_CTRL_CP
+	/* one data journal log holds at most one page of data */
+	if (!strcmp(a->attr.name, "j_data_journal_max_bytes")) {
+		if (t > PAGE_SIZE)
+			return -EINVAL;
+	}
+
+	/* histograms are shared by the module, like the journal */
+	if (!strcmp(a->attr.name, "j_op_latency")) {
+		if (t > 1)
+			return -EINVAL;
+		*ui = (unsigned int)t;
+		j_op_lat_enable(t);
+		return count;
+	}
+
+	/* arming clears the last hit, any change releases a held journal */
+	if (!strcmp(a->attr.name, "j_crash_point")) {
+		if (t >= J_CRASH_NR_POINTS)
+			return -EINVAL;
+		if (t)
+			WRITE_ONCE(sbi->j_crash_hit, J_CRASH_NONE);
+		WRITE_ONCE(*ui, (unsigned int)t);
+		j_crash_release();
+		return count;
+	}
+
+	/* runs the stress test, returns when it is over */
+	if (!strcmp(a->attr.name, "j_stress")) {
+		if (!t || t > J_STRESS_MAX_THREADS)
+			return -EINVAL;
+		*ui = (unsigned int)t;
+		ret = j_stress_run(sbi, t);
+		return ret ? ret : count;
+	}
+#endif
+
 	if (!strcmp(a->attr.name, "gc_urgent")) {
 		if (t == 0) {
 			sbi->gc_mode = GC_NORMAL;
@@ -718,6 +852,30 @@ F2FS_RW_ATTR(FAULT_INFO_TYPE, f2fs_fault_info, inject_type, inject_type);
 F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, data_io_flag, data_io_flag);
 F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, node_io_flag, node_io_flag);
 F2FS_RW_ATTR(CPRC_INFO, ckpt_req_control, ckpt_thread_ioprio, ckpt_thread_ioprio);
+#if F2FSJ_CTRL_CP
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, j_max_recovery_ms, j_max_recovery_ms);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, j_replay_cost_ns, j_replay_cost_ns);
+F2FS_GENERAL_RO_ATTR(j_est_recovery_ms);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, j_absorb_max_pages, j_absorb_max_pages);
+F2FS_GENERAL_RO_ATTR(j_absorbed_pages);
+F2FS_GENERAL_RO_ATTR(j_journal_fill);
+F2FS_GENERAL_RO_ATTR(j_epochs_busy);
+F2FS_GENERAL_RO_ATTR(j_epochs_committed);
+F2FS_GENERAL_RO_ATTR(j_fsync_stall_us);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, j_data_journal_max_bytes, j_data_journal_max_bytes);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, j_log_compaction, j_log_compaction);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, j_compress_journal, j_compress_journal);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, j_op_latency, j_op_latency);
+F2FS_GENERAL_RO_ATTR(j_write_kbytes);
+F2FS_GENERAL_RO_ATTR(j_waf);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, j_crash_point, j_crash_point);
+F2FS_GENERAL_RO_ATTR(j_crash_hit);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, j_stress, j_stress);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, j_stress_ops, j_stress_ops);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, j_stress_files, j_stress_files);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, j_stress_dir_ino, j_stress_dir_ino);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, j_stress_commit_ops, j_stress_commit_ops);
+#endif
 F2FS_GENERAL_RO_ATTR(dirty_segments);
 F2FS_GENERAL_RO_ATTR(free_segments);
 F2FS_GENERAL_RO_ATTR(ovp_segments);
@@ -827,6 +985,30 @@ static struct attribute *f2fs_attrs[] = {
 	ATTR_LIST(data_io_flag),
 	ATTR_LIST(node_io_flag),
 	ATTR_LIST(ckpt_thread_ioprio),
+#if F2FSJ_CTRL_CP
+	ATTR_LIST(j_max_recovery_ms),
+	ATTR_LIST(j_replay_cost_ns),
+	ATTR_LIST(j_est_recovery_ms),
+	ATTR_LIST(j_absorb_max_pages),
+	ATTR_LIST(j_absorbed_pages),
+	ATTR_LIST(j_journal_fill),
+	ATTR_LIST(j_epochs_busy),
+	ATTR_LIST(j_epochs_committed),
+	ATTR_LIST(j_fsync_stall_us),
+	ATTR_LIST(j_data_journal_max_bytes),
+	ATTR_LIST(j_log_compaction),
+	ATTR_LIST(j_compress_journal),
+	ATTR_LIST(j_op_latency),
+	ATTR_LIST(j_write_kbytes),
+	ATTR_LIST(j_waf),
+	ATTR_LIST(j_crash_point),
+	ATTR_LIST(j_crash_hit),
+	ATTR_LIST(j_stress),
+	ATTR_LIST(j_stress_ops),
+	ATTR_LIST(j_stress_files),
+	ATTR_LIST(j_stress_dir_ino),
+	ATTR_LIST(j_stress_commit_ops),
+#endif
 	ATTR_LIST(dirty_segments),
 	ATTR_LIST(free_segments),
 	ATTR_LIST(ovp_segments),
@@ -1059,6 +1241,29 @@ static int __maybe_unused segment_info_seq_show(struct seq_file *seq,
 	return 0;
 }
 
+#if F2FSJ_CTRL_CP
+static int __maybe_unused j_stats_seq_show(struct seq_file *seq,
+						void *offset)
+{
+	j_stats_show(seq);
+	return 0;
+}
+
+static int __maybe_unused j_op_latency_seq_show(struct seq_file *seq,
+						void *offset)
+{
+	j_op_lat_show(seq);
+	return 0;
+}
+
+static int __maybe_unused j_stress_seq_show(struct seq_file *seq,
+						void *offset)
+{
+	j_stress_show(seq);
+	return 0;
+}
+#endif
+
 static int __maybe_unused segment_bits_seq_show(struct seq_file *seq,
 						void *offset)
 {
@@ -1176,6 +1381,14 @@ int f2fs_register_sysfs(struct f2fs_sb_info *sbi)
 #endif
 		proc_create_single_data("victim_bits", 0444, sbi->s_proc,
 				victim_bits_seq_show, sb);
+#if F2FSJ_CTRL_CP
+		proc_create_single_data("j_stats", 0444, sbi->s_proc,
+				j_stats_seq_show, sb);
+		proc_create_single_data("j_op_latency", 0444, sbi->s_proc,
+				j_op_latency_seq_show, sb);
+		proc_create_single_data("j_stress", 0444, sbi->s_proc,
+				j_stress_seq_show, sb);
+#endif
 	}
 	return 0;
 put_feature_list_kobj:
@@ -1199,6 +1412,11 @@ void f2fs_unregister_sysfs(struct f2fs_sb_info *sbi)
 		remove_proc_entry("segment_info", sbi->s_proc);
 		remove_proc_entry("segment_bits", sbi->s_proc);
 		remove_proc_entry("victim_bits", sbi->s_proc);
+#if F2FSJ_CTRL_CP
+		remove_proc_entry("j_stats", sbi->s_proc);
+		remove_proc_entry("j_op_latency", sbi->s_proc);
+		remove_proc_entry("j_stress", sbi->s_proc);
+#endif
 		remove_proc_entry(sbi->sb->s_id, f2fs_proc_root);
 	}
 
@@ -22,6 +22,7 @@
 #include "f2fs.h"
 #include "xattr.h"
 #include "segment.h"
+#include "j_log_operate.h"
 
 static void *xattr_alloc(struct f2fs_sb_info *sbi, int size, bool *is_inline)
 {
@@ -745,6 +746,18 @@ static int __f2fs_setxattr(struct inode *inode, int index,
 	if (index == F2FS_XATTR_INDEX_ENCRYPTION &&
 			!strcmp(name, F2FS_XATTR_NAME_ENCRYPTION_CONTEXT))
 		f2fs_set_encrypted_inode(inode);
+#if F2FSJ_CTRL_CP && F2FSJ_ABSORB_ATTR
+	/*
+	 * ipage is only given for a new inode, its xattrs are written with
+	 * the inode. A journaled xattr of directory is replayed from journal,
+	 * no need to checkpoint for it. Recovery does not replay XATTR_LOG
+	 * yet, so until it does (F2FSJ_ABSORB_ATTR) nothing is logged.
+	 */
+	if (!ipage && j_log_xattr(inode, index, name, len, value, size) == F2FSJ_OK) {
+		f2fsj_absorb_inode_dirty(inode);
+		goto same;
+	}
+#endif
 	f2fs_mark_inode_dirty_sync(inode, true);
 	if (!error && S_ISDIR(inode->i_mode))
 		set_sbi_flag(F2FS_I_SB(inode), SBI_NEED_CP);
@@ -0,0 +1,478 @@
+/**
+ * @file mdbench.c
+ * @author leslie.cui (10033908@github.com)
+ * @brief mdtest style metadata benchmark: every thread count of -t runs the phases of -o
+ *        (mkdir, create, stat, rename, unlink, rmdir) one after another, all threads of a
+ *        phase start together on a barrier. Prints ops/s and p50/p99/p99.9 latency of
+ *        each phase and thread count.
+ * @version 0.1
+ * @date 2023-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MD_MAX_THREADS      (1024)
+#define MD_MAX_COUNTS       (32)
+#define MD_NAME_LEN         (4096)
+#define MD_DIR_LEN          (MD_NAME_LEN - 64)  ///< room for the entry name
+
+typedef enum __md_op_e
+{
+    MD_MKDIR  = 0,
+    MD_CREATE = 1,
+    MD_STAT   = 2,
+    MD_RENAME = 3,
+    MD_UNLINK = 4,
+    MD_RMDIR  = 5,
+    MD_NR_OPS,
+}md_op_e;
+
+static const char *md_op_name[MD_NR_OPS] =
+{
+    [MD_MKDIR]  = "mkdir",
+    [MD_CREATE] = "create",
+    [MD_STAT]   = "stat",
+    [MD_RENAME] = "rename",
+    [MD_UNLINK] = "unlink",
+    [MD_RMDIR]  = "rmdir",
+};
+
+typedef struct __md_conf
+{
+    const char *root;                       ///< directory on the fs under test
+    uint32_t    nr_files;                   ///< files and dirs per thread
+    uint32_t    counts[MD_MAX_COUNTS];      ///< thread counts to run
+    uint32_t    nr_counts;
+    md_op_e     ops[MD_NR_OPS];             ///< phases in order
+    uint32_t    nr_ops;
+    int         shared;                     ///< 1: all threads in one dir, 0: a dir per thread
+    int         fsync;                      ///< fsync the file or the parent dir after each op
+    int         csv;
+}md_conf_t;
+
+typedef struct __md_thread
+{
+    pthread_t   tid;
+    uint32_t    idx;
+    md_op_e     op;
+    char        dir[MD_DIR_LEN];            ///< dir of this thread's entries
+    uint64_t   *lat_ns;                     ///< nr_files latencies of the current phase
+    uint32_t    nr_errs;
+    int         first_err;
+}md_thread_t;
+
+static md_conf_t g_conf =
+{
+    .root     = NULL,
+    .nr_files = 10000,
+    .counts   = {1},
+    .nr_counts = 1,
+    .ops      = {MD_MKDIR, MD_CREATE, MD_STAT, MD_RENAME, MD_UNLINK, MD_RMDIR},
+    .nr_ops   = MD_NR_OPS,
+};
+
+static pthread_barrier_t g_barrier;
+static md_thread_t g_threads[MD_MAX_THREADS];
+
+static uint64_t md_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void md_name(md_thread_t *t, md_op_e op, uint32_t i, char *buf)
+{
+    // dirs and files of a thread never collide, in the shared dir the thread index keeps them apart
+    if (op == MD_MKDIR || op == MD_RMDIR)
+    {
+        snprintf(buf, MD_NAME_LEN, "%s/d.%u.%u", t->dir, t->idx, i);
+    }
+    else
+    {
+        snprintf(buf, MD_NAME_LEN, "%s/f.%u.%u", t->dir, t->idx, i);
+    }
+}
+
+static int md_sync_dir(md_thread_t *t)
+{
+    int fd = open(t->dir, O_RDONLY | O_DIRECTORY);
+    int err = 0;
+
+    if (fd < 0)
+    {
+        return -1;
+    }
+    err = fsync(fd);
+    close(fd);
+    return err;
+}
+
+static int md_do_op(md_thread_t *t, uint32_t i)
+{
+    char name[MD_NAME_LEN];
+    char new_name[MD_NAME_LEN + 2];
+    struct stat st;
+    int fd = 0;
+    int err = 0;
+
+    md_name(t, t->op, i, name);
+    snprintf(new_name, sizeof(new_name), "%s.r", name);
+
+    switch (t->op)
+    {
+        case MD_MKDIR:
+            err = mkdir(name, 0755);
+            break;
+        case MD_CREATE:
+            fd = open(name, O_CREAT | O_EXCL | O_WRONLY, 0644);
+            if (fd < 0)
+            {
+                return -1;
+            }
+            if (g_conf.fsync)
+            {
+                err = fsync(fd);
+            }
+            close(fd);
+            return err;
+        case MD_STAT:
+            return stat(name, &st);
+        case MD_RENAME:
+            err = rename(name, new_name);
+            break;
+        case MD_UNLINK:
+            // stat and rename may have run before, unlink whichever name is there
+            err = unlink(new_name);
+            if (err && errno == ENOENT)
+            {
+                err = unlink(name);
+            }
+            break;
+        case MD_RMDIR:
+            err = rmdir(name);
+            break;
+        default:
+            return -1;
+    }
+
+    if (!err && g_conf.fsync)
+    {
+        err = md_sync_dir(t);
+    }
+
+    return err;
+}
+
+static void *md_thread_fn(void *arg)
+{
+    md_thread_t *t = arg;
+    uint64_t start_ns = 0;
+    uint32_t i = 0;
+
+    pthread_barrier_wait(&g_barrier);
+    for (i = 0; i < g_conf.nr_files; i++)
+    {
+        start_ns = md_now_ns();
+        if (md_do_op(t, i))
+        {
+            if (!t->nr_errs)
+            {
+                t->first_err = errno;
+            }
+            t->nr_errs++;
+        }
+        t->lat_ns[i] = md_now_ns() - start_ns;
+    }
+    pthread_barrier_wait(&g_barrier);
+
+    return NULL;
+}
+
+static int md_cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static uint64_t md_pct(uint64_t *sorted, uint64_t nr, uint32_t per_mille)
+{
+    uint64_t idx = (nr * per_mille + 999) / 1000;
+
+    return sorted[idx ? idx - 1 : 0];
+}
+
+/**
+ * @brief Run one phase with nr_threads, threads and the main thread meet on the barrier
+ *        before and after the phase, so the wall time is the slowest thread's
+ */
+static int md_run_phase(uint32_t nr_threads, md_op_e op, uint64_t *all_lat)
+{
+    uint64_t start_ns = 0;
+    uint64_t wall_ns = 0;
+    uint64_t nr = (uint64_t)nr_threads * g_conf.nr_files;
+    uint32_t nr_errs = 0;
+    uint32_t i = 0;
+
+    pthread_barrier_init(&g_barrier, NULL, nr_threads + 1);
+    for (i = 0; i < nr_threads; i++)
+    {
+        g_threads[i].op = op;
+        g_threads[i].nr_errs = 0;
+        g_threads[i].lat_ns = all_lat + (uint64_t)i * g_conf.nr_files;
+        if (pthread_create(&g_threads[i].tid, NULL, md_thread_fn, &g_threads[i]))
+        {
+            fprintf(stderr, "pthread_create failed\n");
+            exit(1);
+        }
+    }
+
+    pthread_barrier_wait(&g_barrier);
+    start_ns = md_now_ns();
+    pthread_barrier_wait(&g_barrier);
+    wall_ns = md_now_ns() - start_ns;
+
+    for (i = 0; i < nr_threads; i++)
+    {
+        pthread_join(g_threads[i].tid, NULL);
+        if (g_threads[i].nr_errs && !nr_errs)
+        {
+            fprintf(stderr, "%s: thread %u: %s\n", md_op_name[op], i, strerror(g_threads[i].first_err));
+        }
+        nr_errs += g_threads[i].nr_errs;
+    }
+    pthread_barrier_destroy(&g_barrier);
+
+    qsort(all_lat, nr, sizeof(uint64_t), md_cmp_u64);
+    if (g_conf.csv)
+    {
+        printf("%u,%s,%s,%d,%llu,%.1f,%.1f,%.1f,%.1f,%.1f,%u\n",
+               nr_threads, md_op_name[op], g_conf.shared ? "shared" : "private", g_conf.fsync,
+               (unsigned long long)nr, nr * 1e9 / wall_ns,
+               md_pct(all_lat, nr, 500) / 1e3, md_pct(all_lat, nr, 990) / 1e3,
+               md_pct(all_lat, nr, 999) / 1e3, all_lat[nr - 1] / 1e3, nr_errs);
+    }
+    else
+    {
+        printf("%7u %-7s %10llu %12.1f %10.1f %10.1f %10.1f %10.1f %6u\n",
+               nr_threads, md_op_name[op], (unsigned long long)nr, nr * 1e9 / wall_ns,
+               md_pct(all_lat, nr, 500) / 1e3, md_pct(all_lat, nr, 990) / 1e3,
+               md_pct(all_lat, nr, 999) / 1e3, all_lat[nr - 1] / 1e3, nr_errs);
+    }
+    fflush(stdout);
+
+    return nr_errs ? -1 : 0;
+}
+
+/**
+ * @brief Remove what the phases left, e.g. when -o has no unlink, so the next thread count starts empty
+ */
+static void md_cleanup(uint32_t nr_threads)
+{
+    char name[MD_NAME_LEN];
+    char new_name[MD_NAME_LEN + 2];
+    uint32_t t = 0;
+    uint32_t i = 0;
+
+    for (t = 0; t < nr_threads; t++)
+    {
+        for (i = 0; i < g_conf.nr_files; i++)
+        {
+            md_name(&g_threads[t], MD_CREATE, i, name);
+            snprintf(new_name, sizeof(new_name), "%s.r", name);
+            unlink(name);
+            unlink(new_name);
+            md_name(&g_threads[t], MD_RMDIR, i, name);
+            rmdir(name);
+        }
+        if (!g_conf.shared)
+        {
+            rmdir(g_threads[t].dir);
+        }
+    }
+    if (g_conf.shared)
+    {
+        rmdir(g_threads[0].dir);
+    }
+}
+
+static int md_run(uint32_t nr_threads, uint64_t *all_lat)
+{
+    uint32_t i = 0;
+    int err = 0;
+
+    for (i = 0; i < nr_threads; i++)
+    {
+        g_threads[i].idx = i;
+        if (g_conf.shared)
+        {
+            snprintf(g_threads[i].dir, MD_DIR_LEN, "%s/mdbench.shared", g_conf.root);
+        }
+        else
+        {
+            snprintf(g_threads[i].dir, MD_DIR_LEN, "%s/mdbench.t%u", g_conf.root, i);
+        }
+        if (mkdir(g_threads[i].dir, 0755) && errno != EEXIST)
+        {
+            fprintf(stderr, "mkdir %s: %s\n", g_threads[i].dir, strerror(errno));
+            return -1;
+        }
+    }
+    sync();
+
+    for (i = 0; i < g_conf.nr_ops && !err; i++)
+    {
+        err = md_run_phase(nr_threads, g_conf.ops[i], all_lat);
+    }
+
+    md_cleanup(nr_threads);
+    sync();
+
+    return err;
+}
+
+static int md_parse_ops(char *arg)
+{
+    char *tok = NULL;
+    int i = 0;
+
+    g_conf.nr_ops = 0;
+    for (tok = strtok(arg, ","); tok; tok = strtok(NULL, ","))
+    {
+        for (i = 0; i < MD_NR_OPS && strcmp(tok, md_op_name[i]); i++)
+            ;
+        if (i == MD_NR_OPS || g_conf.nr_ops == MD_NR_OPS)
+        {
+            fprintf(stderr, "invalid op %s\n", tok);
+            return -1;
+        }
+        g_conf.ops[g_conf.nr_ops++] = i;
+    }
+
+    return g_conf.nr_ops ? 0 : -1;
+}
+
+static int md_parse_counts(char *arg)
+{
+    char *tok = NULL;
+    long v = 0;
+
+    g_conf.nr_counts = 0;
+    for (tok = strtok(arg, ","); tok; tok = strtok(NULL, ","))
+    {
+        v = strtol(tok, NULL, 0);
+        if (v < 1 || v > MD_MAX_THREADS || g_conf.nr_counts == MD_MAX_COUNTS)
+        {
+            fprintf(stderr, "invalid thread count %s, 1..%d\n", tok, MD_MAX_THREADS);
+            return -1;
+        }
+        g_conf.counts[g_conf.nr_counts++] = v;
+    }
+
+    return g_conf.nr_counts ? 0 : -1;
+}
+
+static void md_usage(const char *prog)
+{
+    fprintf(stderr,
+            "%s -d dir [options]\n"
+            "  -d dir        directory on the fs under test\n"
+            "  -t 1,2,4,8    thread counts, each runs all phases\n"
+            "  -n 10000      files and dirs per thread\n"
+            "  -o ops        phases in order, default mkdir,create,stat,rename,unlink,rmdir\n"
+            "  -s            shared dir for all threads, default a dir per thread\n"
+            "  -F            fsync the new file, or the parent dir, after each op\n"
+            "  -C            csv output\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t *all_lat = NULL;
+    uint32_t max_threads = 0;
+    uint32_t i = 0;
+    int opt = 0;
+    int err = 0;
+
+    while ((opt = getopt(argc, argv, "d:t:n:o:sFCh")) != -1)
+    {
+        switch (opt)
+        {
+            case 'd':
+                g_conf.root = optarg;
+                break;
+            case 't':
+                err = md_parse_counts(optarg);
+                break;
+            case 'n':
+                g_conf.nr_files = strtoul(optarg, NULL, 0);
+                break;
+            case 'o':
+                err = md_parse_ops(optarg);
+                break;
+            case 's':
+                g_conf.shared = 1;
+                break;
+            case 'F':
+                g_conf.fsync = 1;
+                break;
+            case 'C':
+                g_conf.csv = 1;
+                break;
+            default:
+                err = -1;
+                break;
+        }
+    }
+
+    if (err || !g_conf.root || !g_conf.nr_files)
+    {
+        md_usage(argv[0]);
+        return 1;
+    }
+
+    for (i = 0; i < g_conf.nr_counts; i++)
+    {
+        max_threads = g_conf.counts[i] > max_threads ? g_conf.counts[i] : max_threads;
+    }
+    all_lat = malloc((uint64_t)max_threads * g_conf.nr_files * sizeof(uint64_t));
+    if (!all_lat)
+    {
+        fprintf(stderr, "no memory for %u x %u latencies\n", max_threads, g_conf.nr_files);
+        return 1;
+    }
+
+    if (g_conf.csv)
+    {
+        printf("threads,op,dir,fsync,ops,ops_s,p50_us,p99_us,p999_us,max_us,errors\n");
+    }
+    else
+    {
+        printf("# %s dir, %s, %u per thread, latency in us\n", g_conf.shared ? "shared" : "private",
+               g_conf.fsync ? "fsync" : "no fsync", g_conf.nr_files);
+        printf("%7s %-7s %10s %12s %10s %10s %10s %10s %6s\n",
+               "threads", "op", "ops", "ops/s", "p50", "p99", "p99.9", "max", "errors");
+    }
+
+    for (i = 0; i < g_conf.nr_counts && !err; i++)
+    {
+        err = md_run(g_conf.counts[i], all_lat);
+    }
+
+    free(all_lat);
+    return err ? 1 : 0;
+}
@@ -0,0 +1,118 @@
+#!/bin/bash
+# Thread scaling of metadata ops with ./mdbench. Either runs on a mounted dir (-m), or
+# formats -D with each fs of -f and mounts it on -m for every profile.
+# Results: <out>/<fs>_<profile>.csv, one line per thread count and op.
+
+script_path=$(cd $(dirname $0) && pwd)
+
+fs_list=""
+dev_path=""
+mount_path=/mnt/f2fsj_mdbench
+thread_list="1,2,4,8,16,32"
+profile_list="private shared private_fsync shared_fsync"
+out_path=$script_path/results/$(date +%Y%m%d-%H%M%S)
+
+# profile -> mdbench options, fsync ones are ~100x slower and use fewer files
+declare -A profile_args=(
+    [private]="-n 10000"
+    [shared]="-n 10000 -s"
+    [private_fsync]="-n 1000 -F"
+    [shared_fsync]="-n 1000 -s -F"
+)
+
+function help_cmd(){
+    echo "---------------------------------------------"
+    echo "./mdbench.sh [options]"
+    echo "  -m dir                     mount point, or an already mounted dir when -f is not given"
+    echo "  -f \"f2fsj f2fs ext4 xfs\"   format -D with each fs in turn"
+    echo "  -D /dev/xxx                device for -f"
+    echo "  -t 1,2,4,8,16,32           thread counts"
+    echo "  -p \"private shared\"        profiles: private shared private_fsync shared_fsync"
+    echo "  -o dir                     output dir, default ./results/<date>"
+    echo "---------------------------------------------"
+}
+
+function format_fs(){
+    local fs=$1
+
+    case $fs in
+        f2fsj|f2fs) sudo mkfs.f2fs -f $dev_path > /dev/null ;;
+        ext4)       sudo mkfs.ext4 -F $dev_path > /dev/null ;;
+        xfs)        sudo mkfs.xfs -f $dev_path > /dev/null ;;
+        *)          return 1 ;;
+    esac
+}
+
+function mount_fs(){
+    local fs=$1
+
+    format_fs $fs || return 1
+    sudo modprobe $fs || return 1
+    sudo mount -t $fs $dev_path $mount_path || return 1
+    sudo chmod 777 $mount_path
+}
+
+function reset_fs(){
+    local fs=$1
+
+    sudo umount $mount_path
+    if [ $fs == "f2fsj" ]; then
+        sudo rmmod f2fsj
+    fi
+}
+
+function run_profile(){
+    local name=$1
+    local profile=$2
+
+    echo -e "\e[32m $(date +%T) $name $profile threads $thread_list \e[0m"
+    sync
+    sudo sh -c 'echo 3 > /proc/sys/vm/drop_caches'
+    $script_path/mdbench -d $mount_path -t $thread_list ${profile_args[$profile]} -C | tee $out_path/${name}_$profile.csv
+}
+
+while getopts "m:f:D:t:p:o:h" opt; do
+    case $opt in
+        m) mount_path=$OPTARG ;;
+        f) fs_list=$OPTARG ;;
+        D) dev_path=$OPTARG ;;
+        t) thread_list=$OPTARG ;;
+        p) profile_list=$OPTARG ;;
+        o) out_path=$OPTARG ;;
+        h) help_cmd; exit 0 ;;
+        *) help_cmd; exit 1 ;;
+    esac
+done
+
+for p in $profile_list; do
+    if [ -z "${profile_args[$p]}" ]; then
+        echo "invalid profile $p, plz check"
+        exit 1
+    fi
+done
+
+make -C $script_path > /dev/null || exit 1
+mkdir -p $out_path
+
+if [ -z "$fs_list" ]; then
+    for p in $profile_list; do
+        run_profile $(basename $mount_path) $p
+    done
+    exit 0
+fi
+
+if [ ! -b "$dev_path" ]; then
+    echo "-f needs a block device in -D"
+    exit 1
+fi
+sudo mkdir -p $mount_path
+
+# a fresh fs for every profile so that one profile does not age the next
+for fs in $fs_list; do
+    for p in $profile_list; do
+        mount_fs $fs || { echo "mount $fs fail"; exit 1; }
+        run_profile $fs $p
+        reset_fs $fs
+    done
+done
+echo -e "\e[32m mdbench Over, results in $out_path \e[0m"
@@ -0,0 +1,378 @@
+#!/bin/bash
+# Comparative filebench harness: formats one device with each filesystem, runs the
+# workloads under ../meta_data_only, ../data_and_meta_data and ../real_workloads with
+# the given thread counts and repetitions, and writes results.csv, flowops.csv,
+# perf.csv, summary.csv, summary.json and report.txt into the output directory.
+# Use ./bench_compare.sh to check a new result directory against an older one.
+
+script_path=$(cd $(dirname $0) && pwd)
+bench_root=$(dirname $script_path)
+
+fs_list="f2fsj f2fs ext4 xfs"
+profile_list="meta_data_only data_and_meta_data real_workloads"
+case_list=""
+thread_list="1"
+nr_reps=3
+dev_spec="loop:32G"
+out_path=$bench_root/results/$(date +%Y%m%d-%H%M%S)
+mount_path=/mnt/f2fsj_bench
+perf_on=1
+perf_delay=5
+
+dev_path=""
+loop_img=""
+
+# case name -> workload file, same names as the xx_fb.sh scripts
+declare -A case_file=(
+    [create_empty]=meta_data_only/micro_createfiles_empty.f
+    [unlink_empty]=meta_data_only/micro_delete_empty.f
+    [mkdir]=meta_data_only/micro_makedirs.f
+    [rmdir]=meta_data_only/micro_removedirs.f
+    [readdir]=meta_data_only/micro_listdirs_empty.f
+    [create_4k]=data_and_meta_data/micro_createfiles.f
+    [create_32k]=data_and_meta_data/micro_createfiles_32k.f
+    [copy_4k]=data_and_meta_data/micro_copyfiles.f
+    [delete_4k]=data_and_meta_data/micro_delete.f
+    [read_small]=data_and_meta_data/filemicro_read_small_files.f
+    [create_1g]=data_and_meta_data/micro_createfiles_1g.f
+    [rread_64g]=data_and_meta_data/filemicro_rread.f
+    [rwrite_64g]=data_and_meta_data/filemicro_rwrite.f
+    [seqread_64g]=data_and_meta_data/filemicro_seqread.f
+    [seqwrite_64g]=data_and_meta_data/filemicro_seqwrite.f
+    [create_64g]=data_and_meta_data/micro_createfiles_64g.f
+    [varmail]=real_workloads/real_varmail.f
+    [oltp]=real_workloads/real_oltp.f
+    [fileserver]=real_workloads/real_fileserver.f
+    [webproxy]=real_workloads/real_webproxy.f
+    [webserver]=real_workloads/real_webserver.f
+)
+
+# default cases of each profile, the 1g/64g ones need a big device and are only run with -c
+declare -A profile_cases=(
+    [meta_data_only]="create_empty unlink_empty mkdir rmdir readdir"
+    [data_and_meta_data]="create_4k create_32k copy_4k delete_4k read_small"
+    [real_workloads]="varmail oltp fileserver webproxy webserver"
+)
+
+function help_cmd(){
+    echo "---------------------------------------------"
+    echo "./bench.sh [options]"
+    echo "  -f \"f2fsj f2fs ext4 xfs\"   filesystems to compare"
+    echo "  -p \"meta_data_only ...\"    profiles, default all three"
+    echo "  -c \"create_empty varmail\"  cases, overrides -p (names as in ./xx_fb.sh -h)"
+    echo "  -t \"1 4 16\"                thread counts, sets \$nthreads of the workload"
+    echo "  -r 3                       repetitions of each run"
+    echo "  -d loop:32G                device: loop:<size>, nullb:<size> or /dev/xxx"
+    echo "  -o dir                     output dir, default ../results/<date>"
+    echo "  -m dir                     mount point, default $mount_path"
+    echo "  -P                         do not run perf.sh"
+    echo "---------------------------------------------"
+}
+
+function info(){
+    echo -e "\e[32m $* \e[0m"
+}
+
+function fail(){
+    echo -e "\e[31m $* \e[0m"
+}
+
+function setup_dev(){
+    local kind=${dev_spec%%:*}
+    local size=${dev_spec#*:}
+
+    if [ $kind == "loop" ]; then
+        loop_img=$out_path/dev.img
+        truncate -s $size $loop_img
+        dev_path=$(sudo losetup --show -f $loop_img)
+    elif [ $kind == "nullb" ]; then
+        # memory backed so that data is really kept, null_blk takes the size in GB
+        sudo modprobe null_blk nr_devices=1 memory_backed=1 gb=${size%G}
+        dev_path=/dev/nullb0
+    else
+        dev_path=$dev_spec
+    fi
+
+    if [ ! -b "$dev_path" ]; then
+        fail "no block device for $dev_spec"
+        return 1
+    fi
+    info "bench device $dev_path"
+    return 0
+}
+
+function release_dev(){
+    local kind=${dev_spec%%:*}
+
+    if [ $kind == "loop" ]; then
+        sudo losetup -d $dev_path
+        rm -f $loop_img
+    elif [ $kind == "nullb" ]; then
+        sudo rmmod null_blk
+    fi
+}
+
+function format_fs(){
+    local fs=$1
+
+    case $fs in
+        f2fsj|f2fs) sudo mkfs.f2fs -f $dev_path > /dev/null ;;
+        ext4)       sudo mkfs.ext4 -F $dev_path > /dev/null ;;
+        xfs)        sudo mkfs.xfs -f $dev_path > /dev/null ;;
+        *)          return 1 ;;
+    esac
+}
+
+function mount_fs(){
+    local fs=$1
+
+    sudo modprobe $fs || return 1
+    sudo mount -t $fs $dev_path $mount_path
+}
+
+function reset_fs(){
+    local fs=$1
+
+    sudo umount $mount_path
+    # f2fsj keeps journal state in module globals, reload it for a clean start
+    if [ $fs == "f2fsj" ]; then
+        sudo rmmod f2fsj
+    fi
+}
+
+function drop_caches(){
+    sync
+    sudo sh -c 'echo 3 > /proc/sys/vm/drop_caches'
+}
+
+# copy the workload of fs, pointing it at our mount point with the given thread count
+function make_workload(){
+    local fs=$1
+    local name=$2
+    local threads=$3
+    local dst=$4
+    local dir=${case_file[$name]%%/*}
+    local file=${case_file[$name]#*/}
+    local fs_dir=${fs}_fb
+
+    if [ $fs == "f2fsj" ]; then
+        fs_dir=j_f2fs_fb
+    fi
+
+    sed -e "s|^set \$dir=.*|set \$dir=$mount_path|" \
+        -e "s|^set \$nthreads=.*|set \$nthreads=$threads|" \
+        $bench_root/$dir/$fs_dir/$file > $dst
+}
+
+# snapshot f2fsj counters of the bench device
+function save_f2fsj_stats(){
+    local run_dir=$1
+    local dev=$(basename $(readlink -f $dev_path))
+    local f=""
+
+    for f in iostat_info j_stats j_op_latency; do
+        sudo cat /proc/fs/f2fsj/$dev/$f > $run_dir/$f 2>/dev/null
+    done
+    for f in j_write_kbytes j_waf; do
+        sudo cat /sys/fs/f2fsj/$dev/$f > $run_dir/$f 2>/dev/null
+    done
+}
+
+# filebench log -> one csv line: ops,ops_s,mb_s,lat_ms
+# handles both "IO Summary: N ops X ops/s ... Y.Zms/op" and the older "..., Nms latency"
+function parse_summary(){
+    awk '/IO Summary:/ {
+            line = $0
+            gsub(",", "", line)
+            ops = ops_s = mb_s = lat = 0
+            if (match(line, /[0-9]+ ops /))       { ops = substr(line, RSTART, RLENGTH - 5) }
+            if (match(line, /[0-9.]+ ops\/s/))    { ops_s = substr(line, RSTART, RLENGTH - 6) }
+            if (match(line, /[0-9.]+mb\/s/))      { mb_s = substr(line, RSTART, RLENGTH - 4) }
+            if (match(line, /[0-9.]+ms\/op/))     { lat = substr(line, RSTART, RLENGTH - 5) }
+            else if (match(line, /[0-9.]+ms latency/)) { lat = substr(line, RSTART, RLENGTH - 10) }
+        }
+        END { printf "%s,%s,%s,%s\n", ops, ops_s, mb_s, lat }' $1
+}
+
+# per flowop lines: name ops ops/s mb/s ms/op [min - max] -> name,ops,ops_s,mb_s,lat_ms,min_ms,max_ms
+function parse_flowops(){
+    awk '$2 ~ /^[0-9]+ops$/ && $3 ~ /ops\/s$/ {
+            name = $1; ops = $2; ops_s = $3; mb_s = $4; lat = $5
+            sub(/ops$/, "", ops); sub(/ops\/s$/, "", ops_s); sub(/mb\/s$/, "", mb_s); sub(/ms\/op$/, "", lat)
+            lo = hi = ""
+            if (match($0, /\[[0-9.]+[mu]?s - [0-9.]+[mu]?s\]/)) {
+                split(substr($0, RSTART + 1, RLENGTH - 2), r, " - ")
+                lo = to_ms(r[1]); hi = to_ms(r[2])
+            }
+            printf "%s,%s,%s,%s,%s,%s,%s\n", name, ops, ops_s, mb_s, lat, lo, hi
+        }
+        function to_ms(v) {
+            if (v ~ /ms$/) { sub(/ms$/, "", v); return v }
+            if (v ~ /us$/) { sub(/us$/, "", v); return v / 1000 }
+            sub(/s$/, "", v); return v * 1000
+        }' $1
+}
+
+# perf stat output -> event,value
+function parse_perf(){
+    awk '$1 ~ /^[0-9][0-9,.]*$/ && $2 !~ /^(msec|seconds)$/ { v = $1; gsub(",", "", v); print $2 "," v }
+         $1 ~ /^[0-9][0-9,.]*$/ && $2 == "msec" { v = $1; gsub(",", "", v); print $3 "," v }' $1
+}
+
+function run_one(){
+    local fs=$1
+    local name=$2
+    local threads=$3
+    local rep=$4
+    local run_dir=$out_path/raw/$fs/$name/t$threads/r$rep
+    local fb_pid=""
+    local worker=""
+
+    mkdir -p $run_dir
+    make_workload $fs $name $threads $run_dir/workload.f
+
+    format_fs $fs || { fail "format $fs fail"; return 1; }
+    mount_fs $fs || { fail "mount $fs fail"; return 1; }
+    drop_caches
+
+    info "$(date +%T) $fs $name threads=$threads rep=$rep"
+    sudo filebench -f $run_dir/workload.f > $run_dir/filebench.log 2>&1 &
+    fb_pid=$!
+
+    # the newest filebench process is a worker once the fileset is allocated
+    if [ $perf_on -eq 1 ]; then
+        sleep $perf_delay
+        worker=$(pgrep -n -x filebench)
+        if [ -n "$worker" ]; then
+            bash $script_path/perf.sh $worker > $run_dir/perf.txt 2>&1
+        fi
+    fi
+    wait $fb_pid
+
+    if [ $fs == "f2fsj" ]; then
+        save_f2fsj_stats $run_dir
+    fi
+    reset_fs $fs
+
+    echo "$fs,$name,$threads,$rep,$(parse_summary $run_dir/filebench.log)" >> $out_path/results.csv
+    parse_flowops $run_dir/filebench.log | sed "s|^|$fs,$name,$threads,$rep,|" >> $out_path/flowops.csv
+    if [ -f $run_dir/perf.txt ]; then
+        parse_perf $run_dir/perf.txt | sed "s|^|$fs,$name,$threads,$rep,|" >> $out_path/perf.csv
+    fi
+}
+
+# results.csv -> summary.csv and summary.json, percentiles are over the repetitions
+function summarize(){
+    tail -n +2 $out_path/results.csv | sort -t, -k1,1 -k2,2 -k3,3n -k4,4n | awk -F, -v csv=$out_path/summary.csv -v json=$out_path/summary.json '
+        function pct(a, n, p,    i, j, t, k) {
+            for (i = 2; i <= n; i++) { t = a[i]; for (j = i - 1; j >= 1 && a[j] > t; j--) a[j + 1] = a[j]; a[j + 1] = t }
+            k = int(p * (n - 1) / 100 + 0.5) + 1
+            return a[k]
+        }
+        function flush(    s, i) {
+            if (!n) return
+            s = 0; for (i = 1; i <= n; i++) s += ops[i]
+            printf "%s,%s,%s,%d,%.1f,%.1f,%.1f,%.1f,%.3f,%.3f,%.3f\n", fs, name, thr, n, s / n,
+                pct(ops, n, 50), pct(ops, n, 5), pct(ops, n, 95), pct(lat, n, 50), pct(lat, n, 90), pct(lat, n, 99) >> csv
+            printf "%s\n    {\"fs\": \"%s\", \"case\": \"%s\", \"threads\": %s, \"reps\": %d, \"ops_s\": {\"mean\": %.1f, \"p50\": %.1f, \"p5\": %.1f, \"p95\": %.1f}, \"lat_ms\": {\"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f}}", sep, fs, name, thr, n, s / n,
+                pct(ops, n, 50), pct(ops, n, 5), pct(ops, n, 95), pct(lat, n, 50), pct(lat, n, 90), pct(lat, n, 99) >> json
+            sep = ","
+            n = 0
+        }
+        BEGIN {
+            print "fs,case,threads,reps,ops_s_mean,ops_s_p50,ops_s_p5,ops_s_p95,lat_ms_p50,lat_ms_p90,lat_ms_p99" > csv
+            printf "{\n  \"results\": [" > json
+        }
+        $1 != fs || $2 != name || $3 != thr { flush(); fs = $1; name = $2; thr = $3 }
+        { n++; ops[n] = $6; lat[n] = $8 }
+        END { flush(); printf "\n  ]\n}\n" >> json }'
+}
+
+# summary.csv -> ops/s of each fs and its ratio to the first fs of -f
+function report(){
+    local base_fs=${fs_list%% *}
+
+    awk -F, -v base=$base_fs -v order="$fs_list" '
+        BEGIN { nf = split(order, fl, " ") }
+        NR > 1 { key = $2 " t" $3; ops[key, $1] = $6; if (!(key in seen)) { seen[key] = 1; keys[++nk] = key } }
+        END {
+            printf "%-24s", "case"
+            for (i = 1; i <= nf; i++) printf "%16s", fl[i]
+            printf "\n"
+            for (k = 1; k <= nk; k++) {
+                printf "%-24s", keys[k]
+                for (i = 1; i <= nf; i++) {
+                    if (!((keys[k], fl[i]) in ops)) { printf "%16s", "-"; continue }
+                    v = ops[keys[k], fl[i]]; b = ops[keys[k], base]
+                    if (fl[i] == base || b == 0) printf "%16.1f", v
+                    else printf "%9.1f(%4.2f)", v, v / b
+                }
+                printf "\n"
+            }
+            printf "\nmedian ops/s over repetitions, (x) is the ratio to %s\n", base
+        }' $out_path/summary.csv > $out_path/report.txt
+    cat $out_path/report.txt
+}
+
+while getopts "f:p:c:t:r:d:o:m:Ph" opt; do
+    case $opt in
+        f) fs_list=$OPTARG ;;
+        p) profile_list=$OPTARG ;;
+        c) case_list=$OPTARG ;;
+        t) thread_list=$OPTARG ;;
+        r) nr_reps=$OPTARG ;;
+        d) dev_spec=$OPTARG ;;
+        o) out_path=$OPTARG ;;
+        m) mount_path=$OPTARG ;;
+        P) perf_on=0 ;;
+        h) help_cmd; exit 0 ;;
+        *) help_cmd; exit 1 ;;
+    esac
+done
+
+if [ -z "$case_list" ]; then
+    for p in $profile_list; do
+        case_list="$case_list ${profile_cases[$p]}"
+    done
+fi
+for c in $case_list; do
+    if [ -z "${case_file[$c]}" ]; then
+        fail "invalid test case $c, plz check"
+        exit 1
+    fi
+done
+
+## test steps
+mkdir -p $out_path
+sudo mkdir -p $mount_path
+sudo sh -c 'echo 0 > /proc/sys/kernel/randomize_va_space'
+setup_dev || exit 1
+info "Begin to filebench test, results in $out_path"
+{
+    echo "fs: $fs_list"
+    echo "cases: $case_list"
+    echo "threads: $thread_list"
+    echo "reps: $nr_reps"
+    echo "device: $dev_spec $dev_path"
+    echo "kernel: $(uname -r)"
+    echo "date: $(date)"
+} > $out_path/config.txt
+
+echo "fs,case,threads,rep,ops,ops_s,mb_s,lat_ms" > $out_path/results.csv
+echo "fs,case,threads,rep,flowop,ops,ops_s,mb_s,lat_ms,min_ms,max_ms" > $out_path/flowops.csv
+echo "fs,case,threads,rep,event,value" > $out_path/perf.csv
+
+for name in $case_list; do
+    for threads in $thread_list; do
+        for fs in $fs_list; do
+            for rep in $(seq 1 $nr_reps); do
+                run_one $fs $name $threads $rep
+            done
+        done
+    done
+done
+
+release_dev
+summarize
+report
+info "filebench test Over, $(date)"
@@ -0,0 +1,41 @@
+#!/bin/bash
+# Compare two ./bench.sh result directories, e.g. the last release against this one:
+#   ./bench_compare.sh ../results/old ../results/new [threshold_percent]
+# A run regresses when its median ops/s drops or its median latency grows by more than
+# threshold_percent (default 5), and with 3+ repetitions the old and new ranges
+# (p5..p95 of ops/s) do not overlap, so that noise alone does not fail a release.
+# Exits 1 when any run regressed.
+
+old_path=$1
+new_path=$2
+threshold=${3:-5}
+
+if [ ! -f "$old_path/summary.csv" ] || [ ! -f "$new_path/summary.csv" ]; then
+    echo "./bench_compare.sh old_result_dir new_result_dir [threshold_percent]"
+    exit 1
+fi
+
+awk -F, -v th=$threshold '
+    # summary.csv: fs,case,threads,reps,ops_s_mean,ops_s_p50,ops_s_p5,ops_s_p95,lat_ms_p50,lat_ms_p90,lat_ms_p99
+    BEGIN { printf "%-32s %12s %12s %8s %8s\n", "fs,case,threads", "old ops/s", "new ops/s", "ops/s", "lat" }
+    FNR == 1 { next }
+    NR == FNR { key = $1 "," $2 "," $3; old_ops[key] = $6; old_lo[key] = $7; old_hi[key] = $8; old_lat[key] = $9; next }
+    {
+        key = $1 "," $2 "," $3
+        if (!(key in old_ops)) { printf "%-32s %12s %12.1f %8s  new\n", key, "-", $6, "-"; next }
+
+        d_ops = old_ops[key] > 0 ? ($6 - old_ops[key]) * 100 / old_ops[key] : 0
+        d_lat = old_lat[key] > 0 ? ($9 - old_lat[key]) * 100 / old_lat[key] : 0
+        apart = $4 < 3 || $8 < old_lo[key] || $7 > old_hi[key]
+
+        verdict = ""
+        if ((d_ops < -th || d_lat > th) && apart) { verdict = "REGRESSION"; nr_bad++ }
+        else if (d_ops > th && apart) { verdict = "improved" }
+        printf "%-32s %12.1f %12.1f %+7.1f%% %+7.1f%%  %s\n", key, old_ops[key], $6, d_ops, d_lat, verdict
+    }
+    END {
+        printf "\n%d regression(s), threshold %s%%\n", nr_bad, th
+        exit nr_bad ? 1 : 0
+    }' $old_path/summary.csv $new_path/summary.csv | tee $new_path/compare.txt
+
+exit ${PIPESTATUS[0]}